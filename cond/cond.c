@@ -30,9 +30,12 @@
 
 static int cond_error_scaling(iri_result *iri, msis_result *msis,
                               cond_workspace *w);
-static double cond_direct(cond_result *result, cond_workspace *w);
-static double cond_pederson(cond_result *result, cond_workspace *w);
-static double cond_hall(cond_result *result, cond_workspace *w);
+static void cond_conductivities(const size_t nalt, cond_workspace *w);
+
+/* ion masses, indexed by COND_ION_xxx */
+static const double cond_ion_mass[COND_NION] = {
+  COND_MASS_O, COND_MASS_H, COND_MASS_HE, COND_MASS_O2, COND_MASS_NO, COND_MASS_N
+};
 
 cond_workspace *
 cond_alloc(size_t nalt, const char *f107_datafile)
@@ -47,14 +50,56 @@ cond_alloc(size_t nalt, const char *f107_datafile)
       return 0;
     }
 
-  w->cond_results = malloc(nalt * sizeof(cond_result));
-  if (!w->cond_results)
+  w->profile.data = malloc(COND_PROFILE_NFIELDS * nalt * sizeof(double));
+  if (!w->profile.data)
     {
       fprintf(stderr, "cond_alloc: malloc failed: %s\n", strerror(errno));
       cond_free(w);
       return 0;
     }
 
+  /* assign altitude arrays */
+  {
+    cond_profile *p = &(w->profile);
+    double *ptr = p->data;
+    size_t k;
+
+    p->height = ptr; ptr += nalt;
+    p->B = ptr; ptr += nalt;
+    p->rA = ptr; ptr += nalt;
+    p->n_n = ptr; ptr += nalt;
+    p->n_e = ptr; ptr += nalt;
+    p->T_e = ptr; ptr += nalt;
+    p->T_i = ptr; ptr += nalt;
+    p->T_n_iri = ptr; ptr += nalt;
+    p->T_n_msis = ptr; ptr += nalt;
+    p->v_en = ptr; ptr += nalt;
+    p->v_ei = ptr; ptr += nalt;
+    p->v_e = ptr; ptr += nalt;
+    p->n_N2p = ptr; ptr += nalt;
+    p->n_He = ptr; ptr += nalt;
+    p->n_O = ptr; ptr += nalt;
+    p->n_O2 = ptr; ptr += nalt;
+    p->n_N2 = ptr; ptr += nalt;
+    p->n_Ar = ptr; ptr += nalt;
+    p->n_H = ptr; ptr += nalt;
+    p->n_N = ptr; ptr += nalt;
+    p->v_O = ptr; ptr += nalt;
+    p->v_O2 = ptr; ptr += nalt;
+    p->v_N2 = ptr; ptr += nalt;
+    p->sigma_0 = ptr; ptr += nalt;
+    p->sigma_p = ptr; ptr += nalt;
+    p->sigma_h = ptr; ptr += nalt;
+
+    for (k = 0; k < COND_NION; ++k)
+      {
+        p->n_ion[k] = ptr; ptr += nalt;
+        p->v_ion[k] = ptr; ptr += nalt;
+      }
+  }
+
+  w->nalt = nalt;
+
   w->msynth_workspace_p = msynth_igrf_read(MSYNTH_IGRF_FILE);
   w->iri_workspace_p = iri_alloc(nalt, f107_datafile);
   w->msis_workspace_p = msis_alloc(nalt, f107_datafile);
@@ -73,8 +118,8 @@ cond_alloc(size_t nalt, const char *f107_datafile)
 void
 cond_free(cond_workspace *w)
 {
-  if (w->cond_results)
-    free(w->cond_results);
+  if (w->profile.data)
+    free(w->profile.data);
 
   if (w->msynth_workspace_p)
     msynth_free(w->msynth_workspace_p);
@@ -173,7 +218,10 @@ Return: success or error
 
 Notes:
 
-The units of the sigma outputs are SI (A / V / m)
+1) The units of the sigma outputs are SI (A / V / m)
+
+2) Results are stored in w->profile and may be accessed with
+cond_get_profile() or cond_get_result()
 */
 
 int
@@ -183,8 +231,15 @@ cond_calc(double theta, double phi, time_t t, double altmin,
   int s = 0;
   const double R = R_EARTH_KM;
   const double tyear = get_year(t);
-  size_t i, j;
-  cond_result result;
+  cond_profile *p = &(w->profile);
+  size_t i, k;
+
+  if (nalt > w->nalt)
+    {
+      fprintf(stderr, "cond_calc: specified nalt exceeds previous value (%zu,%zu)\n",
+              nalt, w->nalt);
+      return 1;
+    }
 
   /* compute IRI and MSIS values */
   s += iri_calc(theta, phi, t, altmin, altstp, nalt, w->iri_workspace_p);
@@ -196,253 +251,313 @@ cond_calc(double theta, double phi, time_t t, double altmin,
       return s;
     }
 
+  /* gather model outputs into altitude arrays */
   for (i = 0; i < nalt; ++i)
     {
       double alt = altmin + i * altstp;
       double r = R + alt;
       iri_result *result_iri = iri_get_result(i, w->iri_workspace_p);
       msis_result *result_msis = msis_get_result(i, w->msis_workspace_p);
+      double n_n;   /* neutral density */
       double A;     /* mean molecular weight */
       double B[4];  /* magnetic field */
 
       /* perform scaling for error analysis if necessary */
       cond_error_scaling(result_iri, result_msis, w);
 
-      /*result.n_n = result_msis->n_n;*/
-      result.n_n = result_msis->n_O +
-                   result_msis->n_O2 +
-                   result_msis->n_N2;
+      n_n = result_msis->n_O +
+            result_msis->n_O2 +
+            result_msis->n_N2;
 
       A = (16.0*result_msis->n_O + 32.0*result_msis->n_O2 +
-           28.02*result_msis->n_N2) / result.n_n;
+           28.02*result_msis->n_N2) / n_n;
+
+      p->rA[i] = sqrt(1.0 / A);
 
       /*
        * convert densities to cm^{-3} since Kelley's formulas use that
        * assumption
        */
 
-      result.n_n *= 1.0e-6;
-      result.n_e = result_iri->Ne * 1.0e-6;
+      p->n_n[i] = n_n * 1.0e-6;
 
-      result.n_Op = result_iri->n_Op * 1.0e-6;
-      result.n_Hp = result_iri->n_Hp * 1.0e-6;
-      result.n_HEp = result_iri->n_HEp * 1.0e-6;
-      result.n_O2p = result_iri->n_O2p * 1.0e-6;
-      result.n_NOp = result_iri->n_NOp * 1.0e-6;
-      result.n_Np = result_iri->n_Np * 1.0e-6;
+      p->n_ion[COND_ION_O][i] = result_iri->n_Op * 1.0e-6;
+      p->n_ion[COND_ION_H][i] = result_iri->n_Hp * 1.0e-6;
+      p->n_ion[COND_ION_HE][i] = result_iri->n_HEp * 1.0e-6;
+      p->n_ion[COND_ION_O2][i] = result_iri->n_O2p * 1.0e-6;
+      p->n_ion[COND_ION_NO][i] = result_iri->n_NOp * 1.0e-6;
+      p->n_ion[COND_ION_N][i] = result_iri->n_Np * 1.0e-6;
 
-      /*
-       * sometimes IRI calculates densities where:
-       * Sum [ n_i ] != n_e
-       * but the conductivity formulas require this condition to work
-       * (particularly the Hall conductivity)
-       */
-      result.n_e = result.n_Op + result.n_Hp + result.n_HEp +
-                   result.n_O2p + result.n_NOp + result.n_Np;
-
-      result.n_He = result_msis->n_He * 1.0e-6;
-      result.n_O = result_msis->n_O * 1.0e-6;
-      result.n_O2 = result_msis->n_O2 * 1.0e-6;
-      result.n_N2 = result_msis->n_N2 * 1.0e-6;
-      result.n_Ar = result_msis->n_Ar * 1.0e-6;
-      result.n_H = result_msis->n_H * 1.0e-6;
-      result.n_N = result_msis->n_N * 1.0e-6;
-
-      /* store temperatures */
-
-      result.T_e = result_iri->Te;
-      result.T_i = result_iri->Ti;
-      result.T_n_iri = result_iri->Tn;
-      result.T_n_msis = result_msis->T_n;
+      p->n_He[i] = result_msis->n_He * 1.0e-6;
+      p->n_O[i] = result_msis->n_O * 1.0e-6;
+      p->n_O2[i] = result_msis->n_O2 * 1.0e-6;
+      p->n_N2[i] = result_msis->n_N2 * 1.0e-6;
+      p->n_Ar[i] = result_msis->n_Ar * 1.0e-6;
+      p->n_H[i] = result_msis->n_H * 1.0e-6;
+      p->n_N[i] = result_msis->n_N * 1.0e-6;
 
       /*
        * Below 120km, IRI does not provide temperatures, but assumes
        * thermal equilibrium: T_e = T_i = T_n, so use the neutral
        * temperature from MSIS for this region
        */
-      if (result.T_i < 0.0)
-        result.T_i = result_msis->T_n;
-      if (result.T_e < 0.0)
-        result.T_e = result_msis->T_n;
-      if (result.T_n_iri < 0.0)
-        result.T_n_iri = result_msis->T_n;
+      p->T_e[i] = (result_iri->Te < 0.0) ? result_msis->T_n : result_iri->Te;
+      p->T_i[i] = (result_iri->Ti < 0.0) ? result_msis->T_n : result_iri->Ti;
+      p->T_n_iri[i] = (result_iri->Tn < 0.0) ? result_msis->T_n : result_iri->Tn;
+      p->T_n_msis[i] = result_msis->T_n;
+
+      msynth_eval(tyear, r, theta, phi, B, w->msynth_workspace_p);
+
+      /* convert to T */
+      p->B[i] = B[3] * 1.0e-9;
+      p->height[i] = alt;
+    }
+
+  /*
+   * sometimes IRI calculates densities where:
+   * Sum [ n_i ] != n_e
+   * but the conductivity formulas require this condition to work
+   * (particularly the Hall conductivity)
+   */
+  for (i = 0; i < nalt; ++i)
+    p->n_e[i] = 0.0;
 
-      result.v_en = 5.4e-10 * result.n_n * sqrt(result.T_e);
+  for (k = 0; k < COND_NION; ++k)
+    {
+      const double *n_i = p->n_ion[k];
+
+      for (i = 0; i < nalt; ++i)
+        p->n_e[i] += n_i[i];
+    }
+
+  /* electron and neutral collision frequencies */
+  for (i = 0; i < nalt; ++i)
+    {
+      double n_e = p->n_e[i];
+      double T_e = p->T_e[i];
+      double v_ei;
+
+      p->v_en[i] = 5.4e-10 * p->n_n[i] * sqrt(T_e);
 
       /*
        * For altitudes below 80km, IRI does not produce an electron
        * density since it is so small. In this region, set v_ei = 0
        */
-      if (result.n_e < 1.0e-5)
-        result.v_ei = 0.0;
+      if (n_e < 1.0e-5)
+        v_ei = 0.0;
       else
-        result.v_ei = (34.0 + 4.18*log10(result.T_e * result.T_e * result.T_e / result.n_e)) *
-                     result.n_e * pow(result.T_e, -1.5);
+        v_ei = (34.0 + 4.18*log10(T_e * T_e * T_e / n_e)) * n_e / (T_e * sqrt(T_e));
 
-      result.v_e = result.v_en + result.v_ei;
+      p->v_ei[i] = v_ei;
 
       /* effective collision frequency (factor-4 correction) */
-      result.v_e *= w->alpha;
-
-      result.v_e_sq = result.v_e * result.v_e;
+      p->v_e[i] = w->alpha * (p->v_en[i] + v_ei);
 
       /* N2+ is not given by IRI so estimate from MSIS */
-      result.n_N2p = result.n_N2 / result.n_n * result.n_e;
-
-      result.v_Op = 2.6e-9 * (result.n_Op + result.n_n) * sqrt(1.0 / A);
-      result.v_Op_sq = result.v_Op * result.v_Op;
-      result.v_Hp = 2.6e-9 * (result.n_Hp + result.n_n) * sqrt(1.0 / A);
-      result.v_Hp_sq = result.v_Hp * result.v_Hp;
-      result.v_HEp = 2.6e-9 * (result.n_HEp + result.n_n) * sqrt(1.0 / A);
-      result.v_HEp_sq = result.v_HEp * result.v_HEp;
-      result.v_O2p = 2.6e-9 * (result.n_O2p + result.n_n) * sqrt(1.0 / A);
-      result.v_O2p_sq = result.v_O2p * result.v_O2p;
-      result.v_NOp = 2.6e-9 * (result.n_NOp + result.n_n) * sqrt(1.0 / A);
-      result.v_NOp_sq = result.v_NOp * result.v_NOp;
-      result.v_Np = 2.6e-9 * (result.n_Np + result.n_n) * sqrt(1.0 / A);
-      result.v_Np_sq = result.v_Np * result.v_Np;
-
-      result.v_O = 2.6e-9 * (result.n_O + result.n_n) * sqrt(1.0 / A);
-      result.v_O_sq = result.v_O * result.v_O;
-      result.v_O2 = 2.6e-9 * (result.n_O2 + result.n_n) * sqrt(1.0 / A);
-      result.v_O2_sq = result.v_O2 * result.v_O2;
-      result.v_N2 = 2.6e-9 * (result.n_N2 + result.n_n) * sqrt(1.0 / A);
-      result.v_N2_sq = result.v_N2 * result.v_N2;
+      p->n_N2p[i] = p->n_N2[i] / p->n_n[i] * n_e;
 
-      msynth_eval(tyear, r, theta, phi, B, w->msynth_workspace_p);
-      
-      /* convert to T */
-      for (j = 0; j < 4; ++j)
-        B[j] *= 1.0e-9;
-
-      /* compute gyro-frequencies */
-
-      result.w_e = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] /
-                   GSL_CONST_MKSA_MASS_ELECTRON;
-      result.w_e_sq = result.w_e * result.w_e;
-
-      result.w_Op = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] / COND_MASS_O;
-      result.w_Op_sq = result.w_Op * result.w_Op;
-      result.w_Hp = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] / COND_MASS_H;
-      result.w_Hp_sq = result.w_Hp * result.w_Hp;
-      result.w_HEp = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] / COND_MASS_HE;
-      result.w_HEp_sq = result.w_HEp * result.w_HEp;
-      result.w_O2p = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] / COND_MASS_O2;
-      result.w_O2p_sq = result.w_O2p * result.w_O2p;
-      result.w_NOp = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] / COND_MASS_NO;
-      result.w_NOp_sq = result.w_NOp * result.w_NOp;
-      result.w_Np = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] / COND_MASS_N;
-      result.w_Np_sq = result.w_Np * result.w_Np;
-
-      result.w_O = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] / COND_MASS_O;
-      result.w_O_sq = result.w_O * result.w_O;
-      result.w_O2 = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] / COND_MASS_O2;
-      result.w_O2_sq = result.w_O2 * result.w_O2;
-      result.w_N2 = GSL_CONST_MKSA_ELECTRON_CHARGE * B[3] / COND_MASS_N2;
-      result.w_N2_sq = result.w_N2 * result.w_N2;
-
-      result.B = B[3];
-      result.height = alt;
-
-      /* compute and store conductivities */
-      result.sigma_0 = cond_direct(&result, w);
-      result.sigma_p = cond_pederson(&result, w);
-      result.sigma_h = cond_hall(&result, w);
-
-      w->cond_results[i] = result;
-
-#if 0
-      printf("%f %e %e %e %e %e %e %e %e %e %e %e\n",
-             alt,
-             result.n_n,
-             result.n_e,
-             result.T_e,
-             result.T_i,
-             result.v_e,
-             result.v_Op,
-             result.v_O2p,
-             result.v_NOp,
-             result.v_Np,
-             result.v_HEp,
-             result.v_Hp);
-#endif
+      p->v_O[i] = 2.6e-9 * (p->n_O[i] + p->n_n[i]) * p->rA[i];
+      p->v_O2[i] = 2.6e-9 * (p->n_O2[i] + p->n_n[i]) * p->rA[i];
+      p->v_N2[i] = 2.6e-9 * (p->n_N2[i] + p->n_n[i]) * p->rA[i];
+    }
+
+  /* ion collision frequencies */
+  for (k = 0; k < COND_NION; ++k)
+    {
+      const double *n_i = p->n_ion[k];
+      double *v_i = p->v_ion[k];
+
+      for (i = 0; i < nalt; ++i)
+        v_i[i] = 2.6e-9 * (n_i[i] + p->n_n[i]) * p->rA[i];
     }
 
+  /* compute and store conductivities */
+  cond_conductivities(nalt, w);
+
   return s;
 } /* cond_calc() */
 
+/*
+cond_get_profile()
+  Return altitude profiles computed by the last call to cond_calc()
+*/
+
+const cond_profile *
+cond_get_profile(const cond_workspace *w)
+{
+  return &(w->profile);
+} /* cond_get_profile() */
+
 /*
 cond_get_result()
+  Return all quantities at a single altitude step
+
+Notes:
+1) The returned pointer refers to a single structure in the workspace,
+which is overwritten by the next call
 */
 
 cond_result *
 cond_get_result(size_t idx, cond_workspace *w)
 {
-  return (&(w->cond_results[idx]));
+  const cond_profile *p = &(w->profile);
+  cond_result *result = &(w->result);
+  const double e = GSL_CONST_MKSA_ELECTRON_CHARGE;
+  const double B = p->B[idx];
+
+  result->n_n = p->n_n[idx];
+  result->n_e = p->n_e[idx];
+  result->v_en = p->v_en[idx];
+  result->v_ei = p->v_ei[idx];
+  result->v_e = p->v_e[idx];
+  result->v_e_sq = result->v_e * result->v_e;
+  result->T_e = p->T_e[idx];
+  result->T_i = p->T_i[idx];
+  result->T_n_iri = p->T_n_iri[idx];
+  result->T_n_msis = p->T_n_msis[idx];
+  result->w_e = e * B / GSL_CONST_MKSA_MASS_ELECTRON;
+  result->w_e_sq = result->w_e * result->w_e;
+
+  result->n_Op = p->n_ion[COND_ION_O][idx];
+  result->n_Hp = p->n_ion[COND_ION_H][idx];
+  result->n_HEp = p->n_ion[COND_ION_HE][idx];
+  result->n_O2p = p->n_ion[COND_ION_O2][idx];
+  result->n_NOp = p->n_ion[COND_ION_NO][idx];
+  result->n_Np = p->n_ion[COND_ION_N][idx];
+  result->n_N2p = p->n_N2p[idx];
+
+  result->n_He = p->n_He[idx];
+  result->n_O = p->n_O[idx];
+  result->n_O2 = p->n_O2[idx];
+  result->n_N2 = p->n_N2[idx];
+  result->n_Ar = p->n_Ar[idx];
+  result->n_H = p->n_H[idx];
+  result->n_N = p->n_N[idx];
+
+  result->v_Op = p->v_ion[COND_ION_O][idx];
+  result->v_Hp = p->v_ion[COND_ION_H][idx];
+  result->v_HEp = p->v_ion[COND_ION_HE][idx];
+  result->v_O2p = p->v_ion[COND_ION_O2][idx];
+  result->v_NOp = p->v_ion[COND_ION_NO][idx];
+  result->v_Np = p->v_ion[COND_ION_N][idx];
+
+  result->v_O = p->v_O[idx];
+  result->v_O2 = p->v_O2[idx];
+  result->v_N2 = p->v_N2[idx];
+
+  result->v_Op_sq = result->v_Op * result->v_Op;
+  result->v_Hp_sq = result->v_Hp * result->v_Hp;
+  result->v_HEp_sq = result->v_HEp * result->v_HEp;
+  result->v_O2p_sq = result->v_O2p * result->v_O2p;
+  result->v_NOp_sq = result->v_NOp * result->v_NOp;
+  result->v_Np_sq = result->v_Np * result->v_Np;
+
+  result->v_O_sq = result->v_O * result->v_O;
+  result->v_O2_sq = result->v_O2 * result->v_O2;
+  result->v_N2_sq = result->v_N2 * result->v_N2;
+
+  result->w_Op = e * B / COND_MASS_O;
+  result->w_Hp = e * B / COND_MASS_H;
+  result->w_HEp = e * B / COND_MASS_HE;
+  result->w_O2p = e * B / COND_MASS_O2;
+  result->w_NOp = e * B / COND_MASS_NO;
+  result->w_Np = e * B / COND_MASS_N;
+
+  result->w_O = e * B / COND_MASS_O;
+  result->w_O2 = e * B / COND_MASS_O2;
+  result->w_N2 = e * B / COND_MASS_N2;
+
+  result->w_Op_sq = result->w_Op * result->w_Op;
+  result->w_Hp_sq = result->w_Hp * result->w_Hp;
+  result->w_HEp_sq = result->w_HEp * result->w_HEp;
+  result->w_O2p_sq = result->w_O2p * result->w_O2p;
+  result->w_NOp_sq = result->w_NOp * result->w_NOp;
+  result->w_Np_sq = result->w_Np * result->w_Np;
+
+  result->w_O_sq = result->w_O * result->w_O;
+  result->w_O2_sq = result->w_O2 * result->w_O2;
+  result->w_N2_sq = result->w_N2 * result->w_N2;
+
+  result->B = B;
+  result->height = p->height[idx];
+
+  result->sigma_0 = p->sigma_0[idx];
+  result->sigma_p = p->sigma_p[idx];
+  result->sigma_h = p->sigma_h[idx];
+
+  return result;
 } /* cond_get_result() */
 
 /****************************************
  * INTERNAL ROUTINES                    *
  ****************************************/
 
-static double
-cond_direct(cond_result *result, cond_workspace *w)
-{
-  double sigma =
-    1.0e6 * w->e_sq *
-    (result->n_e / GSL_CONST_MKSA_MASS_ELECTRON / result->v_e +
-     result->n_Op / COND_MASS_O / result->v_Op +
-     result->n_O2p / COND_MASS_O2 / result->v_O2p +
-     result->n_NOp / COND_MASS_NO / result->v_NOp +
-     result->n_Hp / COND_MASS_H / result->v_Hp +
-     result->n_HEp / COND_MASS_HE / result->v_HEp +
-     result->n_Np / COND_MASS_N / result->v_Np);
-
-  return sigma;
-} /* cond_direct() */
-
-static double
-cond_pederson(cond_result *result, cond_workspace *w)
-{
-  double sigma =
-    1.0e6 * w->e_sq *
-    ((result->n_e * result->v_e / GSL_CONST_MKSA_MASS_ELECTRON) /
-     (result->v_e_sq + result->w_e_sq) +
-     (result->n_Op * result->v_Op / COND_MASS_O) /
-     (result->v_Op_sq + result->w_Op_sq) +
-     (result->n_O2p * result->v_O2p / COND_MASS_O2) /
-     (result->v_O2p_sq + result->w_O2p_sq) +
-     (result->n_NOp * result->v_NOp / COND_MASS_NO) /
-     (result->v_NOp_sq + result->w_NOp_sq) +
-     (result->n_Hp * result->v_Hp / COND_MASS_H) /
-     (result->v_Hp_sq + result->w_Hp_sq) +
-     (result->n_HEp * result->v_HEp / COND_MASS_HE) /
-     (result->v_HEp_sq + result->w_HEp_sq) +
-     (result->n_Np * result->v_Np / COND_MASS_N) /
-     (result->v_Np_sq + result->w_Np_sq));
-
-  return sigma;
-} /* cond_pederson() */
-
-static double
-cond_hall(cond_result *result, cond_workspace *w)
+/*
+cond_conductivities()
+  Compute direct, Pedersen and Hall conductivities over the
+altitude profile:
+
+sigma_0 = e^2 sum_s n_s / (m_s v_s)
+sigma_p = e^2 sum_s n_s v_s / (m_s (v_s^2 + w_s^2))
+sigma_h = e^2 sum_s q_s n_s w_s / (m_s (v_s^2 + w_s^2))
+
+where the sum is over electrons and the ion species, q_s = +1 for
+electrons and -1 for ions, and w_s = e B / m_s is the gyro-frequency
+
+Notes:
+1) Each species is accumulated in a separate unit-stride loop over
+altitude
+*/
+
+static void
+cond_conductivities(const size_t nalt, cond_workspace *w)
 {
-  double sigma =
-    1.0e6 * w->e_sq *
-    ((result->n_e * result->w_e / GSL_CONST_MKSA_MASS_ELECTRON) /
-     (result->v_e_sq + result->w_e_sq) -
-     (result->n_Op * result->w_Op / COND_MASS_O) /
-     (result->v_Op_sq + result->w_Op_sq) -
-     (result->n_O2p * result->w_O2p / COND_MASS_O2) /
-     (result->v_O2p_sq + result->w_O2p_sq) -
-     (result->n_Hp * result->w_Hp / COND_MASS_H) /
-     (result->v_Hp_sq + result->w_Hp_sq) -
-     (result->n_HEp * result->w_HEp / COND_MASS_HE) /
-     (result->v_HEp_sq + result->w_HEp_sq) -
-     (result->n_Np * result->w_Np / COND_MASS_N) /
-     (result->v_Np_sq + result->w_Np_sq) -
-     (result->n_NOp * result->w_NOp / COND_MASS_NO) /
-     (result->v_NOp_sq + result->w_NOp_sq));
-
-  return sigma;
-} /* cond_hall() */
+  cond_profile *p = &(w->profile);
+  const double e = GSL_CONST_MKSA_ELECTRON_CHARGE;
+  const double c = 1.0e6 * w->e_sq;
+  double *s0 = p->sigma_0;
+  double *sp = p->sigma_p;
+  double *sh = p->sigma_h;
+  size_t i, k;
+
+  /* electron contribution */
+  for (i = 0; i < nalt; ++i)
+    {
+      double v = p->v_e[i];
+      double wg = e * p->B[i] / GSL_CONST_MKSA_MASS_ELECTRON;
+      double n = p->n_e[i] / GSL_CONST_MKSA_MASS_ELECTRON;
+      double d = v * v + wg * wg;
+
+      s0[i] = n / v;
+      sp[i] = n * v / d;
+      sh[i] = n * wg / d;
+    }
+
+  /* ion contributions */
+  for (k = 0; k < COND_NION; ++k)
+    {
+      const double m = cond_ion_mass[k];
+      const double q = e / m;
+      const double *n_i = p->n_ion[k];
+      const double *v_i = p->v_ion[k];
+
+      for (i = 0; i < nalt; ++i)
+        {
+          double v = v_i[i];
+          double wg = q * p->B[i];
+          double n = n_i[i] / m;
+          double d = v * v + wg * wg;
+
+          s0[i] += n / v;
+          sp[i] += n * v / d;
+          sh[i] -= n * wg / d;
+        }
+    }
+
+  for (i = 0; i < nalt; ++i)
+    {
+      s0[i] *= c;
+      sp[i] *= c;
+      sh[i] *= c;
+    }
+} /* cond_conductivities() */
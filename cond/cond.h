@@ -99,6 +99,59 @@ typedef struct
   double sigma_h;
 } cond_result;
 
+/* ion species indices for cond_profile arrays */
+#define COND_ION_O      0
+#define COND_ION_H      1
+#define COND_ION_HE     2
+#define COND_ION_O2     3
+#define COND_ION_NO     4
+#define COND_ION_N      5
+#define COND_NION       6
+
+/* number of altitude arrays in cond_profile */
+#define COND_PROFILE_NFIELDS    (26 + 2 * COND_NION)
+
+/*
+ * altitude profiles stored as one array per quantity, so the
+ * collision frequency and conductivity loops over altitude have
+ * unit stride; gyro-frequencies and squared terms are computed
+ * on the fly from B and the collision frequencies
+ */
+typedef struct
+{
+  double *height;    /* altitude in km */
+  double *B;         /* magnetic field in T */
+  double *rA;        /* 1 / sqrt(mean molecular weight) */
+  double *n_n;       /* neutral density in cm^{-3} */
+  double *n_e;       /* electron density in cm^{-3} */
+  double *T_e;       /* electron temperature (K) */
+  double *T_i;       /* ion temperature (K) */
+  double *T_n_iri;   /* neutral temperature from IRI (K) */
+  double *T_n_msis;  /* neutral temperature from MSIS (K) */
+  double *v_en;      /* electron-neutral collision frequency in 1/s */
+  double *v_ei;      /* electron-ion collision frequency in 1/s */
+  double *v_e;       /* effective electron collision frequency in 1/s */
+  double *n_N2p;     /* N2+ density in cm^{-3} */
+  double *n_He;      /* neutral densities in cm^{-3} */
+  double *n_O;
+  double *n_O2;
+  double *n_N2;
+  double *n_Ar;
+  double *n_H;
+  double *n_N;
+  double *v_O;       /* neutral collision frequencies in 1/s */
+  double *v_O2;
+  double *v_N2;
+  double *sigma_0;   /* direct conductivity */
+  double *sigma_p;   /* Pedersen conductivity */
+  double *sigma_h;   /* Hall conductivity */
+
+  double *n_ion[COND_NION]; /* ion densities in cm^{-3} */
+  double *v_ion[COND_NION]; /* ion collision frequencies in 1/s */
+
+  double *data;      /* storage for all arrays */
+} cond_profile;
+
 typedef struct
 {
   msynth_workspace *msynth_workspace_p;
@@ -117,7 +170,8 @@ typedef struct
   double iri_n_scale;
   double iri_T_scale;
 
-  cond_result *cond_results; /* results for each altitude step */
+  cond_profile profile;      /* results for each altitude step */
+  cond_result result;        /* single altitude view for cond_get_result() */
   size_t nalt;               /* number of altitude steps */
 } cond_workspace;
 
@@ -144,5 +198,6 @@ int cond_calc(double theta, double phi, time_t t,
               double altmin, double altstp, size_t nalt,
               cond_workspace *w);
 cond_result *cond_get_result(size_t idx, cond_workspace *w);
+const cond_profile *cond_get_profile(const cond_workspace *w);
 
 #endif /* INCLUDED_cond_h */
@@ -259,20 +259,24 @@ calc_quaternions_ECEF(const double r_ECEF[3], const double v_ECEF[3], double q[4
 int
 interp_eph(satdata_mag *data, eph_data *eph)
 {
-  int s = 0;
   size_t i, j;
   eph_workspace *w = eph_alloc(eph);
+  double *POS = malloc(3 * data->n * sizeof(double));
+  double *VEL = malloc(3 * data->n * sizeof(double));
+
+  /* interpolate ephemeris data to all timestamps */
+  eph_interp_n(data->n, data->t, POS, VEL, w);
 
   for (i = 0; i < data->n; ++i)
     {
-      double pos[3], vel[3]; /* position and velocity (ECI or ECEF) */
+      double *pos = &POS[3 * i]; /* position (ECI or ECEF) */
+      double *vel = &VEL[3 * i]; /* velocity (ECI or ECEF) */
       double r, theta, phi;
       double q[4];           /* quaternions for rotation S/C to NEC */
 
-      /* interpolate ephemeris data to time ti */
-      s = eph_interp(data->t[i], pos, vel, w);
-      if (s)
+      if (gsl_isnan(pos[0]))
         {
+          /* outside ephemeris range */
           data->flags[i] |= SATDATA_FLG_NOEPH;
           continue;
         }
@@ -304,6 +308,9 @@ interp_eph(satdata_mag *data, eph_data *eph)
       else
         {
           fprintf(stderr, "interp_eph: unknown interpolation type\n");
+          free(POS);
+          free(VEL);
+          eph_free(w);
           return -1;
         }
 
@@ -316,6 +323,8 @@ interp_eph(satdata_mag *data, eph_data *eph)
     }
 
   eph_free(w);
+  free(POS);
+  free(VEL);
 
   return 0;
 }
@@ -330,7 +339,7 @@ main(int argc, char *argv[])
   int c;
   struct timeval tv0, tv1;
 
-  while ((c = getopt(argc, argv, "i:o:b:t:")) != (-1))
+  while ((c = getopt(argc, argv, "i:o:b:e:t:")) != (-1))
     {
       switch (c)
         {
@@ -346,6 +355,16 @@ main(int argc, char *argv[])
             fprintf(stderr, "done (%zu read, %g seconds)\n", eph->n, time_diff(tv0, tv1));
             break;
 
+          case 'e':
+            fprintf(stderr, "main: mapping ephemeris cache %s...", optarg);
+            gettimeofday(&tv0, NULL);
+            eph = eph_data_map(optarg);
+            gettimeofday(&tv1, NULL);
+            if (!eph)
+              exit(1);
+            fprintf(stderr, "done (%zu records, %g seconds)\n", eph->n, time_diff(tv0, tv1));
+            break;
+
           case 't':
             fprintf(stderr, "main: reading TENA ephemerides from %s...", optarg);
             gettimeofday(&tv0, NULL);
@@ -362,7 +381,7 @@ main(int argc, char *argv[])
 
   if (!infile)
     {
-      fprintf(stderr, "Usage: %s <-i DMSP_ascii_gz_file> [-o output_cdf_file] [-b bowman_ephemeris_file] [-t tena_ephemeris_file]\n",
+      fprintf(stderr, "Usage: %s <-i DMSP_ascii_gz_file> [-o output_cdf_file] [-b bowman_ephemeris_file] [-t tena_ephemeris_file] [-e ephemeris_cache_file]\n",
               argv[0]);
       exit(1);
     }
@@ -15,6 +15,9 @@
 #include "eph_data.h"
 #include "hermite.h"
 
+static void eph_hermite_eval(const size_t idx, const double t_sec, double r[3], double v[3],
+                             const eph_workspace *w);
+
 eph_workspace *
 eph_alloc(const eph_data *data)
 {
@@ -109,13 +112,82 @@ eph_interp(const double t, double r[3], double v[3], eph_workspace *w)
       return -1;
     }
 
-  r[0] = hermite_eval(w->t, data->X, data->VX, t_sec, w->acc, w->hermite_x);
-  r[1] = hermite_eval(w->t, data->Y, data->VY, t_sec, w->acc, w->hermite_y);
-  r[2] = hermite_eval(w->t, data->Z, data->VZ, t_sec, w->acc, w->hermite_z);
+  /* one interval search for all six outputs */
+  eph_hermite_eval(gsl_interp_accel_find(w->acc, w->t, n, t_sec), t_sec, r, v, w);
+
+  return s;
+}
+
+/*
+eph_interp_n()
+  Interpolate ephemeris to a set of times
+
+Inputs: n - number of timestamps
+        t - timestamps (CDF_EPOCH), length n, preferably sorted
+        r - (output) X,Y,Z of interpolated times (ECI or ECEF), length 3*n;
+            r[3*i + j] is component j at time t[i]
+        v - (output) VX,VY,VZ of interpolated times (ECI or ECEF), length 3*n
+        w - workspace
+
+Return: success, or -1 if some timestamps are outside the ephemeris range
 
-  v[0] = hermite_eval_deriv(w->t, data->X, data->VX, t_sec, w->acc, w->hermite_x);
-  v[1] = hermite_eval_deriv(w->t, data->Y, data->VY, t_sec, w->acc, w->hermite_y);
-  v[2] = hermite_eval_deriv(w->t, data->Z, data->VZ, t_sec, w->acc, w->hermite_z);
+Notes:
+1) The interval index is kept in a local cursor, which is advanced
+forward from the previous point, so sorted input costs O(1) per point
+and w is not modified. Several threads may call this function on the
+same workspace at the same time.
+
+2) Outputs for timestamps outside the ephemeris range are set to NaN
+*/
+
+int
+eph_interp_n(const size_t n, const double t[], double r[], double v[],
+             const eph_workspace *w)
+{
+  int s = 0;
+  const size_t neph = w->n;
+  const double *ta = w->t;
+  size_t idx = 0; /* cursor: ta[idx] <= t_sec < ta[idx + 1] */
+  size_t i, j;
+
+  for (i = 0; i < n; ++i)
+    {
+      const double t_sec = t[i] / 1000.0; /* convert to sec */
+
+      if (t_sec < ta[0] || t_sec > ta[neph - 1])
+        {
+          for (j = 0; j < 3; ++j)
+            {
+              r[3 * i + j] = GSL_NAN;
+              v[3 * i + j] = GSL_NAN;
+            }
+
+          s = -1;
+          continue;
+        }
+
+      if (t_sec < ta[idx])
+        {
+          /* input not sorted; restart search */
+          idx = gsl_interp_bsearch(ta, t_sec, 0, neph - 1);
+        }
+      else
+        {
+          while (idx < neph - 2 && t_sec >= ta[idx + 1])
+            {
+              /* jump with a binary search if more than a few intervals away */
+              if (idx + 8 < neph - 1 && t_sec >= ta[idx + 8])
+                {
+                  idx = gsl_interp_bsearch(ta, t_sec, idx + 8, neph - 1);
+                  break;
+                }
+
+              ++idx;
+            }
+        }
+
+      eph_hermite_eval(idx, t_sec, &r[3 * i], &v[3 * i], w);
+    }
 
   return s;
 }
@@ -167,3 +239,58 @@ eph_interp_sph(const double t, double r_sph[3], eph_workspace *w)
 
   return GSL_SUCCESS;
 }
+
+/*
+eph_hermite_eval()
+  Evaluate cubic Hermite interpolants of position and velocity
+on interval [t_idx, t_{idx+1}]
+
+Inputs: idx   - interval index
+        t_sec - time (seconds)
+        r     - (output) X,Y,Z
+        v     - (output) VX,VY,VZ
+        w     - workspace
+
+Notes:
+1) Equivalent to hermite_eval() and hermite_eval_deriv() with degree 3,
+but all six outputs share one set of basis functions
+*/
+
+static void
+eph_hermite_eval(const size_t idx, const double t_sec, double r[3], double v[3],
+                 const eph_workspace *w)
+{
+  const eph_data *data = w->data;
+  const double h = w->t[idx + 1] - w->t[idx];
+  const double s = (t_sec - w->t[idx]) / h;
+  const double s2 = s * s;
+  const double s3 = s2 * s;
+
+  /* basis functions and their derivatives with respect to s */
+  const double h00 = 2.0 * s3 - 3.0 * s2 + 1.0;
+  const double h10 = (s3 - 2.0 * s2 + s) * h;
+  const double h01 = 3.0 * s2 - 2.0 * s3;
+  const double h11 = (s3 - s2) * h;
+  const double d00 = (6.0 * s2 - 6.0 * s) / h;
+  const double d10 = 3.0 * s2 - 4.0 * s + 1.0;
+  const double d01 = -d00;
+  const double d11 = 3.0 * s2 - 2.0 * s;
+  const double *y[3], *dy[3];
+  size_t j;
+
+  y[0] = data->X;
+  y[1] = data->Y;
+  y[2] = data->Z;
+  dy[0] = data->VX;
+  dy[1] = data->VY;
+  dy[2] = data->VZ;
+
+  for (j = 0; j < 3; ++j)
+    {
+      const double y0 = y[j][idx], y1 = y[j][idx + 1];
+      const double m0 = dy[j][idx], m1 = dy[j][idx + 1];
+
+      r[j] = h00 * y0 + h10 * m0 + h01 * y1 + h11 * m1;
+      v[j] = d00 * y0 + d10 * m0 + d01 * y1 + d11 * m1;
+    }
+}
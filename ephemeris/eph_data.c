@@ -7,6 +7,11 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <cdf.h>
 #include <zlib.h>
 
@@ -16,14 +21,234 @@
 
 #include <common/common.h>
 
+#include "fileio.h"
 #include "eph_data.h"
 
+static void eph_data_set_columns(double *base, const size_t stride, eph_data *data);
+
+/*
+eph_data_alloc()
+  Allocate ephemeris data structure
+
+Inputs: n - initial number of records to allocate
+
+Return: pointer to structure with data->n = 0
+*/
+
+eph_data *
+eph_data_alloc(const size_t n)
+{
+  eph_data *data;
+
+  data = calloc(1, sizeof(eph_data));
+  if (!data)
+    return 0;
+
+  if (eph_data_realloc(n, data))
+    {
+      eph_data_free(data);
+      return 0;
+    }
+
+  return data;
+}
+
+/*
+eph_data_realloc()
+  Grow (or shrink) storage of ephemeris data structure to hold
+n records
+
+Inputs: n    - new number of records
+        data - ephemeris data
+
+Return: success/error
+
+Notes:
+1) All columns are stored in a single block of 9*n doubles
+2) Not allowed on data mapped with eph_data_map()
+*/
+
+int
+eph_data_realloc(const size_t n, eph_data *data)
+{
+  double *old = data->t;
+  double *base;
+  size_t nkeep = GSL_MIN(data->n, n);
+  size_t i;
+
+  if (data->map)
+    {
+      fprintf(stderr, "eph_data_realloc: cannot resize mapped ephemeris\n");
+      return -1;
+    }
+
+  base = malloc(EPH_DATA_CACHE_NCOL * n * sizeof(double));
+  if (!base)
+    {
+      fprintf(stderr, "eph_data_realloc: unable to allocate %zu records: %s\n",
+              n, strerror(errno));
+      return -1;
+    }
+
+  if (old)
+    {
+      /* copy existing columns into new block */
+      for (i = 0; i < EPH_DATA_CACHE_NCOL; ++i)
+        memcpy(base + i * n, old + i * data->ntot, nkeep * sizeof(double));
+
+      free(old);
+    }
+
+  eph_data_set_columns(base, n, data);
+  data->ntot = n;
+  data->n = nkeep;
+
+  return 0;
+}
+
 void
 eph_data_free(eph_data *data)
 {
+  if (data->map)
+    munmap(data->map, data->map_len);
+  else if (data->t)
+    free(data->t);
+
   free(data);
 }
 
+/*
+eph_data_write()
+  Write ephemeris data to binary cache file, which can later
+be mapped with eph_data_map()
+
+Inputs: filename - output file
+        data     - ephemeris data
+
+Return: success/error
+
+Notes:
+1) File format is a header of EPH_DATA_CACHE_HDR_SIZE bytes containing
+the magic string, n and flags, followed by the columns
+t, X, Y, Z, VX, VY, VZ, latitude, longitude, each of n doubles in
+native byte order
+*/
+
+int
+eph_data_write(const char *filename, const eph_data *data)
+{
+  const double *cols[EPH_DATA_CACHE_NCOL];
+  char hdr[EPH_DATA_CACHE_HDR_SIZE];
+  char tmpname[PATH_MAX];
+  size_t nwritten = 0;
+  size_t i;
+  FILE *fp;
+
+  fp = fileio_open(filename, tmpname);
+  if (!fp)
+    return -1;
+
+  memset(hdr, 0, sizeof(hdr));
+  memcpy(hdr, EPH_DATA_CACHE_MAGIC, 8);
+  memcpy(hdr + 8, &(data->n), sizeof(size_t));
+  memcpy(hdr + 8 + sizeof(size_t), &(data->flags), sizeof(size_t));
+  nwritten += fwrite(hdr, 1, sizeof(hdr), fp);
+
+  cols[0] = data->t;
+  cols[1] = data->X;
+  cols[2] = data->Y;
+  cols[3] = data->Z;
+  cols[4] = data->VX;
+  cols[5] = data->VY;
+  cols[6] = data->VZ;
+  cols[7] = data->latitude;
+  cols[8] = data->longitude;
+
+  for (i = 0; i < EPH_DATA_CACHE_NCOL; ++i)
+    nwritten += fwrite(cols[i], sizeof(double), data->n, fp);
+
+  return fileio_close(fp, nwritten == sizeof(hdr) + EPH_DATA_CACHE_NCOL * data->n,
+                      tmpname, filename);
+}
+
+/*
+eph_data_map()
+  Map binary ephemeris cache file written by eph_data_write()
+
+Inputs: filename - cache file
+
+Return: pointer to ephemeris data, whose arrays point into a
+read-only shared mapping of the file
+
+Notes:
+1) Pages are shared between all processes mapping the same file,
+and only the parts of the orbit which are accessed become resident
+2) The returned structure must not be modified or resized; free
+it with eph_data_free()
+*/
+
+eph_data *
+eph_data_map(const char *filename)
+{
+  eph_data *data;
+  struct stat sb;
+  size_t n, flags;
+  void *map;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    {
+      fprintf(stderr, "eph_data_map: unable to open %s: %s\n",
+              filename, strerror(errno));
+      return 0;
+    }
+
+  if (fstat(fd, &sb) != 0 || (size_t) sb.st_size < EPH_DATA_CACHE_HDR_SIZE)
+    {
+      fprintf(stderr, "eph_data_map: %s: invalid cache file\n", filename);
+      close(fd);
+      return 0;
+    }
+
+  map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED)
+    {
+      fprintf(stderr, "eph_data_map: mmap failed: %s\n", strerror(errno));
+      return 0;
+    }
+
+  memcpy(&n, (char *) map + 8, sizeof(size_t));
+  memcpy(&flags, (char *) map + 8 + sizeof(size_t), sizeof(size_t));
+
+  if (memcmp(map, EPH_DATA_CACHE_MAGIC, 8) != 0 ||
+      (size_t) sb.st_size != EPH_DATA_CACHE_HDR_SIZE + EPH_DATA_CACHE_NCOL * n * sizeof(double))
+    {
+      fprintf(stderr, "eph_data_map: %s: invalid cache file\n", filename);
+      munmap(map, sb.st_size);
+      return 0;
+    }
+
+  data = calloc(1, sizeof(eph_data));
+  if (!data)
+    {
+      munmap(map, sb.st_size);
+      return 0;
+    }
+
+  data->map = map;
+  data->map_len = sb.st_size;
+  data->n = n;
+  data->ntot = n;
+  data->flags = flags;
+
+  eph_data_set_columns((double *) ((char *) map + EPH_DATA_CACHE_HDR_SIZE), n, data);
+
+  return data;
+}
+
 /* read ephemeris (gzip) data file as provided by Bruce Bowman */
 eph_data *
 eph_data_read_bowman(const char *filename)
@@ -41,7 +266,13 @@ eph_data_read_bowman(const char *filename)
       return 0;
     }
 
-  data = malloc(sizeof(eph_data));
+  data = eph_data_alloc(EPH_DATA_INIT_SIZE);
+  if (!data)
+    {
+      gzclose(fp);
+      return 0;
+    }
+
   data->flags = EPH_DATA_FLG_ECI;
 
   while (gzgets(fp, buffer, 2048) != 0)
@@ -80,6 +311,9 @@ eph_data_read_bowman(const char *filename)
 
       doy2md(year, doy, &month, &day);
 
+      if (n >= data->ntot && eph_data_realloc(2 * data->ntot, data))
+        break;
+
       data->t[n] = computeEPOCH(year, month, day, hour, min, sec, msec);
       data->X[n] = r_ECI[0] * 1.0e-3;
       data->Y[n] = r_ECI[1] * 1.0e-3;
@@ -90,16 +324,15 @@ eph_data_read_bowman(const char *filename)
       data->latitude[n] = latc;
       data->longitude[n] = lonc;
 
-      if (++n >= EPH_MAX_DATA)
-        {
-          fprintf(stderr, "EPH_MAX_DATA too small\n");
-          break;
-        }
+      /* keep data->n current so eph_data_realloc() preserves all records */
+      data->n = ++n;
     }
 
   gzclose(fp);
 
-  data->n = n;
+  /* release unused records */
+  if (n > 0 && n < data->ntot)
+    eph_data_realloc(n, data);
 
   return data;
 } /* eph_data_read_bowman() */
@@ -124,7 +357,13 @@ eph_data_read_tena(const char *filename)
       return 0;
     }
 
-  data = malloc(sizeof(eph_data));
+  data = eph_data_alloc(EPH_DATA_INIT_SIZE);
+  if (!data)
+    {
+      fclose(fp);
+      return 0;
+    }
+
   data->flags = EPH_DATA_FLG_ECEF;
 
   while (fgets(buffer, 2048, fp) != 0)
@@ -196,6 +435,9 @@ eph_data_read_tena(const char *filename)
       sec = (int) fsec;
       msec = 0;
 
+      if (n >= data->ntot && eph_data_realloc(2 * data->ntot, data))
+        break;
+
       data->t[n] = computeEPOCH(year, month, day, hour, min, sec, msec);
       data->X[n] = X;
       data->Y[n] = Y;
@@ -203,17 +445,32 @@ eph_data_read_tena(const char *filename)
       data->VX[n] = VX;
       data->VY[n] = VY;
       data->VZ[n] = VZ;
+      data->latitude[n] = 0.0;  /* not provided by TENA */
+      data->longitude[n] = 0.0;
 
-      if (++n >= EPH_MAX_DATA)
-        {
-          fprintf(stderr, "EPH_MAX_DATA too small\n");
-          break;
-        }
+      /* keep data->n current so eph_data_realloc() preserves all records */
+      data->n = ++n;
     }
 
   fclose(fp);
 
-  data->n = n;
+  /* release unused records */
+  if (n > 0 && n < data->ntot)
+    eph_data_realloc(n, data);
 
   return data;
 }
+
+static void
+eph_data_set_columns(double *base, const size_t stride, eph_data *data)
+{
+  data->t = base;
+  data->X = base + stride;
+  data->Y = base + 2 * stride;
+  data->Z = base + 3 * stride;
+  data->VX = base + 4 * stride;
+  data->VY = base + 5 * stride;
+  data->VZ = base + 6 * stride;
+  data->latitude = base + 7 * stride;
+  data->longitude = base + 8 * stride;
+}
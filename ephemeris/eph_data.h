@@ -5,7 +5,10 @@
 #ifndef INCLUDED_eph_data_h
 #define INCLUDED_eph_data_h
 
-#define EPH_MAX_DATA         35000000
+#include <stddef.h>
+
+/* initial number of records allocated by the readers; arrays grow as needed */
+#define EPH_DATA_INIT_SIZE   1000000
 
 #define EPH_DATA_FLG_ECI     (1 << 0) /* ephemeris is ECI */
 #define EPH_DATA_FLG_ECEF    (1 << 1) /* ephemeris is ECEF */
@@ -13,24 +16,37 @@
 /* ephemeris data */
 typedef struct
 {
-  double t[EPH_MAX_DATA];         /* timestamp (CDF_EPOCH) */
-  double X[EPH_MAX_DATA];         /* X in km */
-  double Y[EPH_MAX_DATA];         /* Y in km */
-  double Z[EPH_MAX_DATA];         /* Z in km */
-  double VX[EPH_MAX_DATA];        /* V_x in km/s */
-  double VY[EPH_MAX_DATA];        /* V_y in km/s */
-  double VZ[EPH_MAX_DATA];        /* V_z in km/s */
-  double latitude[EPH_MAX_DATA];  /* geocentric latitude in deg */
-  double longitude[EPH_MAX_DATA]; /* geocentric longitude in deg */
-  size_t n;                       /* number of points stored */
-  size_t flags;                   /* ECI or ECEF */
+  double *t;         /* timestamp (CDF_EPOCH) */
+  double *X;         /* X in km */
+  double *Y;         /* Y in km */
+  double *Z;         /* Z in km */
+  double *VX;        /* V_x in km/s */
+  double *VY;        /* V_y in km/s */
+  double *VZ;        /* V_z in km/s */
+  double *latitude;  /* geocentric latitude in deg */
+  double *longitude; /* geocentric longitude in deg */
+  size_t n;          /* number of points stored */
+  size_t ntot;       /* number of points allocated */
+  size_t flags;      /* ECI or ECEF */
+
+  void *map;         /* mapping of binary cache file, or NULL if arrays are malloc'd */
+  size_t map_len;    /* length of mapping in bytes */
 } eph_data;
 
+/* binary cache file: header followed by one column of n doubles per field */
+#define EPH_DATA_CACHE_MAGIC    "EPHDAT01"
+#define EPH_DATA_CACHE_HDR_SIZE 4096 /* keeps columns page aligned */
+#define EPH_DATA_CACHE_NCOL     9
+
 /*
  * Prototypes
  */
 
+eph_data *eph_data_alloc(const size_t n);
+int eph_data_realloc(const size_t n, eph_data *data);
 void eph_data_free(eph_data *data);
+int eph_data_write(const char *filename, const eph_data *data);
+eph_data *eph_data_map(const char *filename);
 eph_data *eph_data_read_bowman(const char *filename);
 eph_data *eph_data_read_tena(const char *filename);
 
@@ -2,10 +2,13 @@
  * print.c
  * Patrick Alken
  *
- * Usage: ./print [-b bowman_ephemeris_gz_file]
+ * Usage: ./print [-b bowman_ephemeris_gz_file] [-e eph_cache_file] [-w eph_cache_file]
  * 
  * This program reads a Bowman ephemeris file, and prints
  * the data
+ *
+ * With -w, the ephemeris is also written to a binary cache file,
+ * which can later be mapped (-e) instead of parsing the ASCII file
  */
 
 #include <stdio.h>
@@ -68,10 +71,11 @@ int
 main(int argc, char *argv[])
 {
   eph_data *data = NULL;
+  char *cache_file = NULL;
   int c;
   struct timeval tv0, tv1;
 
-  while ((c = getopt(argc, argv, "b:")) != (-1))
+  while ((c = getopt(argc, argv, "b:e:w:")) != (-1))
     {
       switch (c)
         {
@@ -81,15 +85,37 @@ main(int argc, char *argv[])
             data = eph_data_read_bowman(optarg);
             gettimeofday(&tv1, NULL);
             fprintf(stderr, "done (%zu read, %g seconds)\n", data->n, time_diff(tv0, tv1));
+            break;
+
+          case 'e':
+            fprintf(stderr, "main: mapping ephemeris cache %s...", optarg);
+            gettimeofday(&tv0, NULL);
+            data = eph_data_map(optarg);
+            gettimeofday(&tv1, NULL);
+            if (!data)
+              exit(1);
+            fprintf(stderr, "done (%zu records, %g seconds)\n", data->n, time_diff(tv0, tv1));
+            break;
+
+          case 'w':
+            cache_file = optarg;
+            break;
         }
     }
 
   if (data == NULL)
     {
-      fprintf(stderr, "Usage: %s [-b <bowman_gz_file>]\n", argv[0]);
+      fprintf(stderr, "Usage: %s [-b <bowman_gz_file>] [-e eph_cache_file] [-w eph_cache_file]\n", argv[0]);
       exit(1);
     }
 
+  if (cache_file)
+    {
+      fprintf(stderr, "main: writing ephemeris cache to %s...", cache_file);
+      eph_data_write(cache_file, data);
+      fprintf(stderr, "done\n");
+    }
+
   print_eph(data);
 
   eph_data_free(data);
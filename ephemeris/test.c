@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <unistd.h>
 #include <sys/time.h>
 #include <getopt.h>
 
@@ -23,6 +24,7 @@
 
 #include "eph.h"
 #include "eph_data.h"
+#include "hermite.h"
 
 int
 test_geo(const double eps_lat, const double eps_lon,
@@ -99,6 +101,99 @@ test_interp(const eph_data *data)
   return s;
 } /* test_interp() */
 
+/* test batched interpolation against hermite_eval() at interval midpoints */
+int
+test_interp_n(const eph_data *data)
+{
+  int s = 0;
+  eph_workspace *w = eph_alloc(data);
+  const size_t n = data->n - 1;
+  double *t = malloc(n * sizeof(double));
+  double *r = malloc(3 * n * sizeof(double));
+  double *v = malloc(3 * n * sizeof(double));
+  const double tol = 1.0e-10;
+  size_t i, j;
+
+  for (i = 0; i < n; ++i)
+    t[i] = 0.5 * (data->t[i] + data->t[i + 1]);
+
+  s = eph_interp_n(n, t, r, v, w);
+  gsl_test(s, "eph_interp_n status");
+
+  /* reference: divided difference Hermite interpolation in seconds */
+  for (i = 0; i < n; ++i)
+    {
+      const double t_sec = t[i] / 1000.0;
+      double pos[3], vel[3];
+
+      pos[0] = hermite_eval(w->t, data->X, data->VX, t_sec, w->acc, w->hermite_x);
+      pos[1] = hermite_eval(w->t, data->Y, data->VY, t_sec, w->acc, w->hermite_y);
+      pos[2] = hermite_eval(w->t, data->Z, data->VZ, t_sec, w->acc, w->hermite_z);
+
+      vel[0] = hermite_eval_deriv(w->t, data->X, data->VX, t_sec, w->acc, w->hermite_x);
+      vel[1] = hermite_eval_deriv(w->t, data->Y, data->VY, t_sec, w->acc, w->hermite_y);
+      vel[2] = hermite_eval_deriv(w->t, data->Z, data->VZ, t_sec, w->acc, w->hermite_z);
+
+      for (j = 0; j < 3; ++j)
+        {
+          gsl_test_rel(r[3 * i + j], pos[j], tol, "eph_interp_n position i=%zu j=%zu", i, j);
+          gsl_test_rel(v[3 * i + j], vel[j], tol, "eph_interp_n velocity i=%zu j=%zu", i, j);
+        }
+    }
+
+  eph_free(w);
+  free(t);
+  free(r);
+  free(v);
+
+  return s;
+} /* test_interp_n() */
+
+/* test binary cache round trip */
+int
+test_cache(const eph_data *data)
+{
+  int s = 0;
+  char filename[] = "/tmp/eph_test_XXXXXX";
+  eph_data *data2;
+  size_t i;
+  int fd;
+
+  fd = mkstemp(filename);
+  if (fd < 0)
+    return -1;
+
+  close(fd);
+
+  eph_data_write(filename, data);
+  data2 = eph_data_map(filename);
+  unlink(filename);
+
+  gsl_test(data2 == NULL, "eph_data_map");
+  if (!data2)
+    return -1;
+
+  gsl_test(data2->n != data->n, "cache n");
+  gsl_test(data2->flags != data->flags, "cache flags");
+
+  for (i = 0; i < data->n; ++i)
+    {
+      gsl_test(data2->t[i] != data->t[i], "cache t");
+      gsl_test(data2->X[i] != data->X[i], "cache X");
+      gsl_test(data2->Y[i] != data->Y[i], "cache Y");
+      gsl_test(data2->Z[i] != data->Z[i], "cache Z");
+      gsl_test(data2->VX[i] != data->VX[i], "cache VX");
+      gsl_test(data2->VY[i] != data->VY[i], "cache VY");
+      gsl_test(data2->VZ[i] != data->VZ[i], "cache VZ");
+      gsl_test(data2->latitude[i] != data->latitude[i], "cache latitude");
+      gsl_test(data2->longitude[i] != data->longitude[i], "cache longitude");
+    }
+
+  eph_data_free(data2);
+
+  return s;
+} /* test_cache() */
+
 int
 main(int argc, char *argv[])
 {
@@ -156,6 +251,14 @@ main(int argc, char *argv[])
   test_interp(data);
   fprintf(stderr, "done\n");
 
+  fprintf(stderr, "main: testing batched interpolation...");
+  test_interp_n(data);
+  fprintf(stderr, "done\n");
+
+  fprintf(stderr, "main: testing ephemeris cache...");
+  test_cache(data);
+  fprintf(stderr, "done\n");
+
   eph_data_free(data);
 
   exit (gsl_test_summary());
@@ -7,11 +7,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <errno.h>
+#include <string.h>
 
 #include <indices/indices.h>
 
 #include "estist_calc.h"
 
+static time_t estist_calc_start(const time_t t);
+
 estist_calc_workspace *
 estist_calc_alloc(const char *dst_file)
 {
@@ -32,6 +36,12 @@ estist_calc_free(estist_calc_workspace *w)
   if (w->dst_workspace_p)
     dst_free(w->dst_workspace_p);
 
+  if (w->series_est)
+    free(w->series_est);
+
+  if (w->series_ist)
+    free(w->series_ist);
+
   free(w);
 } /* estist_calc_free() */
 
@@ -67,9 +77,135 @@ estist_calc(int ndst, double dst[], double est[], double ist[],
   return s;
 } /* estist_calc() */
 
+/*
+estist_calc_init()
+  Precompute Est/Ist hourly time series for a time interval
+
+Inputs: t0 - start time
+        t1 - end time
+        w  - workspace
+
+Return: success/error
+
+Notes:
+1) The series starts at t0 rounded down to a multiple of
+ESTIST_NSERIES hours (see estist_calc_start()). The Dst series
+starting ESTIST_NDST - 1 hours before that and ending at t1 is
+separated with a single run of the recursive filter, so each
+value has at least one year of filter history, and the first
+value equals the per-timestamp one year separation
+
+2) If Dst is not available up to t1, the series is truncated
+at the last available hour; an error is returned only if Dst
+is missing before the series start
+
+3) Afterwards, estist_calc_get() for t in [t0,t1] is a table lookup
+*/
+
+int
+estist_calc_init(const time_t t0, const time_t t1, estist_calc_workspace *w)
+{
+  int s = 0;
+  const time_t ts0 = estist_calc_start(t0);            /* first hour of series */
+  const time_t tstart = ts0 - (ESTIST_NDST - 1) * 3600; /* start time for Dst series */
+  size_t nmax;
+  double *dst, *est, *ist;
+  size_t ndst, i;
+
+  if (t1 < t0)
+    {
+      fprintf(stderr, "estist_calc_init: error: t1 = %ld is before t0 = %ld\n",
+              (long) t1, (long) t0);
+      return -1;
+    }
+
+  nmax = ESTIST_NDST + (t1 - ts0) / 3600;
+
+  dst = malloc(nmax * sizeof(double));
+  est = malloc(nmax * sizeof(double));
+  ist = malloc(nmax * sizeof(double));
+  if (!dst || !est || !ist)
+    {
+      fprintf(stderr, "estist_calc_init: malloc failed: %s\n", strerror(errno));
+      free(dst);
+      free(est);
+      free(ist);
+      return -1;
+    }
+
+  for (ndst = 0; ndst < nmax; ++ndst)
+    {
+      time_t t = tstart + ndst * 3600;
+
+      if (dst_get(t, &dst[ndst], w->dst_workspace_p))
+        {
+          if (ndst < ESTIST_NDST)
+            {
+              fprintf(stderr, "estist_calc_init: dst not found: %ld\n", t);
+              s = -1;
+            }
+
+          break;
+        }
+    }
+
+  if (s == 0)
+    {
+      /* perform Est/Ist separation */
+      s = estist_calc((int) ndst, dst, est, ist, w);
+    }
+
+  if (s == 0)
+    {
+      const size_t n = ndst - (ESTIST_NDST - 1);
+      double *series_est = realloc(w->series_est, n * sizeof(double));
+      double *series_ist;
+
+      if (series_est)
+        w->series_est = series_est;
+
+      series_ist = realloc(w->series_ist, n * sizeof(double));
+      if (series_ist)
+        w->series_ist = series_ist;
+
+      if (!series_est || !series_ist)
+        {
+          fprintf(stderr, "estist_calc_init: realloc failed: %s\n", strerror(errno));
+
+          /* old series is no longer valid */
+          w->series_n = 0;
+          s = -1;
+        }
+      else
+        {
+          for (i = 0; i < n; ++i)
+            {
+              w->series_est[i] = est[ESTIST_NDST - 1 + i];
+              w->series_ist[i] = ist[ESTIST_NDST - 1 + i];
+            }
+
+          w->series_t0 = ts0;
+          w->series_n = n;
+        }
+    }
+
+  free(dst);
+  free(est);
+  free(ist);
+
+  return s;
+} /* estist_calc_init() */
+
 /*
 estist_calc_get()
   Compute Est/Ist for a given timestamp
+
+Notes:
+1) Values are looked up in the series precomputed by estist_calc_init().
+If t is outside the series, the series of ESTIST_NSERIES hours
+containing t on the fixed grid of estist_calc_start() is computed, so
+consecutive calls for nearby times share one filter run, and the
+result does not depend on the order of calls
 */
 
 int
@@ -77,28 +213,36 @@ estist_calc_get(const time_t t, double *est, double *ist,
                 estist_calc_workspace *w)
 {
   int s = 0;
-  const size_t ndst = ESTIST_NDST;
-  size_t i;
-  time_t t1 = t - (ndst - 1) * 3600; /* start time for Dst series */
+  size_t idx;
 
-  for (i = 0; i < ndst; ++i)
+  if (w->series_n == 0 || t < w->series_t0 ||
+      (size_t) ((t - w->series_t0) / 3600) >= w->series_n)
     {
-      s += dst_get(t1, &(w->dst[i]), w->dst_workspace_p);
-      if (s)
-        {
-          fprintf(stderr, "estist_calc_get: dst not found: %ld\n", t1);
-          return s;
-        }
+      const time_t ts0 = estist_calc_start(t);
 
-      /* advance 1 hour */
-      t1 += 3600;
+      s = estist_calc_init(ts0, ts0 + (ESTIST_NSERIES - 1) * 3600, w);
+      if (s)
+        return s;
     }
 
-  /* perform Est/Ist separation */
-  s += estist_calc(ndst, w->dst, w->est, w->ist, w);
+  idx = (t - w->series_t0) / 3600;
 
-  *est = w->est[ndst - 1];
-  *ist = w->ist[ndst - 1];
+  if (t < w->series_t0 || idx >= w->series_n)
+    {
+      /* Dst not available up to t */
+      fprintf(stderr, "estist_calc_get: dst not found: %ld\n", (long) t);
+      return -1;
+    }
+
+  *est = w->series_est[idx];
+  *ist = w->series_ist[idx];
 
   return s;
 } /* estist_calc_get() */
+
+/* start of the ESTIST_NSERIES hour block containing t */
+static time_t
+estist_calc_start(const time_t t)
+{
+  return t - (t % (ESTIST_NSERIES * 3600));
+}
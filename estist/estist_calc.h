@@ -12,13 +12,19 @@
 /* 1-hr samples */
 #define ESTIST_NDST          (ESTIST_NUM_DAYS * 24)
 
+/* number of hourly values precomputed at once by estist_calc_get() */
+#define ESTIST_NSERIES       (30 * 24)
+
 typedef struct
 {
-  double dst[ESTIST_NDST];
-  double est[ESTIST_NDST];
-  double ist[ESTIST_NDST];
   int model;
 
+  /* precomputed Est/Ist time series, see estist_calc_init() */
+  time_t series_t0;    /* timestamp of first value (on the hour) */
+  size_t series_n;     /* number of hourly values in series, 0 if none */
+  double *series_est;  /* Est at series_t0 + i*3600, length series_n */
+  double *series_ist;  /* Ist at series_t0 + i*3600, length series_n */
+
   dst_workspace *dst_workspace_p;
 } estist_calc_workspace;
 
@@ -33,6 +39,7 @@ estist_calc_workspace *estist_calc_alloc(const char *dst_file);
 void estist_calc_free(estist_calc_workspace *w);
 int estist_calc(int ndst, double dst[], double est[], double ist[],
                 estist_calc_workspace *w);
+int estist_calc_init(const time_t t0, const time_t t1, estist_calc_workspace *w);
 int estist_calc_get(const time_t t, double *est, double *ist,
                     estist_calc_workspace *w);
 
@@ -81,6 +81,10 @@ main(int argc, char *argv[])
   buf[strlen(buf) - 1] = '\0';
   fprintf(stderr, "main: end time:   %ld (%s)\n", t1, buf);
 
+  fprintf(stderr, "main: computing Est/Ist time series...");
+  s = estist_calc_init(t0, t1, estist_calc_p);
+  fprintf(stderr, "done (s = %d)\n", s);
+
   for (t = t0; t <= t1; t += 3600)
     {
       /* output status every 5 days */
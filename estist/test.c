@@ -16,6 +16,57 @@
 
 #include "estist_calc.h"
 
+/*
+test_window()
+  Check the first value of a precomputed series against a separation
+of the one year of Dst ending at that hour, and check that values do
+not depend on the order of estist_calc_get() calls
+*/
+
+int
+test_window(const time_t t, dst_workspace *dst_p)
+{
+  int s = 0;
+  const time_t ts0 = t - (t % (ESTIST_NSERIES * 3600)); /* series start */
+  const time_t t2 = ts0 + 10 * 3600;
+  estist_calc_workspace *w1 = estist_calc_alloc(DST_IDX_FILE);
+  estist_calc_workspace *w2 = estist_calc_alloc(DST_IDX_FILE);
+  double *dst = malloc(ESTIST_NDST * sizeof(double));
+  double *est = malloc(ESTIST_NDST * sizeof(double));
+  double *ist = malloc(ESTIST_NDST * sizeof(double));
+  double est1, ist1, est2, ist2;
+  size_t i;
+
+  /* one year window ending at ts0 */
+  for (i = 0; i < ESTIST_NDST; ++i)
+    s += dst_get(ts0 - (time_t) (ESTIST_NDST - 1 - i) * 3600, &dst[i], dst_p);
+
+  s += estist_calc(ESTIST_NDST, dst, est, ist, w1);
+
+  /* series computed on a miss at a later hour of the same block */
+  s += estist_calc_get(t2, &est1, &ist1, w1);
+  s += estist_calc_get(ts0, &est1, &ist1, w1);
+
+  gsl_test_rel(est1, est[ESTIST_NDST - 1], 1.0e-12, "window est t=%ld", ts0);
+  gsl_test_rel(ist1, ist[ESTIST_NDST - 1], 1.0e-12, "window ist t=%ld", ts0);
+
+  /* reverse order of calls in a fresh workspace */
+  s += estist_calc_get(t2, &est1, &ist1, w1);
+  s += estist_calc_get(ts0 + ESTIST_NSERIES * 3600, &est2, &ist2, w2);
+  s += estist_calc_get(t2, &est2, &ist2, w2);
+
+  gsl_test_rel(est2, est1, 1.0e-12, "order est t=%ld", t2);
+  gsl_test_rel(ist2, ist1, 1.0e-12, "order ist t=%ld", t2);
+
+  free(dst);
+  free(est);
+  free(ist);
+  estist_calc_free(w1);
+  estist_calc_free(w2);
+
+  return s;
+}
+
 int
 main()
 {
@@ -32,6 +83,8 @@ main()
   t0 = 1112076000; /* Mar 29 06:00:00 2005 */
   t1 = 1112659200; /* Apr 5 00:00:00 2005 */
 
+  gsl_test(test_window(t0, dst_p), "estist window");
+
   for (t = t0; t <= t1; t += 3600)
     {
       s += estist_calc_get(t, &est, &ist, estist_calc_p);
@@ -50,5 +103,5 @@ main()
   dst_free(dst_p);
   estist_calc_free(estist_calc_p);
 
-  return 0;
+  exit (gsl_test_summary());
 } /* main() */
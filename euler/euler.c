@@ -33,6 +33,12 @@ static int euler_apply_Ry(const int deriv, const double x,
 static int euler_apply_Rz(const int deriv, const double x,
                           const double A_in[3], double A_out[3]);
 static int euler_find(const double t, size_t *idx, const euler_workspace *w);
+static int euler_find_next(const double t, size_t *idx, const euler_workspace *w);
+static int euler_resize(const size_t ntot, euler_workspace *w);
+static int euler_calc_R(const size_t idx, euler_workspace *w);
+static int euler_vfm2nec_bin(const size_t idx, const double q[],
+                             const double B_in[3], double B_out[3],
+                             const euler_workspace *w);
 
 /*
 euler_alloc()
@@ -55,12 +61,33 @@ euler_alloc(const size_t flags)
   w->n = 0;
   w->flags = flags;
 
+  if (euler_resize(EULER_INIT_BINS, w))
+    {
+      euler_free(w);
+      return 0;
+    }
+
   return w;
 } /* euler_alloc() */
 
 void
 euler_free(euler_workspace *w)
 {
+  if (w->t)
+    free(w->t);
+
+  if (w->alpha)
+    free(w->alpha);
+
+  if (w->beta)
+    free(w->beta);
+
+  if (w->gamma)
+    free(w->gamma);
+
+  if (w->R)
+    free(w->R);
+
   free(w);
 } /* euler_free() */
 
@@ -82,7 +109,8 @@ euler_read(const char *filename)
   while (fgets(buf, EULER_MAX_BUFFER, fp) != NULL)
     {
       int c;
-      double t, year, alpha, beta, gamma;
+      double t, alpha, beta, gamma;
+      char *p, *end;
 
       /* search for flags to allocate workspace */
       if (!w)
@@ -101,13 +129,29 @@ euler_read(const char *filename)
       if (*buf == '#')
         continue;
 
-      c = sscanf(buf, "%lf %lf %lf %lf %lf",
-                 &t,
-                 &year,
-                 &alpha,
-                 &beta,
-                 &gamma);
-      if (c < 5)
+      /* fields: t year alpha beta gamma ... */
+      t = strtod(buf, &end);
+      if (end == buf)
+        continue;
+
+      p = end;
+      strtod(p, &end); /* year */
+      if (end == p)
+        continue;
+
+      p = end;
+      alpha = strtod(p, &end);
+      if (end == p)
+        continue;
+
+      p = end;
+      beta = strtod(p, &end);
+      if (end == p)
+        continue;
+
+      p = end;
+      gamma = strtod(p, &end);
+      if (end == p)
         continue;
 
       if (w->n > 0)
@@ -121,16 +165,17 @@ euler_read(const char *filename)
             }
         }
 
+      if (w->n >= w->ntot && euler_resize(2 * w->ntot, w))
+        break;
+
       w->t[w->n] = t;
       w->alpha[w->n] = alpha * M_PI / 180.0;
       w->beta[w->n] = beta * M_PI / 180.0;
       w->gamma[w->n] = gamma * M_PI / 180.0;
 
-      if (++(w->n) >= EULER_MAX_BINS)
-        {
-          fprintf(stderr, "euler_read: MAX_BINS too small: %zu\n", w->n);
-          break;
-        }
+      euler_calc_R(w->n, w);
+
+      ++(w->n);
     }
 
   fclose(fp);
@@ -291,11 +336,20 @@ euler_add(const double t, const gsl_vector *x, euler_workspace *w)
   const double beta = gsl_vector_get(x, EULER_IDX_BETA);
   const double gamma = gsl_vector_get(x, EULER_IDX_GAMMA);
 
+  if (w->n >= w->ntot)
+    {
+      s = euler_resize(2 * w->ntot, w);
+      if (s)
+        return s;
+    }
+
   w->t[w->n] = t;
   w->alpha[w->n] = alpha;
   w->beta[w->n] = beta;
   w->gamma[w->n] = gamma;
 
+  euler_calc_R(w->n, w);
+
   ++(w->n);
 
   return s;
@@ -317,22 +371,47 @@ with Euler angles and satellite quaternions
 
 int
 euler_apply(satdata_mag *data, const euler_workspace *w)
+{
+  return euler_vfm2nec_n(data->n, data->t, data->q, data->B_VFM, data->B, w);
+} /* euler_apply() */
+
+/*
+euler_vfm2nec_n()
+  Convert an array of vectors from VFM to NEC frame
+
+Inputs: n     - number of vectors
+        t     - timestamps (CDF_EPOCH), length n, preferably sorted
+        q     - quaternions for CRF to NEC, length 4*n
+        B_in  - input vectors (VFM frame), length 3*n
+        B_out - (output) vectors (NEC frame), length 3*n
+        w     - workspace
+
+Return: success or error
+
+Notes:
+1) Euler rotations use the matrices precomputed for each bin,
+and the bin is found with a cursor which advances from the
+previous timestamp, so sorted input needs no binary searches
+
+2) In place transform is allowed (ie: B_in == B_out)
+*/
+
+int
+euler_vfm2nec_n(const size_t n, const double t[], const double q[],
+                const double B_in[], double B_out[], const euler_workspace *w)
 {
   int s = 0;
+  size_t idx = 0;
   size_t i;
 
-  for (i = 0; i < data->n; ++i)
+  for (i = 0; i < n; ++i)
     {
-      double *q = &(data->q[4 * i]);
-      double *B_VFM = &(data->B_VFM[3 * i]);
-      double *B = &(data->B[3 * i]);
-      double t = data->t[i];
-
-      s += euler_vfm2nec_t(t, q, B_VFM, B, w);
+      s += euler_find_next(t[i], &idx, w);
+      s += euler_vfm2nec_bin(idx, &q[4 * i], &B_in[3 * i], &B_out[3 * i], w);
     }
 
   return s;
-} /* euler_apply() */
+} /* euler_vfm2nec_n() */
 
 /*
 euler_magdata_apply()
@@ -352,6 +431,7 @@ int
 euler_magdata_apply(magdata *data, const euler_workspace *w)
 {
   int s = 0;
+  size_t idx = 0;
   size_t i;
   double B_vfm[3], B_nec[3];
 
@@ -364,7 +444,8 @@ euler_magdata_apply(magdata *data, const euler_workspace *w)
       B_vfm[1] = data->By_vfm[i];
       B_vfm[2] = data->Bz_vfm[i];
 
-      s += euler_vfm2nec_t(t, q, B_vfm, B_nec, w);
+      s += euler_find_next(t, &idx, w);
+      s += euler_vfm2nec_bin(idx, q, B_vfm, B_nec, w);
 
       data->Bx_nec[i] = B_nec[0];
       data->By_nec[i] = B_nec[1];
@@ -435,8 +516,7 @@ euler_vfm2nec_t(const double t, const double q[],
   if (s)
     return s;
 
-  s = euler_vfm2nec(w->flags, w->alpha[idx], w->beta[idx], w->gamma[idx],
-                    q, B_in, B_out);
+  s = euler_vfm2nec_bin(idx, q, B_in, B_out, w);
 
   return s;
 } /* euler_vfm2nec_t() */
@@ -883,3 +963,142 @@ euler_find(const double t, size_t *idx, const euler_workspace *w)
 
   return s;
 } /* euler_find() */
+
+/*
+euler_find_next()
+  Find bin corresponding to angles for time t, starting
+the search from a previous bin
+
+Inputs: t   - timestamp (CDF_EPOCH)
+        idx - (input/output) on input, bin index of previous
+              timestamp; on output, bin index for t
+        w   - workspace
+
+Return: success or error
+
+Notes:
+1) Returns the same index as euler_find(); the cursor is advanced
+linearly for nearby bins and falls back to euler_find() otherwise
+*/
+
+static int
+euler_find_next(const double t, size_t *idx, const euler_workspace *w)
+{
+  size_t i = *idx;
+  size_t k;
+
+  if (w->n < 2)
+    return euler_find(t, idx, w);
+
+  if (i > w->n - 2 || t < w->t[i])
+    return euler_find(t, idx, w);
+
+  for (k = 0; k < 4; ++k)
+    {
+      if (i == w->n - 2 || t < w->t[i + 1])
+        {
+          *idx = i;
+          return 0;
+        }
+
+      ++i;
+    }
+
+  return euler_find(t, idx, w);
+}
+
+/*
+euler_resize()
+  Resize Euler angle arrays to hold ntot bins
+*/
+
+static int
+euler_resize(const size_t ntot, euler_workspace *w)
+{
+  double *t = realloc(w->t, ntot * sizeof(double));
+  double *alpha = t ? realloc(w->alpha, ntot * sizeof(double)) : NULL;
+  double *beta = alpha ? realloc(w->beta, ntot * sizeof(double)) : NULL;
+  double *gamma = beta ? realloc(w->gamma, ntot * sizeof(double)) : NULL;
+  double *R = gamma ? realloc(w->R, 9 * ntot * sizeof(double)) : NULL;
+
+  /* store successfully reallocated blocks so euler_free() releases them */
+  if (t)
+    w->t = t;
+  if (alpha)
+    w->alpha = alpha;
+  if (beta)
+    w->beta = beta;
+  if (gamma)
+    w->gamma = gamma;
+  if (R)
+    w->R = R;
+
+  if (!R)
+    {
+      fprintf(stderr, "euler_resize: unable to allocate %zu bins: %s\n",
+              ntot, strerror(errno));
+      return -1;
+    }
+
+  w->ntot = ntot;
+
+  return 0;
+}
+
+/*
+euler_calc_R()
+  Compute and store Euler rotation matrix R_3 for bin idx, so that
+B_VFM -> B_CRF rotations do not recompute trig functions per sample
+*/
+
+static int
+euler_calc_R(const size_t idx, euler_workspace *w)
+{
+  int s = 0;
+  double *R = &(w->R[9 * idx]);
+  size_t j;
+
+  for (j = 0; j < 3; ++j)
+    {
+      double e[3] = { 0.0, 0.0, 0.0 };
+      double col[3];
+
+      /* column j of R_3 is R_3 e_j */
+      e[j] = 1.0;
+      s += euler_apply_R3(w->flags, w->alpha[idx], w->beta[idx], w->gamma[idx], e, col);
+
+      R[j] = col[0];
+      R[3 + j] = col[1];
+      R[6 + j] = col[2];
+    }
+
+  return s;
+}
+
+/*
+euler_vfm2nec_bin()
+  Convert a vector from VFM to NEC frame using the precomputed
+Euler rotation of bin idx
+
+Notes:
+1) In place transform is allowed (ie: B_in == B_out)
+*/
+
+static int
+euler_vfm2nec_bin(const size_t idx, const double q[],
+                  const double B_in[3], double B_out[3],
+                  const euler_workspace *w)
+{
+  const double *R = &(w->R[9 * idx]);
+  double tmp[3];
+
+  /* compute tmp = R_3(alpha,beta,gamma) B_in */
+  tmp[0] = R[0] * B_in[0] + R[1] * B_in[1] + R[2] * B_in[2];
+  tmp[1] = R[3] * B_in[0] + R[4] * B_in[1] + R[5] * B_in[2];
+  tmp[2] = R[6] * B_in[0] + R[7] * B_in[1] + R[8] * B_in[2];
+
+  /* compute B_out = R_q R_3(alpha,beta,gamma) B_in */
+  quat_apply(q, tmp, B_out);
+
+  return 0;
+}
@@ -27,19 +27,21 @@
 #define EULER_IDX_BETA              1
 #define EULER_IDX_GAMMA             2
 
-/* maximum number of bins for Euler angles */
-#define EULER_MAX_BINS             1000
+/* initial number of bins for Euler angles; tables grow as needed */
+#define EULER_INIT_BINS            1000
 
 #define EULER_MAX_BUFFER           2048
 
 typedef struct
 {
-  double t[EULER_MAX_BINS];     /* timestamp (CDF_EPOCH) sorted low to high */
-  double alpha[EULER_MAX_BINS]; /* alpha (radians) */
-  double beta[EULER_MAX_BINS];  /* beta (radians) */
-  double gamma[EULER_MAX_BINS]; /* gamma (radians) */
-  size_t n;                     /* number of data */
-  size_t flags;                 /* EULER_FLG_xxx for Euler convention */
+  double *t;     /* timestamp (CDF_EPOCH) sorted low to high */
+  double *alpha; /* alpha (radians) */
+  double *beta;  /* beta (radians) */
+  double *gamma; /* gamma (radians) */
+  double *R;     /* R_3(alpha,beta,gamma) for each bin, row-major 3-by-3, size 9*ntot */
+  size_t n;      /* number of data */
+  size_t ntot;   /* number of bins allocated */
+  size_t flags;  /* EULER_FLG_xxx for Euler convention */
 } euler_workspace;
 
 /*
@@ -55,6 +57,8 @@ int euler_write_swarm(const double fday_start, const double fday_end,
                       const euler_workspace *w);
 int euler_add(const double t, const gsl_vector *x, euler_workspace *w);
 int euler_apply(satdata_mag *data, const euler_workspace *w);
+int euler_vfm2nec_n(const size_t n, const double t[], const double q[],
+                    const double B_in[], double B_out[], const euler_workspace *w);
 int euler_magdata_apply(magdata *data, const euler_workspace *w);
 int euler_nec2vfm_t(const double t, const double q[],
                     const double B_in[3], double B_out[3],
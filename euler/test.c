@@ -76,6 +76,59 @@ test_euler(euler_workspace *w)
   return s;
 } /* test_euler() */
 
+/* test batched rotation against rotation with explicit angles */
+int
+test_euler_n(euler_workspace *w)
+{
+  int s = 0;
+  const double tol = 1.0e-12;
+  const size_t n = 1000;
+  const double t0 = w->t[0];
+  const double dt = (w->t[w->n - 1] - t0) / (n - 1.0);
+  double *t = malloc(n * sizeof(double));
+  double *q = malloc(4 * n * sizeof(double));
+  double *B_vfm = malloc(3 * n * sizeof(double));
+  double *B_nec = malloc(3 * n * sizeof(double));
+  gsl_rng *r = gsl_rng_alloc(gsl_rng_default);
+  size_t i, j;
+
+  for (i = 0; i < n; ++i)
+    {
+      t[i] = t0 + i * dt;
+      test_quaternion(r, &q[4 * i]);
+
+      for (j = 0; j < 3; ++j)
+        B_vfm[3 * i + j] = gsl_rng_uniform(r) * 10.0;
+    }
+
+  s += euler_vfm2nec_n(n, t, q, B_vfm, B_nec, w);
+
+  for (i = 0; i < n; ++i)
+    {
+      size_t idx = 0;
+      double B[3];
+
+      /* find bin by linear search */
+      while (idx + 2 < w->n && t[i] >= w->t[idx + 1])
+        ++idx;
+
+      euler_vfm2nec(w->flags, w->alpha[idx], w->beta[idx], w->gamma[idx],
+                    &q[4 * i], &B_vfm[3 * i], B);
+
+      gsl_test_rel(B_nec[3 * i], B[0], tol, "n t=%f X", t[i]);
+      gsl_test_rel(B_nec[3 * i + 1], B[1], tol, "n t=%f Y", t[i]);
+      gsl_test_rel(B_nec[3 * i + 2], B[2], tol, "n t=%f Z", t[i]);
+    }
+
+  free(t);
+  free(q);
+  free(B_vfm);
+  free(B_nec);
+  gsl_rng_free(r);
+
+  return s;
+} /* test_euler_n() */
+
 int
 main(int argc, char *argv[])
 {
@@ -87,6 +140,7 @@ main(int argc, char *argv[])
   fprintf(stderr, "done (%zu sets of angles read)\n", euler_p->n);
 
   test_euler(euler_p);
+  test_euler_n(euler_p);
 
   euler_free(euler_p);
 
@@ -0,0 +1,101 @@
+/*
+ * fileio.c
+ *
+ * Write files through a temporary file in the same directory, which
+ * is renamed to the final name only once it is complete. Since rename()
+ * is atomic, readers (possibly in other processes) see either the old
+ * file or the complete new one, and an interrupted or failed write
+ * never leaves a truncated file behind. Usage:
+ *
+ * char tmpname[PATH_MAX];
+ * FILE *fp = fileio_open(filename, tmpname);
+ * ... nwrite += fwrite(...) ...
+ * s = fileio_close(fp, nwrite == expected, tmpname, filename);
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "fileio.h"
+
+/*
+fileio_open()
+  Open a temporary file <filename>.<pid>.tmp for writing
+
+Inputs: filename - final output file
+        tmpname  - (output) name of temporary file
+
+Return: file pointer, or NULL on error
+*/
+
+FILE *
+fileio_open(const char *filename, char tmpname[PATH_MAX])
+{
+  FILE *fp;
+
+  if (snprintf(tmpname, PATH_MAX, "%s.%d.tmp", filename, (int) getpid()) >= PATH_MAX)
+    {
+      fprintf(stderr, "fileio_open: file name too long: %s\n", filename);
+      return NULL;
+    }
+
+  fp = fopen(tmpname, "w");
+  if (!fp)
+    {
+      fprintf(stderr, "fileio_open: unable to open %s: %s\n",
+              tmpname, strerror(errno));
+      return NULL;
+    }
+
+  return fp;
+} /* fileio_open() */
+
+/*
+fileio_close()
+  Close a temporary file opened with fileio_open() and rename it
+to filename
+
+Inputs: fp       - file pointer returned by fileio_open()
+        ok       - 1 if all writes to fp succeeded, 0 otherwise
+        tmpname  - name of temporary file
+        filename - final output file
+
+Return: 0 on success, -1 on error
+
+Notes:
+1) On error the temporary file is removed and filename is left
+unchanged
+*/
+
+int
+fileio_close(FILE *fp, const int ok, const char *tmpname, const char *filename)
+{
+  if (fclose(fp) != 0)
+    {
+      fprintf(stderr, "fileio_close: error writing %s: %s\n",
+              tmpname, strerror(errno));
+      remove(tmpname);
+      return -1;
+    }
+
+  if (!ok)
+    {
+      fprintf(stderr, "fileio_close: incomplete write to %s\n", tmpname);
+      remove(tmpname);
+      return -1;
+    }
+
+  if (rename(tmpname, filename) != 0)
+    {
+      fprintf(stderr, "fileio_close: unable to rename %s to %s: %s\n",
+              tmpname, filename, strerror(errno));
+      remove(tmpname);
+      return -1;
+    }
+
+  return 0;
+} /* fileio_close() */
@@ -0,0 +1,18 @@
+/*
+ * fileio.h
+ */
+
+#ifndef INCLUDED_fileio_h
+#define INCLUDED_fileio_h
+
+#include <stdio.h>
+#include <limits.h>
+
+/*
+ * Prototypes
+ */
+
+FILE *fileio_open(const char *filename, char tmpname[PATH_MAX]);
+int fileio_close(FILE *fp, const int ok, const char *tmpname, const char *filename);
+
+#endif /* INCLUDED_fileio_h */
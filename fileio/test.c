@@ -0,0 +1,88 @@
+/*
+ * test.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gsl/gsl_test.h>
+
+#include "fileio.h"
+
+/* read entire contents of a small file into buf */
+static size_t
+test_read(const char *filename, char *buf, const size_t len)
+{
+  FILE *fp = fopen(filename, "r");
+  size_t n;
+
+  if (!fp)
+    return 0;
+
+  n = fread(buf, 1, len, fp);
+  fclose(fp);
+
+  return n;
+}
+
+/*
+ * a completed write replaces the file, a failed write leaves the
+ * previous contents in place, and no temporary file is left behind
+ */
+static int
+test_write(void)
+{
+  int s = 0;
+  char filename[] = "/tmp/fileio_test_XXXXXX";
+  char tmpname[PATH_MAX];
+  char buf[64];
+  size_t n;
+  FILE *fp;
+  int fd;
+
+  fd = mkstemp(filename);
+  if (fd < 0)
+    return -1;
+
+  close(fd);
+
+  fp = fileio_open(filename, tmpname);
+  gsl_test(fp == NULL, "fileio_open");
+  if (!fp)
+    {
+      unlink(filename);
+      return -1;
+    }
+
+  n = fwrite("first", 1, 5, fp);
+  s += fileio_close(fp, n == 5, tmpname, filename);
+
+  n = test_read(filename, buf, sizeof(buf));
+  gsl_test(n != 5 || memcmp(buf, "first", 5) != 0, "fileio completed write");
+  gsl_test(access(tmpname, F_OK) == 0, "fileio temporary file removed after rename");
+
+  fp = fileio_open(filename, tmpname);
+  if (fp)
+    {
+      fwrite("second", 1, 6, fp);
+      gsl_test(fileio_close(fp, 0, tmpname, filename) != -1, "fileio failed write status");
+
+      n = test_read(filename, buf, sizeof(buf));
+      gsl_test(n != 5 || memcmp(buf, "first", 5) != 0, "fileio failed write keeps old file");
+      gsl_test(access(tmpname, F_OK) == 0, "fileio temporary file removed after failure");
+    }
+
+  unlink(filename);
+
+  return s;
+} /* test_write() */
+
+int
+main()
+{
+  gsl_test(test_write(), "fileio write");
+
+  exit (gsl_test_summary());
+} /* main() */
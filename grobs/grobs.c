@@ -60,7 +60,8 @@ grobs_realloc(const size_t ntot, grobs_data *data)
   data->D = realloc(data->D, ntot * sizeof(double));
   data->I = realloc(data->I, ntot * sizeof(double));
 
-  for (i = 0; i < ntot; ++i)
+  /* initialize new records */
+  for (i = data->ntot; i < ntot; ++i)
     {
       data->t[i] = 0;
       data->X[i] = 0.0;
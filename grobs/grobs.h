@@ -43,6 +43,7 @@ void grobs_free(grobs_data *data);
 
 /* iaga.c */
 grobs_data *grobs_iaga_read(const char *filename, grobs_data *data);
+grobs_data *grobs_iaga_read_cache(const char *filename, const char *cache_file, grobs_data *data);
 
 /* wamnet.c */
 grobs_data *grobs_wamnet_read(const char *filename, grobs_data *data);
@@ -2,6 +2,16 @@
  * iaga.c
  *
  * Routines for reading IAGA formatted data files
+ *
+ * Files are read into memory in one pass and data lines are parsed
+ * with a fixed-column parser (IAGA-2002 format):
+ *
+ * YYYY-MM-DD hh:mm:ss.sss DOY   v1 v2 v3 v4
+ *
+ * Lines which do not match the fixed layout are parsed with sscanf().
+ *
+ * grobs_iaga_read_cache() additionally keeps a binary column cache
+ * of each file, so repeat runs do not parse the ASCII data.
  */
 
 #include <stdio.h>
@@ -11,42 +21,96 @@
 #include <errno.h>
 #include <strings.h>
 #include <ctype.h>
+#include <limits.h>
+#include <sys/stat.h>
 
 #include <gsl/gsl_math.h>
 
 #include <common/common.h>
 
+#include "fileio.h"
 #include "grobs.h"
 
-static int iaga_read_HDZF(FILE *fp, grobs_data *data);
-static int iaga_read_XYZF(FILE *fp, grobs_data *data);
+/* approximate length of an IAGA-2002 data line, used to estimate record count */
+#define IAGA_LINE_LENGTH     71
+
+#define IAGA_CACHE_MAGIC     "GROBSC01"
+
+typedef struct
+{
+  char magic[8];
+  long mtime;     /* modification time of IAGA file */
+  long size;      /* size of IAGA file in bytes */
+  size_t n;       /* number of records */
+  double glat;
+  double glon;
+} iaga_cache_header;
+
+static char *iaga_read_file(const char *filename, size_t *len);
+static int iaga_read_data(const int type, char *ptr, const char *end, grobs_data *data);
+static int iaga_parse_line(const char *line, int *year, int *month, int *day,
+                           int *hour, int *min, double *fsec, double v[4]);
+static int iaga_parse_int(const char *p, const size_t len, int *val);
+static int iaga_cache_read(const char *cache_file, const struct stat *sb, grobs_data *data);
+static int iaga_cache_write(const char *cache_file, const struct stat *sb,
+                            const size_t idx, const grobs_data *data);
+
+#define IAGA_TYPE_HDZF       0
+#define IAGA_TYPE_XYZF       1
+
+/*
+grobs_iaga_read()
+  Read IAGA-2002 data file
+
+Inputs: filename - IAGA file
+        data     - (input/output) data structure, or NULL to allocate;
+                   records are appended
+
+Return: pointer to data structure, or NULL on error
+
+Notes:
+1) If the header cannot be read (missing geodetic latitude/longitude
+or an unknown reported format), no records are appended and NULL is
+returned. A data structure passed in by the caller is left as it was
+and remains owned by the caller
+*/
 
 grobs_data *
 grobs_iaga_read(const char *filename, grobs_data *data)
 {
-  FILE *fp;
-  char buf[GROBS_MAX_BUFFER];
+  char *buf, *ptr, *end;
   char s1[GROBS_MAX_BUFFER];
   char s2[GROBS_MAX_BUFFER];
   int header_cnt = 0;
+  const int alloc = (data == NULL);
+  size_t n0;
+  size_t len;
 
-  fp = fopen(filename, "r");
-  if (!fp)
-    {
-      fprintf(stderr, "fopen: cannot open %s: %s\n",
-              filename, strerror(errno));
-      return NULL;
-    }
+  buf = iaga_read_file(filename, &len);
+  if (!buf)
+    return NULL;
 
-  /* allocate space for 1-minute data */
-  if (data == NULL)
-    data = grobs_alloc(GROBS_MAX_YEAR * 527040);
+  /* allocate space for 1-minute data, estimated from file size */
+  n0 = data ? data->n : 0;
+  data = grobs_realloc(n0 + len / IAGA_LINE_LENGTH + 1, data);
 
-  while (fgets(buf, GROBS_MAX_BUFFER, fp) != NULL)
+  ptr = buf;
+  end = buf + len;
+
+  while (ptr < end)
     {
       int c;
       double val;
-      char *bufptr = buf;
+      char *bufptr = ptr;
+      char *eol = memchr(ptr, '\n', end - ptr);
+
+      if (eol)
+        {
+          *eol = '\0';
+          ptr = eol + 1;
+        }
+      else
+        ptr = end;
 
       while (isspace(*bufptr))
         bufptr++;
@@ -80,11 +144,11 @@ grobs_iaga_read(const char *filename, grobs_data *data)
               ++header_cnt;
               if (!strncmp(s2, "HDZF", 4))
                 {
-                  iaga_read_HDZF(fp, data);
+                  iaga_read_data(IAGA_TYPE_HDZF, ptr, end, data);
                 }
               else if (!strncmp(s2, "XYZF", 4) || !strncmp(s2, "XYZG", 4))
                 {
-                  iaga_read_XYZF(fp, data);
+                  iaga_read_data(IAGA_TYPE_XYZF, ptr, end, data);
                 }
               else
                 {
@@ -99,35 +163,157 @@ grobs_iaga_read(const char *filename, grobs_data *data)
         }
     }
 
-  fclose(fp);
+  free(buf);
 
   if (header_cnt != 3)
     {
-      fprintf(stderr, "grobs_iaga_read: failed to read header\n");
+      fprintf(stderr, "grobs_iaga_read: %s: failed to read header\n", filename);
+
+      if (alloc)
+        grobs_free(data);
+      else
+        data->n = n0;
+
+      return NULL;
     }
 
   return data;
 }
 
+/*
+grobs_iaga_read_cache()
+  Read IAGA data file, using a binary cache of the parsed data
+if it is up to date
+
+Inputs: filename   - IAGA file
+        cache_file - binary cache file for this IAGA file
+        data       - (input/output) data structure, or NULL to allocate;
+                     records are appended
+
+Return: pointer to data structure, or NULL on error
+
+Notes:
+1) The cache is keyed on the modification time and size of the IAGA
+file. If they do not match (or the cache does not exist), the IAGA
+file is parsed and the cache is rewritten. The cache is not written
+if the IAGA file cannot be parsed.
+
+2) The cache holds the columns t, X, Y, Z, H, D, I in native byte order
+*/
+
+grobs_data *
+grobs_iaga_read_cache(const char *filename, const char *cache_file, grobs_data *data)
+{
+  struct stat sb;
+  const int alloc = (data == NULL);
+  size_t idx;
+
+  if (stat(filename, &sb) != 0)
+    {
+      fprintf(stderr, "grobs_iaga_read_cache: cannot stat %s: %s\n",
+              filename, strerror(errno));
+      return NULL;
+    }
+
+  if (data == NULL)
+    data = grobs_alloc(0);
+
+  if (iaga_cache_read(cache_file, &sb, data) == 0)
+    return data;
+
+  /* cache missing or stale: parse IAGA file and write records added */
+  idx = data->n;
+  if (grobs_iaga_read(filename, data) == NULL)
+    {
+      if (alloc)
+        grobs_free(data);
+
+      return NULL;
+    }
+
+  iaga_cache_write(cache_file, &sb, idx, data);
+
+  return data;
+}
+
+/* read entire file into a nul-terminated buffer */
+static char *
+iaga_read_file(const char *filename, size_t *len)
+{
+  FILE *fp;
+  struct stat sb;
+  char *buf;
+
+  fp = fopen(filename, "r");
+  if (!fp)
+    {
+      fprintf(stderr, "fopen: cannot open %s: %s\n",
+              filename, strerror(errno));
+      return NULL;
+    }
+
+  if (fstat(fileno(fp), &sb) != 0)
+    {
+      fclose(fp);
+      return NULL;
+    }
+
+  buf = malloc(sb.st_size + 1);
+  if (!buf)
+    {
+      fprintf(stderr, "iaga_read_file: unable to allocate buffer: %s\n",
+              strerror(errno));
+      fclose(fp);
+      return NULL;
+    }
+
+  *len = fread(buf, 1, sb.st_size, fp);
+  buf[*len] = '\0';
+
+  fclose(fp);
+
+  return buf;
+}
+
+/*
+iaga_read_data()
+  Parse IAGA data lines
+
+Inputs: type - IAGA_TYPE_HDZF or IAGA_TYPE_XYZF
+        ptr  - start of data lines
+        end  - end of buffer (nul-terminated)
+        data - (output) data structure, records are appended
+
+Notes:
+1) Timestamps are computed from the start of each day plus the time
+of day, so date2timet() is called once per day rather than once per line
+*/
+
 static int
-iaga_read_HDZF(FILE *fp, grobs_data *data)
+iaga_read_data(const int type, char *ptr, const char *end, grobs_data *data)
 {
-  int ret;
-  char buf[GROBS_MAX_BUFFER];
   size_t n = data->n;
+  int year0 = -1, month0 = -1, day0 = -1;
+  time_t t0 = 0;
 
-  while (fgets(buf, GROBS_MAX_BUFFER, fp) != NULL)
+  while (ptr < end)
     {
+      char *line = ptr;
+      char *eol = memchr(ptr, '\n', end - ptr);
       int year, month, day;
-      int hour, min, doy;
-      double fsec;
-      double Z, D, F, H, Drad;
-
-      /* read day number */
-      ret = sscanf(buf, "%d-%d-%d %d:%d:%lf %d %lf %lf %lf %lf",
-                   &year, &month, &day, &hour, &min, &fsec,
-                   &doy, &H, &D, &Z, &F);
-      if (ret < 11)
+      int hour, min;
+      double fsec, v[4];
+      double Z, H;
+
+      if (eol)
+        {
+          *eol = '\0';
+          ptr = eol + 1;
+        }
+      else
+        ptr = (char *) end;
+
+      if (iaga_parse_line(line, &year, &month, &day, &hour, &min, &fsec, v))
         continue;
 
       if (day < 1 || day > 31)
@@ -137,32 +323,55 @@ iaga_read_HDZF(FILE *fp, grobs_data *data)
         continue;
 
       /* check missing data */
-      if (fabs(H) > 90000.0)
+      if (fabs(v[0]) > 90000.0)
         continue;
-      if (fabs(D) > 90000.0)
+      if (fabs(v[1]) > 90000.0)
         continue;
-      if (fabs(Z) > 90000.0)
+      if (fabs(v[2]) > 90000.0)
         continue;
-      if (fabs(F) > 90000.0)
+      if (fabs(v[3]) > 90000.0)
         continue;
 
-      /* D is in arcminutes */
-      Drad = (D / 60.0) * M_PI / 180.0;
+      if (n >= data->ntot)
+        grobs_realloc(GSL_MAX(2 * data->ntot, 1440), data);
+
+      if (year != year0 || month != month0 || day != day0)
+        {
+          t0 = date2timet(0, 0, 0, day, month, year);
+          year0 = year;
+          month0 = month;
+          day0 = day;
+        }
+
+      data->t[n] = t0 + 3600 * hour + 60 * min + (int) fsec;
+
+      Z = v[2];
+
+      if (type == IAGA_TYPE_HDZF)
+        {
+          /* D is in arcminutes */
+          double Drad = (v[1] / 60.0) * M_PI / 180.0;
+
+          H = v[0];
+
+          data->X[n] = H * cos(Drad);
+          data->Y[n] = H * sin(Drad);
+          data->D[n] = Drad * 180.0 / M_PI;
+        }
+      else
+        {
+          H = gsl_hypot(v[0], v[1]);
+
+          data->X[n] = v[0];
+          data->Y[n] = v[1];
+          data->D[n] = atan2(v[1], v[0]) * 180.0 / M_PI;
+        }
 
-      /* store value */
-      data->t[n] = date2timet((int) fsec, min, hour, day, month, year);
-      data->X[n] = H * cos(Drad);
-      data->Y[n] = H * sin(Drad);
       data->Z[n] = Z;
       data->H[n] = H;
-      data->D[n] = Drad * 180.0 / M_PI;
       data->I[n] = atan2(Z, H);
 
-      if (++n >= data->ntot)
-        {
-          fprintf(stderr, "iaga_read: not enough space allocated: %zu\n", data->ntot);
-          break;
-        }
+      ++n;
     }
 
   data->n = n;
@@ -170,62 +379,163 @@ iaga_read_HDZF(FILE *fp, grobs_data *data)
   return 0;
 }
 
+/*
+iaga_parse_line()
+  Parse an IAGA-2002 data line
+
+Return: 0 on success, -1 if line is not a data line
+
+Notes:
+1) Date and time are read from fixed columns; the DOY and values
+are whitespace separated. Lines which do not have the fixed layout
+are parsed with sscanf()
+*/
+
 static int
-iaga_read_XYZF(FILE *fp, grobs_data *data)
+iaga_parse_line(const char *line, int *year, int *month, int *day,
+                int *hour, int *min, double *fsec, double v[4])
 {
-  int ret;
-  char buf[GROBS_MAX_BUFFER];
-  size_t n = data->n;
+  const char *p;
+  char *endp;
+  size_t i;
+
+  if (strlen(line) >= 23 &&
+      line[4] == '-' && line[7] == '-' && line[10] == ' ' &&
+      line[13] == ':' && line[16] == ':' &&
+      !iaga_parse_int(line, 4, year) &&
+      !iaga_parse_int(line + 5, 2, month) &&
+      !iaga_parse_int(line + 8, 2, day) &&
+      !iaga_parse_int(line + 11, 2, hour) &&
+      !iaga_parse_int(line + 14, 2, min))
+    {
+      *fsec = strtod(line + 17, &endp);
+      if (endp == line + 17)
+        return -1;
+
+      /* day of year */
+      p = endp;
+      strtol(p, &endp, 10);
+      if (endp == p)
+        return -1;
+
+      for (i = 0; i < 4; ++i)
+        {
+          p = endp;
+          v[i] = strtod(p, &endp);
+          if (endp == p)
+            return -1;
+        }
 
-  while (fgets(buf, GROBS_MAX_BUFFER, fp) != NULL)
+      return 0;
+    }
+  else
     {
-      int year, month, day;
-      int hour, min, doy;
-      double fsec;
-      double X, Y, Z, F, H;
-
-      /* read day number */
-      ret = sscanf(buf, "%d-%d-%d %d:%d:%lf %d %lf %lf %lf %lf",
-                   &year, &month, &day, &hour, &min, &fsec,
-                   &doy, &X, &Y, &Z, &F);
-      if (ret < 11)
-        continue;
+      int doy;
+      int ret = sscanf(line, "%d-%d-%d %d:%d:%lf %d %lf %lf %lf %lf",
+                       year, month, day, hour, min, fsec,
+                       &doy, &v[0], &v[1], &v[2], &v[3]);
 
-      if (day < 1 || day > 31)
-        continue;
+      return (ret < 11) ? -1 : 0;
+    }
+}
 
-      if (month < 1 || month > 12)
-        continue;
+static int
+iaga_parse_int(const char *p, const size_t len, int *val)
+{
+  int x = 0;
+  size_t i;
 
-      /* check missing data */
-      if (fabs(X) > 90000.0)
-        continue;
-      if (fabs(Y) > 90000.0)
-        continue;
-      if (fabs(Z) > 90000.0)
-        continue;
-      if (fabs(F) > 90000.0)
-        continue;
+  for (i = 0; i < len; ++i)
+    {
+      if (p[i] < '0' || p[i] > '9')
+        return -1;
 
-      H = gsl_hypot(X, Y);
+      x = 10 * x + (p[i] - '0');
+    }
 
-      /* store value */
-      data->t[n] = date2timet((int) fsec, min, hour, day, month, year);
-      data->X[n] = X;
-      data->Y[n] = Y;
-      data->Z[n] = Z;
-      data->H[n] = H;
-      data->D[n] = atan2(Y, X) * 180.0 / M_PI;
-      data->I[n] = atan2(Z, H);
+  *val = x;
 
-      if (++n >= data->ntot)
-        {
-          fprintf(stderr, "iaga_read: not enough space allocated: %zu\n", data->ntot);
-          break;
-        }
+  return 0;
+}
+
+/* append cached records to data; return 0 if cache is valid */
+static int
+iaga_cache_read(const char *cache_file, const struct stat *sb, grobs_data *data)
+{
+  FILE *fp;
+  iaga_cache_header hdr;
+  size_t n0 = data->n;
+  size_t nread = 0;
+
+  fp = fopen(cache_file, "r");
+  if (!fp)
+    return -1;
+
+  if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+      memcmp(hdr.magic, IAGA_CACHE_MAGIC, 8) != 0 ||
+      hdr.mtime != (long) sb->st_mtime ||
+      hdr.size != (long) sb->st_size)
+    {
+      fclose(fp);
+      return -1;
     }
 
-  data->n = n;
+  grobs_realloc(n0 + hdr.n, data);
+
+  nread += fread(data->t + n0, sizeof(time_t), hdr.n, fp);
+  nread += fread(data->X + n0, sizeof(double), hdr.n, fp);
+  nread += fread(data->Y + n0, sizeof(double), hdr.n, fp);
+  nread += fread(data->Z + n0, sizeof(double), hdr.n, fp);
+  nread += fread(data->H + n0, sizeof(double), hdr.n, fp);
+  nread += fread(data->D + n0, sizeof(double), hdr.n, fp);
+  nread += fread(data->I + n0, sizeof(double), hdr.n, fp);
+
+  fclose(fp);
+
+  if (nread != 7 * hdr.n)
+    {
+      fprintf(stderr, "iaga_cache_read: %s: truncated cache file\n", cache_file);
+      return -1;
+    }
+
+  data->n = n0 + hdr.n;
+  data->glat = hdr.glat;
+  data->glon = hdr.glon;
 
   return 0;
 }
+
+/* write records [idx, data->n) to cache file */
+static int
+iaga_cache_write(const char *cache_file, const struct stat *sb,
+                 const size_t idx, const grobs_data *data)
+{
+  FILE *fp;
+  iaga_cache_header hdr;
+  const size_t n = data->n - idx;
+  char tmpname[PATH_MAX];
+  size_t nwrite = 0;
+
+  fp = fileio_open(cache_file, tmpname);
+  if (!fp)
+    return -1;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, IAGA_CACHE_MAGIC, 8);
+  hdr.mtime = (long) sb->st_mtime;
+  hdr.size = (long) sb->st_size;
+  hdr.n = n;
+  hdr.glat = data->glat;
+  hdr.glon = data->glon;
+
+  nwrite += fwrite(&hdr, sizeof(hdr), 1, fp);
+  nwrite += fwrite(data->t + idx, sizeof(time_t), n, fp);
+  nwrite += fwrite(data->X + idx, sizeof(double), n, fp);
+  nwrite += fwrite(data->Y + idx, sizeof(double), n, fp);
+  nwrite += fwrite(data->Z + idx, sizeof(double), n, fp);
+  nwrite += fwrite(data->H + idx, sizeof(double), n, fp);
+  nwrite += fwrite(data->D + idx, sizeof(double), n, fp);
+  nwrite += fwrite(data->I + idx, sizeof(double), n, fp);
+
+  return fileio_close(fp, nwrite == 1 + 7 * n, tmpname, cache_file);
+}
@@ -1,28 +1,332 @@
+/*
+ * test.c
+ *
+ * Print ground observatory data, or run self tests of the IAGA
+ * reader if no arguments are given
+ */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <getopt.h>
 #include <time.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
 
 #include <gsl/gsl_math.h>
+#include <gsl/gsl_test.h>
 
 #include <common/common.h>
 
 #include "grobs.h"
 
+/* IAGA-2002 file header, followed by the reported type */
+static const char *test_iaga_header =
+  " Format                 IAGA-2002                                    |\n"
+  " Source of Data         Test                                         |\n"
+  " Station Name           Test                                         |\n"
+  " IAGA CODE              TST                                          |\n"
+  " Geodetic Latitude      -11.950                                      |\n"
+  " Geodetic Longitude     283.130                                      |\n"
+  " Elevation              550                                          |\n";
+
+/*
+ * data lines: fixed-column lines, a missing value, a day change, lines
+ * with single digit fields which fall back to sscanf(), and a line
+ * without a trailing newline
+ */
+static const char *test_iaga_hdzf =
+  " Reported               HDZF                                         |\n"
+  " # D is in arcminutes                                                |\n"
+  "DATE       TIME         DOY     TSTH      TSTD      TSTZ      TSTF   |\n"
+  "2015-03-17 00:00:00.000 076     25123.40    -13.50   -1234.50  25153.71\n"
+  "2015-03-17 00:01:00.000 076     25124.10    -13.52   -1233.90  25154.38\n"
+  "2015-03-17 00:02:00.000 076     99999.00  99999.00  99999.00  99999.00\n"
+  "2015-03-17 23:59:00.000 076     25119.80    -13.41   -1236.20  25150.20\n"
+  "2015-03-18 00:00:00.000 077     25119.75    -13.40   -1236.25  25150.15\n"
+  "2015-3-18 1:2:3.000 077 25118.00 -13.30 -1237.00 25148.44\n"
+  "2015-03-18 12:30:45.000 077     25110.05    -12.95   -1240.10  25140.65";
+
+static const char *test_iaga_xyzf =
+  " Reported               XYZF                                         |\n"
+  "DATE       TIME         DOY     TSTX      TSTY      TSTZ      TSTF   |\n"
+  "2015-12-31 23:58:00.000 365     27123.40   -412.50  -1234.50  27154.60\n"
+  "2015-12-31 23:59:00.000 365     27124.10   -413.20  -1233.90  27155.27\n"
+  "2016-01-01 00:00:00.000 001     27125.00   -413.90  99999.00  99999.00\n"
+  "2016-01-01 00:01:00.000 001     27125.80   -414.60  -1232.70  27157.00\n"
+  "2016-1-1 0:2:0.000 1 27126.30 -415.00 -1232.20 27157.45\n";
+
+static const char *test_iaga_unknown =
+  " Reported               ABCD                                         |\n"
+  "DATE       TIME         DOY     TSTA      TSTB      TSTC      TSTD   |\n"
+  "2015-03-17 00:00:00.000 076     25123.40    -13.50   -1234.50  25153.71\n";
+
+/* make a unique temporary file name which does not exist yet */
+static int
+test_tmpname(char *filename)
+{
+  int fd;
+
+  strcpy(filename, "/tmp/grobs_test_XXXXXX");
+
+  fd = mkstemp(filename);
+  if (fd < 0)
+    return -1;
+
+  close(fd);
+  unlink(filename);
+
+  return 0;
+}
+
+/* write IAGA file with given body */
+static int
+test_write_iaga(const char *filename, const char *body)
+{
+  FILE *fp = fopen(filename, "w");
+  int s = 0;
+
+  if (!fp)
+    return -1;
+
+  if (fputs(test_iaga_header, fp) == EOF || fputs(body, fp) == EOF)
+    s = -1;
+
+  if (fclose(fp))
+    s = -1;
+
+  return s;
+}
+
+/*
+ * parse data lines of body with the original sscanf() reader, one
+ * line at a time, and compute records as it did
+ */
+static grobs_data *
+test_parse_sscanf(const int hdzf, const char *body)
+{
+  grobs_data *data = grobs_alloc(64);
+  const char *p = body;
+  size_t n = 0;
+
+  while (*p)
+    {
+      char buf[GROBS_MAX_BUFFER];
+      const char *eol = strchr(p, '\n');
+      size_t len = eol ? (size_t) (eol - p) : strlen(p);
+      int year, month, day;
+      int hour, min, doy;
+      double fsec, v[4];
+      int ret;
+
+      memcpy(buf, p, len);
+      buf[len] = '\0';
+      p += eol ? len + 1 : len;
+
+      ret = sscanf(buf, "%d-%d-%d %d:%d:%lf %d %lf %lf %lf %lf",
+                   &year, &month, &day, &hour, &min, &fsec,
+                   &doy, &v[0], &v[1], &v[2], &v[3]);
+      if (ret < 11)
+        continue;
+
+      if (day < 1 || day > 31 || month < 1 || month > 12)
+        continue;
+
+      if (fabs(v[0]) > 90000.0 || fabs(v[1]) > 90000.0 ||
+          fabs(v[2]) > 90000.0 || fabs(v[3]) > 90000.0)
+        continue;
+
+      data->t[n] = date2timet((int) fsec, min, hour, day, month, year);
+
+      if (hdzf)
+        {
+          double Drad = (v[1] / 60.0) * M_PI / 180.0;
+
+          data->X[n] = v[0] * cos(Drad);
+          data->Y[n] = v[0] * sin(Drad);
+          data->H[n] = v[0];
+          data->D[n] = Drad * 180.0 / M_PI;
+        }
+      else
+        {
+          data->X[n] = v[0];
+          data->Y[n] = v[1];
+          data->H[n] = gsl_hypot(v[0], v[1]);
+          data->D[n] = atan2(v[1], v[0]) * 180.0 / M_PI;
+        }
+
+      data->Z[n] = v[2];
+      data->I[n] = atan2(data->Z[n], data->H[n]);
+
+      ++n;
+    }
+
+  data->n = n;
+
+  return data;
+}
+
+/* compare two sets of records to relative tolerance tol */
+static void
+test_compare(const double tol, const grobs_data *data, const grobs_data *expected,
+             const char *desc)
+{
+  size_t i;
+
+  gsl_test(data->n != expected->n, "%s: number of records %zu/%zu",
+           desc, data->n, expected->n);
+  gsl_test_rel(data->glat, -11.950, tol, "%s: glat", desc);
+  gsl_test_rel(data->glon, 283.130, tol, "%s: glon", desc);
+
+  for (i = 0; i < GSL_MIN(data->n, expected->n); ++i)
+    {
+      gsl_test(data->t[i] != expected->t[i], "%s: t[%zu] = %ld/%ld",
+               desc, i, (long) data->t[i], (long) expected->t[i]);
+      gsl_test_rel(data->X[i], expected->X[i], tol, "%s: X[%zu]", desc, i);
+      gsl_test_rel(data->Y[i], expected->Y[i], tol, "%s: Y[%zu]", desc, i);
+      gsl_test_rel(data->Z[i], expected->Z[i], tol, "%s: Z[%zu]", desc, i);
+      gsl_test_rel(data->H[i], expected->H[i], tol, "%s: H[%zu]", desc, i);
+      gsl_test_rel(data->D[i], expected->D[i], tol, "%s: D[%zu]", desc, i);
+      gsl_test_rel(data->I[i], expected->I[i], tol, "%s: I[%zu]", desc, i);
+    }
+}
+
+/*
+ * parse an IAGA file, compare against the sscanf() reader, then
+ * check the cached and reread records match the parsed records
+ */
+static int
+test_iaga(const int hdzf, const char *body, const size_t n_expected)
+{
+  int s = 0;
+  const double tol = 1.0e-12;
+  const char *desc = hdzf ? "HDZF" : "XYZF";
+  char iaga_file[PATH_MAX], cache_file[PATH_MAX];
+  grobs_data *expected, *data, *cached, *reread;
+  char buf[256];
+
+  if (test_tmpname(iaga_file) || test_tmpname(cache_file))
+    return -1;
+
+  s += test_write_iaga(iaga_file, body);
+
+  expected = test_parse_sscanf(hdzf, body);
+  gsl_test(expected->n != n_expected, "%s: sscanf records %zu/%zu",
+           desc, expected->n, n_expected);
+
+  data = grobs_iaga_read(iaga_file, NULL);
+  if (data == NULL)
+    {
+      gsl_test(1, "%s: grobs_iaga_read failed", desc);
+      grobs_free(expected);
+      unlink(iaga_file);
+      return -1;
+    }
+
+  sprintf(buf, "%s parsed", desc);
+  test_compare(tol, data, expected, buf);
+
+  /* first call parses the IAGA file and writes the cache */
+  cached = grobs_iaga_read_cache(iaga_file, cache_file, NULL);
+  gsl_test(access(cache_file, F_OK) != 0, "%s: cache file written", desc);
+
+  /* second call reads the cache */
+  reread = grobs_iaga_read_cache(iaga_file, cache_file, NULL);
+
+  if (cached && reread)
+    {
+      sprintf(buf, "%s cached", desc);
+      test_compare(0.0, cached, data, buf);
+
+      sprintf(buf, "%s reread", desc);
+      test_compare(0.0, reread, data, buf);
+    }
+  else
+    {
+      gsl_test(1, "%s: grobs_iaga_read_cache failed", desc);
+      s = -1;
+    }
+
+  grobs_free(expected);
+  grobs_free(data);
+  if (cached)
+    grobs_free(cached);
+  if (reread)
+    grobs_free(reread);
+
+  unlink(iaga_file);
+  unlink(cache_file);
+
+  return s;
+}
+
+/*
+ * an unknown reported type must be an error, leave the caller's
+ * records in place and not write a cache file
+ */
+static int
+test_iaga_bad(void)
+{
+  int s = 0;
+  char iaga_file[PATH_MAX], cache_file[PATH_MAX];
+  grobs_data *data, *ret;
+
+  if (test_tmpname(iaga_file) || test_tmpname(cache_file))
+    return -1;
+
+  s += test_write_iaga(iaga_file, test_iaga_unknown);
+
+  ret = grobs_iaga_read(iaga_file, NULL);
+  gsl_test(ret != NULL, "bad header: grobs_iaga_read returns NULL");
+
+  data = test_parse_sscanf(1, test_iaga_hdzf);
+  ret = grobs_iaga_read(iaga_file, data);
+  gsl_test(ret != NULL, "bad header: grobs_iaga_read with data returns NULL");
+  gsl_test(data->n != 6, "bad header: caller records kept, n = %zu", data->n);
+
+  ret = grobs_iaga_read_cache(iaga_file, cache_file, NULL);
+  gsl_test(ret != NULL, "bad header: grobs_iaga_read_cache returns NULL");
+  gsl_test(access(cache_file, F_OK) == 0, "bad header: no cache file written");
+
+  grobs_free(data);
+
+  unlink(iaga_file);
+  unlink(cache_file);
+
+  return s;
+}
+
 int
 main(int argc, char *argv[])
 {
   int c;
   grobs_data *data = NULL;
+  char *cache_file = NULL;
   size_t i;
 
-  while ((c = getopt(argc, argv, "i:w:")) != (-1))
+  if (argc == 1)
+    {
+      gsl_test(test_iaga(1, test_iaga_hdzf, 6), "IAGA HDZF");
+      gsl_test(test_iaga(0, test_iaga_xyzf, 4), "IAGA XYZF");
+      gsl_test(test_iaga_bad(), "IAGA bad header");
+
+      exit (gsl_test_summary());
+    }
+
+  while ((c = getopt(argc, argv, "c:i:w:")) != (-1))
     {
       switch (c)
         {
+          case 'c':
+            cache_file = optarg;
+            break;
+
           case 'i':
-            data = grobs_iaga_read(optarg, NULL);
+            if (cache_file)
+              data = grobs_iaga_read_cache(optarg, cache_file, NULL);
+            else
+              data = grobs_iaga_read(optarg, NULL);
             break;
 
           case 'w':
@@ -39,7 +343,7 @@ main(int argc, char *argv[])
 
   if (data == NULL)
     {
-      printf("usage: %s [-i iaga_file] [-w wamnet_file]\n", argv[0]);
+      printf("usage: %s [-c cache_file] [-i iaga_file] [-w wamnet_file]\n", argv[0]);
       exit(1);
     }
 
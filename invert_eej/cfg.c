@@ -72,6 +72,21 @@ static cfg_struct cfg_dirs[] = {
   { "main_nmax_int", &(cfg_params.main_nmax_int), CFG_INT|CFG_OPTIONAL },
   { "crust_nmax_int", &(cfg_params.crust_nmax_int), CFG_INT|CFG_OPTIONAL },
 
+  { "nprocs", &(cfg_params.nprocs), CFG_INT|CFG_OPTIONAL },
+  { "model_nprocs", &(cfg_params.model_nprocs), CFG_INT|CFG_OPTIONAL },
+  { "mageq_table_file", &(cfg_params.mageq_table_file), CFG_STRING|CFG_OPTIONAL },
+  { "eej_geometry_file", &(cfg_params.eej_geometry_file), CFG_STRING|CFG_OPTIONAL },
+  { "pde_solver", &(cfg_params.pde_solver), CFG_STRING|CFG_OPTIONAL },
+  { "pde_lis_options", &(cfg_params.pde_lis_options), CFG_STRING|CFG_OPTIONAL },
+  { "pde_system_file", &(cfg_params.pde_system_file), CFG_STRING|CFG_OPTIONAL },
+
+  { "sigma_cache_file", &(cfg_params.sigma_cache_file), CFG_STRING|CFG_OPTIONAL },
+  { "sigma_cache_dt", &(cfg_params.sigma_cache_dt), CFG_DOUBLE|CFG_OPTIONAL },
+  { "sigma_cache_dlon", &(cfg_params.sigma_cache_dlon), CFG_DOUBLE|CFG_OPTIONAL },
+  { "sigma_cache_dtheta", &(cfg_params.sigma_cache_dtheta), CFG_DOUBLE|CFG_OPTIONAL },
+  { "sigma_cache_interp", &(cfg_params.sigma_cache_interp), CFG_INT|CFG_OPTIONAL },
+  { "sigma_cache_nslots", &(cfg_params.sigma_cache_nslots), CFG_INT|CFG_OPTIONAL },
+
   { 0, 0, 0 }
 };
 
@@ -56,6 +56,19 @@ typedef struct
   int calc_field_models;       /* calculate along-track field models */
   int main_nmax_int;           /* spherical harmonic nmax for core field model */
   int crust_nmax_int;          /* spherical harmonic nmax for crustal field model */
+  int nprocs;                  /* number of worker processes for track processing */
+  int model_nprocs;            /* number of IRI/MSIS/HWM server processes */
+  const char *mageq_table_file; /* dip equator lookup table file */
+  const char *eej_geometry_file; /* line current geometry cache file */
+  const char *pde_solver;      /* PDE sparse solver: lis, superlu or gmres */
+  const char *pde_lis_options; /* lis solver/preconditioner options */
+  const char *pde_system_file; /* file to save first PDE system to */
+  const char *sigma_cache_file; /* conductivity profile cache file */
+  double sigma_cache_dt;       /* conductivity cache time bucket (minutes) */
+  double sigma_cache_dlon;     /* conductivity cache longitude bin (degrees) */
+  double sigma_cache_dtheta;   /* conductivity cache colatitude bin (degrees) */
+  int sigma_cache_interp;      /* interpolate cached profiles in colatitude */
+  int sigma_cache_nslots;      /* number of conductivity cache table slots */
 } cfg_parameters;
 
 typedef struct
@@ -90,7 +90,8 @@ mag_alloc(mag_params *params)
                                                          params->sq_nmax_ext, params->sq_mmax_ext);
 
   w->eej_workspace_p = mag_eej_alloc(params->year, params->ncurr,
-                                     params->curr_altitude, params->qdlat_max);
+                                     params->curr_altitude, params->qdlat_max,
+                                     params->eej_geometry_file);
 
   {
     pde_parameters pde_params;
@@ -110,6 +111,21 @@ mag_alloc(mag_params *params)
     pde_params.theta_max = 115.0 * M_PI / 180.0;
     pde_params.ntheta = 101;
     pde_params.f107_file = params->f107_file;
+    pde_params.sigma_cache_file = params->sigma_cache_file;
+    pde_params.sigma_cache_params = sigma_cache_default_parameters();
+    pde_params.sigma_cache_params.dt = params->sigma_cache_dt * 60.0;
+    pde_params.sigma_cache_params.dlon = params->sigma_cache_dlon * M_PI / 180.0;
+    pde_params.sigma_cache_params.dtheta = params->sigma_cache_dtheta * M_PI / 180.0;
+    pde_params.sigma_cache_params.interp = params->sigma_cache_interp;
+    pde_params.sigma_cache_params.nslots = params->sigma_cache_nslots;
+    pde_params.model_nprocs = params->model_nprocs;
+    pde_params.mageq_table_file = params->mageq_table_file;
+    pde_params.mageq_tmin = (double) params->year;
+    pde_params.mageq_tmax = (double) params->year + 1.0;
+    pde_params.solver_params = pde_solver_default_parameters();
+    pde_params.solver_params.type = params->pde_solver;
+    pde_params.solver_params.lis_options = params->pde_lis_options;
+    pde_params.system_file = params->pde_system_file;
 
     w->pde_workspace_p = pde_alloc(&pde_params);
 
@@ -441,6 +457,11 @@ to other modules for processing.
 
 Inputs: data - satellite data
         w    - workspace
+
+Notes:
+1) If params->nprocs > 1, the accepted tracks are distributed
+among worker processes with mag_parallel_proc(); the log and
+output files are identical to a serial run
 */
 
 int
@@ -453,6 +474,7 @@ mag_proc(const mag_params *params, track_workspace *track_p,
   size_t nrejgap = 0,    /* number of rejections due to data gap */
          nrejlat = 0,    /* number of rejections due to latitude */
          nrejflag = 0;   /* number of rejections due to various flags */
+  size_t *idx;           /* indices of tracks to process */
 
   if (data->n < 1000)
     {
@@ -467,15 +489,14 @@ mag_proc(const mag_params *params, track_workspace *track_p,
   /* preprocess tracks using given parameters */
   mag_preproc(params, track_p, data, w);
 
+  idx = malloc(GSL_MAX(track_p->n, 1) * sizeof(size_t));
+
+  /* select tracks for processing */
   for (i = 0; i < track_p->n; ++i)
     {
-      int s;
       track_data *tptr = &(track_p->tracks[i]);
-      size_t sidx, eidx;
-      double lon_eq, lat_eq, t_eq, lt_eq, kp;
-      time_t unix_time;
-      int dir;
-      char buf[2048];
+      size_t sidx = tptr->start_idx;
+      size_t eidx = tptr->end_idx;
 
       /* discard flagged tracks */
       if (tptr->flags)
@@ -484,16 +505,6 @@ mag_proc(const mag_params *params, track_workspace *track_p,
           continue;
         }
 
-      sidx = tptr->start_idx;
-      eidx = tptr->end_idx;
-      lon_eq = tptr->lon_eq;
-      lat_eq = tptr->lat_eq;
-      t_eq = tptr->t_eq;
-      lt_eq = tptr->lt_eq;
-      unix_time = satdata_epoch2timet(tptr->t_eq);
-
-      kp_get(unix_time, &kp, w->kp_workspace_p);
-
       /* reject tracks with insufficient latitude coverage */
       if (fabs(data->qdlat[sidx]) < 35.0 || fabs(data->qdlat[eidx]) < 35.0)
         {
@@ -502,158 +513,225 @@ mag_proc(const mag_params *params, track_workspace *track_p,
         }
 
       /* check for data gaps */
-      s = mag_track_datagap(params->dlat_max, sidx, eidx, data);
-      if (s)
+      if (mag_track_datagap(params->dlat_max, sidx, eidx, data))
         {
           ++nrejgap;
           continue;
         }
 
-      ++ntrack;
-      dir = tptr->satdir;
-
-      sprintf(buf, "%s", ctime(&unix_time));
-      buf[strlen(buf) - 1] = '\0';
+      idx[ntrack++] = i;
+    }
 
-      fprintf(stderr, "mag_proc: found track %zu, %s, lon = %g, lt = %g, kp = %g, dir = %d\n",
-              ntrack, buf, lon_eq, lt_eq, kp, dir);
+  if (params->nprocs > 1 && ntrack > 1)
+    {
+      size_t ngap = 0;
 
-      /*
-       * store track in workspace, compute magnetic coordinates, and
-       * F^(1) residuals
-       */ 
-      s = mag_compute_F1(t_eq, lon_eq * M_PI / 180.0, M_PI / 2.0 - lat_eq * M_PI / 180.0, sidx, eidx, data, w);
-      if (s)
-        return s; /* error occurred */
-
-      /* filter out Sq and compute B^(2) or F^(2) residuals */
-      if (params->use_vector)
-        s = mag_sqfilt_vector(w, w->sqfilt_scalar_workspace_p);
-      else
-        s = mag_sqfilt_scalar(w, w->sqfilt_scalar_workspace_p);
-
-      if (s)
+      status = mag_parallel_proc(params, track_p, idx, ntrack, data, w, &ngap);
+      nrejgap += ngap;
+    }
+  else
+    {
+      for (i = 0; i < ntrack; ++i)
         {
-          /*
-           * While the above call to mag_track_datagap() searches for data gaps
-           * in the latitude variable, its possible there is a data gap in
-           * the available vector measurements, which is detected by
-           * mag_sqfilt_vector()
-           */
-          ++nrejgap;
-          continue;
+          int gap = 0;
+
+          status = mag_proc_track(params, &(track_p->tracks[idx[i]]), i + 1,
+                                  data, w, &gap);
+          if (status)
+            break; /* error occurred */
+
+          nrejgap += gap;
         }
+    }
 
-      /* invert for EEJ height-integrated current density */
-      if (params->use_vector)
-        s = mag_eej_vector_proc(&(w->track), w->EEJ, w->eej_workspace_p);
-      else
-        s = mag_eej_proc(&(w->track), w->EEJ, w->eej_workspace_p);
+  free(idx);
 
-      if (s)
-        return s;
+  if (status)
+    return status;
 
-      /* log information for this profile (track number, t_eq, lon_eq) */
-      mag_log_profile(0, ntrack, kp, dir, w);
+  log_proc(w->log_general,
+           "mag_proc: %zu/%zu tracks rejected due to insufficient latitude coverage\n",
+           nrejlat, track_p->n);
+  log_proc(w->log_general,
+           "mag_proc: %zu/%zu tracks rejected due to latitude gap\n",
+           nrejgap, track_p->n);
+  log_proc(w->log_general,
+           "mag_proc: %zu/%zu tracks rejected due to flags (LT, kp, rms)\n",
+           nrejflag, track_p->n);
 
-      /* print F^(2) or B^(2) residuals to log file */
-      if (params->use_vector)
-        mag_log_B2(0, w);
-      else
-        mag_log_F2(0, w);
+  return status;
+} /* mag_proc() */
 
-      /* output Sq SVD, L-curve and corners */
-      mag_log_Sq_Lcurve(0, w);
-      mag_log_Sq_Lcorner(0, w);
-      mag_log_Sq_svd(0, w);
+/*
+mag_proc_track()
+  Process a single satellite track which has passed the selection
+criteria in mag_proc(): compute F^(1) residuals, filter Sq, invert
+for the EEJ current profile, solve the PDE and invert for the EEF
+
+Inputs: params   - parameters
+        tptr     - track to process
+        ntrack   - track number for log files
+        data     - satellite data
+        w        - workspace
+        rejected - (output) set to 1 if the track was rejected due to
+                   a data gap in the vector measurements, 0 otherwise
+
+Return: success or error; PDE and EEF inversion failures are logged
+but not considered errors
+*/
 
-      /* print line current profiles to log file */
-      mag_log_LC(0, w);
+int
+mag_proc_track(const mag_params *params, const track_data *tptr,
+               const size_t ntrack, satdata_mag *data, mag_workspace *w,
+               int *rejected)
+{
+  int s;
+  size_t sidx = tptr->start_idx;
+  size_t eidx = tptr->end_idx;
+  double lon_eq = tptr->lon_eq;
+  double lat_eq = tptr->lat_eq;
+  double t_eq = tptr->t_eq;
+  double lt_eq = tptr->lt_eq;
+  time_t unix_time = satdata_epoch2timet(tptr->t_eq);
+  int dir = tptr->satdir;
+  double kp;
+  char buf[2048];
+
+  *rejected = 0;
+
+  kp_get(unix_time, &kp, w->kp_workspace_p);
+
+  sprintf(buf, "%s", ctime(&unix_time));
+  buf[strlen(buf) - 1] = '\0';
+
+  fprintf(stderr, "mag_proc: found track %zu, %s, lon = %g, lt = %g, kp = %g, dir = %d\n",
+          ntrack, buf, lon_eq, lt_eq, kp, dir);
+
+  /*
+   * store track in workspace, compute magnetic coordinates, and
+   * F^(1) residuals
+   */ 
+  s = mag_compute_F1(t_eq, lon_eq * M_PI / 180.0, M_PI / 2.0 - lat_eq * M_PI / 180.0, sidx, eidx, data, w);
+  if (s)
+    return s; /* error occurred */
 
-      /* print EEJ current density to log file */
-      mag_log_EEJ(0, w);
+  /* filter out Sq and compute B^(2) or F^(2) residuals */
+  if (params->use_vector)
+    s = mag_sqfilt_vector(w, w->sqfilt_scalar_workspace_p);
+  else
+    s = mag_sqfilt_scalar(w, w->sqfilt_scalar_workspace_p);
 
-      /* output EEJ SVD, L-curve and corners */
-      mag_log_EEJ_Lcurve(0, w);
-      mag_log_EEJ_Lcorner(0, w);
-      mag_log_EEJ_svd(0, w);
+  if (s)
+    {
+      /*
+       * While the above call to mag_track_datagap() searches for data gaps
+       * in the latitude variable, its possible there is a data gap in
+       * the available vector measurements, which is detected by
+       * mag_sqfilt_vector()
+       */
+      *rejected = 1;
+      return 0;
+    }
 
-      /* output EEJ current density to output directory */
-      mag_output(0, w);
+  /* invert for EEJ height-integrated current density */
+  if (params->use_vector)
+    s = mag_eej_vector_proc(&(w->track), w->EEJ, w->eej_workspace_p);
+  else
+    s = mag_eej_proc(&(w->track), w->EEJ, w->eej_workspace_p);
 
-      /* stop processing here if we only want profiles */
-      if (params->profiles_only)
-        continue;
+  if (s)
+    return s;
 
-      /* solve PDE */
-      s = pde_proc(unix_time, lon_eq * M_PI / 180.0, w->pde_workspace_p);
+  /* log information for this profile (track number, t_eq, lon_eq) */
+  mag_log_profile(0, ntrack, kp, dir, w);
 
-      /*
-       * print PDE solution J(E,u=0) and J(E=0,u) to log file - solution
-       * is printed even if pde solver fails to keep indexing
-       * consistent in log files
-       */
-      mag_log_PDE(0, w);
+  /* print F^(2) or B^(2) residuals to log file */
+  if (params->use_vector)
+    mag_log_B2(0, w);
+  else
+    mag_log_F2(0, w);
 
-      if (s)
-        {
-          log_proc(w->log_general, "mag_proc: pde_proc failed on profile %zu\n",
-                   ntrack);
-        }
+  /* output Sq SVD, L-curve and corners */
+  mag_log_Sq_Lcurve(0, w);
+  mag_log_Sq_Lcorner(0, w);
+  mag_log_Sq_svd(0, w);
+
+  /* print line current profiles to log file */
+  mag_log_LC(0, w);
+
+  /* print EEJ current density to log file */
+  mag_log_EEJ(0, w);
+
+  /* output EEJ SVD, L-curve and corners */
+  mag_log_EEJ_Lcurve(0, w);
+  mag_log_EEJ_Lcorner(0, w);
+  mag_log_EEJ_svd(0, w);
+
+  /* output EEJ current density to output directory */
+  mag_output(0, w);
+
+  /* stop processing here if we only want profiles */
+  if (params->profiles_only)
+    return 0;
+
+  /* solve PDE */
+  s = pde_proc(unix_time, lon_eq * M_PI / 180.0, w->pde_workspace_p);
+
+  /*
+   * print PDE solution J(E,u=0) and J(E=0,u) to log file - solution
+   * is printed even if pde solver fails to keep indexing
+   * consistent in log files
+   */
+  mag_log_PDE(0, w);
 
-      /* invert for EEF */
-      {
-        gsl_vector_view J_sat = gsl_vector_view_array(w->EEJ, w->ncurr);
-
-        s += inverteef_calc(&J_sat.vector,
-                            w->pde_workspace_p->theta_grid,
-                            w->pde_workspace_p->J_lat_E,
-                            w->pde_workspace_p->J_lat_u,
-                            w->inverteef_workspace_p);
-
-        /* compute final EEF value in mV/m */
-        w->EEF = w->inverteef_workspace_p->E_scale * EEF_PHI_0 * 1.0e3;
-
-        /* store relative error between modeled and satellite profiles */
-        w->RelErr = w->inverteef_workspace_p->RelErr;
-
-        log_proc(w->log_general,
-                 "mag_proc: profile %zu: [t,LT,lon,EEF,RelErr,kp,dir] = [%d,%.2f,%7.2f,%6.3f,%.2f,%.1f,%d]\n",
-                 ntrack,
-                 unix_time,
-                 lt_eq,
-                 lon_eq,
-                 w->EEF,
-                 w->RelErr,
-                 kp,
-                 dir);
-        fprintf(stderr, "mag_proc: electric field = %f mV/m\n", w->EEF);
-        fprintf(stderr, "mag_proc: relative error = %f\n", w->RelErr);
-
-        /* log modeled profile */
-        mag_log_model(0, w);
-
-        /* if no errors, log EEF value to output file; since EEF is only printed
-         * upon success, this file could be desynced from the other log files
-         * which are all synced together for each profile, regardless of failure
-         */
-        if (s == GSL_SUCCESS)
-          mag_log_EEF(0, unix_time, lon_eq * M_PI / 180.0, kp, w);
-      }
+  if (s)
+    {
+      log_proc(w->log_general, "mag_proc: pde_proc failed on profile %zu\n",
+               ntrack);
     }
 
-  log_proc(w->log_general,
-           "mag_proc: %zu/%zu tracks rejected due to insufficient latitude coverage\n",
-           nrejlat, track_p->n);
-  log_proc(w->log_general,
-           "mag_proc: %zu/%zu tracks rejected due to latitude gap\n",
-           nrejgap, track_p->n);
-  log_proc(w->log_general,
-           "mag_proc: %zu/%zu tracks rejected due to flags (LT, kp, rms)\n",
-           nrejflag, track_p->n);
+  /* invert for EEF */
+  {
+    gsl_vector_view J_sat = gsl_vector_view_array(w->EEJ, w->ncurr);
+
+    s += inverteef_calc(&J_sat.vector,
+                        w->pde_workspace_p->theta_grid,
+                        w->pde_workspace_p->J_lat_E,
+                        w->pde_workspace_p->J_lat_u,
+                        w->inverteef_workspace_p);
+
+    /* compute final EEF value in mV/m */
+    w->EEF = w->inverteef_workspace_p->E_scale * EEF_PHI_0 * 1.0e3;
+
+    /* store relative error between modeled and satellite profiles */
+    w->RelErr = w->inverteef_workspace_p->RelErr;
+
+    log_proc(w->log_general,
+             "mag_proc: profile %zu: [t,LT,lon,EEF,RelErr,kp,dir] = [%d,%.2f,%7.2f,%6.3f,%.2f,%.1f,%d]\n",
+             ntrack,
+             unix_time,
+             lt_eq,
+             lon_eq,
+             w->EEF,
+             w->RelErr,
+             kp,
+             dir);
+    fprintf(stderr, "mag_proc: electric field = %f mV/m\n", w->EEF);
+    fprintf(stderr, "mag_proc: relative error = %f\n", w->RelErr);
+
+    /* log modeled profile */
+    mag_log_model(0, w);
+
+    /* if no errors, log EEF value to output file; since EEF is only printed
+     * upon success, this file could be desynced from the other log files
+     * which are all synced together for each profile, regardless of failure
+     */
+    if (s == GSL_SUCCESS)
+      mag_log_EEF(0, unix_time, lon_eq * M_PI / 180.0, kp, w);
+  }
 
-  return status;
-} /* mag_proc() */
+  return 0;
+} /* mag_proc_track() */
 
 /*
 mag_track_datagap()
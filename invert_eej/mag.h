@@ -59,6 +59,19 @@ typedef struct
   int calc_field_models;          /* compute along-track field models? */
   int main_nmax_int;              /* spherical harmonic nmax for core field model */
   int crust_nmax_int;             /* spherical harmonic nmax for crustal field model */
+  size_t nprocs;                  /* number of worker processes for track processing */
+  size_t model_nprocs;            /* number of IRI/MSIS/HWM server processes (0 for none) */
+  char *mageq_table_file;         /* dip equator lookup table file (NULL for none) */
+  char *eej_geometry_file;        /* line current geometry cache file (NULL for none) */
+  int pde_solver;                 /* PDE sparse solver (PDE_SOLVER_xxx) */
+  char *pde_lis_options;          /* lis solver/preconditioner options (NULL for default) */
+  char *pde_system_file;          /* file to save first PDE system to (NULL for none) */
+  char *sigma_cache_file;         /* conductivity profile cache file (NULL for none) */
+  double sigma_cache_dt;          /* conductivity cache time bucket (minutes) */
+  double sigma_cache_dlon;        /* conductivity cache longitude bin (degrees) */
+  double sigma_cache_dtheta;      /* conductivity cache colatitude bin (degrees) */
+  int sigma_cache_interp;         /* interpolate cached profiles in colatitude */
+  size_t sigma_cache_nslots;      /* number of conductivity cache table slots */
 
   char *prev_day_file;            /* previous day MAGx_LR file */
   char *curr_day_file;            /* current day MAGx_LR file */
@@ -161,6 +174,9 @@ typedef struct
   gsl_matrix *mid_pos_z;
 
   double *mid_lon; /* approx. geocentric longitudes of segment midpts (deg) */
+  size_t *kidx;    /* indices of segments within longitude window, length nlon */
+
+  gsl_matrix *G;     /* Green's matrix for current track, MAG_MAX_TRACK-by-p */
 
   gsl_matrix *X;     /* least squares matrix */
   gsl_matrix *cov;   /* covariance matrix */
@@ -223,6 +239,16 @@ typedef struct
   gsl_vector *reg_param; /* vector of regularization parameters */
   size_t reg_idx;    /* index of optimal regularization parameter */
 
+  gsl_matrix *G;     /* scalar basis functions b . dB for all track points, MAG_MAX_TRACK-by-p */
+  gsl_matrix *GX;    /* X basis functions for all track points, MAG_MAX_TRACK-by-p */
+  gsl_matrix *GY;    /* Y basis functions for all track points, MAG_MAX_TRACK-by-p */
+  gsl_matrix *GZ;    /* Z basis functions for all track points, MAG_MAX_TRACK-by-p */
+
+  size_t nthreads;   /* number of OpenMP threads */
+  green_workspace **green_int_p; /* internal Green's functions, size nthreads */
+  green_workspace **green_ext_p; /* external Green's functions, size nthreads */
+  double **basis;    /* Green's function buffers, size nthreads */
+
   gsl_multifit_linear_workspace *multifit_workspace_p;
 } mag_sqfilt_scalar_workspace;
 
@@ -290,6 +316,14 @@ int mag_preproc(const mag_params *params, track_workspace *track_p,
                 satdata_mag *data, mag_workspace *w);
 int mag_proc(const mag_params *params, track_workspace *track_p,
              satdata_mag *data, mag_workspace *w);
+int mag_proc_track(const mag_params *params, const track_data *tptr,
+                   const size_t ntrack, satdata_mag *data, mag_workspace *w,
+                   int *rejected);
+
+/* mag_parallel.c */
+int mag_parallel_proc(const mag_params *params, const track_workspace *track_p,
+                      const size_t *idx, const size_t ntrack, satdata_mag *data,
+                      mag_workspace *w, size_t *nrejgap);
 
 /* mag_log.c */
 int mag_log_profile(const int header, const size_t ntrack,
@@ -324,8 +358,8 @@ int mag_sqfilt_vector(mag_workspace *mag_p, mag_sqfilt_scalar_workspace *w);
 
 /* mag_eej.c */
 mag_eej_workspace *mag_eej_alloc(const int year, const size_t ncurr,
-                                 const double altitude,
-                                 const double qdlat_max);
+                                 const double altitude, const double qdlat_max,
+                                 const char *geometry_file);
 void mag_eej_free(mag_eej_workspace *w);
 int mag_eej_proc(mag_track *track, double *J, mag_eej_workspace *w);
 int mag_eej_vector_proc(mag_track *track, double *J, mag_eej_workspace *w);
@@ -10,6 +10,8 @@
 #include <math.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
+#include <sys/time.h>
 
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_vector.h>
@@ -30,14 +32,25 @@
 
 #include <apex/apex.h>
 
+#include "fileio.h"
 #include "geod2geoc.h"
 #include "mag.h"
 #include "mageq.h"
 
+#define MAG_EEJ_GEOMETRY_MAGIC     "EEJGEOM1"
+
+static int mag_eej_geometry(const double epoch, mag_eej_workspace *w);
+static int mag_eej_geometry_read(const char *filename, const double epoch,
+                                 mag_eej_workspace *w);
+static int mag_eej_geometry_write(const char *filename, const double epoch,
+                                  const mag_eej_workspace *w);
+static int mag_eej_green(const mag_track *track, gsl_matrix *G, mag_eej_workspace *w);
 static int mag_eej_matrix_row(const double r, const double theta, const double phi,
-                              const double b[3], gsl_vector *v, const mag_eej_workspace *w);
-static int eej_add_B(const double ri[3], const double rjk[3],
-                     const double Jjk[3], double Bij[3]);
+                              const double b[3], gsl_vector *v, mag_eej_workspace *w);
+static void eej_sum_B(const double ri[3], const size_t nseg, const size_t *kidx,
+                      const double *rx, const double *ry, const double *rz,
+                      const double *Jx, const double *Jy, const double *Jz,
+                      double Bij[3]);
 static int eej_ls(const gsl_matrix *X, const gsl_vector *y,
                   gsl_vector *c, gsl_matrix *cov, mag_eej_workspace *w);
 
@@ -45,27 +58,27 @@ static int eej_ls(const gsl_matrix *X, const gsl_vector *y,
 mag_eej_alloc()
   Allocate workspace for fitting line currents to magnetic data
 
-Inputs: year      - year of data to be inverted (for computing QD transformations)
-        ncurr     - number of line currents (placed symmetrically around magnetic equator)
-        altitude  - altitude of line currents (km)
-        qdlat_max - line currents will span [-qdlat_max,qdlat_max]
+Inputs: year          - year of data to be inverted (for computing QD transformations)
+        ncurr         - number of line currents (placed symmetrically around magnetic equator)
+        altitude      - altitude of line currents (km)
+        qdlat_max     - line currents will span [-qdlat_max,qdlat_max]
+        geometry_file - file caching the line current geometry, or NULL;
+                        read if it matches the above inputs, otherwise
+                        the geometry is computed and saved to it
 
 Return: workspace
 */
 
 mag_eej_workspace *
 mag_eej_alloc(const int year, const size_t ncurr,
-              const double altitude, const double qdlat_max)
+              const double altitude, const double qdlat_max,
+              const char *geometry_file)
 {
   mag_eej_workspace *w;
   const size_t n = 5000;   /* maximum number of F^(2) data to fit */
-  const double qdlon_min = 0.0;
-  const double qdlon_max = 359.0;
   const size_t nlon = 360;
-  const double dlon = (qdlon_max - qdlon_min) / (nlon - 1.0);
   const double dlat = (2.0 * qdlat_max) / (ncurr - 1.0);
   const double epoch = (double) year;
-  size_t j, k;
 
   w = calloc(1, sizeof(mag_eej_workspace));
   if (!w)
@@ -90,6 +103,8 @@ mag_eej_alloc(const int year, const size_t ncurr,
   w->mid_pos_y = gsl_matrix_alloc(ncurr, nlon);
   w->mid_pos_z = gsl_matrix_alloc(ncurr, nlon);
   w->mid_lon = malloc(nlon * sizeof(double));
+  w->kidx = malloc(nlon * sizeof(size_t));
+  w->G = gsl_matrix_alloc(MAG_MAX_TRACK, w->p);
 
   w->X = gsl_matrix_alloc(n, w->p);
   w->cov = gsl_matrix_alloc(w->p, w->p);
@@ -131,6 +146,50 @@ mag_eej_alloc(const int year, const size_t ncurr,
   }
 #endif
 
+  if (geometry_file == NULL ||
+      mag_eej_geometry_read(geometry_file, epoch, w) != GSL_SUCCESS)
+    {
+      struct timeval tv0, tv1;
+
+      fprintf(stderr, "mag_eej_alloc: computing line current geometry...");
+      gettimeofday(&tv0, NULL);
+      mag_eej_geometry(epoch, w);
+      gettimeofday(&tv1, NULL);
+      fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+
+      if (geometry_file)
+        mag_eej_geometry_write(geometry_file, epoch, w);
+    }
+  else
+    {
+      fprintf(stderr, "mag_eej_alloc: read line current geometry from %s\n",
+              geometry_file);
+    }
+
+  return w;
+} /* mag_eej_alloc() */
+
+/*
+mag_eej_geometry()
+  Compute the positions and current vectors of all line current
+segments
+
+Inputs: epoch - decimal year for QD transformations
+        w     - workspace
+*/
+
+static int
+mag_eej_geometry(const double epoch, mag_eej_workspace *w)
+{
+  const size_t ncurr = w->p;
+  const size_t nlon = w->nlon;
+  const double qdlon_min = 0.0;
+  const double qdlon_max = 359.0;
+  const double dlon = (qdlon_max - qdlon_min) / (nlon - 1.0);
+  const double qdlat_max = w->qdlat_max;
+  const double dlat = w->dqdlat;
+  size_t j, k;
+
   /*
    * precompute Cartesian positions of each current segment for each
    * line current arc; current arcs follow lines of constant QD
@@ -227,8 +286,113 @@ mag_eej_alloc(const int year, const size_t ncurr,
         }
     }
 
-  return w;
-} /* mag_eej_alloc() */
+  return GSL_SUCCESS;
+} /* mag_eej_geometry() */
+
+/*
+mag_eej_geometry_write()
+  Save line current geometry computed by mag_eej_geometry()
+
+Return: success or error
+
+Notes:
+1) The matrices are allocated contiguously, so their data arrays are
+written directly in the layout expected by gsl_matrix_fread()
+*/
+
+static int
+mag_eej_geometry_write(const char *filename, const double epoch,
+                       const mag_eej_workspace *w)
+{
+  const size_t n = w->Jx->size1 * w->Jx->size2;
+  char tmpname[PATH_MAX];
+  size_t nwrite = 0;
+  FILE *fp;
+
+  fp = fileio_open(filename, tmpname);
+  if (!fp)
+    return GSL_FAILURE;
+
+  nwrite += fwrite(MAG_EEJ_GEOMETRY_MAGIC, 1, 8, fp);
+  nwrite += fwrite(&epoch, sizeof(double), 1, fp);
+  nwrite += fwrite(&(w->qd_alt), sizeof(double), 1, fp);
+  nwrite += fwrite(&(w->qdlat_max), sizeof(double), 1, fp);
+  nwrite += fwrite(&(w->p), sizeof(size_t), 1, fp);
+  nwrite += fwrite(&(w->nlon), sizeof(size_t), 1, fp);
+  nwrite += fwrite(w->mid_lon, sizeof(double), w->nlon, fp);
+  nwrite += fwrite(w->mid_pos_x->data, sizeof(double), n, fp);
+  nwrite += fwrite(w->mid_pos_y->data, sizeof(double), n, fp);
+  nwrite += fwrite(w->mid_pos_z->data, sizeof(double), n, fp);
+  nwrite += fwrite(w->Jx->data, sizeof(double), n, fp);
+  nwrite += fwrite(w->Jy->data, sizeof(double), n, fp);
+  nwrite += fwrite(w->Jz->data, sizeof(double), n, fp);
+
+  if (fileio_close(fp, nwrite == 13 + w->nlon + 6 * n, tmpname, filename) != 0)
+    return GSL_FAILURE;
+
+  return GSL_SUCCESS;
+} /* mag_eej_geometry_write() */
+
+/*
+mag_eej_geometry_read()
+  Read line current geometry saved by mag_eej_geometry_write()
+
+Return: success, or GSL_FAILURE if the file does not exist, or was
+computed for a different epoch, altitude or arc configuration
+*/
+
+static int
+mag_eej_geometry_read(const char *filename, const double epoch,
+                      mag_eej_workspace *w)
+{
+  FILE *fp;
+  char magic[8];
+  double file_epoch, qd_alt, qdlat_max;
+  size_t p, nlon;
+  size_t nread = 0;
+  int s = 0;
+
+  fp = fopen(filename, "r");
+  if (!fp)
+    return GSL_FAILURE;
+
+  nread += fread(magic, 1, 8, fp);
+  nread += fread(&file_epoch, sizeof(double), 1, fp);
+  nread += fread(&qd_alt, sizeof(double), 1, fp);
+  nread += fread(&qdlat_max, sizeof(double), 1, fp);
+  nread += fread(&p, sizeof(size_t), 1, fp);
+  nread += fread(&nlon, sizeof(size_t), 1, fp);
+
+  if (nread != 13 || memcmp(magic, MAG_EEJ_GEOMETRY_MAGIC, 8) != 0 ||
+      file_epoch != epoch || qd_alt != w->qd_alt ||
+      qdlat_max != w->qdlat_max || p != w->p || nlon != w->nlon)
+    {
+      fprintf(stderr, "mag_eej_geometry_read: %s does not match current configuration\n",
+              filename);
+      fclose(fp);
+      return GSL_FAILURE;
+    }
+
+  if (fread(w->mid_lon, sizeof(double), nlon, fp) != nlon)
+    s = GSL_FAILURE;
+
+  s += gsl_matrix_fread(fp, w->mid_pos_x);
+  s += gsl_matrix_fread(fp, w->mid_pos_y);
+  s += gsl_matrix_fread(fp, w->mid_pos_z);
+  s += gsl_matrix_fread(fp, w->Jx);
+  s += gsl_matrix_fread(fp, w->Jy);
+  s += gsl_matrix_fread(fp, w->Jz);
+
+  fclose(fp);
+
+  if (s)
+    {
+      fprintf(stderr, "mag_eej_geometry_read: %s is truncated\n", filename);
+      return GSL_FAILURE;
+    }
+
+  return GSL_SUCCESS;
+} /* mag_eej_geometry_read() */
 
 void
 mag_eej_free(mag_eej_workspace *w)
@@ -257,6 +421,12 @@ mag_eej_free(mag_eej_workspace *w)
   if (w->mid_lon)
     free(w->mid_lon);
 
+  if (w->kidx)
+    free(w->kidx);
+
+  if (w->G)
+    gsl_matrix_free(w->G);
+
   if (w->X)
     gsl_matrix_free(w->X);
 
@@ -325,33 +495,29 @@ mag_eej_proc(mag_track *track, double *J, mag_eej_workspace *w)
   int s = 0;
   size_t i;
   size_t ndata = 0;
-  gsl_matrix_view Xv;
+  gsl_matrix_view Xv, Gv;
   gsl_vector_view v;
 
+  /* compute Green's matrix for all track points */
+  s = mag_eej_green(track, w->G, w);
+  if (s)
+    return s;
+
   /* build LS matrix and rhs vector */
   for (i = 0; i < track->n; ++i)
     {
-      double r = track->r[i];
-      double theta = track->theta[i];
-      double phi = track->phi[i];
-      gsl_vector_view v;
-      double bi[3]; /* unit field vector in NEC */
+      gsl_vector_view gi = gsl_matrix_row(w->G, i);
+      gsl_vector_view xi = gsl_matrix_row(w->X, ndata);
 
       /* ignore data outside [-qd_max,qd_max] */
       if (fabs(track->qdlat[i]) > w->qdlat_max)
         continue;
 
-      /* compute unit magnetic field vector at this point */
-      bi[0] = track->Bx_int[i] / track->F_int[i];
-      bi[1] = track->By_int[i] / track->F_int[i];
-      bi[2] = track->Bz_int[i] / track->F_int[i];
-
       /* add F^(2) to rhs vector */
       gsl_vector_set(w->rhs, ndata, track->F2[i]);
 
-      /* construct this row of LS matrix */
-      v = gsl_matrix_row(w->X, ndata);
-      mag_eej_matrix_row(r, theta, phi, bi, &v.vector, w);
+      /* copy this row of LS matrix */
+      gsl_vector_memcpy(&xi.vector, &gi.vector);
 
       ++ndata;
     }
@@ -373,25 +539,10 @@ mag_eej_proc(mag_track *track, double *J, mag_eej_workspace *w)
   gsl_vector_memcpy(&v.vector, w->S);
   gsl_vector_scale(&v.vector, 1.0 / w->curr_dist_km);
 
-  /* compute and store F^(2) fit */
-  for (i = 0; i < track->n; ++i)
-    {
-      double r = track->r[i];
-      double theta = track->theta[i];
-      double phi = track->phi[i];
-      double bi[3]; /* unit field vector in NEC */
-
-      /* compute unit magnetic field vector at this point */
-      bi[0] = track->Bx_int[i] / track->F_int[i];
-      bi[1] = track->By_int[i] / track->F_int[i];
-      bi[2] = track->Bz_int[i] / track->F_int[i];
-
-      /* construct this row of LS matrix */
-      v = gsl_matrix_row(w->X, 0);
-      mag_eej_matrix_row(r, theta, phi, bi, &v.vector, w);
-
-      gsl_blas_ddot(&v.vector, w->S, &(track->F2_fit[i]));
-    }
+  /* compute and store F^(2) fit = G S */
+  Gv = gsl_matrix_submatrix(w->G, 0, 0, track->n, w->p);
+  v = gsl_vector_view_array(track->F2_fit, track->n);
+  gsl_blas_dgemv(CblasNoTrans, 1.0, &Gv.matrix, w->S, 0.0, &v.vector);
 
   return s;
 } /* mag_eej() */
@@ -495,47 +646,89 @@ mag_eej_vector_proc(mag_track *track, double *J, mag_eej_workspace *w)
   return s;
 }
 
+/*
+mag_eej_green()
+  Compute the line current Green's matrix for a satellite track
+
+Inputs: track - satellite track
+        G     - (output) G(i,j) = B_{ij} . b_i, the F^(2) contribution at
+                track point i of a unit current in arc j, size
+                MAG_MAX_TRACK-by-p; first track->n rows are filled
+        w     - workspace
+
+Notes:
+1) Each row is computed once and reused for both the least squares
+matrix and the F^(2) fit
+*/
+
+static int
+mag_eej_green(const mag_track *track, gsl_matrix *G, mag_eej_workspace *w)
+{
+  size_t i;
+
+  if (track->n > G->size1)
+    {
+      GSL_ERROR("track too long for Green's matrix", GSL_EBADLEN);
+    }
+
+  for (i = 0; i < track->n; ++i)
+    {
+      gsl_vector_view v = gsl_matrix_row(G, i);
+      double bi[3]; /* unit field vector in NEC */
+
+      /* compute unit magnetic field vector at this point */
+      bi[0] = track->Bx_int[i] / track->F_int[i];
+      bi[1] = track->By_int[i] / track->F_int[i];
+      bi[2] = track->Bz_int[i] / track->F_int[i];
+
+      mag_eej_matrix_row(track->r[i], track->theta[i], track->phi[i],
+                         bi, &v.vector, w);
+    }
+
+  return GSL_SUCCESS;
+} /* mag_eej_green() */
+
 static int
 mag_eej_matrix_row(const double r, const double theta, const double phi,
-                   const double b[3], gsl_vector *v, const mag_eej_workspace *w)
+                   const double b[3], gsl_vector *v, mag_eej_workspace *w)
 {
   const double max_dlon = 30.0; /* maximum longitude window in deg */
   const double lon_deg = phi * 180.0 / M_PI;
   const double lat_rad = M_PI / 2.0 - theta;
+  size_t nseg = 0;
   size_t j, k;
   double ri[3];
 
   /* compute ECEF cartesian position vector of satellite position */
   sphere2cart(phi, lat_rad, r, ri);
 
+  /*
+   * find segments within max_dlon of obs point; mid_lon is shared
+   * by all arcs so the window is found once for all j
+   */
+  for (k = 0; k < w->nlon; ++k)
+    {
+      double dlon = wrap180(w->mid_lon[k] - lon_deg);
+
+      if (fabs(dlon) <= max_dlon)
+        w->kidx[nseg++] = k;
+    }
+
   for (j = 0; j < w->p; ++j)
     {
       double Bij[3]; /* magnetic field at ri due to line j in ECEF */
       double Bij_NEC[3]; /* Bij in NEC */
       double Fij; /* B_{ij} . b_i */
 
-      Bij[0] = Bij[1] = Bij[2] = 0.0;
-
       /* compute B_{ij} = sum_k dB_{ijk} (eq 14) */
-      for (k = 0; k < w->nlon; ++k)
-        {
-          double rjk[3], Jjk[3];
-          double dlon = wrap180(w->mid_lon[k] - lon_deg);
-
-          /* check if this segment is within max_dlon of obs point */
-          if (fabs(dlon) > max_dlon)
-            continue;
-
-          rjk[0] = gsl_matrix_get(w->mid_pos_x, j, k);
-          rjk[1] = gsl_matrix_get(w->mid_pos_y, j, k);
-          rjk[2] = gsl_matrix_get(w->mid_pos_z, j, k);
-
-          Jjk[0] = gsl_matrix_get(w->Jx, j, k);
-          Jjk[1] = gsl_matrix_get(w->Jy, j, k);
-          Jjk[2] = gsl_matrix_get(w->Jz, j, k);
-
-          eej_add_B(ri, rjk, Jjk, Bij);
-        }
+      eej_sum_B(ri, nseg, w->kidx,
+                gsl_matrix_const_ptr(w->mid_pos_x, j, 0),
+                gsl_matrix_const_ptr(w->mid_pos_y, j, 0),
+                gsl_matrix_const_ptr(w->mid_pos_z, j, 0),
+                gsl_matrix_const_ptr(w->Jx, j, 0),
+                gsl_matrix_const_ptr(w->Jy, j, 0),
+                gsl_matrix_const_ptr(w->Jz, j, 0),
+                Bij);
 
       /* convert B_{ij} to NEC coordinates */
       cart2sphere_vec(phi, lat_rad, Bij[0], Bij[1], Bij[2],
@@ -552,22 +745,31 @@ mag_eej_matrix_row(const double r, const double theta, const double phi,
 } /* mag_eej_matrix_row() */
 
 /*
-eej_add_B()
-  Add contribution of a single line current segment to a running
-vector sum using Biot-Savart law. See eq 13 of paper
-
-Inputs: ri  - observer location (ECEF)
-        rjk - midpoint of longitudinal segment k of arc current j (ECEF)
-        Jjk - unit current vector of flow direction for this segment (ECEF)
-        Bij - (output) updated with ECEF X,Y,Z components of magnetic field
-              for this line segment at observer location ri (nT)
+eej_sum_B()
+  Compute the magnetic field of a set of line current segments of
+a single arc using Biot-Savart law. See eqs 13-14 of paper
+
+Inputs: ri     - observer location (ECEF)
+        nseg   - number of segments to sum
+        kidx   - indices of segments to sum, length nseg
+        rx     - ECEF X positions of segment midpoints of this arc
+        ry     - ECEF Y positions of segment midpoints
+        rz     - ECEF Z positions of segment midpoints
+        Jx     - ECEF X components of segment current vectors
+        Jy     - ECEF Y components of segment current vectors
+        Jz     - ECEF Z components of segment current vectors
+        Bij    - (output) ECEF X,Y,Z components of magnetic field
+                 at observer location ri (nT)
 
 Notes:
-1) on output, Bij = Bij + dBijk
+1) Each term needs only one sqrt and no pow(); the constant factor is
+applied once after the sum
 */
 
-static int
-eej_add_B(const double ri[3], const double rjk[3], const double Jjk[3],
+static void
+eej_sum_B(const double ri[3], const size_t nseg, const size_t *kidx,
+          const double *rx, const double *ry, const double *rz,
+          const double *Jx, const double *Jy, const double *Jz,
           double Bij[3])
 {
   /*
@@ -576,18 +778,27 @@ eej_add_B(const double ri[3], const double rjk[3], const double Jjk[3],
    */
   const double mu0 = (4.0 * M_PI) * 1.0e-7;
   const double C = 1.0e9 * mu0 / (4.0 * M_PI);
+  double Bx = 0.0, By = 0.0, Bz = 0.0;
+  size_t n;
 
-  double dx = ri[0] - rjk[0];
-  double dy = ri[1] - rjk[1];
-  double dz = ri[2] - rjk[2];
-  double invr3 = pow(dx*dx + dy*dy + dz*dz, -1.5);
-
-  Bij[0] += C * (Jjk[1]*dz - Jjk[2]*dy) * invr3;
-  Bij[1] += C * (Jjk[2]*dx - Jjk[0]*dz) * invr3;
-  Bij[2] += C * (Jjk[0]*dy - Jjk[1]*dx) * invr3;
+  for (n = 0; n < nseg; ++n)
+    {
+      size_t k = kidx[n];
+      double dx = ri[0] - rx[k];
+      double dy = ri[1] - ry[k];
+      double dz = ri[2] - rz[k];
+      double d2 = dx*dx + dy*dy + dz*dz;
+      double invr3 = 1.0 / (d2 * sqrt(d2));
+
+      Bx += (Jy[k]*dz - Jz[k]*dy) * invr3;
+      By += (Jz[k]*dx - Jx[k]*dz) * invr3;
+      Bz += (Jx[k]*dy - Jy[k]*dx) * invr3;
+    }
 
-  return GSL_SUCCESS;
-} /* eej_add_B() */
+  Bij[0] = C * Bx;
+  Bij[1] = C * By;
+  Bij[2] = C * Bz;
+} /* eej_sum_B() */
 
 /*
 eej_ls()
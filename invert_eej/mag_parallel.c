@@ -0,0 +1,396 @@
+/*
+ * mag_parallel.c
+ *
+ * Process satellite tracks in parallel using a pool of worker
+ * processes. The IRI, MSIS and HWM Fortran models called by the
+ * conductivity module keep global state and are not thread-safe, so
+ * each worker is a separate process created with fork(), inheriting
+ * its own copy of the pde, sigma and all other workspaces.
+ *
+ * Workers take the next unprocessed track from a shared counter and
+ * write all log and output entries to private temporary files, while
+ * recording the file offsets of each track's entries in shared memory.
+ * After all workers finish, the parent copies each track's entries
+ * into the real log and output files in track order, so the results
+ * are identical to a serial run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+
+#include <gsl/gsl_math.h>
+
+#include <satdata/satdata.h>
+
+#include <common/common.h>
+
+#include "log.h"
+#include "mag.h"
+#include "track.h"
+
+/* number of log/output files written during track processing */
+#define MAG_PARALLEL_NFILES        17
+
+/* track status in shared memory */
+#define MAG_PARALLEL_TODO          0
+#define MAG_PARALLEL_DONE          1
+#define MAG_PARALLEL_ERROR         2
+
+typedef struct
+{
+  int flag;                         /* MAG_PARALLEL_xxx */
+  int status;                       /* return value of mag_proc_track() */
+  int rejected;                     /* track rejected by Sq filter */
+  size_t worker;                    /* worker which processed this track */
+  long start[MAG_PARALLEL_NFILES];  /* offset of track entries in worker files */
+  long end[MAG_PARALLEL_NFILES];
+} mag_parallel_track;
+
+typedef struct
+{
+  size_t next;                      /* next track to process */
+  int stop;                         /* set when a worker encounters an error */
+  mag_parallel_track track[1];      /* ntrack entries */
+} mag_parallel_shared;
+
+static void mag_parallel_files(mag_workspace *w, FILE **fp[]);
+static int mag_parallel_worker(const size_t worker, const mag_params *params,
+                               const track_workspace *track_p, const size_t *idx,
+                               const size_t ntrack, satdata_mag *data,
+                               mag_parallel_shared *shared, mag_workspace *w);
+static int mag_parallel_copy(const char *filename, const long start,
+                             const long end, FILE *fp);
+static void mag_parallel_tmpname(const mag_params *params, const size_t worker,
+                                 const size_t k, char *buf);
+
+/*
+mag_parallel_proc()
+  Process a set of tracks using params->nprocs worker processes
+
+Inputs: params - parameters
+        track_p - track workspace
+        idx     - indices into track_p->tracks of tracks to process,
+                  length ntrack
+        ntrack  - number of tracks to process
+        data    - satellite data
+        w       - workspace
+        nrejgap - (output) number of tracks rejected by the Sq filter
+                  due to data gaps
+
+Return: success, or the error status of the first failed track
+
+Notes:
+1) Track numbers in the log files are 1 + the position in idx[],
+as in the serial loop of mag_proc()
+
+2) As in the serial case, processing stops at the first track which
+returns an error; entries of all earlier tracks are written to the
+log files
+*/
+
+int
+mag_parallel_proc(const mag_params *params, const track_workspace *track_p,
+                  const size_t *idx, const size_t ntrack, satdata_mag *data,
+                  mag_workspace *w, size_t *nrejgap)
+{
+  int status = 0;
+  const size_t nprocs = GSL_MIN(params->nprocs, ntrack);
+  const size_t shared_size = sizeof(mag_parallel_shared) +
+                             ntrack * sizeof(mag_parallel_track);
+  mag_parallel_shared *shared;
+  pid_t *pid;
+  FILE **fp[MAG_PARALLEL_NFILES];
+  char buf[LOG_MAX_BUFFER];
+  struct timeval tv0, tv1;
+  size_t i, k;
+
+  *nrejgap = 0;
+
+  shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED)
+    {
+      fprintf(stderr, "mag_parallel_proc: mmap failed: %s\n", strerror(errno));
+      return -1;
+    }
+
+  memset(shared, 0, shared_size);
+
+  pid = malloc(nprocs * sizeof(pid_t));
+
+  mag_parallel_files(w, fp);
+
+  /* flush stdio buffers so they are not duplicated in the workers */
+  fflush(NULL);
+
+  fprintf(stderr, "mag_parallel_proc: processing %zu tracks with %zu processes...\n",
+          ntrack, nprocs);
+  gettimeofday(&tv0, NULL);
+
+  for (i = 0; i < nprocs; ++i)
+    {
+      pid[i] = fork();
+      if (pid[i] == 0)
+        {
+          int s = mag_parallel_worker(i, params, track_p, idx, ntrack, data, shared, w);
+
+          /* skip atexit handlers and stdio cleanup of the parent's files */
+          _exit(s ? 1 : 0);
+        }
+      else if (pid[i] < 0)
+        {
+          fprintf(stderr, "mag_parallel_proc: fork failed: %s\n", strerror(errno));
+          shared->stop = 1;
+          status = -1;
+          break;
+        }
+    }
+
+  /* wait for all workers which were started */
+  for (k = 0; k < i; ++k)
+    {
+      int wstatus;
+
+      waitpid(pid[k], &wstatus, 0);
+
+      if (!WIFEXITED(wstatus))
+        {
+          fprintf(stderr, "mag_parallel_proc: worker %zu terminated abnormally\n", k);
+          status = -1;
+        }
+    }
+
+  gettimeofday(&tv1, NULL);
+  fprintf(stderr, "mag_parallel_proc: workers finished (%g seconds)\n",
+          time_diff(tv0, tv1));
+
+  /* merge worker output in track order */
+  for (k = 0; k < ntrack && status == 0; ++k)
+    {
+      mag_parallel_track *tptr = &(shared->track[k]);
+      size_t j;
+
+      if (tptr->flag == MAG_PARALLEL_ERROR)
+        {
+          status = tptr->status;
+          break;
+        }
+      else if (tptr->flag != MAG_PARALLEL_DONE)
+        {
+          fprintf(stderr, "mag_parallel_proc: track %zu was not processed\n", k + 1);
+          status = -1;
+          break;
+        }
+
+      for (j = 0; j < MAG_PARALLEL_NFILES; ++j)
+        {
+          if (fp[j] == NULL || tptr->end[j] == tptr->start[j])
+            continue;
+
+          mag_parallel_tmpname(params, tptr->worker, j, buf);
+          status = mag_parallel_copy(buf, tptr->start[j], tptr->end[j], *fp[j]);
+          if (status)
+            break;
+        }
+
+      *nrejgap += (size_t) tptr->rejected;
+    }
+
+  /* remove temporary files */
+  for (k = 0; k < i; ++k)
+    {
+      size_t j;
+
+      for (j = 0; j < MAG_PARALLEL_NFILES; ++j)
+        {
+          mag_parallel_tmpname(params, k, j, buf);
+          unlink(buf);
+        }
+    }
+
+  free(pid);
+  munmap(shared, shared_size);
+
+  return status;
+} /* mag_parallel_proc() */
+
+/*
+mag_parallel_files()
+  Store pointers to all FILE handles written during track processing;
+entries are NULL for files which are not open
+*/
+
+static void
+mag_parallel_files(mag_workspace *w, FILE **fp[])
+{
+  log_workspace *logs[MAG_PARALLEL_NFILES - 1];
+  size_t i;
+
+  logs[0] = w->log_general;
+  logs[1] = w->log_profile;
+  logs[2] = w->log_F2;
+  logs[3] = w->log_B2;
+  logs[4] = w->log_B2_grad;
+  logs[5] = w->log_Sq_Lcurve;
+  logs[6] = w->log_Sq_Lcorner;
+  logs[7] = w->log_Sq_svd;
+  logs[8] = w->log_LC;
+  logs[9] = w->log_EEJ;
+  logs[10] = w->log_EEJ_Lcurve;
+  logs[11] = w->log_EEJ_Lcorner;
+  logs[12] = w->log_EEJ_svd;
+  logs[13] = w->log_PDE;
+  logs[14] = w->log_model;
+  logs[15] = w->log_EEF;
+
+  for (i = 0; i < MAG_PARALLEL_NFILES - 1; ++i)
+    {
+      if (logs[i] && logs[i]->fp)
+        fp[i] = &(logs[i]->fp);
+      else
+        fp[i] = NULL;
+    }
+
+  fp[MAG_PARALLEL_NFILES - 1] = w->fp_output ? &(w->fp_output) : NULL;
+} /* mag_parallel_files() */
+
+/*
+mag_parallel_worker()
+  Main loop of a worker process: redirect all log files to temporary
+files, then process tracks until none are left
+*/
+
+static int
+mag_parallel_worker(const size_t worker, const mag_params *params,
+                    const track_workspace *track_p, const size_t *idx,
+                    const size_t ntrack, satdata_mag *data,
+                    mag_parallel_shared *shared, mag_workspace *w)
+{
+  int s = 0;
+  FILE **fp[MAG_PARALLEL_NFILES];
+  char buf[LOG_MAX_BUFFER];
+  size_t j;
+
+  mag_parallel_files(w, fp);
+
+  for (j = 0; j < MAG_PARALLEL_NFILES; ++j)
+    {
+      if (fp[j] == NULL)
+        continue;
+
+      mag_parallel_tmpname(params, worker, j, buf);
+
+      /* the parent's FILE is left open so its buffer is not flushed twice */
+      *fp[j] = fopen(buf, "w");
+      if (!*fp[j])
+        {
+          fprintf(stderr, "mag_parallel_worker: unable to open %s: %s\n",
+                  buf, strerror(errno));
+          shared->stop = 1;
+          return -1;
+        }
+    }
+
+  while (!shared->stop)
+    {
+      size_t k = __sync_fetch_and_add(&(shared->next), 1);
+      mag_parallel_track *tptr;
+
+      if (k >= ntrack)
+        break;
+
+      tptr = &(shared->track[k]);
+      tptr->worker = worker;
+
+      for (j = 0; j < MAG_PARALLEL_NFILES; ++j)
+        tptr->start[j] = fp[j] ? ftell(*fp[j]) : 0;
+
+      s = mag_proc_track(params, &(track_p->tracks[idx[k]]), k + 1,
+                         data, w, &(tptr->rejected));
+
+      for (j = 0; j < MAG_PARALLEL_NFILES; ++j)
+        {
+          if (fp[j])
+            {
+              fflush(*fp[j]);
+              tptr->end[j] = ftell(*fp[j]);
+            }
+          else
+            tptr->end[j] = 0;
+        }
+
+      tptr->status = s;
+
+      if (s)
+        {
+          tptr->flag = MAG_PARALLEL_ERROR;
+          shared->stop = 1;
+          break;
+        }
+
+      tptr->flag = MAG_PARALLEL_DONE;
+    }
+
+  for (j = 0; j < MAG_PARALLEL_NFILES; ++j)
+    {
+      if (fp[j])
+        fclose(*fp[j]);
+    }
+
+  return s;
+} /* mag_parallel_worker() */
+
+/*
+mag_parallel_copy()
+  Append bytes [start,end) of a file to fp
+*/
+
+static int
+mag_parallel_copy(const char *filename, const long start,
+                  const long end, FILE *fp)
+{
+  FILE *fp_in;
+  char buf[BUFSIZ];
+  long n = end - start;
+
+  fp_in = fopen(filename, "r");
+  if (!fp_in)
+    {
+      fprintf(stderr, "mag_parallel_copy: unable to open %s: %s\n",
+              filename, strerror(errno));
+      return -1;
+    }
+
+  fseek(fp_in, start, SEEK_SET);
+
+  while (n > 0)
+    {
+      size_t nread = fread(buf, 1, (size_t) GSL_MIN(n, (long) BUFSIZ), fp_in);
+
+      if (nread == 0)
+        break;
+
+      fwrite(buf, 1, nread, fp);
+      n -= (long) nread;
+    }
+
+  fclose(fp_in);
+  fflush(fp);
+
+  return (n == 0) ? 0 : -1;
+} /* mag_parallel_copy() */
+
+static void
+mag_parallel_tmpname(const mag_params *params, const size_t worker,
+                     const size_t k, char *buf)
+{
+  snprintf(buf, LOG_MAX_BUFFER, "%s/.worker%zu.%zu.tmp",
+           params->log_dir, worker, k);
+} /* mag_parallel_tmpname() */
@@ -3,12 +3,20 @@
  *
  * Fit spherical harmonic model to satellite scalar or vector residuals
  * to remove Sq and external fields
+ *
+ * The model basis functions are computed once for every point of a
+ * track, in parallel with OpenMP, and stored in w->G (scalar) and
+ * w->G{X,Y,Z} (vector components). The least squares matrix is a row
+ * subset of w->G, and the Sq model along the whole track is obtained
+ * from matrix-vector products, so the Green's functions are not
+ * evaluated a second time after the fit.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <assert.h>
+#include <omp.h>
 
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_vector.h>
@@ -26,15 +34,14 @@
 #include "Gdef.h"
 
 static int sqfilt_linear_init(mag_workspace *mag_p, mag_sqfilt_scalar_workspace *w);
-static int sqfilt_linear_matrix_row(const double r, const double thetaq,
-                                    const double phi,
-                                    const double b_int[3],
-                                    gsl_vector *v, mag_workspace *w);
+static int sqfilt_basis(const mag_track *track, mag_sqfilt_scalar_workspace *w);
+static int sqfilt_basis_row(const double r, const double thetaq, const double phi,
+                            const double b_int[3], const double fday,
+                            const size_t row, const int thread_id,
+                            mag_sqfilt_scalar_workspace *w);
 static int sqfilt_calc_F2(const gsl_vector *c, mag_workspace *w);
-static int sqfilt_model_int(const gsl_vector *c, double *X, double *Y, double *Z,
-                            mag_workspace *w);
-static int sqfilt_model_ext(const gsl_vector *c, double *X, double *Y, double *Z,
-                            mag_workspace *w);
+static void sqfilt_eval(const gsl_matrix *G, const size_t offset, const size_t p,
+                        const gsl_vector *c, const size_t n, double *out);
 static size_t sqfilt_nmidx(const size_t type, const size_t n, const int m,
                            const mag_sqfilt_scalar_workspace *w);
 
@@ -106,6 +113,30 @@ mag_sqfilt_scalar_alloc(const size_t nmax_int, const size_t mmax_int,
 
   w->multifit_workspace_p = gsl_multifit_linear_alloc(ndata, w->p);
 
+  /* basis functions for all points of a track */
+  w->G = gsl_matrix_alloc(MAG_MAX_TRACK, w->p);
+  w->GX = gsl_matrix_alloc(MAG_MAX_TRACK, w->p);
+  w->GY = gsl_matrix_alloc(MAG_MAX_TRACK, w->p);
+  w->GZ = gsl_matrix_alloc(MAG_MAX_TRACK, w->p);
+
+  /* per-thread Green's function workspaces */
+  w->nthreads = (size_t) omp_get_max_threads();
+  w->green_int_p = calloc(w->nthreads, sizeof(green_workspace *));
+  w->green_ext_p = calloc(w->nthreads, sizeof(green_workspace *));
+  w->basis = calloc(w->nthreads, sizeof(double *));
+
+  for (l = 0; l < w->nthreads; ++l)
+    {
+      size_t nnm;
+
+      w->green_int_p[l] = green_alloc(nmax_int, mmax_int, R_EARTH_KM);
+      w->green_ext_p[l] = green_alloc(nmax_ext, mmax_ext, R_EARTH_KM);
+
+      /* dX, dY, dZ, dX_ext, dY_ext, dZ_ext */
+      nnm = w->green_int_p[l]->nnm + w->green_ext_p[l]->nnm;
+      w->basis[l] = malloc(3 * nnm * sizeof(double));
+    }
+
   {
     const double beta = -0.1;
 
@@ -142,6 +173,8 @@ mag_sqfilt_scalar_alloc(const size_t nmax_int, const size_t mmax_int,
 void
 mag_sqfilt_scalar_free(mag_sqfilt_scalar_workspace *w)
 {
+  size_t l;
+
   if (w->base_int)
     free(w->base_int);
 
@@ -175,6 +208,39 @@ mag_sqfilt_scalar_free(mag_sqfilt_scalar_workspace *w)
   if (w->L)
     gsl_vector_free(w->L);
 
+  if (w->G)
+    gsl_matrix_free(w->G);
+
+  if (w->GX)
+    gsl_matrix_free(w->GX);
+
+  if (w->GY)
+    gsl_matrix_free(w->GY);
+
+  if (w->GZ)
+    gsl_matrix_free(w->GZ);
+
+  for (l = 0; l < w->nthreads; ++l)
+    {
+      if (w->green_int_p && w->green_int_p[l])
+        green_free(w->green_int_p[l]);
+
+      if (w->green_ext_p && w->green_ext_p[l])
+        green_free(w->green_ext_p[l]);
+
+      if (w->basis && w->basis[l])
+        free(w->basis[l]);
+    }
+
+  if (w->green_int_p)
+    free(w->green_int_p);
+
+  if (w->green_ext_p)
+    free(w->green_ext_p);
+
+  if (w->basis)
+    free(w->basis);
+
   free(w);
 }
 
@@ -319,15 +385,16 @@ sqfilt_linear_init(mag_workspace *mag_p, mag_sqfilt_scalar_workspace *w)
       return -1;
     }
 
+  /* compute basis functions for all track points */
+  s = sqfilt_basis(track, w);
+  if (s)
+    return s;
+
   /* build least squares matrix and RHS */
   for (i = 0; i < ntot; ++i)
     {
-      double r = track->r[i];
-      double thetaq = track->thetaq[i]; /* use QD colatitude */
-      double phi = track->phi[i];
       double rhsval = track->F1[i];
-      double b_int[3];
-      gsl_vector_view v;
+      gsl_vector_view gi, xi;
 
       /* exclude points in the equatorial electrojet region */
       if (fabs(track->qdlat[i]) < exclude_lat)
@@ -343,14 +410,10 @@ sqfilt_linear_init(mag_workspace *mag_p, mag_sqfilt_scalar_workspace *w)
             continue;
         }
 
-      /* compute unit vector in internal field direction */
-      b_int[0] = track->Bx_int[i] / track->F_int[i];
-      b_int[1] = track->By_int[i] / track->F_int[i];
-      b_int[2] = track->Bz_int[i] / track->F_int[i];
-
-      /* add green basis functions to current row of matrix */
-      v = gsl_matrix_row(w->X, ndata);
-      sqfilt_linear_matrix_row(r, thetaq, phi, b_int, &v.vector, mag_p);
+      /* copy green basis functions to current row of matrix */
+      gi = gsl_matrix_row(w->G, i);
+      xi = gsl_matrix_row(w->X, ndata);
+      gsl_vector_memcpy(&xi.vector, &gi.vector);
 
       /* set RHS value */
       gsl_vector_set(w->rhs, ndata, rhsval);
@@ -364,96 +427,158 @@ sqfilt_linear_init(mag_workspace *mag_p, mag_sqfilt_scalar_workspace *w)
 } /* sqfilt_linear_init() */
 
 /*
-sqfilt_linear_matrix_row()
-  Add a row to the least squares matrix
+sqfilt_basis()
+  Compute Sq model basis functions for all points of a track
 
-Inputs: r      - radius (km)
-        thetaq - QD colatitude (radians)
-        phi    - geographic longitude (radians)
-        b_int  - unit vector for internal field
-        v      - row of LS matrix
-        w      - workspace
+Inputs: track - satellite track
+        w     - sqfilt workspace
 
 Notes:
-1) On output, w->green_workspace contains the internal and
-external Green's functions
+1) On output, the first track->n rows of w->G contain the scalar
+basis functions b_int . dB, and rows of w->G{X,Y,Z} contain the
+X, Y, Z components of dB
+
+2) Rows are independent and are computed in parallel; each thread
+uses its own Green's function workspace
+
+Return: success, or GSL_EBADLEN if the track has more points than
+rows of w->G
+*/
+
+static int
+sqfilt_basis(const mag_track *track, mag_sqfilt_scalar_workspace *w)
+{
+  const time_t unix_time = satdata_epoch2timet(track->t_eq);
+  const double fday = time2fday(unix_time);
+  size_t i;
+
+  if (track->n > w->G->size1)
+    {
+      /* the caller rejects the track; GSL_ERROR would abort the process */
+      fprintf(stderr, "sqfilt_basis: track too long for basis matrix (%zu > %zu points)\n",
+              track->n, w->G->size1);
+      return GSL_EBADLEN;
+    }
+
+#pragma omp parallel for private(i)
+  for (i = 0; i < track->n; ++i)
+    {
+      int thread_id = omp_get_thread_num();
+      double b_int[3];
+
+      /* compute unit vector in internal field direction */
+      b_int[0] = track->Bx_int[i] / track->F_int[i];
+      b_int[1] = track->By_int[i] / track->F_int[i];
+      b_int[2] = track->Bz_int[i] / track->F_int[i];
+
+      /* use QD colatitude */
+      sqfilt_basis_row(track->r[i], track->thetaq[i], track->phi[i],
+                       b_int, fday, i, thread_id, w);
+    }
+
+  return GSL_SUCCESS;
+} /* sqfilt_basis() */
+
+/*
+sqfilt_basis_row()
+  Compute basis functions for a single track point
+
+Inputs: r         - radius (km)
+        thetaq    - QD colatitude (radians)
+        phi       - geographic longitude (radians)
+        b_int     - unit vector for internal field
+        fday      - fractional day for GEO/SM transformation
+        row       - row of w->G{,X,Y,Z} to fill
+        thread_id - thread number
+        w         - workspace
 */
 
 static int
-sqfilt_linear_matrix_row(const double r, const double thetaq,
-                         const double phi, const double b_int[3],
-                         gsl_vector *v, mag_workspace *w)
+sqfilt_basis_row(const double r, const double thetaq, const double phi,
+                 const double b_int[3], const double fday,
+                 const size_t row, const int thread_id,
+                 mag_sqfilt_scalar_workspace *w)
 {
   int s = 0;
-  const double R = 6371.2;
-  mag_sqfilt_scalar_workspace *sqfilt_p = w->sqfilt_scalar_workspace_p;
+  green_workspace *green_int_p = w->green_int_p[thread_id];
+  green_workspace *green_ext_p = w->green_ext_p[thread_id];
+  double *dX = w->basis[thread_id];
+  double *dY = dX + green_int_p->nnm;
+  double *dZ = dY + green_int_p->nnm;
+  double *dX_ext = dZ + green_int_p->nnm;
+  double *dY_ext = dX_ext + green_ext_p->nnm;
+  double *dZ_ext = dY_ext + green_ext_p->nnm;
   double phi_sm, theta_sm, lat_sm;
   double lat = M_PI / 2.0 - thetaq;
-  time_t unix_time = satdata_epoch2timet(w->track.t_eq);
-  double fday = time2fday(unix_time);
   size_t i, n;
 
   /* compute basis functions for M(r,thetaq,phi) */
-  green_calc_int(r, thetaq, phi, w->dX, w->dY, w->dZ, w->green_int_p);
+  green_calc_int(r, thetaq, phi, dX, dY, dZ, green_int_p);
 
   /* compute basis functions for K(r,thetaq_SM,phi_SM) */
   trans(GEO2SM, fday, phi, lat, &phi_sm, &lat_sm);
   theta_sm = M_PI / 2.0 - lat_sm;
 
-  green_calc_ext(r, theta_sm, phi_sm, w->dX_ext, w->dY_ext, w->dZ_ext, w->green_ext_p);
+  green_calc_ext(r, theta_sm, phi_sm, dX_ext, dY_ext, dZ_ext, green_ext_p);
 
-  for (i = 0; i < w->green_ext_p->nnm; ++i)
+  for (i = 0; i < green_ext_p->nnm; ++i)
     {
       double phi_ss, lat_ss;
       double X, Y, Z;
 
-      trans_vec(SM2GEO, fday, phi_sm, lat_sm, w->dX_ext[i],
-                w->dY_ext[i], w->dZ_ext[i], &phi_ss,
+      trans_vec(SM2GEO, fday, phi_sm, lat_sm, dX_ext[i],
+                dY_ext[i], dZ_ext[i], &phi_ss,
                 &lat_ss, &X, &Y, &Z);
 
-      w->dX_ext[i] = X;
-      w->dY_ext[i] = Y;
-      w->dZ_ext[i] = Z;
+      dX_ext[i] = X;
+      dY_ext[i] = Y;
+      dZ_ext[i] = Z;
     }
 
   /* internal coefficients */
-  for (n = 1; n <= sqfilt_p->nmax_int; ++n)
+  for (n = 1; n <= w->nmax_int; ++n)
     {
-      int M = (int) GSL_MIN(n, sqfilt_p->mmax_int);
+      int M = (int) GSL_MIN(n, w->mmax_int);
       int m;
 
       for (m = -M; m <= M; ++m)
         {
-          size_t idx = sqfilt_nmidx(0, n, m, sqfilt_p);
-          size_t gidx = green_nmidx(n, m, w->green_int_p);
-          double val = b_int[0] * w->dX[gidx] +
-                       b_int[1] * w->dY[gidx] +
-                       b_int[2] * w->dZ[gidx];
-
-          gsl_vector_set(v, idx, val);
+          size_t idx = sqfilt_nmidx(0, n, m, w);
+          size_t gidx = green_nmidx(n, m, green_int_p);
+          double val = b_int[0] * dX[gidx] +
+                       b_int[1] * dY[gidx] +
+                       b_int[2] * dZ[gidx];
+
+          gsl_matrix_set(w->G, row, idx, val);
+          gsl_matrix_set(w->GX, row, idx, dX[gidx]);
+          gsl_matrix_set(w->GY, row, idx, dY[gidx]);
+          gsl_matrix_set(w->GZ, row, idx, dZ[gidx]);
         }
     }
 
   /* external coefficients */
-  for (n = 1; n <= sqfilt_p->nmax_ext; ++n)
+  for (n = 1; n <= w->nmax_ext; ++n)
     {
-      int M = (int) GSL_MIN(n, sqfilt_p->mmax_ext);
+      int M = (int) GSL_MIN(n, w->mmax_ext);
       int m;
 
       for (m = -M; m <= M; ++m)
         {
-          size_t idx = sqfilt_nmidx(1, n, m, sqfilt_p);
-          size_t gidx = green_nmidx(n, m, w->green_ext_p);
-          double val = b_int[0] * w->dX_ext[gidx] +
-                       b_int[1] * w->dY_ext[gidx] +
-                       b_int[2] * w->dZ_ext[gidx];
-
-          gsl_vector_set(v, idx, val);
+          size_t idx = sqfilt_nmidx(1, n, m, w);
+          size_t gidx = green_nmidx(n, m, green_ext_p);
+          double val = b_int[0] * dX_ext[gidx] +
+                       b_int[1] * dY_ext[gidx] +
+                       b_int[2] * dZ_ext[gidx];
+
+          gsl_matrix_set(w->G, row, idx, val);
+          gsl_matrix_set(w->GX, row, idx, dX_ext[gidx]);
+          gsl_matrix_set(w->GY, row, idx, dY_ext[gidx]);
+          gsl_matrix_set(w->GZ, row, idx, dZ_ext[gidx]);
         }
     }
 
   return s;
-} /* sqfilt_linear_matrix_row() */
+} /* sqfilt_basis_row() */
 
 /*
 sqfilt_calc_F2()
@@ -465,80 +590,34 @@ Inputs: c - model coefficients
 
 Notes:
 1) On output, w->track.F2 is modified to contain F^(2) residuals
+
+2) Basis functions must have been computed by sqfilt_basis()
 */
 
 static int
 sqfilt_calc_F2(const gsl_vector *c, mag_workspace *w)
 {
   mag_sqfilt_scalar_workspace *sqfilt_p = w->sqfilt_scalar_workspace_p;
-  size_t i;
   mag_track *track = &(w->track);
-  gsl_vector *v = sqfilt_p->work_p;
-
-  for (i = 0; i < track->n; ++i)
-    {
-      double r = track->r[i];
-      double thetaq = track->thetaq[i]; /* use QD colatitude */
-      double phi = track->phi[i];
-      double b_int[3];
-      double val; /* Sq model value b . (M + K) */
-
-      /* compute unit vector in internal field direction */
-      b_int[0] = track->Bx_int[i] / track->F_int[i];
-      b_int[1] = track->By_int[i] / track->F_int[i];
-      b_int[2] = track->Bz_int[i] / track->F_int[i];
+  const size_t n = track->n;
+  const size_t int_offset = sqfilt_p->int_offset;
+  const size_t ext_offset = sqfilt_p->ext_offset;
+  size_t i;
 
-      /* compute basis functions */
-      sqfilt_linear_matrix_row(r, thetaq, phi, b_int, v, w);
+  /* internal scalar model b . M and vector model M */
+  sqfilt_eval(sqfilt_p->G, int_offset, sqfilt_p->p_int, c, n, track->Sq_int);
+  sqfilt_eval(sqfilt_p->GX, int_offset, sqfilt_p->p_int, c, n, track->X_Sq_int);
+  sqfilt_eval(sqfilt_p->GY, int_offset, sqfilt_p->p_int, c, n, track->Y_Sq_int);
+  sqfilt_eval(sqfilt_p->GZ, int_offset, sqfilt_p->p_int, c, n, track->Z_Sq_int);
 
-      if (sqfilt_p->p_int > 0)
-        {
-          gsl_vector_const_view c_int = gsl_vector_const_subvector(c, sqfilt_p->int_offset, sqfilt_p->p_int);
-          gsl_vector_const_view v_int = gsl_vector_const_subvector(v, sqfilt_p->int_offset, sqfilt_p->p_int);
-          double X, Y, Z;
-
-          /* compute internal scalar model = b . M */
-          gsl_blas_ddot(&v_int.vector, &c_int.vector, &val);
-          track->Sq_int[i] = val;
-
-          /* compute internal vector model M */
-          sqfilt_model_int(c, &X, &Y, &Z, w);
-          track->X_Sq_int[i] = X;
-          track->Y_Sq_int[i] = Y;
-          track->Z_Sq_int[i] = Z;
-        }
-      else
-        {
-          track->Sq_int[i] = 0.0;
-          track->X_Sq_int[i] = 0.0;
-          track->Y_Sq_int[i] = 0.0;
-          track->Z_Sq_int[i] = 0.0;
-        }
-
-      if (sqfilt_p->p_ext > 0)
-        {
-          gsl_vector_const_view c_ext = gsl_vector_const_subvector(c, sqfilt_p->ext_offset, sqfilt_p->p_ext);
-          gsl_vector_const_view v_ext = gsl_vector_const_subvector(v, sqfilt_p->ext_offset, sqfilt_p->p_ext);
-          double X, Y, Z;
-
-          /* compute external scalar model = b . K */
-          gsl_blas_ddot(&v_ext.vector, &c_ext.vector, &val);
-          track->Sq_ext[i] = val;
-
-          /* compute external vector model K */
-          sqfilt_model_ext(c, &X, &Y, &Z, w);
-          track->X_Sq_ext[i] = X;
-          track->Y_Sq_ext[i] = Y;
-          track->Z_Sq_ext[i] = Z;
-        }
-      else
-        {
-          track->Sq_ext[i] = 0.0;
-          track->X_Sq_ext[i] = 0.0;
-          track->Y_Sq_ext[i] = 0.0;
-          track->Z_Sq_ext[i] = 0.0;
-        }
+  /* external scalar model b . K and vector model K */
+  sqfilt_eval(sqfilt_p->G, ext_offset, sqfilt_p->p_ext, c, n, track->Sq_ext);
+  sqfilt_eval(sqfilt_p->GX, ext_offset, sqfilt_p->p_ext, c, n, track->X_Sq_ext);
+  sqfilt_eval(sqfilt_p->GY, ext_offset, sqfilt_p->p_ext, c, n, track->Y_Sq_ext);
+  sqfilt_eval(sqfilt_p->GZ, ext_offset, sqfilt_p->p_ext, c, n, track->Z_Sq_ext);
 
+  for (i = 0; i < n; ++i)
+    {
       track->F2[i] = track->F1[i] - (track->Sq_int[i] + track->Sq_ext[i]);
       track->X2[i] = track->X1[i] - (track->X_Sq_int[i] + track->X_Sq_ext[i]);
       track->Y2[i] = track->Y1[i] - (track->Y_Sq_int[i] + track->Y_Sq_ext[i]);
@@ -548,67 +627,28 @@ sqfilt_calc_F2(const gsl_vector *c, mag_workspace *w)
   return GSL_SUCCESS;
 } /* sqfilt_calc_F2() */
 
-static int
-sqfilt_model_int(const gsl_vector *c, double *X, double *Y, double *Z,
-                 mag_workspace *w)
-{
-  mag_sqfilt_scalar_workspace *sqfilt_p = w->sqfilt_scalar_workspace_p;
-  size_t n;
-
-  *X = 0.0;
-  *Y = 0.0;
-  *Z = 0.0;
-
-  for (n = 1; n <= sqfilt_p->nmax_int; ++n)
-    {
-      int M = (int) GSL_MIN(n, sqfilt_p->mmax_int);
-      int m;
-
-      for (m = -M; m <= M; ++m)
-        {
-          size_t idx = sqfilt_nmidx(0, n, m, sqfilt_p);
-          size_t gidx = green_nmidx(n, m, w->green_int_p);
-          double cnm = gsl_vector_get(c, idx);
-
-          *X += cnm * w->dX[gidx];
-          *Y += cnm * w->dY[gidx];
-          *Z += cnm * w->dZ[gidx];
-        }
-    }
-
-  return GSL_SUCCESS;
-}
+/*
+sqfilt_eval()
+  Evaluate out = G(:,offset:offset+p-1) c(offset:offset+p-1) for
+the first n rows of a basis matrix; out is set to 0 if p = 0
+*/
 
-static int
-sqfilt_model_ext(const gsl_vector *c, double *X, double *Y, double *Z,
-                 mag_workspace *w)
+static void
+sqfilt_eval(const gsl_matrix *G, const size_t offset, const size_t p,
+            const gsl_vector *c, const size_t n, double *out)
 {
-  mag_sqfilt_scalar_workspace *sqfilt_p = w->sqfilt_scalar_workspace_p;
-  size_t n;
-
-  *X = 0.0;
-  *Y = 0.0;
-  *Z = 0.0;
+  gsl_vector_view outv = gsl_vector_view_array(out, n);
 
-  for (n = 1; n <= sqfilt_p->nmax_ext; ++n)
+  if (p > 0)
     {
-      int M = (int) GSL_MIN(n, sqfilt_p->mmax_ext);
-      int m;
+      gsl_matrix_const_view Gv = gsl_matrix_const_submatrix(G, 0, offset, n, p);
+      gsl_vector_const_view cv = gsl_vector_const_subvector(c, offset, p);
 
-      for (m = -M; m <= M; ++m)
-        {
-          size_t idx = sqfilt_nmidx(1, n, m, sqfilt_p);
-          size_t gidx = green_nmidx(n, m, w->green_ext_p);
-          double cnm = gsl_vector_get(c, idx);
-
-          *X += cnm * w->dX_ext[gidx];
-          *Y += cnm * w->dY_ext[gidx];
-          *Z += cnm * w->dZ_ext[gidx];
-        }
+      gsl_blas_dgemv(CblasNoTrans, 1.0, &Gv.matrix, &cv.vector, 0.0, &outv.vector);
     }
-
-  return GSL_SUCCESS;
-}
+  else
+    gsl_vector_set_zero(&outv.vector);
+} /* sqfilt_eval() */
 
 /*
 sqfilt_nmidx()
@@ -76,6 +76,40 @@ fill_parameters(mag_params *params)
     params->main_nmax_int = cfg_params.main_nmax_int;
   if (cfg_params.crust_nmax_int >= 0)
     params->crust_nmax_int = cfg_params.crust_nmax_int;
+  if (cfg_params.nprocs > 0)
+    params->nprocs = (size_t) cfg_params.nprocs;
+  if (cfg_params.model_nprocs >= 0)
+    params->model_nprocs = (size_t) cfg_params.model_nprocs;
+  if (cfg_params.mageq_table_file != NULL)
+    params->mageq_table_file = (char *) cfg_params.mageq_table_file;
+  if (cfg_params.eej_geometry_file != NULL)
+    params->eej_geometry_file = (char *) cfg_params.eej_geometry_file;
+  if (cfg_params.pde_solver != NULL)
+    {
+      params->pde_solver = pde_solver_type(cfg_params.pde_solver);
+      if (params->pde_solver < 0)
+        {
+          fprintf(stderr, "fill_parameters: unknown pde_solver: %s\n",
+                  cfg_params.pde_solver);
+          s = -1;
+        }
+    }
+  if (cfg_params.pde_lis_options != NULL)
+    params->pde_lis_options = (char *) cfg_params.pde_lis_options;
+  if (cfg_params.pde_system_file != NULL)
+    params->pde_system_file = (char *) cfg_params.pde_system_file;
+  if (cfg_params.sigma_cache_file != NULL)
+    params->sigma_cache_file = (char *) cfg_params.sigma_cache_file;
+  if (cfg_params.sigma_cache_dt > 0.0)
+    params->sigma_cache_dt = cfg_params.sigma_cache_dt;
+  if (cfg_params.sigma_cache_dlon > 0.0)
+    params->sigma_cache_dlon = cfg_params.sigma_cache_dlon;
+  if (cfg_params.sigma_cache_dtheta > 0.0)
+    params->sigma_cache_dtheta = cfg_params.sigma_cache_dtheta;
+  if (cfg_params.sigma_cache_interp >= 0)
+    params->sigma_cache_interp = cfg_params.sigma_cache_interp;
+  if (cfg_params.sigma_cache_nslots > 0)
+    params->sigma_cache_nslots = (size_t) cfg_params.sigma_cache_nslots;
 
   return s;
 }
@@ -126,6 +160,8 @@ print_help(char *argv[])
   fprintf(stderr, "\t --qdmax | -q qdmax                  - maximum QD latitude for line currents (deg)\n");
   fprintf(stderr, "\t --profiles_only | -p                - compute magnetic/current profiles only (no EEF)\n");
   fprintf(stderr, "\t --vector | -z                       - use vector data instead of scalar\n");
+  fprintf(stderr, "\t --nprocs | -j nprocs                - number of worker processes for track processing\n");
+  fprintf(stderr, "\t --model_nprocs | -J nprocs          - number of IRI/MSIS/HWM server processes\n");
 }
 
 int
@@ -179,6 +215,21 @@ main(int argc, char *argv[])
   params.core_file = NULL;
   params.lith_file = NULL;
   params.main_nmax_int = 15;
+  params.nprocs = 1;
+  params.model_nprocs = 0;
+  params.mageq_table_file = NULL;
+  params.eej_geometry_file = NULL;
+  params.pde_solver = PDE_SOLVER_LIS;
+  params.pde_lis_options = NULL;
+  params.pde_system_file = NULL;
+
+  /* conductivity profile cache (disabled by default) */
+  params.sigma_cache_file = NULL;
+  params.sigma_cache_dt = 15.0;
+  params.sigma_cache_dlon = 1.0;
+  params.sigma_cache_dtheta = 0.25;
+  params.sigma_cache_interp = 1;
+  params.sigma_cache_nslots = 65536;
 
   while (1)
     {
@@ -197,10 +248,12 @@ main(int argc, char *argv[])
           { "ncurr", required_argument, NULL, 'm' },
           { "qdmax", required_argument, NULL, 'q' },
           { "vector", required_argument, NULL, 'z' },
+          { "nprocs", required_argument, NULL, 'j' },
+          { "model_nprocs", required_argument, NULL, 'J' },
           { 0, 0, 0, 0 }
         };
 
-      c = getopt_long(argc, argv, "a:b:c:k:l:m:o:pq:r:s:zC:", long_options, &option_index);
+      c = getopt_long(argc, argv, "a:b:c:j:J:k:l:m:o:pq:r:s:zC:", long_options, &option_index);
       if (c == -1)
         break;
 
@@ -236,6 +289,14 @@ main(int argc, char *argv[])
 
             break;
 
+          case 'j':
+            params.nprocs = (size_t) atoi(optarg);
+            break;
+
+          case 'J':
+            params.model_nprocs = (size_t) atoi(optarg);
+            break;
+
           case 'k':
             params.curr_altitude = atof(optarg);
             break;
@@ -319,8 +380,8 @@ main(int argc, char *argv[])
   config_workspace_p = cfg_alloc(config_file);
   fprintf(stderr, "done\n");
 
-  if (config_workspace_p)
-    fill_parameters(&params);
+  if (config_workspace_p && fill_parameters(&params) != 0)
+    exit(1);
 
   /* check if command line arguments override any parameters */
   if (lt_min > 0.0)
@@ -389,6 +450,24 @@ main(int argc, char *argv[])
   fprintf(stderr, "main: Sq external mmax:          %zu\n", params.sq_mmax_ext);
   fprintf(stderr, "main: Sq QD minimum latitude:    %.1f [deg]\n", params.sq_qdmin);
   fprintf(stderr, "main: Sq QD maximum latitude:    %.1f [deg]\n", params.sq_qdmax);
+  fprintf(stderr, "main: worker processes:          %zu\n", params.nprocs);
+  fprintf(stderr, "main: model server processes:    %zu\n", params.model_nprocs);
+  if (params.nprocs > 1 && params.model_nprocs > 0)
+    {
+      /* model_pool_run() is serial in processes other than the pool owner */
+      fprintf(stderr, "main: warning: -J has no effect with -j > 1; track workers evaluate IRI/MSIS/HWM serially\n");
+    }
+  fprintf(stderr, "main: dip equator table:         %s\n",
+          params.mageq_table_file ? params.mageq_table_file : "none");
+  fprintf(stderr, "main: line current geometry:    %s\n",
+          params.eej_geometry_file ? params.eej_geometry_file : "none");
+  fprintf(stderr, "main: PDE solver:                %s %s\n",
+          pde_solver_name(params.pde_solver),
+          params.pde_lis_options ? params.pde_lis_options : "");
+  fprintf(stderr, "main: conductivity cache:        %s\n",
+          params.sigma_cache_file ? params.sigma_cache_file : "none");
+  if (params.sigma_cache_file)
+    fprintf(stderr, "main: conductivity cache slots:  %zu\n", params.sigma_cache_nslots);
 
   track_workspace_p = track_alloc();
   track_init(data, NULL, track_workspace_p);
@@ -0,0 +1,514 @@
+/*
+ * model_pool.c
+ *
+ * Pool of model server processes for evaluating the IRI, MSIS and HWM
+ * Fortran models in parallel. These models keep their state in global
+ * COMMON blocks and cannot be called from several threads, so each
+ * server is a separate process created with fork(), holding its own
+ * copy of the model state and of all workspaces which existed when the
+ * pool was allocated.
+ *
+ * A batch request consists of n fixed-size input records, such as
+ * (colatitude, longitude, time) columns, which are written to a shared
+ * memory buffer. The servers take elements from a shared counter,
+ * call the requested function on their own copy of the parameters,
+ * and write the results to a shared output buffer. Pipes are used to
+ * start a batch and to signal its completion.
+ *
+ * If a server process dies, the pool is shut down and the current and
+ * all later batches are evaluated serially in the calling process.
+ *
+ * Calling sequence:
+ * 1. model_pool_alloc  - allocate pool; must be called after all
+ *                        model workspaces are initialized
+ * 2. model_pool_input  - fill input records
+ * 3. model_pool_run    - evaluate batch
+ * 4. model_pool_output - read output records
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <gsl/gsl_math.h>
+
+#include "model_pool.h"
+
+/* alignment of input/output buffers in shared region */
+#define MODEL_POOL_ALIGN           64
+
+/* interval in ms for checking that servers are alive during a batch */
+#define MODEL_POOL_POLL_MS         1000
+
+static size_t model_pool_round(const size_t n);
+static int model_pool_local(model_pool_workspace *w);
+static int model_pool_wait(model_pool_workspace *w);
+static void model_pool_stop(model_pool_workspace *w);
+static void model_pool_server(const int cmd_fd, const int done_fd,
+                              model_pool_workspace *w);
+static int model_pool_serial(model_pool_func *func, void *params, const size_t n,
+                             const size_t in_stride, const size_t out_stride,
+                             model_pool_workspace *w);
+
+/*
+model_pool_alloc()
+  Allocate a pool of model server processes
+
+Inputs: nprocs   - number of server processes
+        in_size  - size of input buffer in bytes
+        out_size - size of output buffer in bytes
+
+Return: pointer to workspace
+
+Notes:
+1) Servers see the process state at the time of this call; model
+workspaces passed later as 'params' to model_pool_run() must already
+exist and be fully configured
+
+2) If nprocs = 0, or fork() fails, batches are evaluated serially in
+the calling process
+
+3) When servers are started, SIGPIPE is ignored so that writing to
+the command pipe of a dead server returns EPIPE instead of killing
+the calling process
+*/
+
+model_pool_workspace *
+model_pool_alloc(const size_t nprocs, const size_t in_size,
+                 const size_t out_size)
+{
+  model_pool_workspace *w;
+  int done_pipe[2];
+  size_t i;
+
+  w = calloc(1, sizeof(model_pool_workspace));
+  if (!w)
+    {
+      fprintf(stderr, "model_pool_alloc: calloc failed: %s\n", strerror(errno));
+      return 0;
+    }
+
+  w->owner = getpid();
+  w->in_size = model_pool_round(in_size);
+  w->out_size = model_pool_round(out_size);
+  w->shared_size = model_pool_round(sizeof(model_pool_shared)) + w->in_size + w->out_size;
+  w->done_fd = -1;
+
+  w->shared = mmap(NULL, w->shared_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (w->shared == MAP_FAILED)
+    {
+      fprintf(stderr, "model_pool_alloc: mmap failed: %s\n", strerror(errno));
+      w->shared = NULL;
+      model_pool_free(w);
+      return 0;
+    }
+
+  w->in = (char *) w->shared + model_pool_round(sizeof(model_pool_shared));
+  w->out = w->in + w->in_size;
+
+  w->pid = calloc(GSL_MAX(nprocs, 1), sizeof(pid_t));
+  w->cmd_fd = calloc(GSL_MAX(nprocs, 1), sizeof(int));
+
+  if (nprocs == 0 || pipe(done_pipe) != 0)
+    return w;
+
+  w->done_fd = done_pipe[0];
+
+  signal(SIGPIPE, SIG_IGN);
+
+  /* flush stdio buffers so they are not duplicated in the servers */
+  fflush(NULL);
+
+  for (i = 0; i < nprocs; ++i)
+    {
+      int cmd_pipe[2];
+      pid_t pid;
+
+      if (pipe(cmd_pipe) != 0)
+        break;
+
+      pid = fork();
+      if (pid == 0)
+        {
+          size_t j;
+
+          /* close command pipes of previously created servers */
+          for (j = 0; j < i; ++j)
+            close(w->cmd_fd[j]);
+
+          close(cmd_pipe[1]);
+          close(done_pipe[0]);
+
+          model_pool_server(cmd_pipe[0], done_pipe[1], w);
+
+          /* skip atexit handlers and stdio cleanup of the parent's files */
+          _exit(0);
+        }
+      else if (pid < 0)
+        {
+          fprintf(stderr, "model_pool_alloc: fork failed: %s\n", strerror(errno));
+          close(cmd_pipe[0]);
+          close(cmd_pipe[1]);
+          break;
+        }
+
+      close(cmd_pipe[0]);
+      w->pid[i] = pid;
+      w->cmd_fd[i] = cmd_pipe[1];
+      ++(w->nprocs);
+    }
+
+  close(done_pipe[1]);
+
+  return w;
+} /* model_pool_alloc() */
+
+void
+model_pool_free(model_pool_workspace *w)
+{
+  size_t i;
+
+  if (getpid() == w->owner)
+    {
+      /* tell servers to exit */
+      for (i = 0; i < w->nprocs; ++i)
+        {
+          char c = 'q';
+
+          if (write(w->cmd_fd[i], &c, 1) != 1)
+            kill(w->pid[i], SIGTERM);
+        }
+
+      for (i = 0; i < w->nprocs; ++i)
+        waitpid(w->pid[i], NULL, 0);
+    }
+
+  for (i = 0; i < w->nprocs; ++i)
+    close(w->cmd_fd[i]);
+
+  if (w->done_fd >= 0)
+    close(w->done_fd);
+
+  if (w->pid)
+    free(w->pid);
+
+  if (w->cmd_fd)
+    free(w->cmd_fd);
+
+  if (w->local)
+    {
+      free(w->in);
+      free(w->out);
+    }
+
+  if (w->shared)
+    munmap(w->shared, w->shared_size);
+
+  free(w);
+} /* model_pool_free() */
+
+/* return input buffer for next batch, or NULL on error */
+void *
+model_pool_input(model_pool_workspace *w)
+{
+  if (model_pool_local(w))
+    return NULL;
+
+  return w->in;
+}
+
+/* return output buffer of last batch */
+void *
+model_pool_output(model_pool_workspace *w)
+{
+  return w->out;
+}
+
+/*
+model_pool_run()
+  Evaluate a batch of n elements
+
+Inputs: func       - function to evaluate for each element
+        params     - parameters passed to func; in the servers this
+                     refers to their own copy of the object
+        n          - number of elements
+        in_stride  - size of each input record in bytes
+        out_stride - size of each output record in bytes
+        w          - workspace
+
+Return: success, or the first nonzero return value of func
+
+Notes:
+1) Input records are read from model_pool_input(), and output
+records are written to model_pool_output()
+
+2) When called from a process other than the one which allocated the
+pool (for example a forked track worker), the batch is evaluated
+serially in the calling process, since the servers belong to the
+pool owner; such processes use private input/output buffers so they
+do not overwrite each other's batches
+
+3) If a server cannot be started on the batch or exits before
+finishing it, the remaining servers are stopped and the batch is
+evaluated serially; later batches are then also evaluated serially
+*/
+
+int
+model_pool_run(model_pool_func *func, void *params, const size_t n,
+               const size_t in_stride, const size_t out_stride,
+               model_pool_workspace *w)
+{
+  model_pool_shared *shared = w->shared;
+  size_t i;
+
+  if (n * in_stride > w->in_size || n * out_stride > w->out_size)
+    {
+      fprintf(stderr, "model_pool_run: batch too large for buffers\n");
+      return -1;
+    }
+
+  if (model_pool_local(w))
+    return -1;
+
+  if (w->nprocs == 0 || getpid() != w->owner)
+    return model_pool_serial(func, params, n, in_stride, out_stride, w);
+
+  shared->func = func;
+  shared->params = params;
+  shared->n = n;
+  shared->in_stride = in_stride;
+  shared->out_stride = out_stride;
+  shared->next = 0;
+  shared->status = 0;
+
+  __sync_synchronize();
+
+  for (i = 0; i < w->nprocs; ++i)
+    {
+      char c = 'r';
+
+      if (write(w->cmd_fd[i], &c, 1) != 1)
+        {
+          fprintf(stderr, "model_pool_run: server %zu not responding, evaluating serially\n", i);
+          model_pool_stop(w);
+          return model_pool_serial(func, params, n, in_stride, out_stride, w);
+        }
+    }
+
+  /* wait for all servers to finish */
+  if (model_pool_wait(w))
+    {
+      fprintf(stderr, "model_pool_run: lost connection to servers, evaluating serially\n");
+      model_pool_stop(w);
+      return model_pool_serial(func, params, n, in_stride, out_stride, w);
+    }
+
+  __sync_synchronize();
+
+  return shared->status;
+} /* model_pool_run() */
+
+static size_t
+model_pool_round(const size_t n)
+{
+  return (n + MODEL_POOL_ALIGN - 1) / MODEL_POOL_ALIGN * MODEL_POOL_ALIGN;
+}
+
+/*
+model_pool_local()
+  In a process other than the pool owner, replace the shared
+input/output buffers by private copies
+
+Return: 0 on success, -1 if the buffers could not be allocated
+*/
+
+static int
+model_pool_local(model_pool_workspace *w)
+{
+  char *in, *out;
+
+  if (w->local || getpid() == w->owner)
+    return 0;
+
+  in = malloc(w->in_size);
+  out = malloc(w->out_size);
+  if (!in || !out)
+    {
+      fprintf(stderr, "model_pool_local: malloc failed: %s\n", strerror(errno));
+      free(in);
+      free(out);
+      return -1;
+    }
+
+  w->in = in;
+  w->out = out;
+  w->local = 1;
+
+  return 0;
+} /* model_pool_local() */
+
+/*
+model_pool_wait()
+  Wait for all servers to signal completion of the current batch
+
+Return: 0 on success, -1 if a server exited or the completion pipe
+failed
+
+Notes:
+1) The completion pipe is polled with a timeout, so that a server
+which dies without writing its completion byte is detected with
+waitpid() instead of blocking forever
+*/
+
+static int
+model_pool_wait(model_pool_workspace *w)
+{
+  size_t ndone = 0;
+
+  while (ndone < w->nprocs)
+    {
+      struct pollfd pfd;
+      int rc;
+      size_t i;
+
+      pfd.fd = w->done_fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+
+      rc = poll(&pfd, 1, MODEL_POOL_POLL_MS);
+      if (rc < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return -1;
+        }
+      else if (rc > 0)
+        {
+          char buf[64];
+          ssize_t nread = read(w->done_fd, buf, GSL_MIN(sizeof(buf), w->nprocs - ndone));
+
+          if (nread > 0)
+            {
+              ndone += (size_t) nread;
+              continue;
+            }
+          else if (nread < 0 && errno == EINTR)
+            continue;
+
+          /* end of file: all servers have closed the pipe */
+          return -1;
+        }
+
+      /* timeout: check that all servers are still running */
+      for (i = 0; i < w->nprocs; ++i)
+        {
+          if (w->pid[i] > 0 && waitpid(w->pid[i], NULL, WNOHANG) == w->pid[i])
+            {
+              fprintf(stderr, "model_pool_wait: server %zu (pid %ld) exited\n",
+                      i, (long) w->pid[i]);
+              w->pid[i] = 0; /* already reaped */
+              return -1;
+            }
+        }
+    }
+
+  return 0;
+} /* model_pool_wait() */
+
+/*
+model_pool_stop()
+  Stop all servers after a failure, so that all later batches are
+evaluated serially in the pool owner
+*/
+
+static void
+model_pool_stop(model_pool_workspace *w)
+{
+  size_t i;
+
+  for (i = 0; i < w->nprocs; ++i)
+    {
+      if (w->pid[i] > 0)
+        {
+          kill(w->pid[i], SIGKILL);
+          waitpid(w->pid[i], NULL, 0);
+        }
+
+      close(w->cmd_fd[i]);
+    }
+
+  if (w->done_fd >= 0)
+    {
+      close(w->done_fd);
+      w->done_fd = -1;
+    }
+
+  w->nprocs = 0;
+} /* model_pool_stop() */
+
+/*
+model_pool_server()
+  Main loop of a server process
+*/
+
+static void
+model_pool_server(const int cmd_fd, const int done_fd,
+                  model_pool_workspace *w)
+{
+  model_pool_shared *shared = w->shared;
+  char c;
+
+  while (read(cmd_fd, &c, 1) == 1 && c == 'r')
+    {
+      __sync_synchronize();
+
+      while (1)
+        {
+          size_t k = __sync_fetch_and_add(&(shared->next), 1);
+          int s;
+
+          if (k >= shared->n)
+            break;
+
+          s = (shared->func)(w->in + k * shared->in_stride,
+                             w->out + k * shared->out_stride,
+                             shared->params);
+          if (s)
+            __sync_bool_compare_and_swap(&(shared->status), 0, s);
+        }
+
+      __sync_synchronize();
+
+      c = 'd';
+      if (write(done_fd, &c, 1) != 1)
+        break;
+    }
+} /* model_pool_server() */
+
+static int
+model_pool_serial(model_pool_func *func, void *params, const size_t n,
+                  const size_t in_stride, const size_t out_stride,
+                  model_pool_workspace *w)
+{
+  int status = 0;
+  size_t k;
+
+  for (k = 0; k < n; ++k)
+    {
+      int s = func(w->in + k * in_stride, w->out + k * out_stride, params);
+
+      if (s && status == 0)
+        status = s;
+    }
+
+  return status;
+} /* model_pool_serial() */
@@ -0,0 +1,60 @@
+/*
+ * model_pool.h
+ */
+
+#ifndef INCLUDED_model_pool_h
+#define INCLUDED_model_pool_h
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * function evaluated for each element of a batch; 'in' and 'out'
+ * point to the element's input and output records, and 'params'
+ * to the caller's state as it existed when the pool was created
+ */
+typedef int model_pool_func(const void *in, void *out, void *params);
+
+/* control block in shared memory, followed by input and output buffers */
+typedef struct
+{
+  model_pool_func *func;   /* function for current batch */
+  void *params;            /* parameters for current batch */
+  size_t n;                /* number of elements in batch */
+  size_t in_stride;        /* bytes per input record */
+  size_t out_stride;       /* bytes per output record */
+  size_t next;             /* next element to evaluate */
+  int status;              /* first nonzero return value of func */
+} model_pool_shared;
+
+typedef struct
+{
+  size_t nprocs;           /* number of server processes */
+  pid_t owner;             /* process which created the pool */
+  pid_t *pid;              /* server process ids */
+  int *cmd_fd;             /* write end of command pipe for each server */
+  int done_fd;             /* read end of completion pipe */
+
+  size_t in_size;          /* input buffer size in bytes */
+  size_t out_size;         /* output buffer size in bytes */
+  size_t shared_size;      /* total size of shared region */
+  model_pool_shared *shared;
+  char *in;                /* input buffer */
+  char *out;               /* output buffer */
+  int local;               /* in and out are private copies (non-owner process) */
+} model_pool_workspace;
+
+/*
+ * Prototypes
+ */
+
+model_pool_workspace *model_pool_alloc(const size_t nprocs, const size_t in_size,
+                                       const size_t out_size);
+void model_pool_free(model_pool_workspace *w);
+void *model_pool_input(model_pool_workspace *w);
+void *model_pool_output(model_pool_workspace *w);
+int model_pool_run(model_pool_func *func, void *params, const size_t n,
+                   const size_t in_stride, const size_t out_stride,
+                   model_pool_workspace *w);
+
+#endif /* INCLUDED_model_pool_h */
@@ -31,25 +31,39 @@
 #include <common/oct.h>
 
 #include "mageq.h"
-#include "lisw.h"
-#include "superlu.h"
+#include "pde_solver.h"
 
+#include "model_pool.h"
 #include "pde.h"
 #include "sigma.h"
 
 #include "pde_common.c"
 
-#define PDE_SOLVER_LIS          0
-#define PDE_SOLVER_SUPERLU      1
+/* input record of a wind column evaluated by a model server */
+typedef struct
+{
+  double theta;      /* colatitude (radians) */
+  double phi;        /* longitude (radians) */
+  time_t t;          /* timestamp */
+  double alt_min;    /* minimum altitude (km) */
+  double alt_step;   /* altitude step (km) */
+  size_t nalt;       /* number of altitudes */
+} pde_wind_input;
 
 static int pde_initialize(time_t t, double longitude, pde_workspace *w);
 static int pde_sigma_tensor(sigma_workspace *sigma_p, pde_workspace *w);
 static void pde_compute_wind(pde_workspace *w);
+static int pde_wind_column(const void *in, void *out, void *params);
+static mageq_table *pde_mageq_table(const pde_parameters *params, pde_workspace *w);
 static int pde_scales(sigma_workspace *sigma_p, pde_workspace *w);
+static int pde_operator(pde_workspace *w);
 static int pde_coefficients(pde_workspace *w);
+static int pde_rhs(int compute_winds, double E_phi0, gsl_vector *b, pde_workspace *w);
 static int pde_discretize(pde_workspace *w);
+static gsl_spmatrix *pde_matrix_alloc(const pde_workspace *w);
 static int pde_matrix(pde_workspace *w);
-static int pde_compute_psi(pde_workspace *w);
+static int pde_compute_psi(const size_t nrhs, pde_workspace *w);
+static int pde_current(int compute_winds, double E_phi0, const size_t k, pde_workspace *w);
 static int pde_check_psi(pde_workspace *w);
 static int pde_calc_J(pde_workspace *w);
 static int pde_magnetic_field(pde_workspace *w);
@@ -59,7 +73,7 @@ pde_workspace *
 pde_alloc(pde_parameters *params)
 {
   pde_workspace *w;
-  size_t i, j;
+  size_t i;
   size_t nrt; /* nr * ntheta */
 
   w = calloc(1, sizeof(pde_workspace));
@@ -76,6 +90,10 @@ pde_alloc(pde_parameters *params)
   w->theta_min = params->theta_min;
   w->theta_max = params->theta_max;
 
+  w->solver_params = params->solver_params;
+  w->system_file = params->system_file;
+  w->system_written = 0;
+
   w->dr = (w->rmax - w->rmin) / w->nr;
   w->dtheta = (w->theta_max - w->theta_min) / (w->ntheta - 1.0);
 
@@ -112,10 +130,20 @@ pde_alloc(pde_parameters *params)
       return 0;
     }
 
+  w->B = gsl_matrix_alloc(PDE_NRHS, nrt);
+  w->PSI = gsl_matrix_alloc(PDE_NRHS, nrt);
+  if (w->B == 0 || w->PSI == 0)
+    {
+      pde_free(w);
+      return 0;
+    }
+
   w->alpha = malloc(nrt * sizeof(double));
   w->beta = malloc(nrt * sizeof(double));
   w->gamma = malloc(nrt * sizeof(double));
-  if (!w->alpha || !w->beta || !w->gamma)
+  w->dadr = malloc(nrt * sizeof(double));
+  w->dadt = malloc(nrt * sizeof(double));
+  if (!w->alpha || !w->beta || !w->gamma || !w->dadr || !w->dadt)
     {
       pde_free(w);
       return 0;
@@ -178,37 +206,37 @@ pde_alloc(pde_parameters *params)
 
   w->nprocs = 2;
 
-  w->S = gsl_spmatrix_alloc(nrt, nrt);
+  w->S = pde_matrix_alloc(w);
   if (!w->S)
     {
       pde_free(w);
       return 0;
     }
 
-  w->sigma = calloc(1, w->nr * w->ntheta * sizeof(gsl_matrix *));
-  if (!w->sigma)
+  w->sigma[0] = malloc(9 * nrt * sizeof(double));
+  if (!w->sigma[0])
     {
       pde_free(w);
       return 0;
     }
 
-  for (i = 0; i < w->nr; ++i)
-    {
-      for (j = 0; j < w->ntheta; ++j)
-        {
-          w->sigma[PDE_IDX(i, j, w)] = gsl_matrix_alloc(3, 3);
-          if (!w->sigma[PDE_IDX(i, j, w)])
-            {
-              pde_free(w);
-              return 0;
-            }
-        }
-    }
+  for (i = 1; i < 9; ++i)
+    w->sigma[i] = w->sigma[0] + i * nrt;
 
   w->sigma_workspace_p = sigma_alloc(params->f107_file, w->nr, w->ntheta,
                                      w->rmin, w->rmax,
                                      w->theta_min, w->theta_max);
 
+  if (params->sigma_cache_file)
+    {
+      int s = sigma_set_cache(params->sigma_cache_file,
+                              &(params->sigma_cache_params),
+                              w->sigma_workspace_p);
+      if (s)
+        fprintf(stderr, "pde_alloc: unable to use conductivity cache %s\n",
+                params->sigma_cache_file);
+    }
+
   /* initialize scaling factors to 1 - they are computed later */
   w->r_s = 1.0;
   w->sigma_s = 1.0;
@@ -230,6 +258,37 @@ pde_alloc(pde_parameters *params)
   for (i = 0; i < w->ntheta; ++i)
     w->theta_grid[i] = pde_theta(i, w);
 
+  if (params->mageq_table_file)
+    {
+      w->mageq_table_p = pde_mageq_table(params, w);
+      if (w->mageq_table_p)
+        {
+          int s = mageq_set_table(w->mageq_table_p, PDE_MAGEQ_TOL_LAT,
+                                  PDE_MAGEQ_TOL_ANGLE, w->mageq_workspace_p);
+
+          s += mageq_set_table(w->mageq_table_p, PDE_MAGEQ_TOL_LAT, PDE_MAGEQ_TOL_ANGLE,
+                               w->sigma_workspace_p->mageq_workspace_p);
+          if (s)
+            fprintf(stderr, "pde_alloc: dip equator table %s exceeds error tolerance, not used\n",
+                    params->mageq_table_file);
+        }
+    }
+
+  /*
+   * start model servers last, so they inherit the fully initialized
+   * HWM, sigma and conductivity cache workspaces
+   */
+  if (params->model_nprocs > 0)
+    {
+      size_t in_size = w->ntheta * GSL_MAX(sizeof(sigma_column_input),
+                                           sizeof(pde_wind_input));
+      size_t out_size = w->ntheta * GSL_MAX(3 * w->nr, 2 * (w->nr + 1)) * sizeof(double);
+
+      w->model_pool_p = model_pool_alloc(params->model_nprocs, in_size, out_size);
+      if (w->model_pool_p)
+        sigma_set_pool(w->model_pool_p, w->sigma_workspace_p);
+    }
+
   return w;
 } /* pde_alloc() */
 
@@ -238,12 +297,22 @@ pde_free(pde_workspace *w)
 {
   size_t i;
 
+  /* stop model servers before freeing the workspaces they use */
+  if (w->model_pool_p)
+    model_pool_free(w->model_pool_p);
+
   if (w->b)
     gsl_vector_free(w->b);
 
   if (w->psi)
     gsl_vector_free(w->psi);
 
+  if (w->B)
+    gsl_matrix_free(w->B);
+
+  if (w->PSI)
+    gsl_matrix_free(w->PSI);
+
   if (w->J_lat)
     gsl_vector_free(w->J_lat);
 
@@ -274,6 +343,12 @@ pde_free(pde_workspace *w)
   if (w->gamma)
     free(w->gamma);
 
+  if (w->dadr)
+    free(w->dadr);
+
+  if (w->dadt)
+    free(w->dadt);
+
   if (w->f1)
     free(w->f1);
 
@@ -331,21 +406,11 @@ pde_free(pde_workspace *w)
   if (w->sigma_workspace_p)
     sigma_free(w->sigma_workspace_p);
 
-  if (w->sigma)
-    {
-      size_t i, j;
+  if (w->mageq_table_p)
+    mageq_table_free(w->mageq_table_p);
 
-      for (i = 0; i < w->nr; ++i)
-        {
-          for (j = 0; j < w->ntheta; ++j)
-            {
-              if (w->sigma[PDE_IDX(i, j, w)])
-                gsl_matrix_free(w->sigma[PDE_IDX(i, j, w)]);
-            }
-        }
-
-      free(w->sigma);
-    }
+  if (w->sigma[0])
+    free(w->sigma[0]);
 
   for (i = 0; i < 9; ++i)
     {
@@ -367,6 +432,9 @@ Notes:
 1) On output, solutions are stored in
    w->J_lat_E = J(E, u = 0)
    w->J_lat_u = J(E = 0, u)
+
+2) The PDE operator depends only on the conductivity tensor, so
+it is assembled once and both right hand sides are solved together
 */
 
 int
@@ -374,6 +442,8 @@ pde_proc(const time_t t, const double longitude,
          pde_workspace *w)
 {
   int s = 0;
+  gsl_vector_view b_E = gsl_matrix_row(w->B, 0);
+  gsl_vector_view b_u = gsl_matrix_row(w->B, 1);
 
   gsl_vector_set_zero(w->J_lat_E);
   gsl_vector_set_zero(w->J_lat_u);
@@ -391,6 +461,17 @@ pde_proc(const time_t t, const double longitude,
   if (s)
     return s;
 
+  s = pde_operator(w);
+  if (s)
+    return s;
+
+  pde_debug(w, "pde_proc: constructing rhs for E_0 (no winds) and winds (no E_0)...");
+  s = pde_rhs(0, EEF_PHI_0, &b_E.vector, w);
+  s += pde_rhs(1, 0.0, &b_u.vector, w);
+  pde_debug(w, "done (s = %d)\n", s);
+  if (s)
+    return s;
+
   /*
    * Record errors in the PDE solution but don't return
    * prematurely - the solution is calculated even if the iterative
@@ -398,16 +479,20 @@ pde_proc(const time_t t, const double longitude,
    * like
    */
 
-  pde_debug(w, "pde_proc: ---- solving for E_0 (no winds) ----\n");
+  pde_debug(w, "pde_proc: computing psi solutions...");
+  s += pde_compute_psi(2, w);
+  pde_debug(w, "done (residual norm = %.12e)\n", w->residual);
+
+  pde_debug(w, "pde_proc: ---- computing current for E_0 (no winds) ----\n");
 
-  s += pde_solve(0, EEF_PHI_0, w);
+  s += pde_current(0, EEF_PHI_0, 0, w);
 
   /* save J(E_0, u = 0) solution */
   gsl_vector_memcpy(w->J_lat_E, w->J_lat);
 
-  pde_debug(w, "pde_proc: ---- solving for winds (no E_0) ----\n");
+  pde_debug(w, "pde_proc: ---- computing current for winds (no E_0) ----\n");
 
-  s += pde_solve(1, 0.0, w);
+  s += pde_current(1, 0.0, 1, w);
 
   /* save J(E_0 = 0, u) solution */
   gsl_vector_memcpy(w->J_lat_u, w->J_lat);
@@ -477,32 +562,65 @@ Notes:
 1) pde_initialize() must be called prior to this function
 
 2) height-integrated current solution is stored in w->J_lat on output
+
+3) To solve for both E_0 and winds, pde_proc() is more efficient since
+it assembles and factors the PDE matrix only once
 */
 
 int
 pde_solve(int compute_winds, double E_phi0, pde_workspace *w)
 {
-  double min, max;
   int s = 0;
-  double normb;
+  gsl_vector_view b = gsl_matrix_row(w->B, 0);
 
-  w->compute_winds = compute_winds;
-  w->E_phi0 = E_phi0;
+  s = pde_operator(w);
+  if (s)
+    return s;
+
+  pde_debug(w, "pde_solve: constructing rhs...");
+  s = pde_rhs(compute_winds, E_phi0, &b.vector, w);
+  pde_debug(w, "done (s = %d)\n", s);
+  if (s)
+    return s;
+
+  pde_debug(w, "pde_solve: computing psi solution...");
+  s += pde_compute_psi(1, w);
+  pde_debug(w, "done (residual norm = %.12e)\n", w->residual);
+
+  s += pde_current(compute_winds, E_phi0, 0, w);
+
+  return s;
+} /* pde_solve() */
+
+/*
+pde_operator()
+  Construct the PDE matrix w->S, which depends only on the
+conductivity tensor and not on E_0 or the winds
+
+Notes:
+1) pde_initialize() must be called prior to this function
+*/
+
+static int
+pde_operator(pde_workspace *w)
+{
+  int s = 0;
+  double min, max;
 
   /* compute coefficients of PDE for all grid points */
-  pde_debug(w, "pde_solve: computing PDE coefficients...");
+  pde_debug(w, "pde_operator: computing PDE coefficients...");
   s = pde_coefficients(w);
   pde_debug(w, "done (s = %d)\n", s);
   if (s)
     return s;
 
-  pde_debug(w, "pde_solve: constructing difference equation coefficients...");
+  pde_debug(w, "pde_operator: constructing difference equation coefficients...");
   s = pde_discretize(w);
   pde_debug(w, "done (s = %d)\n", s);
   if (s)
     return s;
 
-  pde_debug(w, "pde_solve: constructing PDE matrix...");
+  pde_debug(w, "pde_operator: constructing PDE matrix...");
   s = pde_matrix(w);
   pde_debug(w, "done (non zero elements = %d)\n",
             gsl_spmatrix_nnz(w->S));
@@ -510,35 +628,57 @@ pde_solve(int compute_winds, double E_phi0, pde_workspace *w)
     return s;
 
   gsl_spmatrix_minmax(w->S, &min, &max);
-  pde_debug(w, "pde_solve: matrix minimum element = %.4e, maximum element = %.4e\n", min, max);
-  gsl_vector_minmax(w->b, &min, &max);
-  pde_debug(w, "pde_solve: rhs minimum element = %.4e, maximum element = %.4e\n", min, max);
+  pde_debug(w, "pde_operator: matrix minimum element = %.4e, maximum element = %.4e\n", min, max);
 
-  normb = gsl_blas_dnrm2(w->b);
+  return s;
+} /* pde_operator() */
 
-  pde_debug(w, "pde_solve: computing psi solution...");
-  s += pde_compute_psi(w);
-  pde_debug(w, "done (residual norm = %.12e, relative residual norm = %.12e)\n", w->residual, w->residual / normb);
+/*
+pde_current()
+  Compute the eastward current from a psi solution previously
+computed by pde_compute_psi()
+
+Inputs: compute_winds - winds used for this solution? (0/1)
+        E_phi0        - eastward electric field in V/m used for this solution
+        k             - row of w->PSI containing the solution
+        w             - pde workspace
+
+Notes:
+1) height-integrated current solution is stored in w->J_lat on output
+*/
+
+static int
+pde_current(int compute_winds, double E_phi0, const size_t k, pde_workspace *w)
+{
+  int s = 0;
+  gsl_vector_view psi = gsl_matrix_row(w->PSI, k);
+
+  /* restore beta/gamma for this right hand side */
+  s = pde_rhs(compute_winds, E_phi0, w->b, w);
+  if (s)
+    return s;
+
+  gsl_vector_memcpy(w->psi, &psi.vector);
 
 #if 0
-  pde_debug(w, "pde_solve: checking psi solution...");
+  pde_debug(w, "pde_current: checking psi solution...");
   s += pde_check_psi(w);
   pde_debug(w, "done (s = %d)\n", s);
   if (s)
     return s;
 #endif
 
-  pde_debug(w, "pde_solve: computing eastward current...");
+  pde_debug(w, "pde_current: computing eastward current...");
   s += pde_calc_J(w);
   pde_debug(w, "done (s = %d)\n", s);
 
   /* J_lat is height-integrated and has units of current * meters */
-  pde_debug(w, "pde_solve: scaling output back to physical units...");
+  pde_debug(w, "pde_current: scaling output back to physical units...");
   gsl_vector_scale(w->J_lat, w->J_s * w->r_s);
   pde_debug(w, "done\n");
 
   return s;
-} /* pde_solve() */
+} /* pde_current() */
 
 /*
 pde_magnetic_field()
@@ -594,7 +734,7 @@ pde_magnetic_field(pde_workspace *w)
 
 /*
 pde_sigma_tensor()
-  Compute w->sigma matrices using w->s{0,1,2} previously
+  Compute w->sigma tensor components using w->s{0,1,2} previously
 computed by 'sigma' program
 */
 
@@ -606,14 +746,12 @@ pde_sigma_tensor(sigma_workspace *sigma_p, pde_workspace *w)
   double b[3]; /* unit magnetic field vector */
   double s0, s1, s2;
 
-  for (j = 0; j < w->ntheta; ++j)
+  for (i = 0; i < w->nr; ++i)
     {
-      double theta = pde_theta(j, w);
-
-      for (i = 0; i < w->nr; ++i)
+      for (j = 0; j < w->ntheta; ++j)
         {
           size_t k = PDE_IDX(i, j, w);
-          gsl_matrix *s = w->sigma[k];
+          double theta = pde_theta(j, w);
           double dsig;
 
           /*
@@ -635,24 +773,24 @@ pde_sigma_tensor(sigma_workspace *sigma_p, pde_workspace *w)
           b[IDX_THETA] = w->Bt[k] / w->Bf[k];
           b[IDX_PHI] = w->Bp[k] / w->Bf[k];
 
-          gsl_matrix_set(s, IDX_R, IDX_R,
-            dsig * b[IDX_R] * b[IDX_R] + s1);
-          gsl_matrix_set(s, IDX_R, IDX_THETA,
-            dsig * b[IDX_R] * b[IDX_THETA] - s2 * b[IDX_PHI]);
-          gsl_matrix_set(s, IDX_R, IDX_PHI,
-            dsig * b[IDX_R] * b[IDX_PHI] + s2 * b[IDX_THETA]);
-          gsl_matrix_set(s, IDX_THETA, IDX_R,
-            dsig * b[IDX_THETA] * b[IDX_R] + s2 * b[IDX_PHI]);
-          gsl_matrix_set(s, IDX_THETA, IDX_THETA,
-            dsig * b[IDX_THETA] * b[IDX_THETA] + s1);
-          gsl_matrix_set(s, IDX_THETA, IDX_PHI,
-            dsig * b[IDX_THETA] * b[IDX_PHI] - s2 * b[IDX_R]);
-          gsl_matrix_set(s, IDX_PHI, IDX_R,
-            dsig * b[IDX_PHI] * b[IDX_R] - s2 * b[IDX_THETA]);
-          gsl_matrix_set(s, IDX_PHI, IDX_THETA,
-            dsig * b[IDX_PHI] * b[IDX_THETA] + s2 * b[IDX_R]);
-          gsl_matrix_set(s, IDX_PHI, IDX_PHI,
-            dsig * b[IDX_PHI] * b[IDX_PHI] + s1);
+          w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_R)][k] =
+            dsig * b[IDX_R] * b[IDX_R] + s1;
+          w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_THETA)][k] =
+            dsig * b[IDX_R] * b[IDX_THETA] - s2 * b[IDX_PHI];
+          w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_PHI)][k] =
+            dsig * b[IDX_R] * b[IDX_PHI] + s2 * b[IDX_THETA];
+          w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_R)][k] =
+            dsig * b[IDX_THETA] * b[IDX_R] + s2 * b[IDX_PHI];
+          w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_THETA)][k] =
+            dsig * b[IDX_THETA] * b[IDX_THETA] + s1;
+          w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_PHI)][k] =
+            dsig * b[IDX_THETA] * b[IDX_PHI] - s2 * b[IDX_R];
+          w->sigma[PDE_SIGMA_IDX(IDX_PHI, IDX_R)][k] =
+            dsig * b[IDX_PHI] * b[IDX_R] - s2 * b[IDX_THETA];
+          w->sigma[PDE_SIGMA_IDX(IDX_PHI, IDX_THETA)][k] =
+            dsig * b[IDX_PHI] * b[IDX_THETA] + s2 * b[IDX_R];
+          w->sigma[PDE_SIGMA_IDX(IDX_PHI, IDX_PHI)][k] =
+            dsig * b[IDX_PHI] * b[IDX_PHI] + s1;
 
 #ifdef PDE_SIGMA_TAPER
 
@@ -661,6 +799,7 @@ pde_sigma_tensor(sigma_workspace *sigma_p, pde_workspace *w)
             double thetan = pde_theta(w->ntheta - 1, w);
             double tmp;
             double taperfac;
+            size_t c;
 
             if (theta - theta0 < PDE_SIGMA_TAPER_RANGE)
               {
@@ -675,7 +814,8 @@ pde_sigma_tensor(sigma_workspace *sigma_p, pde_workspace *w)
             else
               taperfac = 1.0;
 
-            gsl_matrix_scale(s, taperfac);
+            for (c = 0; c < 9; ++c)
+              w->sigma[c][k] *= taperfac;
           }
 
 #endif /* PDE_SIGMA_TAPER */
@@ -690,18 +830,18 @@ pde_sigma_tensor(sigma_workspace *sigma_p, pde_workspace *w)
                  b[IDX_R],
                  b[IDX_THETA],
                  b[IDX_PHI],
-         /*9*/   gsl_matrix_get(s, IDX_R, IDX_R),
-                 gsl_matrix_get(s, IDX_R, IDX_THETA),
-                 gsl_matrix_get(s, IDX_R, IDX_PHI),
-                 gsl_matrix_get(s, IDX_THETA, IDX_R),
-                 gsl_matrix_get(s, IDX_THETA, IDX_THETA),
-                 gsl_matrix_get(s, IDX_THETA, IDX_PHI),
-                 gsl_matrix_get(s, IDX_PHI, IDX_R),
-                 gsl_matrix_get(s, IDX_PHI, IDX_THETA),
-                 gsl_matrix_get(s, IDX_PHI, IDX_PHI));
+         /*9*/   w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_R)][k],
+                 w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_THETA)][k],
+                 w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_PHI)][k],
+                 w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_R)][k],
+                 w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_THETA)][k],
+                 w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_PHI)][k],
+                 w->sigma[PDE_SIGMA_IDX(IDX_PHI, IDX_R)][k],
+                 w->sigma[PDE_SIGMA_IDX(IDX_PHI, IDX_THETA)][k],
+                 w->sigma[PDE_SIGMA_IDX(IDX_PHI, IDX_PHI)][k]);
 #endif
-        } /* for (i = 0; i < w->nr; ++i) */
-    } /* for (j = 0; j < w->ntheta; ++j) */
+        } /* for (j = 0; j < w->ntheta; ++j) */
+    } /* for (i = 0; i < w->nr; ++i) */
 #if 0
   exit(1);
 #endif
@@ -714,25 +854,74 @@ pde_compute_wind(pde_workspace *w)
 {
   size_t i, j, n;
   double latitude;
+  double *out = NULL;
+  const size_t stride = 2 * (w->nr + 1);
+
+  if (w->model_pool_p)
+    {
+      /* evaluate all HWM columns as one batch on the model servers */
+      pde_wind_input *in = model_pool_input(w->model_pool_p);
+      int s;
+
+      if (!in)
+        {
+          fprintf(stderr, "pde_compute_wind: unable to allocate model input buffer\n");
+          exit(1);
+        }
+
+      for (j = 0; j < w->ntheta; ++j)
+        {
+          latitude = w->lat_eq + M_PI / 2.0 - pde_theta(j, w);
+
+          in[j].theta = M_PI / 2.0 - latitude;
+          in[j].phi = w->longitude;
+          in[j].t = w->t;
+          in[j].alt_min = w->rmin * 1.0e-3 - R_EARTH_KM;
+          in[j].alt_step = w->dr * 1.0e-3;
+          in[j].nalt = w->nr;
+        }
+
+      s = model_pool_run(pde_wind_column, w->hwm_workspace_p, w->ntheta,
+                         sizeof(pde_wind_input), stride * sizeof(double),
+                         w->model_pool_p);
+      if (s)
+        {
+          fprintf(stderr, "pde_compute_wind: hwm_call failed for some columns\n");
+          exit(1);
+        }
+
+      out = model_pool_output(w->model_pool_p);
+    }
 
   for (j = 0; j < w->ntheta; ++j)
     {
+      double *merid = w->merid;
+      double *zonal = w->zonal;
+
       latitude = w->lat_eq + M_PI / 2.0 - pde_theta(j, w);
 
-      n = hwm_call(M_PI / 2.0 - latitude,
-                   w->longitude,
-                   w->t,
-                   w->rmin * 1.0e-3 - R_EARTH_KM,
-                   w->dr * 1.0e-3,
-                   w->nr,
-                   w->merid,
-                   w->zonal,
-                   w->hwm_workspace_p);
-      if (n != w->nr)
+      if (out)
         {
-          fprintf(stderr, "hwm_call only computed %zu conductivities (nr = %zu)\n",
-                  n, w->nr);
-          exit(1);
+          merid = out + stride * j;
+          zonal = merid + w->nr + 1;
+        }
+      else
+        {
+          n = hwm_call(M_PI / 2.0 - latitude,
+                       w->longitude,
+                       w->t,
+                       w->rmin * 1.0e-3 - R_EARTH_KM,
+                       w->dr * 1.0e-3,
+                       w->nr,
+                       merid,
+                       zonal,
+                       w->hwm_workspace_p);
+          if (n != w->nr)
+            {
+              fprintf(stderr, "hwm_call only computed %zu conductivities (nr = %zu)\n",
+                      n, w->nr);
+              exit(1);
+            }
         }
 
       /*
@@ -749,8 +938,8 @@ pde_compute_wind(pde_workspace *w)
       for (i = 0; i < w->nr; ++i)
         {
           size_t k = PDE_IDX(i, j, w);
-          double u_phi = w->zonal[i];
-          double u_theta = -w->merid[i];
+          double u_phi = zonal[i];
+          double u_theta = -merid[i];
 
           w->zwind[k] = u_phi * cos(w->eej_angle) +
                         u_theta * sin(w->eej_angle);
@@ -779,6 +968,76 @@ pde_compute_wind(pde_workspace *w)
 #endif /* PDE_SYMMETRIC_WINDS */
 } /* pde_compute_wind() */
 
+/*
+pde_mageq_table()
+  Read the dip equator lookup table from params->mageq_table_file, or
+compute it and save it there if the file does not exist or does not
+cover the time window [params->mageq_tmin,params->mageq_tmax]
+
+Return: pointer to table, or NULL on error
+
+Notes:
+1) The table is computed at the radius used in pde_initialize() and
+sigma_calc(), with one time point per month
+*/
+
+static mageq_table *
+pde_mageq_table(const pde_parameters *params, pde_workspace *w)
+{
+  const double r = 6371.2 + 108.0;
+  mageq_table *tab;
+  size_t nt;
+
+  tab = mageq_table_read(params->mageq_table_file);
+  if (tab)
+    {
+      if (mageq_table_covers(r, params->mageq_tmin, params->mageq_tmax, tab))
+        {
+          fprintf(stderr, "pde_mageq_table: using dip equator table %s\n",
+                  params->mageq_table_file);
+          return tab;
+        }
+
+      mageq_table_free(tab);
+    }
+
+  nt = (size_t) ceil(12.0 * (params->mageq_tmax - params->mageq_tmin)) + 1;
+  tab = mageq_table_alloc(PDE_MAGEQ_NLON, r, r, 1,
+                          params->mageq_tmin, params->mageq_tmax, GSL_MAX(nt, 2));
+  if (!tab)
+    return 0;
+
+  mageq_table_build(tab, w->mageq_workspace_p);
+
+  fprintf(stderr, "pde_mageq_table: writing dip equator table %s\n",
+          params->mageq_table_file);
+  mageq_table_write(params->mageq_table_file, tab);
+
+  return tab;
+} /* pde_mageq_table() */
+
+/*
+pde_wind_column()
+  Model server function: compute HWM wind profile for one
+pde_wind_input record; output is the meridional and zonal winds,
+each of length nalt + 1
+*/
+
+static int
+pde_wind_column(const void *in, void *out, void *params)
+{
+  const pde_wind_input *p = (const pde_wind_input *) in;
+  hwm_workspace *hwm_p = (hwm_workspace *) params;
+  double *merid = (double *) out;
+  double *zonal = merid + p->nalt + 1;
+  size_t n;
+
+  n = hwm_call(p->theta, p->phi, p->t, p->alt_min, p->alt_step, p->nalt,
+               merid, zonal, hwm_p);
+
+  return (n == p->nalt) ? 0 : -1;
+} /* pde_wind_column() */
+
 /*
 pde_scales()
   Compute scaling factors for non-dimensionalization of PDE equation
@@ -819,14 +1078,15 @@ pde_scales(sigma_workspace *sigma_p, pde_workspace *w)
   m = gsl_matrix_view_array((double *) w->vwind, w->nr, w->ntheta);
   w->U_s = GSL_MAX(w->U_s, gsl_matrix_max(&m.matrix));
 
+  /* all 9 tensor components are stored contiguously */
+  m = gsl_matrix_view_array(w->sigma[0], 9 * w->nr, w->ntheta);
+  gsl_matrix_scale(&m.matrix, 1.0 / w->sigma_s);
+
   for (i = 0; i < w->nr; ++i)
     {
       for (j = 0; j < w->ntheta; ++j)
         {
           size_t k = PDE_IDX(i, j, w);
-          gsl_matrix *sig = w->sigma[k];
-
-          gsl_matrix_scale(sig, 1.0 / w->sigma_s);
 
           w->Br[k] /= w->B_s;
           w->Bt[k] /= w->B_s;
@@ -862,7 +1122,14 @@ pde_scales(sigma_workspace *sigma_p, pde_workspace *w)
 
 /*
 pde_coefficients()
-  Compute coefficients of PDE: f1-f6
+  Compute coefficients of PDE operator: f1-f5
+
+Notes:
+1) These depend only on the conductivity tensor; the rhs
+coefficient f6 is computed separately in pde_rhs()
+
+2) The derivatives of alpha are saved in w->dadr and w->dadt
+for use by pde_rhs()
 */
 
 static int
@@ -872,8 +1139,12 @@ pde_coefficients(pde_workspace *w)
   size_t i, j;
   double dr = pde_dr(w);
   double dtheta = pde_dtheta(w);
+  const double *sig_rr = w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_R)];
+  const double *sig_rt = w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_THETA)];
+  const double *sig_tr = w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_R)];
+  const double *sig_tt = w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_THETA)];
 
-  /* compute parameters alpha, beta, gamma */
+  /* compute parameter alpha */
   for (i = 0; i < w->nr; ++i)
     {
       double r = pde_r(i, w);
@@ -882,46 +1153,15 @@ pde_coefficients(pde_workspace *w)
         {
           size_t k = PDE_IDX(i, j, w);
           double sint = pde_sint(j, w);
-          gsl_matrix *s = w->sigma[k];
-          double s_rr = gsl_matrix_get(s, IDX_R, IDX_R);
-          double s_rt = gsl_matrix_get(s, IDX_R, IDX_THETA);
-          double s_tr = gsl_matrix_get(s, IDX_THETA, IDX_R);
-          double s_tt = gsl_matrix_get(s, IDX_THETA, IDX_THETA);
-          double s_rp = gsl_matrix_get(s, IDX_R, IDX_PHI);
-          double s_tp = gsl_matrix_get(s, IDX_THETA, IDX_PHI);
-          double sUBr, sUBt; /* [sigma U x B]_r, [sigma U x B]_t */
+          double s_rr = sig_rr[k];
+          double s_rt = sig_rt[k];
+          double s_tr = sig_tr[k];
+          double s_tt = sig_tt[k];
 
           w->alpha[k] = r * sint * (s_rr * s_tt - s_tr * s_rt);
 
-          /* E_phi may be 0 here if we are computing wind effects */
-          w->beta[k] = r * sint * (s_tr * s_rp - s_rr * s_tp) * E_phi(i, j, w);
-          w->gamma[k] = r * sint * (s_tt * s_rp - s_rt * s_tp) * E_phi(i, j, w);
-
-          /* account for wind terms */
-          if (w->compute_winds)
-            {
-              /* [sigma U x B]_r */
-              sUBr = s_rr * (w->mwind[k] * w->Bp[k] -
-                             w->zwind[k] * w->Bt[k]) +
-                     s_rt * (w->zwind[k] * w->Br[k] -
-                             w->vwind[k] * w->Bp[k]) +
-                     s_rp * (w->vwind[k] * w->Bt[k] -
-                             w->mwind[k] * w->Br[k]);
-              /* [sigma U x B]_t */
-              sUBt = s_tr * (w->mwind[k] * w->Bp[k] -
-                             w->zwind[k] * w->Bt[k]) +
-                     s_tt * (w->zwind[k] * w->Br[k] -
-                             w->vwind[k] * w->Bp[k]) +
-                     s_tp * (w->vwind[k] * w->Bt[k] -
-                             w->mwind[k] * w->Br[k]);
-
-              w->beta[k] += r * sint * (s_tr * sUBr - s_rr * sUBt);
-              w->gamma[k] += r * sint * (s_tt * sUBr - s_rt * sUBt);
-            }
-
           /* for low altitudes < 90km the conductivity could be 0 */
-          if (!gsl_finite(w->alpha[k]) || !gsl_finite(w->beta[k]) ||
-              !gsl_finite(w->gamma[k]))
+          if (!gsl_finite(w->alpha[k]))
             return GSL_FAILURE;
 
 #if 0
@@ -948,13 +1188,12 @@ pde_coefficients(pde_workspace *w)
       for (j = 0; j < w->ntheta; ++j)
         {
           size_t k = PDE_IDX(i, j, w);
-          gsl_matrix *s = w->sigma[k];
-          double s_rr = gsl_matrix_get(s, IDX_R, IDX_R);
-          double s_rt = gsl_matrix_get(s, IDX_R, IDX_THETA);
-          double s_tr = gsl_matrix_get(s, IDX_THETA, IDX_R);
-          double s_tt = gsl_matrix_get(s, IDX_THETA, IDX_THETA);
-          double dr4, dr5, dr6; /* d/dr terms in f4, f5, f6 */
-          double dt4, dt5, dt6; /* d/dtheta terms in f4, f5, f6 */
+          double s_rr = sig_rr[k];
+          double s_rt = sig_rt[k];
+          double s_tr = sig_tr[k];
+          double s_tt = sig_tt[k];
+          double dr4, dr5; /* d/dr terms in f4, f5 */
+          double dt4, dt5; /* d/dtheta terms in f4, f5 */
           double dadr, dadt; /* d/dr alpha and d/dt alpha */
 
           w->f1[k] = w->alpha[k] * r * s_rr;
@@ -969,14 +1208,12 @@ pde_coefficients(pde_workspace *w)
                                  w->alpha[k]);
 
               dr4 = 1.0 / dr *
-                    (gsl_matrix_get(w->sigma[PDE_IDX(i + 1, j, w)], IDX_THETA, IDX_R) / (r + dr) -
+                    (sig_tr[PDE_IDX(i + 1, j, w)] / (r + dr) -
                      s_tr / r);
 
               dr5 = 1.0 / dr *
-                    (gsl_matrix_get(w->sigma[PDE_IDX(i + 1, j, w)], IDX_R, IDX_R) -
+                    (sig_rr[PDE_IDX(i + 1, j, w)] -
                      s_rr);
-
-              dr6 = 1.0 / dr * (w->beta[PDE_IDX(i + 1, j, w)] - w->beta[k]);
             }
           else if (i == w->nr - 1)
             {
@@ -987,14 +1224,11 @@ pde_coefficients(pde_workspace *w)
 
               dr4 = 1.0 / dr *
                     (s_tr / r -
-                     gsl_matrix_get(w->sigma[PDE_IDX(i - 1, j, w)], IDX_THETA, IDX_R) / (r - dr));
+                     sig_tr[PDE_IDX(i - 1, j, w)] / (r - dr));
 
               dr5 = 1.0 / dr *
                     (s_rr -
-                     gsl_matrix_get(w->sigma[PDE_IDX(i - 1, j, w)], IDX_R, IDX_R));
-
-              dr6 = 1.0 / dr * (w->beta[k] -
-                                w->beta[PDE_IDX(i - 1, j, w)]);
+                     sig_rr[PDE_IDX(i - 1, j, w)]);
             }
           else
             {
@@ -1004,15 +1238,12 @@ pde_coefficients(pde_workspace *w)
                                  w->alpha[PDE_IDX(i - 1, j, w)]);
 
               dr4 = 0.5 / dr *
-                    (gsl_matrix_get(w->sigma[PDE_IDX(i + 1, j, w)], IDX_THETA, IDX_R) / (r + dr) -
-                     gsl_matrix_get(w->sigma[PDE_IDX(i - 1, j, w)], IDX_THETA, IDX_R) / (r - dr));
+                    (sig_tr[PDE_IDX(i + 1, j, w)] / (r + dr) -
+                     sig_tr[PDE_IDX(i - 1, j, w)] / (r - dr));
 
               dr5 = 0.5 / dr *
-                    (gsl_matrix_get(w->sigma[PDE_IDX(i + 1, j, w)], IDX_R, IDX_R) -
-                     gsl_matrix_get(w->sigma[PDE_IDX(i - 1, j, w)], IDX_R, IDX_R));
-
-              dr6 = 0.5 / dr * (w->beta[PDE_IDX(i + 1, j, w)] -
-                                w->beta[PDE_IDX(i - 1, j, w)]);
+                    (sig_rr[PDE_IDX(i + 1, j, w)] -
+                     sig_rr[PDE_IDX(i - 1, j, w)]);
             }
 
           if (j == 0)
@@ -1023,15 +1254,12 @@ pde_coefficients(pde_workspace *w)
                                      w->alpha[k]);
 
               dt4 = 1.0 / dtheta *
-                    (gsl_matrix_get(w->sigma[PDE_IDX(i, j + 1, w)], IDX_THETA, IDX_THETA) / (r + dr) -
+                    (sig_tt[PDE_IDX(i, j + 1, w)] / (r + dr) -
                      s_tt / r);
 
               dt5 = 1.0 / dtheta *
-                    (gsl_matrix_get(w->sigma[PDE_IDX(i, j + 1, w)], IDX_R, IDX_THETA) -
+                    (sig_rt[PDE_IDX(i, j + 1, w)] -
                      s_rt);
-
-              dt6 = 1.0 / dtheta * (w->gamma[PDE_IDX(i, j + 1, w)] -
-                                    w->gamma[k]);
             }
           else if (j == w->ntheta - 1)
             {
@@ -1042,14 +1270,11 @@ pde_coefficients(pde_workspace *w)
 
               dt4 = 1.0 / dtheta *
                     (s_tt / r -
-                     gsl_matrix_get(w->sigma[PDE_IDX(i, j - 1, w)], IDX_THETA, IDX_THETA) / (r - dr));
+                     sig_tt[PDE_IDX(i, j - 1, w)] / (r - dr));
 
               dt5 = 1.0 / dtheta *
                     (s_rt -
-                     gsl_matrix_get(w->sigma[PDE_IDX(i, j - 1, w)], IDX_R, IDX_THETA));
-
-              dt6 = 1.0 / dtheta * (w->gamma[k] -
-                                    w->gamma[PDE_IDX(i, j - 1, w)]);
+                     sig_rt[PDE_IDX(i, j - 1, w)]);
             }
           else
             {
@@ -1059,29 +1284,25 @@ pde_coefficients(pde_workspace *w)
                                      w->alpha[PDE_IDX(i, j - 1, w)]);
 
               dt4 = 0.5 / dtheta *
-                    (gsl_matrix_get(w->sigma[PDE_IDX(i, j + 1, w)], IDX_THETA, IDX_THETA) / (r + dr) -
-                     gsl_matrix_get(w->sigma[PDE_IDX(i, j - 1, w)], IDX_THETA, IDX_THETA) / (r - dr));
+                    (sig_tt[PDE_IDX(i, j + 1, w)] / (r + dr) -
+                     sig_tt[PDE_IDX(i, j - 1, w)] / (r - dr));
 
               dt5 = 0.5 / dtheta *
-                    (gsl_matrix_get(w->sigma[PDE_IDX(i, j + 1, w)], IDX_R, IDX_THETA) -
-                     gsl_matrix_get(w->sigma[PDE_IDX(i, j - 1, w)], IDX_R, IDX_THETA));
-
-              dt6 = 0.5 / dtheta *
-                    (w->gamma[PDE_IDX(i, j + 1, w)] -
-                     w->gamma[PDE_IDX(i, j - 1, w)]);
+                    (sig_rt[PDE_IDX(i, j + 1, w)] -
+                     sig_rt[PDE_IDX(i, j - 1, w)]);
             }
 
           w->f4[k] = w->alpha[k] * (s_tr / r + r * dr4 + dt4) -
                      s_tr * dadr - s_tt / r * dadt;
           w->f5[k] = w->alpha[k] * (s_rr + r * dr5 + dt5) -
                      r * s_rr * dadr - s_rt * dadt;
-          w->f6[k] = w->alpha[k] * (w->beta[k] + r * dr6 + dt6) -
-                     r * w->beta[k] * dadr -
-                     w->gamma[k] * dadt;
+
+          w->dadr[k] = dadr;
+          w->dadt[k] = dadt;
 
           if (!gsl_finite(w->f1[k]) || !gsl_finite(w->f2[k]) ||
               !gsl_finite(w->f3[k]) || !gsl_finite(w->f4[k]) ||
-              !gsl_finite(w->f5[k]) || !gsl_finite(w->f6[k]))
+              !gsl_finite(w->f5[k]))
             return GSL_FAILURE;
 
 #if 0
@@ -1117,9 +1338,124 @@ pde_coefficients(pde_workspace *w)
   return s;
 } /* pde_coefficients() */
 
+/*
+pde_rhs()
+  Compute the E_0 and wind dependent parameters beta, gamma
+and PDE coefficient f6, and construct the rhs vector b = -f6
+
+Inputs: compute_winds - use winds in PDE solution? (0/1)
+        E_phi0        - eastward electric field in V/m
+        b             - (output) rhs vector, length nr * ntheta
+        w             - pde workspace
+
+Notes:
+1) pde_coefficients() must be called prior to this function
+
+2) w->compute_winds and w->E_phi0 are set on output, so that
+w->beta and w->gamma are consistent with pde_calc_J()
+*/
+
+static int
+pde_rhs(int compute_winds, double E_phi0, gsl_vector *b, pde_workspace *w)
+{
+  int s = 0;
+  size_t i, j;
+  double dr = pde_dr(w);
+  double dtheta = pde_dtheta(w);
+
+  w->compute_winds = compute_winds;
+  w->E_phi0 = E_phi0;
+
+  /* compute parameters beta, gamma */
+  for (i = 0; i < w->nr; ++i)
+    {
+      double r = pde_r(i, w);
+
+      for (j = 0; j < w->ntheta; ++j)
+        {
+          size_t k = PDE_IDX(i, j, w);
+          double sint = pde_sint(j, w);
+          double s_rr = w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_R)][k];
+          double s_rt = w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_THETA)][k];
+          double s_tr = w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_R)][k];
+          double s_tt = w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_THETA)][k];
+          double s_rp = w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_PHI)][k];
+          double s_tp = w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_PHI)][k];
+          double sUBr, sUBt; /* [sigma U x B]_r, [sigma U x B]_t */
+
+          /* E_phi may be 0 here if we are computing wind effects */
+          w->beta[k] = r * sint * (s_tr * s_rp - s_rr * s_tp) * E_phi(i, j, w);
+          w->gamma[k] = r * sint * (s_tt * s_rp - s_rt * s_tp) * E_phi(i, j, w);
+
+          /* account for wind terms */
+          if (w->compute_winds)
+            {
+              /* [sigma U x B]_r */
+              sUBr = s_rr * (w->mwind[k] * w->Bp[k] -
+                             w->zwind[k] * w->Bt[k]) +
+                     s_rt * (w->zwind[k] * w->Br[k] -
+                             w->vwind[k] * w->Bp[k]) +
+                     s_rp * (w->vwind[k] * w->Bt[k] -
+                             w->mwind[k] * w->Br[k]);
+              /* [sigma U x B]_t */
+              sUBt = s_tr * (w->mwind[k] * w->Bp[k] -
+                             w->zwind[k] * w->Bt[k]) +
+                     s_tt * (w->zwind[k] * w->Br[k] -
+                             w->vwind[k] * w->Bp[k]) +
+                     s_tp * (w->vwind[k] * w->Bt[k] -
+                             w->mwind[k] * w->Br[k]);
+
+              w->beta[k] += r * sint * (s_tr * sUBr - s_rr * sUBt);
+              w->gamma[k] += r * sint * (s_tt * sUBr - s_rt * sUBt);
+            }
+
+          if (!gsl_finite(w->beta[k]) || !gsl_finite(w->gamma[k]))
+            return GSL_FAILURE;
+        }
+    }
+
+  /* compute PDE coefficient f6 */
+  for (i = 0; i < w->nr; ++i)
+    {
+      double r = pde_r(i, w);
+
+      for (j = 0; j < w->ntheta; ++j)
+        {
+          size_t k = PDE_IDX(i, j, w);
+          double dr6, dt6; /* d/dr and d/dtheta terms in f6 */
+
+          if (i == 0)
+            dr6 = 1.0 / dr * (w->beta[PDE_IDX(i + 1, j, w)] - w->beta[k]);
+          else if (i == w->nr - 1)
+            dr6 = 1.0 / dr * (w->beta[k] - w->beta[PDE_IDX(i - 1, j, w)]);
+          else
+            dr6 = 0.5 / dr * (w->beta[PDE_IDX(i + 1, j, w)] - w->beta[PDE_IDX(i - 1, j, w)]);
+
+          if (j == 0)
+            dt6 = 1.0 / dtheta * (w->gamma[PDE_IDX(i, j + 1, w)] - w->gamma[k]);
+          else if (j == w->ntheta - 1)
+            dt6 = 1.0 / dtheta * (w->gamma[k] - w->gamma[PDE_IDX(i, j - 1, w)]);
+          else
+            dt6 = 0.5 / dtheta * (w->gamma[PDE_IDX(i, j + 1, w)] - w->gamma[PDE_IDX(i, j - 1, w)]);
+
+          w->f6[k] = w->alpha[k] * (w->beta[k] + r * dr6 + dt6) -
+                     r * w->beta[k] * w->dadr[k] -
+                     w->gamma[k] * w->dadt[k];
+
+          if (!gsl_finite(w->f6[k]))
+            return GSL_FAILURE;
+
+          gsl_vector_set(b, k, -w->f6[k]);
+        }
+    }
+
+  return s;
+} /* pde_rhs() */
+
 /*
 pde_discretize()
-  Construct difference matrix w->DC
+  Construct difference matrix w->DC from the PDE operator
+coefficients f1-f5
 
 DC[0][k] = coefficient of psi_{i-1,j-1}
 DC[1][k] = coefficient of psi_{i,j-1}
@@ -1152,7 +1488,6 @@ pde_discretize(pde_workspace *w)
           double f3 = w->f3[k];
           double f4 = w->f4[k];
           double f5 = w->f5[k];
-          double f6 = w->f6[k];
 
 #if 0
           /* this factor will make the PDE coeffs equal to the old method */
@@ -1163,10 +1498,9 @@ pde_discretize(pde_workspace *w)
             f3 /= fac;
             f4 /= fac;
             f5 /= fac;
-            f6 /= fac;
             if (!gsl_finite(f1) || !gsl_finite(f2) ||
                 !gsl_finite(f3) || !gsl_finite(f4) ||
-                !gsl_finite(f5) || !gsl_finite(f6))
+                !gsl_finite(f5))
               return GSL_FAILURE;
           }
 #endif
@@ -1181,10 +1515,8 @@ pde_discretize(pde_workspace *w)
           w->DC[7][k] = f2 / dtheta_sq + f4 / 2.0 / dtheta;  
           w->DC[8][k] = f3 / 4.0 / dr / dtheta;  
 
-          gsl_vector_set(w->b, k, -f6);
-
 #if 0
-          printf("%f %f %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e\n",
+          printf("%f %f %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e %.12e\n",
                  90.0 - pde_theta(j,w)*180/M_PI,
                  pde_r_km(i,w) - R_EARTH_KM,
                  w->alpha[k],
@@ -1193,7 +1525,6 @@ pde_discretize(pde_workspace *w)
                  f3,
                  f4,
                  f5,
-                 f6,
                  w->DC[0][k],
                  w->DC[1][k],
                  w->DC[2][k],
@@ -1214,97 +1545,134 @@ pde_discretize(pde_workspace *w)
 } /* pde_discretize() */
 
 /*
-pde_matrix()
-  Construct PDE matrix and RHS and store in w->S and w->b
+pde_matrix_alloc()
+  Allocate the PDE matrix in compressed row format and compute its
+row pointers
+
+Notes:
+1) The sparsity pattern depends only on the grid size: row k = (i,j)
+couples to the points (i+di, j+dj), di,dj = -1,0,1, excluding r
+neighbors outside the grid (where psi = 0) and theta neighbors outside
+the grid (which are folded into the boundary row). Row lengths are
+therefore known in advance, and pde_matrix() can fill all rows in
+parallel without any insertion or sorting
 */
 
-static int
-pde_matrix(pde_workspace *w)
+static gsl_spmatrix *
+pde_matrix_alloc(const pde_workspace *w)
 {
-  int s = 0;
-  size_t i, j, k;
+  const size_t nrt = w->nr * w->ntheta;
+  gsl_spmatrix *S;
+  size_t *rowptr;
+  size_t i, j, nnz = 0;
 
-  gsl_spmatrix_set_zero(w->S);
+  rowptr = malloc((nrt + 1) * sizeof(size_t));
+  if (!rowptr)
+    return 0;
 
-  /*
-   * add matrix elements for all r grid points, but only interior
-   * theta grid points
-   */
   for (i = 0; i < w->nr; ++i)
     {
-      for (j = 1; j < w->ntheta - 1; ++j)
-        {
-          /* row index */
-          k = PDE_IDX(i, j, w);
-
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i, j - 1, w), w->DC[1][k]);
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i, j, w), w->DC[4][k]);
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i, j + 1, w), w->DC[7][k]);
+      size_t nrow = 1 + (i > 0) + (i < w->nr - 1);
 
-          /*
-           * For the r boundaries, normally we would add nothing to the
-           * matrix and instead add terms to the RHS vector of the form:
-           *
-           * DC * psi_{rmin} or DC * psi_{rmax}.
-           *
-           * But psi is 0 on the upper and lower boundaries so this is
-           * unnecessary
-           */
-          if (i > 0)
-            {
-              gsl_spmatrix_set(w->S, k, PDE_IDX(i - 1, j - 1, w), w->DC[0][k]);
-              gsl_spmatrix_set(w->S, k, PDE_IDX(i - 1, j, w), w->DC[3][k]);
-              gsl_spmatrix_set(w->S, k, PDE_IDX(i - 1, j + 1, w), w->DC[6][k]);
-            }
+      for (j = 0; j < w->ntheta; ++j)
+        {
+          size_t ncol = 1 + (j > 0) + (j < w->ntheta - 1);
 
-          if (i < w->nr - 1)
-            {
-              gsl_spmatrix_set(w->S, k, PDE_IDX(i + 1, j - 1, w), w->DC[2][k]);
-              gsl_spmatrix_set(w->S, k, PDE_IDX(i + 1, j, w), w->DC[5][k]);
-              gsl_spmatrix_set(w->S, k, PDE_IDX(i + 1, j + 1, w), w->DC[8][k]);
-            }
+          rowptr[PDE_IDX(i, j, w)] = nnz;
+          nnz += nrow * ncol;
         }
     }
 
-  /* matrix elements for theta boundaries */
-  for (i = 0; i < w->nr; ++i)
+  rowptr[nrt] = nnz;
+
+  S = gsl_spmatrix_alloc_nzmax(nrt, nrt, nnz, GSL_SPMATRIX_CRS);
+  if (S)
     {
-      /* northern boundary */
-      j = 0;
-      k = PDE_IDX(i, j, w);
+      memcpy(S->p, rowptr, (nrt + 1) * sizeof(size_t));
+      S->nz = nnz;
+    }
 
-      gsl_spmatrix_set(w->S, k, PDE_IDX(i, j, w), w->DC[1][k] + w->DC[4][k]);
-      gsl_spmatrix_set(w->S, k, PDE_IDX(i, j + 1, w), w->DC[7][k]);
+  free(rowptr);
 
-      if (i > 0)
-        {
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i - 1, j, w), w->DC[0][k] + w->DC[3][k]);
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i - 1, j + 1, w), w->DC[6][k]);
-        }
+  return S;
+} /* pde_matrix_alloc() */
 
-      if (i < w->nr - 1)
-        {
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i + 1, j, w), w->DC[2][k] + w->DC[5][k]);
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i + 1, j + 1, w), w->DC[8][k]);
-        }
+/*
+pde_matrix()
+  Construct PDE matrix and store in w->S
+
+Notes:
+1) Column indices and values are written directly into the
+compressed row arrays of w->S, at the row offsets computed by
+pde_matrix_alloc(); rows are independent and are filled in parallel
 
-      /* southern boundary */
-      j = w->ntheta - 1;
-      k = PDE_IDX(i, j, w);
+2) The 9-point stencil coefficient for neighbor (i+di, j+dj)
+is DC[3*(dj+1) + (di+1)][k]
 
-      gsl_spmatrix_set(w->S, k, PDE_IDX(i, j - 1, w), w->DC[1][k]);
-      gsl_spmatrix_set(w->S, k, PDE_IDX(i, j, w), w->DC[4][k] + w->DC[7][k]);
+3) For the r boundaries, normally we would add nothing to the
+matrix and instead add terms to the RHS vector of the form
+DC * psi_{rmin} or DC * psi_{rmax}. But psi is 0 on the upper
+and lower boundaries so this is unnecessary
 
-      if (i > 0)
-        {
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i - 1, j - 1, w), w->DC[0][k]);
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i - 1, j, w), w->DC[3][k] + w->DC[6][k]);
-        }
+4) On the theta boundaries, the coefficients of the missing
+theta neighbors are added to those of the boundary point itself
+*/
+
+static int
+pde_matrix(pde_workspace *w)
+{
+  int s = 0;
+  const int nr = (int) w->nr;
+  const int ntheta = (int) w->ntheta;
+  gsl_spmatrix *S = w->S;
+  int i;
 
-      if (i < w->nr - 1)
+#pragma omp parallel for private(i)
+  for (i = 0; i < nr; ++i)
+    {
+      int j;
+
+      for (j = 0; j < ntheta; ++j)
         {
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i + 1, j - 1, w), w->DC[2][k]);
-          gsl_spmatrix_set(w->S, k, PDE_IDX(i + 1, j, w), w->DC[5][k] + w->DC[8][k]);
+          const size_t k = PDE_IDX(i, j, w);
+          size_t *col = S->i + S->p[k];
+          double *val = S->data + S->p[k];
+          double c[9];
+          int di, dj, idx;
+
+          for (idx = 0; idx < 9; ++idx)
+            c[idx] = w->DC[idx][k];
+
+          if (j == 0)
+            {
+              /* northern boundary */
+              c[3] += c[0];
+              c[4] += c[1];
+              c[5] += c[2];
+            }
+          else if (j == ntheta - 1)
+            {
+              /* southern boundary */
+              c[3] += c[6];
+              c[4] += c[7];
+              c[5] += c[8];
+            }
+
+          /* columns are generated in increasing order */
+          for (di = -1; di <= 1; ++di)
+            {
+              if (i + di < 0 || i + di >= nr)
+                continue;
+
+              for (dj = -1; dj <= 1; ++dj)
+                {
+                  if (j + dj < 0 || j + dj >= ntheta)
+                    continue;
+
+                  *col++ = PDE_IDX(i + di, j + dj, w);
+                  *val++ = c[3 * (dj + 1) + (di + 1)];
+                }
+            }
         }
     }
 
@@ -1313,59 +1681,60 @@ pde_matrix(pde_workspace *w)
 
 /*
 pde_compute_psi()
-  Solve the equation A psi = b for psi
+  Solve the equations A psi_k = b_k for psi_k, k = 0,...,nrhs-1,
+sharing a single factorization (or preconditioner) of A
+
+Inputs: nrhs - number of right hand sides, <= PDE_NRHS
+        w    - workspace
 
-Notes: on output, w->residual is set to the residual ||A psi - b||
+Notes:
+1) Right hand sides are stored in the rows of w->B, and the
+solutions are stored in the corresponding rows of w->PSI on output
+
+2) on output, w->residual is set to the largest residual ||A psi_k - b_k||
+of the scaled system, and w->rrnorm to the largest relative residual
 */
 
 static int
-pde_compute_psi(pde_workspace *w)
+pde_compute_psi(const size_t nrhs, pde_workspace *w)
 {
   int s = 0;
-  double bscale;
 
 #ifdef PDE_CONSTRUCT_MATRIX
 
-  gsl_spmatrix_sp2d(w->A, w->S);
-  gsl_vector_memcpy(w->b_copy, w->b);
-
   {
+    gsl_vector_view b0 = gsl_matrix_row(w->B, 0);
+    gsl_vector_view psi0 = gsl_matrix_row(w->PSI, 0);
     gsl_permutation *p = gsl_permutation_alloc(w->b->size);
     int stat;
     double residual;
 
+    gsl_spmatrix_sp2d(w->A, w->S);
+    gsl_vector_memcpy(w->b_copy, &b0.vector);
+
     gsl_linalg_LU_decomp(w->A, p, &stat);
-    gsl_linalg_LU_solve(w->A, p, w->b_copy, w->psi);
+    gsl_linalg_LU_solve(w->A, p, w->b_copy, &psi0.vector);
 
     gsl_permutation_free(p);
 
     /* construct dense matrix again since it was destroyed */
     gsl_spmatrix_sp2d(w->A, w->S);
-    gsl_vector_memcpy(w->b_copy, w->b);
+    gsl_vector_memcpy(w->b_copy, &b0.vector);
 
-    gsl_blas_dgemv(CblasNoTrans, 1.0, w->A, w->psi, -1.0, w->b_copy);
+    gsl_blas_dgemv(CblasNoTrans, 1.0, w->A, &psi0.vector, -1.0, w->b_copy);
     residual = gsl_blas_dnrm2(w->b_copy);
     fprintf(stderr, "gsl residual = %.12e\n", residual);
-  }
 
-  if (w->b->size <= 5000)
-    {
-      print_octave(w->A, "A");
-      printv_octave(w->b, "b");
-      printv_octave(w->psi, "psigsl");
-    }
+    if (w->b->size <= 5000)
+      {
+        print_octave(w->A, "A");
+        printv_octave(&b0.vector, "b");
+        printv_octave(&psi0.vector, "psigsl");
+      }
+  }
 
 #endif
 
-  /*
-   * the RHS tends to have a much smaller order of magnitude than the
-   * matrix so scale it
-   */
-  bscale = gsl_vector_max(w->b);
-  gsl_vector_scale(w->b, 1.0 / bscale);
-
-#if 1
-
   /*
    * Sparse solvers which seem to work on this matrix equation:
    * preconditioned iterative: lis
@@ -1375,80 +1744,33 @@ pde_compute_psi(pde_workspace *w)
    * lis seems to work well with ILU precond and bicgstab/gmres method
    *
    * does NOT work: superlu
+   *
+   * The solver is selected at runtime with w->solver_params; use
+   * pde_bench to compare solvers on systems saved with params->system_file
    */
-#if PDE_SOLVER_LIS
-
-  {
-    lis_workspace *lis_p = lis_alloc(w->S->size1, w->S->size2);
-    const double tol = 1.0e-6;
-
-    s = lis_proc(w->S, w->b->data, tol, w->psi->data, lis_p);
-    w->residual = lis_p->rnorm;
-
-    mylis_free(lis_p);
-
-    printv_octave(w->psi, "psi_lis");
-
-    if (s)
-      fprintf(stderr, "pde_compute_psi: lis_proc failed: s = %d\n", s);
-  }
-
-#elif PDE_SOLVER_SUPERLU
-
-  {
-    slu_workspace *superlu_p = slu_alloc(w->S->size1, w->S->size2, 1);
-    gsl_spmatrix *C = gsl_spmatrix_compcol(w->S);
-
-    s = slu_proc(C, w->b->data, w->psi->data, superlu_p);
-    w->residual = superlu_p->rnorm;
-
-    slu_free(superlu_p);
-    gsl_spmatrix_free(C);
-
-    printv_octave(w->psi, "psi_superlu");
 
-    if (s)
-      fprintf(stderr, "pde_compute_psi: slu_proc failed: s = %d\n", s);
-  }
-
-#endif
-
-#else
+  if (w->system_file && !w->system_written)
+    {
+      /* rows of w->B are contiguous, i.e. nrhs vectors stored consecutively */
+      pde_debug(w, "pde_compute_psi: writing PDE system to %s\n", w->system_file);
+      pde_solver_write(w->system_file, w->S, nrhs, w->B->data);
+      w->system_written = 1;
+    }
 
   {
-    const double tol = 1.0e-1;
-    const size_t max_iter = 100;
-    const gsl_splinalg_itersolve_type *T = gsl_splinalg_itersolve_gmres;
-    gsl_splinalg_itersolve *work =
-      gsl_splinalg_itersolve_alloc(T, w->psi->size, 40);
-    size_t iter = 0;
-    int status;
-    double normb = gsl_blas_dnrm2(w->b);
-
-    /* initial guess psi = 0 */
-    gsl_vector_set_zero(w->psi);
-
-    do
-      {
-        status = gsl_splinalg_itersolve_iterate(w->S, w->b, tol,
-                                                w->psi, work);
+    pde_solver_stats stats;
 
-        w->residual = gsl_splinalg_itersolve_normr(work);
-        fprintf(stderr, "iter %zu residual = %.12e relerr = %.12e\n",
-                iter, w->residual, w->residual / normb);
+    s = pde_solver_proc(&(w->solver_params), w->S, nrhs, w->B->data,
+                        w->PSI->data, &stats);
 
-        if (status == GSL_SUCCESS)
-          fprintf(stderr, "Converged in %zu iterations\n", iter + 1);
-      }
-    while (status == GSL_CONTINUE && ++iter < max_iter);
+    w->residual = stats.rnorm;
+    w->rrnorm = stats.rrnorm;
 
-    printv_octave(w->psi, "psi_gsl");
+    pde_debug(w, "pde_compute_psi: %s: %zu iterations, %g seconds, relative residual = %.4e\n",
+              pde_solver_name(w->solver_params.type), stats.iter, stats.time,
+              stats.rrnorm);
   }
 
-#endif
-
-  gsl_vector_scale(w->psi, bscale);
-
 #if 0
   {
     size_t i, j;
@@ -1463,7 +1785,7 @@ pde_compute_psi(pde_workspace *w)
           {
             double r = pde_r(i, w);
             double theta = pde_theta(j, w);
-            double psi = gsl_vector_get(w->psi, PDE_IDX(i, j, w)) * w->psi_s;
+            double psi = gsl_matrix_get(w->PSI, 0, PDE_IDX(i, j, w)) * w->psi_s;
 
             fprintf(fp, "%e %e %e %e\n",
                    90.0-pde_theta(j, w)*180/M_PI,
@@ -1629,14 +1951,13 @@ pde_calc_J(pde_workspace *w)
       for (j = 0; j < w->ntheta; ++j)
         {
           size_t k = PDE_IDX(i, j, w);
-          gsl_matrix *s = w->sigma[k];
-          double s_rr = gsl_matrix_get(s, IDX_R, IDX_R);
-          double s_rt = gsl_matrix_get(s, IDX_R, IDX_THETA);
-          double s_tr = gsl_matrix_get(s, IDX_THETA, IDX_R);
-          double s_tt = gsl_matrix_get(s, IDX_THETA, IDX_THETA);
-          double s_pr = gsl_matrix_get(s, IDX_PHI, IDX_R);
-          double s_pt = gsl_matrix_get(s, IDX_PHI, IDX_THETA);
-          double s_pp = gsl_matrix_get(s, IDX_PHI, IDX_PHI);
+          double s_rr = w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_R)][k];
+          double s_rt = w->sigma[PDE_SIGMA_IDX(IDX_R, IDX_THETA)][k];
+          double s_tr = w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_R)][k];
+          double s_tt = w->sigma[PDE_SIGMA_IDX(IDX_THETA, IDX_THETA)][k];
+          double s_pr = w->sigma[PDE_SIGMA_IDX(IDX_PHI, IDX_R)][k];
+          double s_pt = w->sigma[PDE_SIGMA_IDX(IDX_PHI, IDX_THETA)][k];
+          double s_pp = w->sigma[PDE_SIGMA_IDX(IDX_PHI, IDX_PHI)][k];
 
           if (i == 0)
             {
@@ -16,6 +16,8 @@
 
 #include "hwm.h"
 #include "mageq.h"
+#include "model_pool.h"
+#include "pde_solver.h"
 
 #include "sigma.h"
 
@@ -32,6 +34,14 @@
 /* minimum conductivity allowed in SI units */
 #define PDE_MIN_CONDUCTIVITY (1.0e-10)
 
+/*
+ * dip equator lookup table: longitude resolution and maximum
+ * interpolation errors allowed for latitude and EEJ angle
+ */
+#define PDE_MAGEQ_NLON       720
+#define PDE_MAGEQ_TOL_LAT    (0.01 * M_PI / 180.0)
+#define PDE_MAGEQ_TOL_ANGLE  (0.1 * M_PI / 180.0)
+
 /*
  * define to taper sigma tensor to zero outside a window specified by
  * PDE_SIGMA_TAPER_RANGE
@@ -39,6 +49,9 @@
 #define PDE_SIGMA_TAPER
 #define PDE_SIGMA_TAPER_RANGE (10.0 * M_PI / 180.0)
 
+/* number of PDE right hand sides solved together (E_0 and winds) */
+#define PDE_NRHS             2
+
 /* theta range to use for height integrated current calculation */
 #define PDE_HI_THETA_MIN     (75.0 * M_PI / 180.0)
 #define PDE_HI_THETA_MAX     (105.0 * M_PI / 180.0)
@@ -74,6 +87,9 @@
 #define IDX_THETA            1
 #define IDX_PHI              2
 
+/* index of conductivity tensor component sigma_{ab} in w->sigma[] */
+#define PDE_SIGMA_IDX(a,b)   (3 * (a) + (b))
+
 typedef struct
 {
   size_t nr;         /* number of radial grid points */
@@ -83,6 +99,14 @@ typedef struct
   double theta_min;  /* minimum theta in radians */
   double theta_max;  /* maximum theta in radians */
   char *f107_file;   /* f10.7 data file */
+  char *sigma_cache_file; /* conductivity profile cache file, or NULL */
+  sigma_cache_parameters sigma_cache_params; /* conductivity cache parameters */
+  size_t model_nprocs; /* number of IRI/MSIS/HWM server processes, 0 for none */
+  char *mageq_table_file; /* dip equator lookup table file, or NULL */
+  double mageq_tmin;   /* start of lookup table time window (decimal year) */
+  double mageq_tmax;   /* end of lookup table time window (decimal year) */
+  pde_solver_parameters solver_params; /* sparse solver */
+  char *system_file;   /* file to save first PDE system to, or NULL */
 } pde_parameters;
 
 typedef struct
@@ -106,7 +130,12 @@ typedef struct
 
   double eej_angle;  /* angle EEJ makes with geographic eastward */
 
-  gsl_matrix **sigma;
+  /*
+   * conductivity tensor, stored as 9 component arrays of length
+   * nr*ntheta so that stencil loops read them with unit stride:
+   * sigma_{ab} at grid point k is sigma[PDE_SIGMA_IDX(a,b)][k]
+   */
+  double *sigma[9];
 
   double *zwind;    /* zonal wind (u_phi) */
   double *mwind;    /* meridional wind (u_theta) */
@@ -120,11 +149,13 @@ typedef struct
   double *Bp;       /* phi component of B in T */
   double *Bf;       /* total field intensity in T */
 
-  gsl_spmatrix *S; /* sparse pde matrix */
+  gsl_spmatrix *S; /* sparse pde matrix, compressed row format */
   gsl_matrix *A;   /* pde matrix */
   gsl_vector *b;   /* rhs vector */
   gsl_vector *b_copy; /* rhs vector */
   gsl_vector *psi; /* pde solution */
+  gsl_matrix *B;   /* rhs vectors, PDE_NRHS-by-nrt, one per row */
+  gsl_matrix *PSI; /* pde solutions for each row of B, PDE_NRHS-by-nrt */
   double residual; /* residual ||A*psi - b|| */
   double rrnorm;   /* relative residual ||b - A*psi|| / ||b|| */
 
@@ -140,6 +171,8 @@ typedef struct
   double *alpha;
   double *beta;
   double *gamma;
+  double *dadr;     /* d/dr alpha */
+  double *dadt;     /* d/dtheta alpha */
 
   /* pde coefficients */
   double *f1;
@@ -173,6 +206,12 @@ typedef struct
   mageq_workspace *mageq_workspace_p;
   msynth_workspace *msynth_workspace_p;
   sigma_workspace *sigma_workspace_p;
+  model_pool_workspace *model_pool_p; /* model server pool, or NULL */
+  mageq_table *mageq_table_p;         /* dip equator lookup table, or NULL */
+
+  pde_solver_parameters solver_params; /* sparse solver */
+  char *system_file;  /* file to save first PDE system to, or NULL */
+  int system_written; /* system_file has been written */
 } pde_workspace;
 
 #define PDE_IDX(i, j, w)     ((i) * (w)->ntheta + (j))
@@ -0,0 +1,348 @@
+/*
+ * pde_bench.c
+ *
+ * Benchmark sparse solvers and preconditioners on the EEJ PDE
+ * matrix equation.
+ *
+ * 1. Save representative PDE systems for several grid sizes:
+ *
+ *    pde_bench -D -t unix_time -l longitude -f f107_file \
+ *              -g 200x101 -g 400x201 -o prefix
+ *
+ *    writes prefix_200x101.dat, prefix_400x201.dat; systems can
+ *    also be saved by the main program with pde_system_file
+ *
+ * 2. Run each solver configuration on the saved systems:
+ *
+ *    pde_bench prefix_200x101.dat prefix_400x201.dat
+ *
+ * Each configuration runs in a separate child process, so its peak
+ * memory usage can be measured and a crashing solver does not stop
+ * the benchmark.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_spmatrix.h>
+
+#include <common/common.h>
+
+#include "pde.h"
+#include "pde_solver.h"
+
+#define PDE_BENCH_MAX_GRIDS     16
+
+typedef struct
+{
+  int type;            /* PDE_SOLVER_xxx */
+  const char *options; /* lis options */
+} pde_bench_config;
+
+/* solver/preconditioner combinations to compare */
+static const pde_bench_config bench_configs[] =
+{
+  { PDE_SOLVER_LIS, "-i fgmres -p ilut" },
+  { PDE_SOLVER_LIS, "-i fgmres -p ilu -ilu_fill 0" },
+  { PDE_SOLVER_LIS, "-i fgmres -p ilu -ilu_fill 1" },
+  { PDE_SOLVER_LIS, "-i fgmres -p ilu -ilu_fill 2" },
+  { PDE_SOLVER_LIS, "-i bicgstab -p ilut" },
+  { PDE_SOLVER_LIS, "-i bicgstab -p ilu -ilu_fill 1" },
+  { PDE_SOLVER_LIS, "-i fgmres -p saamg -saamg_unsym true" },
+  { PDE_SOLVER_LIS, "-i bicgstab -p saamg -saamg_unsym true" },
+  { PDE_SOLVER_SUPERLU, NULL },
+  { PDE_SOLVER_GMRES, NULL }
+};
+
+#define PDE_BENCH_NCONFIGS      (sizeof(bench_configs) / sizeof(pde_bench_config))
+
+/* result sent from child to parent */
+typedef struct
+{
+  int status;
+  pde_solver_stats stats;
+} pde_bench_result;
+
+static int
+dump_systems(const time_t t, const double longitude, char *f107_file,
+             const size_t ngrid, const size_t *nr, const size_t *ntheta,
+             const char *prefix)
+{
+  int s = 0;
+  size_t i;
+
+  for (i = 0; i < ngrid; ++i)
+    {
+      pde_parameters params;
+      pde_workspace *pde_p;
+      char filename[2048];
+      struct timeval tv0, tv1;
+
+      sprintf(filename, "%s_%zux%zu.dat", prefix, nr[i], ntheta[i]);
+
+      /* same domain as mag_alloc() */
+      memset(&params, 0, sizeof(params));
+      params.rmin = (R_EARTH_KM + 65.0) * 1.0e3;
+      params.rmax = (R_EARTH_KM + 500.0) * 1.0e3;
+      params.nr = nr[i];
+      params.theta_min = 65.0 * M_PI / 180.0;
+      params.theta_max = 115.0 * M_PI / 180.0;
+      params.ntheta = ntheta[i];
+      params.f107_file = f107_file;
+      params.solver_params = pde_solver_default_parameters();
+      params.system_file = filename;
+
+      fprintf(stderr, "dump_systems: computing PDE system on %zu-by-%zu grid...",
+              nr[i], ntheta[i]);
+      gettimeofday(&tv0, NULL);
+
+      pde_p = pde_alloc(&params);
+      if (!pde_p)
+        return -1;
+
+      s += pde_proc(t, longitude, pde_p);
+
+      pde_free(pde_p);
+
+      gettimeofday(&tv1, NULL);
+      fprintf(stderr, "done (%g seconds, written to %s)\n",
+              time_diff(tv0, tv1), filename);
+    }
+
+  return s;
+}
+
+/* run one solver configuration in a child process */
+static int
+run_config(const pde_bench_config *config, const gsl_spmatrix *S,
+           const size_t nrhs, const double *B, pde_bench_result *result,
+           long *maxrss)
+{
+  int fd[2];
+  pid_t pid;
+  int wstatus;
+  struct rusage usage;
+
+  if (pipe(fd) != 0)
+    return -1;
+
+  fflush(NULL);
+
+  pid = fork();
+  if (pid == 0)
+    {
+      pde_solver_parameters params = pde_solver_default_parameters();
+      double *X = malloc(S->size1 * nrhs * sizeof(double));
+      pde_bench_result res;
+
+      close(fd[0]);
+
+      params.type = config->type;
+      params.lis_options = config->options;
+
+      res.status = pde_solver_proc(&params, S, nrhs, B, X, &(res.stats));
+
+      if (write(fd[1], &res, sizeof(res)) != (ssize_t) sizeof(res))
+        _exit(1);
+
+      _exit(0);
+    }
+  else if (pid < 0)
+    {
+      fprintf(stderr, "run_config: fork failed: %s\n", strerror(errno));
+      close(fd[0]);
+      close(fd[1]);
+      return -1;
+    }
+
+  close(fd[1]);
+
+  if (read(fd[0], result, sizeof(*result)) != (ssize_t) sizeof(*result))
+    result->status = -1; /* solver crashed */
+
+  close(fd[0]);
+
+  wait4(pid, &wstatus, 0, &usage);
+  *maxrss = usage.ru_maxrss;
+
+  return 0;
+}
+
+static int
+bench_system(const char *filename)
+{
+  gsl_spmatrix *S;
+  double *B;
+  size_t nrhs, i;
+  int s;
+
+  s = pde_solver_read(filename, &S, &nrhs, &B);
+  if (s)
+    return s;
+
+  fprintf(stderr, "bench_system: %s: n = %zu, nnz = %zu, nrhs = %zu\n",
+          filename, S->size1, S->nz, nrhs);
+
+  for (i = 0; i < PDE_BENCH_NCONFIGS; ++i)
+    {
+      const pde_bench_config *config = &bench_configs[i];
+      pde_bench_result result;
+      long maxrss;
+
+      s = run_config(config, S, nrhs, B, &result, &maxrss);
+      if (s)
+        break;
+
+      printf("%s %zu %zu %s \"%s\" %d %.4f %.4f %zu %.1f %.4e %.4e\n",
+             filename,
+             S->size1,
+             S->nz,
+             pde_solver_name(config->type),
+             config->options ? config->options : "",
+             result.status,
+             result.stats.time,
+             result.stats.ptime,
+             result.stats.iter,
+             maxrss / 1024.0,
+             result.stats.rnorm,
+             result.stats.rrnorm);
+      fflush(stdout);
+    }
+
+  gsl_spmatrix_free(S);
+  free(B);
+
+  return s;
+}
+
+static void
+print_help(char *argv[])
+{
+  fprintf(stderr, "Usage: %s [options] [system_file ...]\n", argv[0]);
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "\t --dump | -D                         - compute and save PDE systems\n");
+  fprintf(stderr, "\t --timestamp | -t unix_time          - timestamp of equator crossing (dump mode)\n");
+  fprintf(stderr, "\t --longitude | -l lon                - longitude of equator crossing in degrees (dump mode)\n");
+  fprintf(stderr, "\t --f107_file | -f file               - F10.7 data file (dump mode)\n");
+  fprintf(stderr, "\t --grid | -g NRxNTHETA               - grid size, may be repeated (dump mode)\n");
+  fprintf(stderr, "\t --output_prefix | -o prefix         - output file prefix (dump mode)\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int dump = 0;
+  time_t t = 0;
+  double longitude = 0.0;
+  char *f107_file = NULL;
+  char *prefix = "pde_system";
+  size_t nr[PDE_BENCH_MAX_GRIDS], ntheta[PDE_BENCH_MAX_GRIDS];
+  size_t ngrid = 0;
+  int s = 0;
+  int i;
+
+  while (1)
+    {
+      int c;
+      int option_index = 0;
+      static struct option long_options[] =
+        {
+          { "dump", no_argument, NULL, 'D' },
+          { "timestamp", required_argument, NULL, 't' },
+          { "longitude", required_argument, NULL, 'l' },
+          { "f107_file", required_argument, NULL, 'f' },
+          { "grid", required_argument, NULL, 'g' },
+          { "output_prefix", required_argument, NULL, 'o' },
+          { 0, 0, 0, 0 }
+        };
+
+      c = getopt_long(argc, argv, "Df:g:l:o:t:", long_options, &option_index);
+      if (c == -1)
+        break;
+
+      switch (c)
+        {
+          case 'D':
+            dump = 1;
+            break;
+
+          case 't':
+            t = (time_t) atol(optarg);
+            break;
+
+          case 'l':
+            longitude = atof(optarg) * M_PI / 180.0;
+            break;
+
+          case 'f':
+            f107_file = optarg;
+            break;
+
+          case 'g':
+            if (ngrid < PDE_BENCH_MAX_GRIDS &&
+                sscanf(optarg, "%zux%zu", &nr[ngrid], &ntheta[ngrid]) == 2)
+              ++ngrid;
+            else
+              fprintf(stderr, "main: ignoring grid %s\n", optarg);
+            break;
+
+          case 'o':
+            prefix = optarg;
+            break;
+
+          default:
+            print_help(argv);
+            exit(1);
+            break;
+        }
+    }
+
+  if (dump)
+    {
+      if (ngrid == 0)
+        {
+          /* grid used by mag_alloc() */
+          nr[0] = 200;
+          ntheta[0] = 101;
+          ngrid = 1;
+        }
+
+      s = dump_systems(t, longitude, f107_file, ngrid, nr, ntheta, prefix);
+      exit(s ? 1 : 0);
+    }
+
+  if (optind >= argc)
+    {
+      print_help(argv);
+      exit(1);
+    }
+
+  i = 1;
+  printf("# Field %d: system file\n", i++);
+  printf("# Field %d: matrix size n\n", i++);
+  printf("# Field %d: nonzero elements\n", i++);
+  printf("# Field %d: solver\n", i++);
+  printf("# Field %d: lis options\n", i++);
+  printf("# Field %d: status (0 = success)\n", i++);
+  printf("# Field %d: solve time (seconds)\n", i++);
+  printf("# Field %d: preconditioner setup time (seconds)\n", i++);
+  printf("# Field %d: iterations\n", i++);
+  printf("# Field %d: peak resident memory (MB)\n", i++);
+  printf("# Field %d: residual norm ||b - A x||\n", i++);
+  printf("# Field %d: relative residual norm ||b - A x|| / ||b||\n", i++);
+
+  for (i = optind; i < argc; ++i)
+    s += bench_system(argv[i]);
+
+  return (s ? 1 : 0);
+}
@@ -0,0 +1,484 @@
+/*
+ * pde_solver.c
+ *
+ * Runtime-selectable sparse solvers for the PDE matrix equation
+ * A psi_k = b_k, k = 0,...,nrhs-1:
+ *
+ * PDE_SOLVER_LIS     - lis iterative solvers, with any lis
+ *                      preconditioner (ILU(k), ILUT, SA-AMG, ...)
+ *                      selected through an option string
+ * PDE_SOLVER_SUPERLU - SuperLU_MT direct factorization
+ * PDE_SOLVER_GMRES   - unpreconditioned GSL GMRES
+ *
+ * Also contains routines to save and load a PDE system, so the
+ * backends can be compared on real matrices with pde_bench.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_spmatrix.h>
+#include <gsl/gsl_spblas.h>
+#include <gsl/gsl_splinalg.h>
+
+#include <common/common.h>
+
+#include "fileio.h"
+#include "lisw.h"
+#include "superlu.h"
+
+#include "pde_solver.h"
+
+#define PDE_SOLVER_MAGIC        "PDESYS01"
+
+static int pde_solver_gmres(const pde_solver_parameters *params, const gsl_spmatrix *S,
+                            const size_t nrhs, const double *B, double *X,
+                            size_t *iter);
+
+static const char *pde_solver_names[PDE_SOLVER_NTYPES] = { "lis", "superlu", "gmres" };
+
+pde_solver_parameters
+pde_solver_default_parameters(void)
+{
+  pde_solver_parameters params;
+
+  params.type = PDE_SOLVER_LIS;
+  params.lis_options = NULL;
+  params.tol = 1.0e-6;
+  params.max_iter = 100;
+  params.nprocs = 1;
+
+  return params;
+}
+
+const char *
+pde_solver_name(const int type)
+{
+  if (type < 0 || type >= PDE_SOLVER_NTYPES)
+    return "unknown";
+
+  return pde_solver_names[type];
+}
+
+/* return PDE_SOLVER_xxx for a solver name, or -1 if not recognized */
+int
+pde_solver_type(const char *name)
+{
+  int i;
+
+  for (i = 0; i < PDE_SOLVER_NTYPES; ++i)
+    {
+      if (strcmp(name, pde_solver_names[i]) == 0)
+        return i;
+    }
+
+  return -1;
+}
+
+/*
+pde_solver_proc()
+  Solve A x_k = b_k for k = 0,...,nrhs-1
+
+Inputs: params - solver parameters
+        S      - PDE matrix A in triplet or compressed row format
+        nrhs   - number of right hand sides
+        B      - right hand sides, stored consecutively (length n * nrhs)
+        X      - (output) solutions, stored consecutively (length n * nrhs)
+        stats  - (output) solver statistics
+
+Return: success, or the solver's error status
+
+Notes:
+1) The right hand side tends to have a much smaller order of magnitude
+than the matrix, so each b_k is scaled by its maximum element before
+solving; residuals in stats refer to the scaled system
+
+2) B is not modified
+*/
+
+int
+pde_solver_proc(const pde_solver_parameters *params, const gsl_spmatrix *S,
+                const size_t nrhs, const double *B, double *X,
+                pde_solver_stats *stats)
+{
+  int s = 0;
+  const size_t n = S->size1;
+  double *Bs = malloc(n * nrhs * sizeof(double));
+  double *bscale = malloc(nrhs * sizeof(double));
+  double *rnorm = malloc(nrhs * sizeof(double));
+  gsl_vector *r = gsl_vector_alloc(n);
+  struct timeval tv0, tv1;
+  size_t k;
+
+  memcpy(Bs, B, n * nrhs * sizeof(double));
+
+  for (k = 0; k < nrhs; ++k)
+    {
+      gsl_vector_view bk = gsl_vector_view_array(Bs + k * n, n);
+      double min, max;
+
+      gsl_vector_minmax(&bk.vector, &min, &max);
+      bscale[k] = (max != 0.0) ? max : 1.0;
+      gsl_vector_scale(&bk.vector, 1.0 / bscale[k]);
+    }
+
+  stats->iter = 0;
+  stats->ptime = 0.0;
+
+  gettimeofday(&tv0, NULL);
+
+  switch (params->type)
+    {
+      case PDE_SOLVER_LIS:
+        {
+          lis_workspace *lis_p = lis_alloc(S->size1, S->size2);
+
+          if (params->lis_options)
+            lis_set_options(params->lis_options, lis_p);
+
+          s = lis_proc_multi(S, nrhs, Bs, params->tol, X, rnorm, lis_p);
+          stats->iter = (size_t) lis_p->iter;
+          stats->ptime = lis_p->ptime;
+
+          mylis_free(lis_p);
+
+          if (s)
+            fprintf(stderr, "pde_solver_proc: lis_proc_multi failed: s = %d\n", s);
+        }
+        break;
+
+      case PDE_SOLVER_SUPERLU:
+        {
+          slu_workspace *superlu_p = slu_alloc(S->size1, S->size2, params->nprocs);
+          gsl_spmatrix *C = pde_solver_ccs(S);
+
+          if (C)
+            {
+              s = slu_proc_multi(C, nrhs, Bs, X, rnorm, superlu_p);
+              gsl_spmatrix_free(C);
+            }
+          else
+            {
+              s = GSL_ENOMEM;
+            }
+
+          slu_free(superlu_p);
+
+          if (s)
+            fprintf(stderr, "pde_solver_proc: slu_proc_multi failed: s = %d\n", s);
+        }
+        break;
+
+      case PDE_SOLVER_GMRES:
+        s = pde_solver_gmres(params, S, nrhs, Bs, X, &(stats->iter));
+        break;
+
+      default:
+        fprintf(stderr, "pde_solver_proc: unknown solver type %d\n", params->type);
+        s = GSL_EINVAL;
+        break;
+    }
+
+  gettimeofday(&tv1, NULL);
+  stats->time = time_diff(tv0, tv1);
+
+  /* compute residuals of scaled system and undo scaling */
+  stats->rnorm = 0.0;
+  stats->rrnorm = 0.0;
+
+  for (k = 0; k < nrhs; ++k)
+    {
+      gsl_vector_view bk = gsl_vector_view_array(Bs + k * n, n);
+      gsl_vector_view xk = gsl_vector_view_array(X + k * n, n);
+      double normb = gsl_blas_dnrm2(&bk.vector);
+      double res;
+
+      gsl_vector_memcpy(r, &bk.vector);
+      gsl_spblas_dgemv(CblasNoTrans, 1.0, S, &xk.vector, -1.0, r);
+      res = gsl_blas_dnrm2(r);
+
+      stats->rnorm = GSL_MAX(stats->rnorm, res);
+      if (normb > 0.0)
+        stats->rrnorm = GSL_MAX(stats->rrnorm, res / normb);
+
+      gsl_vector_scale(&xk.vector, bscale[k]);
+    }
+
+  free(Bs);
+  free(bscale);
+  free(rnorm);
+  gsl_vector_free(r);
+
+  return s;
+} /* pde_solver_proc() */
+
+/*
+pde_solver_write()
+  Save a PDE system A X = B to a binary file
+
+Inputs: filename - output file
+        S        - matrix A in triplet or compressed row format
+        nrhs     - number of right hand sides
+        B        - right hand sides, stored consecutively
+
+Return: success or error
+
+Notes:
+1) The matrix is always stored as triplets
+*/
+
+int
+pde_solver_write(const char *filename, const gsl_spmatrix *S,
+                 const size_t nrhs, const double *B)
+{
+  FILE *fp;
+  char tmpname[PATH_MAX];
+  size_t nwrite = 0;
+  size_t *ridx = NULL;
+
+  if (GSL_SPMATRIX_ISCRS(S))
+    {
+      size_t i, k;
+
+      /* expand row pointers to row indices */
+      ridx = malloc(GSL_MAX(S->nz, 1) * sizeof(size_t));
+      for (i = 0; i < S->size1; ++i)
+        {
+          for (k = S->p[i]; k < S->p[i + 1]; ++k)
+            ridx[k] = i;
+        }
+    }
+  else if (!GSL_SPMATRIX_ISTRIPLET(S))
+    {
+      GSL_ERROR("matrix must be in triplet or compressed row format", GSL_EINVAL);
+    }
+
+  fp = fileio_open(filename, tmpname);
+  if (!fp)
+    {
+      if (ridx)
+        free(ridx);
+      return GSL_FAILURE;
+    }
+
+  nwrite += fwrite(PDE_SOLVER_MAGIC, 1, 8, fp);
+  nwrite += fwrite(&(S->size1), sizeof(size_t), 1, fp);
+  nwrite += fwrite(&(S->size2), sizeof(size_t), 1, fp);
+  nwrite += fwrite(&(S->nz), sizeof(size_t), 1, fp);
+  nwrite += fwrite(&nrhs, sizeof(size_t), 1, fp);
+  if (ridx)
+    {
+      nwrite += fwrite(ridx, sizeof(size_t), S->nz, fp);
+      nwrite += fwrite(S->i, sizeof(size_t), S->nz, fp);
+      free(ridx);
+    }
+  else
+    {
+      nwrite += fwrite(S->i, sizeof(size_t), S->nz, fp);
+      nwrite += fwrite(S->p, sizeof(size_t), S->nz, fp);
+    }
+  nwrite += fwrite(S->data, sizeof(double), S->nz, fp);
+  nwrite += fwrite(B, sizeof(double), S->size1 * nrhs, fp);
+
+  if (fileio_close(fp, nwrite == 12 + 3 * S->nz + S->size1 * nrhs, tmpname, filename) != 0)
+    return GSL_FAILURE;
+
+  return GSL_SUCCESS;
+} /* pde_solver_write() */
+
+/*
+pde_solver_read()
+  Read a PDE system saved with pde_solver_write()
+
+Inputs: filename - input file
+        S        - (output) newly allocated matrix in triplet format
+        nrhs     - (output) number of right hand sides
+        B        - (output) newly allocated right hand sides
+*/
+
+int
+pde_solver_read(const char *filename, gsl_spmatrix **S, size_t *nrhs,
+                double **B)
+{
+  FILE *fp;
+  char magic[8];
+  size_t size1, size2, nz, k;
+  size_t *ridx, *cidx;
+  double *data;
+  size_t nread = 0;
+
+  fp = fopen(filename, "r");
+  if (!fp)
+    {
+      fprintf(stderr, "pde_solver_read: unable to open %s: %s\n",
+              filename, strerror(errno));
+      return GSL_FAILURE;
+    }
+
+  nread += fread(magic, 1, 8, fp);
+  nread += fread(&size1, sizeof(size_t), 1, fp);
+  nread += fread(&size2, sizeof(size_t), 1, fp);
+  nread += fread(&nz, sizeof(size_t), 1, fp);
+  nread += fread(nrhs, sizeof(size_t), 1, fp);
+
+  if (nread != 12 || memcmp(magic, PDE_SOLVER_MAGIC, 8) != 0)
+    {
+      fprintf(stderr, "pde_solver_read: %s is not a PDE system file\n", filename);
+      fclose(fp);
+      return GSL_FAILURE;
+    }
+
+  ridx = malloc(nz * sizeof(size_t));
+  cidx = malloc(nz * sizeof(size_t));
+  data = malloc(nz * sizeof(double));
+  *B = malloc(size1 * (*nrhs) * sizeof(double));
+
+  nread = fread(ridx, sizeof(size_t), nz, fp);
+  nread += fread(cidx, sizeof(size_t), nz, fp);
+  nread += fread(data, sizeof(double), nz, fp);
+  nread += fread(*B, sizeof(double), size1 * (*nrhs), fp);
+
+  fclose(fp);
+
+  if (nread != 3 * nz + size1 * (*nrhs))
+    {
+      fprintf(stderr, "pde_solver_read: %s is truncated\n", filename);
+      free(ridx);
+      free(cidx);
+      free(data);
+      free(*B);
+      return GSL_FAILURE;
+    }
+
+  *S = gsl_spmatrix_alloc_nzmax(size1, size2, nz, GSL_SPMATRIX_TRIPLET);
+
+  for (k = 0; k < nz; ++k)
+    gsl_spmatrix_set(*S, ridx[k], cidx[k], data[k]);
+
+  free(ridx);
+  free(cidx);
+  free(data);
+
+  return GSL_SUCCESS;
+} /* pde_solver_read() */
+
+/*
+pde_solver_gmres()
+  Solve each system separately with unpreconditioned GSL GMRES,
+since it does not support multiple right hand sides
+*/
+
+static int
+pde_solver_gmres(const pde_solver_parameters *params, const gsl_spmatrix *S,
+                 const size_t nrhs, const double *B, double *X,
+                 size_t *iter)
+{
+  int status = GSL_SUCCESS;
+  const size_t n = S->size1;
+  const gsl_splinalg_itersolve_type *T = gsl_splinalg_itersolve_gmres;
+  gsl_splinalg_itersolve *work = gsl_splinalg_itersolve_alloc(T, n, 40);
+  size_t k;
+
+  *iter = 0;
+
+  for (k = 0; k < nrhs; ++k)
+    {
+      gsl_vector_const_view bk = gsl_vector_const_view_array(B + k * n, n);
+      gsl_vector_view xk = gsl_vector_view_array(X + k * n, n);
+      size_t it = 0;
+      int s;
+
+      /* initial guess x = 0 */
+      gsl_vector_set_zero(&xk.vector);
+
+      do
+        s = gsl_splinalg_itersolve_iterate(S, &bk.vector, params->tol,
+                                           &xk.vector, work);
+      while (s == GSL_CONTINUE && ++it < params->max_iter);
+
+      *iter = GSL_MAX(*iter, GSL_MIN(it + 1, params->max_iter));
+
+      if (s != GSL_SUCCESS && status == GSL_SUCCESS)
+        {
+          fprintf(stderr, "pde_solver_gmres: rhs %zu did not converge in %zu iterations\n",
+                  k, params->max_iter);
+          status = GSL_EMAXITER;
+        }
+    }
+
+  gsl_splinalg_itersolve_free(work);
+
+  return status;
+} /* pde_solver_gmres() */
+
+/*
+pde_solver_ccs()
+  Return a newly allocated compressed column copy of S, as
+required by SuperLU
+
+Inputs: S - matrix in triplet or compressed row format
+
+Return: pointer to matrix, or NULL on allocation failure
+
+Notes:
+1) Compressed row input is converted with a counting sort over
+columns in O(nnz) operations, so row indices within each column
+remain sorted
+*/
+
+gsl_spmatrix *
+pde_solver_ccs(const gsl_spmatrix *S)
+{
+  gsl_spmatrix *C;
+  size_t *next;
+  size_t i, j, k;
+
+  if (GSL_SPMATRIX_ISTRIPLET(S))
+    return gsl_spmatrix_compcol(S);
+
+  C = gsl_spmatrix_alloc_nzmax(S->size1, S->size2, GSL_MAX(S->nz, 1),
+                               GSL_SPMATRIX_CCS);
+  if (!C)
+    return 0;
+
+  next = calloc(S->size2 + 1, sizeof(size_t));
+  if (!next)
+    {
+      gsl_spmatrix_free(C);
+      return 0;
+    }
+
+  /* count elements in each column */
+  for (k = 0; k < S->nz; ++k)
+    ++next[S->i[k] + 1];
+
+  for (j = 0; j < S->size2; ++j)
+    next[j + 1] += next[j];
+
+  memcpy(C->p, next, (S->size2 + 1) * sizeof(size_t));
+
+  for (i = 0; i < S->size1; ++i)
+    {
+      for (k = S->p[i]; k < S->p[i + 1]; ++k)
+        {
+          size_t idx = next[S->i[k]]++;
+
+          C->i[idx] = i;
+          C->data[idx] = S->data[k];
+        }
+    }
+
+  C->nz = S->nz;
+
+  free(next);
+
+  return C;
+} /* pde_solver_ccs() */
@@ -0,0 +1,51 @@
+/*
+ * pde_solver.h
+ */
+
+#ifndef INCLUDED_pde_solver_h
+#define INCLUDED_pde_solver_h
+
+#include <gsl/gsl_spmatrix.h>
+
+/* sparse solver backends */
+#define PDE_SOLVER_LIS          0
+#define PDE_SOLVER_SUPERLU      1
+#define PDE_SOLVER_GMRES        2
+
+#define PDE_SOLVER_NTYPES       3
+
+typedef struct
+{
+  int type;                /* PDE_SOLVER_xxx */
+  const char *lis_options; /* lis solver/preconditioner options, NULL for default */
+  double tol;              /* relative tolerance for iterative solvers */
+  size_t max_iter;         /* maximum iterations for GSL GMRES */
+  int nprocs;              /* number of threads for SuperLU_MT */
+} pde_solver_parameters;
+
+typedef struct
+{
+  double time;             /* wall clock time of solve (seconds) */
+  double ptime;            /* preconditioner setup time, if known (seconds) */
+  size_t iter;             /* iterations (maximum over right hand sides); 0 for direct */
+  double rnorm;            /* maximum residual norm ||b_k - A x_k|| */
+  double rrnorm;           /* maximum relative residual ||b_k - A x_k|| / ||b_k|| */
+} pde_solver_stats;
+
+/*
+ * Prototypes
+ */
+
+pde_solver_parameters pde_solver_default_parameters(void);
+const char *pde_solver_name(const int type);
+int pde_solver_type(const char *name);
+int pde_solver_proc(const pde_solver_parameters *params, const gsl_spmatrix *S,
+                    const size_t nrhs, const double *B, double *X,
+                    pde_solver_stats *stats);
+int pde_solver_write(const char *filename, const gsl_spmatrix *S,
+                     const size_t nrhs, const double *B);
+int pde_solver_read(const char *filename, gsl_spmatrix **S, size_t *nrhs,
+                    double **B);
+gsl_spmatrix *pde_solver_ccs(const gsl_spmatrix *S);
+
+#endif /* INCLUDED_pde_solver_h */
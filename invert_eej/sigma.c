@@ -27,6 +27,16 @@
 
 #include "sigma.h"
 
+static int sigma_column(const double theta, const double phi, const time_t t,
+                        double *s0, double *s1, double *s2, sigma_workspace *w);
+static int sigma_cached(const sigma_cache_key *key, const double theta,
+                        const double phi, const time_t t, double *s0,
+                        double *s1, double *s2, sigma_workspace *w);
+static int sigma_cond(const double theta, const double phi, const time_t t,
+                      double *s0, double *s1, double *s2, sigma_workspace *w);
+static double sigma_f107(const time_t t, sigma_workspace *w);
+static int sigma_pool_column(const void *in, void *out, void *params);
+
 /*
  * Global
  */
@@ -85,6 +95,13 @@ sigma_alloc(const char *f107_file, size_t nr, size_t ntheta,
       return 0;
     }
 
+  w->work = malloc(6 * nr * sizeof(double));
+  if (!w->work)
+    {
+      sigma_free(w);
+      return 0;
+    }
+
   cond_set_alpha(4.0, w->cond_workspace_p);
 
   /*cond_set_error_scale(1.0, 4.0, w->cond_workspace_p);*/
@@ -121,9 +138,71 @@ sigma_free(sigma_workspace *w)
   if (w->mageq_workspace_p)
     mageq_free(w->mageq_workspace_p);
 
+  if (w->cache_p)
+    sigma_cache_free(w->cache_p);
+
+  if (w->work)
+    free(w->work);
+
   free(w);
 }
 
+/*
+sigma_set_cache()
+  Use a persistent cache of conductivity profiles in sigma_calc()
+
+Inputs: filename - cache file, created if it does not exist
+        params   - cache parameters
+        w        - workspace
+
+Return: success or error; on error no cache is used
+
+Notes:
+1) Cached profiles are computed at the center of each (time, longitude,
+colatitude) bin, so results differ slightly from uncached calculations;
+the bin widths in params control this tolerance
+*/
+
+int
+sigma_set_cache(const char *filename, const sigma_cache_parameters *params,
+                sigma_workspace *w)
+{
+  if (w->cache_p)
+    sigma_cache_free(w->cache_p);
+
+  w->cache_full = 0;
+  w->cache_p = sigma_cache_alloc(filename, params, w->nr,
+                                 w->rmin * 1.0e-3 - R_EARTH_KM,
+                                 w->rstep * 1.0e-3);
+  if (!w->cache_p)
+    return GSL_FAILURE;
+
+  return GSL_SUCCESS;
+} /* sigma_set_cache() */
+
+/*
+sigma_set_pool()
+  Evaluate the conductivity columns of sigma_calc() with a pool of
+model server processes
+
+Inputs: pool - model server pool, or NULL to compute serially
+        w    - workspace
+
+Notes:
+1) The pool must be allocated after this workspace and its cache are
+fully set up, since the servers use their own copy of them; the input
+buffer must hold ntheta sigma_column_input records and the output
+buffer ntheta * 3 * nr doubles
+
+2) The pool is not freed by sigma_free()
+*/
+
+void
+sigma_set_pool(model_pool_workspace *pool, sigma_workspace *w)
+{
+  w->pool_p = pool;
+} /* sigma_set_pool() */
+
 /*
 pde_sigma()
   Compute conductivity tensor for entire grid
@@ -160,50 +239,64 @@ sigma_calc(time_t t, double longitude, sigma_workspace *w)
   const double r = 6371.2 + 108.0;
   const double tyr = get_year(t);
 
+  double *out = NULL;
+
   lat_eq = mageq_calc(longitude, r, tyr, w->mageq_workspace_p);
 
+  if (w->pool_p)
+    {
+      /* evaluate all columns as one batch on the model servers */
+      sigma_column_input *in = model_pool_input(w->pool_p);
+
+      if (!in)
+        return GSL_FAILURE;
+
+      for (j = 0; j < w->ntheta; ++j)
+        {
+          in[j].theta = w->theta_min + j * w->theta_step - lat_eq;
+          in[j].phi = longitude;
+          in[j].t = t;
+        }
+
+      s = model_pool_run(sigma_pool_column, w, w->ntheta,
+                         sizeof(sigma_column_input),
+                         3 * w->nr * sizeof(double), w->pool_p);
+      if (s)
+        return GSL_FAILURE; /* error occurred */
+
+      out = model_pool_output(w->pool_p);
+    }
+
   /* compute conductivities */
   for (j = 0; j < w->ntheta; ++j)
     {
       /* colatitude offset */
       double theta_off = w->theta_min + j * w->theta_step;
       double theta = theta_off - lat_eq;
+      double *s0 = w->work;
+      double *s1 = w->work + w->nr;
+      double *s2 = w->work + 2 * w->nr;
 
-      /*
-       * set an alarm for 60 seconds so if IRI fails we can continue
-       * processing new profiles
-       */
-      cond_success = 0;
-      /*alarm(60);*/
-
-      s = cond_calc(theta,
-                    longitude,
-                    t,
-                    w->rmin * 1.0e-3 - R_EARTH_KM,
-                    w->rstep * 1.0e-3,
-                    w->nr,
-                    w->cond_workspace_p);
-
-      alarm(0);
-      cond_success = 1;
+      if (out)
+        {
+          s0 = out + 3 * w->nr * j;
+          s1 = s0 + w->nr;
+          s2 = s1 + w->nr;
+        }
+      else
+        {
+          s = sigma_column(theta, longitude, t, s0, s1, s2, w);
+          if (s)
+            return GSL_FAILURE; /* error occurred */
+        }
 
-      if (s)
-        return GSL_FAILURE; /* error occurred */
-        
       /* save conductivity results */
       for (i = 0; i < w->nr; ++i)
         {
-          cond_result *result = cond_get_result(i, w->cond_workspace_p);
-
-          if (!gsl_finite(result->sigma_0) ||
-              !gsl_finite(result->sigma_p) ||
-              !gsl_finite(result->sigma_h))
-            return GSL_FAILURE;
-
-          gsl_matrix_set(w->s0, i, j, result->sigma_0);
-          gsl_matrix_set(w->s1, i, j, result->sigma_p);
-          gsl_matrix_set(w->s2, i, j, result->sigma_h);
-        } /* for (i = 0; i < w->nr; ++i) */
+          gsl_matrix_set(w->s0, i, j, s0[i]);
+          gsl_matrix_set(w->s1, i, j, s1[i]);
+          gsl_matrix_set(w->s2, i, j, s2[i]);
+        }
     } /* for (j = 0; j < w->ntheta; ++j) */
 
 #ifdef SIGMA_SYMMETRIC
@@ -273,3 +366,200 @@ sigma_max(double *s0_max, double *s1_max, double *s2_max,
 
   return s;
 } /* sigma_max() */
+
+/*
+sigma_column()
+  Compute conductivity altitude profiles for one theta grid column,
+using the profile cache if available
+
+Inputs: theta - geographic colatitude (radians)
+        phi   - longitude (radians)
+        t     - timestamp
+        s0    - (output) direct conductivity, length nr
+        s1    - (output) Pedersen conductivity, length nr
+        s2    - (output) Hall conductivity, length nr
+        w     - workspace
+
+Notes:
+1) If w->cache_p->params.interp is set, the profiles are linearly
+interpolated in colatitude between the two neighboring bins; adjacent
+theta grid columns then share cached profiles
+*/
+
+static int
+sigma_column(const double theta, const double phi, const time_t t,
+             double *s0, double *s1, double *s2, sigma_workspace *w)
+{
+  int s;
+  const sigma_cache_parameters *params;
+  sigma_cache_key key;
+  time_t tc;
+  double phic, x;
+
+  if (w->cache_p == NULL)
+    return sigma_cond(theta, phi, t, s0, s1, s2, w);
+
+  params = &(w->cache_p->params);
+
+  /* quantize time and longitude to nearest bin */
+  key.t = (long) floor((double) t / params->dt + 0.5);
+  key.lon = (int) floor(phi / params->dlon + 0.5);
+  key.pad = 0;
+  tc = (time_t) (key.t * params->dt);
+  phic = key.lon * params->dlon;
+  key.f107 = (int) floor(sigma_f107(tc, w) / params->df107 + 0.5);
+
+  x = theta / params->dtheta;
+
+  if (params->interp)
+    {
+      double *t0 = w->work + 3 * w->nr;
+      double *t1 = w->work + 4 * w->nr;
+      double *t2 = w->work + 5 * w->nr;
+      double frac;
+      size_t i;
+
+      key.theta = (int) floor(x);
+      frac = x - key.theta;
+
+      s = sigma_cached(&key, key.theta * params->dtheta, phic, tc, s0, s1, s2, w);
+      if (s || frac == 0.0)
+        return s;
+
+      ++key.theta;
+      s = sigma_cached(&key, key.theta * params->dtheta, phic, tc, t0, t1, t2, w);
+      if (s)
+        return s;
+
+      for (i = 0; i < w->nr; ++i)
+        {
+          s0[i] += frac * (t0[i] - s0[i]);
+          s1[i] += frac * (t1[i] - s1[i]);
+          s2[i] += frac * (t2[i] - s2[i]);
+        }
+    }
+  else
+    {
+      key.theta = (int) floor(x + 0.5);
+      s = sigma_cached(&key, key.theta * params->dtheta, phic, tc, s0, s1, s2, w);
+    }
+
+  return s;
+} /* sigma_column() */
+
+/*
+sigma_cached()
+  Retrieve a profile from the cache, or compute it at the bin center
+(theta,phi,t) and add it to the cache
+*/
+
+static int
+sigma_cached(const sigma_cache_key *key, const double theta,
+             const double phi, const time_t t, double *s0,
+             double *s1, double *s2, sigma_workspace *w)
+{
+  int s;
+
+  if (sigma_cache_lookup(key, s0, s1, s2, w->cache_p))
+    return GSL_SUCCESS;
+
+  s = sigma_cond(theta, phi, t, s0, s1, s2, w);
+  if (s)
+    return s;
+
+  s = sigma_cache_insert(key, s0, s1, s2, w->cache_p);
+  if (s && !w->cache_full)
+    {
+      fprintf(stderr, "sigma_cached: warning: conductivity cache is full, new profiles will not be cached (increase sigma_cache_nslots)\n");
+      w->cache_full = 1;
+    }
+
+  return GSL_SUCCESS;
+} /* sigma_cached() */
+
+/*
+sigma_cond()
+  Call cond_calc() for a single altitude profile and check results
+*/
+
+static int
+sigma_cond(const double theta, const double phi, const time_t t,
+           double *s0, double *s1, double *s2, sigma_workspace *w)
+{
+  int s;
+  size_t i;
+  const cond_profile *p;
+
+  /*
+   * set an alarm for 60 seconds so if IRI fails we can continue
+   * processing new profiles
+   */
+  cond_success = 0;
+  /*alarm(60);*/
+
+  s = cond_calc(theta,
+                phi,
+                t,
+                w->rmin * 1.0e-3 - R_EARTH_KM,
+                w->rstep * 1.0e-3,
+                w->nr,
+                w->cond_workspace_p);
+
+  alarm(0);
+  cond_success = 1;
+
+  if (s)
+    return GSL_FAILURE; /* error occurred */
+
+  p = cond_get_profile(w->cond_workspace_p);
+
+  for (i = 0; i < w->nr; ++i)
+    {
+      if (!gsl_finite(p->sigma_0[i]) ||
+          !gsl_finite(p->sigma_p[i]) ||
+          !gsl_finite(p->sigma_h[i]))
+        return GSL_FAILURE;
+
+      s0[i] = p->sigma_0[i];
+      s1[i] = p->sigma_p[i];
+      s2[i] = p->sigma_h[i];
+    }
+
+  return GSL_SUCCESS;
+} /* sigma_cond() */
+
+/*
+sigma_f107()
+  Return the F10.7 value which IRI will use for time t, for the
+cache key
+*/
+
+static double
+sigma_f107(const time_t t, sigma_workspace *w)
+{
+  iri_workspace *iri_p = w->cond_workspace_p->iri_workspace_p;
+  double f107 = 0.0;
+
+  if (iri_p->f107_override > 0.0)
+    f107 = iri_p->f107_override;
+  else
+    f107_get(t, &f107, iri_p->f107_workspace_p);
+
+  return f107;
+} /* sigma_f107() */
+
+/*
+sigma_pool_column()
+  Model server function: compute conductivity column for one
+sigma_column_input record; output is s0, s1, s2 of length nr each
+*/
+
+static int
+sigma_pool_column(const void *in, void *out, void *params)
+{
+  const sigma_column_input *p = (const sigma_column_input *) in;
+  sigma_workspace *w = (sigma_workspace *) params;
+  double *s0 = (double *) out;
+
+  return sigma_column(p->theta, p->phi, p->t, s0, s0 + w->nr, s0 + 2 * w->nr, w);
+} /* sigma_pool_column() */
@@ -12,6 +12,8 @@
 
 #include "cond.h"
 #include "mageq.h"
+#include "model_pool.h"
+#include "sigma_cache.h"
 
 /* force latitude-symmetric conductivities */
 #define SIGMA_SYMMETRIC
@@ -33,10 +35,23 @@ typedef struct
   gsl_matrix *s1;    /* Pedersen conductivity */
   gsl_matrix *s2;    /* Hall conductivity */
 
+  double *work;      /* workspace, size 6*nr */
+
   cond_workspace *cond_workspace_p;
   mageq_workspace *mageq_workspace_p;
+  sigma_cache_workspace *cache_p; /* conductivity profile cache, or NULL */
+  int cache_full;                 /* set once a failed cache insert has been reported */
+  model_pool_workspace *pool_p;   /* model server pool, or NULL */
 } sigma_workspace;
 
+/* input record of a conductivity column evaluated by a model server */
+typedef struct
+{
+  double theta;      /* colatitude (radians) */
+  double phi;        /* longitude (radians) */
+  time_t t;          /* timestamp */
+} sigma_column_input;
+
 /*
  * Prototypes
  */
@@ -45,6 +60,9 @@ sigma_workspace *sigma_alloc(const char *f107_file, size_t nr, size_t ntheta, do
                              double rmax, double theta_min,
                              double theta_max);
 void sigma_free(sigma_workspace *w);
+int sigma_set_cache(const char *filename, const sigma_cache_parameters *params,
+                    sigma_workspace *w);
+void sigma_set_pool(model_pool_workspace *pool, sigma_workspace *w);
 int sigma_calc(time_t t, double longitude, sigma_workspace *w);
 int sigma_result(size_t i, size_t j, double *s0, double *s1, double *s2,
                  sigma_workspace *w);
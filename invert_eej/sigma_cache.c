@@ -0,0 +1,336 @@
+/*
+ * sigma_cache.c
+ *
+ * Persistent on-disk cache of conductivity altitude profiles
+ * (s0, s1, s2) computed by cond_calc(). Profiles are keyed by a
+ * quantized (time, longitude, colatitude, F10.7) tuple, so that
+ * nearby tracks and repeated processing of the same days can reuse
+ * previous IRI/MSIS model evaluations.
+ *
+ * The cache is an open-addressing hash table stored in a file which
+ * is mapped with mmap(MAP_SHARED), so that several processes (such as
+ * the track workers of mag_parallel_proc()) can read and add profiles
+ * concurrently. A slot is claimed with an atomic compare-and-swap of
+ * its state word, filled in, and then marked valid; readers ignore slots
+ * which are still being written. The claim time is stored with the busy
+ * flag, so a slot left busy by a killed process can be taken over once
+ * SIGMA_CACHE_BUSY_TIMEOUT has passed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <gsl/gsl_math.h>
+
+#include "sigma_cache.h"
+
+static int sigma_cache_init(const double altmin, const double altstp,
+                            sigma_cache_workspace *w);
+static size_t sigma_cache_hash(const sigma_cache_key *key, const size_t nslots);
+static int sigma_cache_equal(const sigma_cache_key *a, const sigma_cache_key *b);
+
+sigma_cache_parameters
+sigma_cache_default_parameters(void)
+{
+  sigma_cache_parameters params;
+
+  params.nslots = 65536;
+  params.dt = 900.0;
+  params.dlon = 1.0 * M_PI / 180.0;
+  params.dtheta = 0.25 * M_PI / 180.0;
+  params.df107 = 1.0;
+  params.interp = 1;
+
+  return params;
+}
+
+/*
+sigma_cache_alloc()
+  Open (or create) a conductivity profile cache file
+
+Inputs: filename - cache file
+        params   - cache parameters
+        nalt     - number of altitude points in each profile
+        altmin   - minimum altitude (km)
+        altstp   - altitude step (km)
+
+Return: pointer to workspace, or NULL on error
+
+Notes:
+1) An existing file must have been created with the same altitude
+grid, number of slots and bin widths; otherwise an error is returned
+*/
+
+sigma_cache_workspace *
+sigma_cache_alloc(const char *filename, const sigma_cache_parameters *params,
+                  const size_t nalt, const double altmin, const double altstp)
+{
+  sigma_cache_workspace *w;
+  int s;
+
+  w = calloc(1, sizeof(sigma_cache_workspace));
+  if (!w)
+    {
+      fprintf(stderr, "sigma_cache_alloc: calloc failed: %s\n", strerror(errno));
+      return 0;
+    }
+
+  w->params = *params;
+  w->nalt = nalt;
+  w->slot_size = sizeof(sigma_cache_entry) + 3 * nalt * sizeof(double);
+  w->size = SIGMA_CACHE_HEADER_SIZE + params->nslots * w->slot_size;
+  w->map = MAP_FAILED;
+
+  w->fd = open(filename, O_RDWR | O_CREAT, 0644);
+  if (w->fd < 0)
+    {
+      fprintf(stderr, "sigma_cache_alloc: unable to open %s: %s\n",
+              filename, strerror(errno));
+      sigma_cache_free(w);
+      return 0;
+    }
+
+  /* serialize creation of the file header between processes */
+  flock(w->fd, LOCK_EX);
+  s = sigma_cache_init(altmin, altstp, w);
+  flock(w->fd, LOCK_UN);
+
+  if (s)
+    {
+      fprintf(stderr, "sigma_cache_alloc: %s is incompatible with current grid\n",
+              filename);
+      sigma_cache_free(w);
+      return 0;
+    }
+
+  w->map = mmap(NULL, w->size, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+  if (w->map == MAP_FAILED)
+    {
+      fprintf(stderr, "sigma_cache_alloc: mmap failed: %s\n", strerror(errno));
+      sigma_cache_free(w);
+      return 0;
+    }
+
+  return w;
+} /* sigma_cache_alloc() */
+
+void
+sigma_cache_free(sigma_cache_workspace *w)
+{
+  if (w->map != MAP_FAILED && w->map != NULL)
+    munmap(w->map, w->size);
+
+  if (w->fd >= 0)
+    close(w->fd);
+
+  free(w);
+}
+
+/*
+sigma_cache_lookup()
+  Search cache for a profile
+
+Inputs: key - profile key
+        s0  - (output) direct conductivity profile, length nalt
+        s1  - (output) Pedersen conductivity profile, length nalt
+        s2  - (output) Hall conductivity profile, length nalt
+        w   - workspace
+
+Return: 1 if found, 0 if not found
+*/
+
+int
+sigma_cache_lookup(const sigma_cache_key *key, double *s0, double *s1,
+                   double *s2, sigma_cache_workspace *w)
+{
+  const size_t nslots = w->params.nslots;
+  const size_t nbytes = w->nalt * sizeof(double);
+  size_t idx = sigma_cache_hash(key, nslots);
+  size_t i;
+
+  for (i = 0; i < SIGMA_CACHE_MAX_PROBE; ++i)
+    {
+      char *ptr = w->map + SIGMA_CACHE_HEADER_SIZE + idx * w->slot_size;
+      sigma_cache_entry *entry = (sigma_cache_entry *) ptr;
+      int flag = (int) (entry->state & SIGMA_CACHE_FLAG_MASK);
+
+      if (flag == SIGMA_CACHE_EMPTY)
+        break;
+
+      if (flag == SIGMA_CACHE_VALID && sigma_cache_equal(key, &(entry->key)))
+        {
+          const double *data = (const double *) (ptr + sizeof(sigma_cache_entry));
+
+          memcpy(s0, data, nbytes);
+          memcpy(s1, data + w->nalt, nbytes);
+          memcpy(s2, data + 2 * w->nalt, nbytes);
+
+          return 1;
+        }
+
+      idx = (idx + 1) % nslots;
+    }
+
+  return 0;
+} /* sigma_cache_lookup() */
+
+/*
+sigma_cache_insert()
+  Add a profile to the cache
+
+Inputs: key - profile key
+        s0  - direct conductivity profile, length nalt
+        s1  - Pedersen conductivity profile, length nalt
+        s2  - Hall conductivity profile, length nalt
+        w   - workspace
+
+Return: success, or -1 if no free slot was found
+
+Notes:
+1) A slot which has been busy for longer than SIGMA_CACHE_BUSY_TIMEOUT
+was left by a process killed while writing it, and is reclaimed
+
+2) A writer whose slot was reclaimed in the meantime leaves marking
+it valid to the process which reclaimed it
+*/
+
+int
+sigma_cache_insert(const sigma_cache_key *key, const double *s0,
+                   const double *s1, const double *s2,
+                   sigma_cache_workspace *w)
+{
+  const size_t nslots = w->params.nslots;
+  const size_t nbytes = w->nalt * sizeof(double);
+  size_t idx = sigma_cache_hash(key, nslots);
+  const long now = (long) time(NULL);
+  const long busy = (now << 2) | SIGMA_CACHE_BUSY;
+  size_t i;
+
+  for (i = 0; i < SIGMA_CACHE_MAX_PROBE; ++i)
+    {
+      char *ptr = w->map + SIGMA_CACHE_HEADER_SIZE + idx * w->slot_size;
+      sigma_cache_entry *entry = (sigma_cache_entry *) ptr;
+      long state = entry->state;
+      int flag = (int) (state & SIGMA_CACHE_FLAG_MASK);
+      int claimed = 0;
+
+      if (flag == SIGMA_CACHE_VALID && sigma_cache_equal(key, &(entry->key)))
+        return 0; /* already added by another process */
+
+      if (flag == SIGMA_CACHE_EMPTY)
+        claimed = __sync_bool_compare_and_swap(&(entry->state), state, busy);
+      else if (flag == SIGMA_CACHE_BUSY && now - (state >> 2) > SIGMA_CACHE_BUSY_TIMEOUT)
+        claimed = __sync_bool_compare_and_swap(&(entry->state), state, busy);
+
+      if (claimed)
+        {
+          double *data = (double *) (ptr + sizeof(sigma_cache_entry));
+
+          entry->key = *key;
+          memcpy(data, s0, nbytes);
+          memcpy(data + w->nalt, s1, nbytes);
+          memcpy(data + 2 * w->nalt, s2, nbytes);
+
+          /* make profile visible before the flag; fails only if reclaimed meanwhile */
+          __sync_synchronize();
+          __sync_bool_compare_and_swap(&(entry->state), busy, (long) SIGMA_CACHE_VALID);
+
+          return 0;
+        }
+
+      idx = (idx + 1) % nslots;
+    }
+
+  return -1;
+} /* sigma_cache_insert() */
+
+/*
+sigma_cache_init()
+  Write header of a new cache file, or verify header of an existing
+file; must be called with the file locked
+*/
+
+static int
+sigma_cache_init(const double altmin, const double altstp,
+                 sigma_cache_workspace *w)
+{
+  const sigma_cache_parameters *params = &(w->params);
+  sigma_cache_header header;
+  struct stat st;
+
+  if (fstat(w->fd, &st) != 0)
+    return -1;
+
+  if (st.st_size == 0)
+    {
+      /* new file: write header; table slots are zero (empty) */
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, SIGMA_CACHE_MAGIC, 8);
+      header.version = SIGMA_CACHE_VERSION;
+      header.nslots = params->nslots;
+      header.nalt = w->nalt;
+      header.altmin = altmin;
+      header.altstp = altstp;
+      header.dt = params->dt;
+      header.dlon = params->dlon;
+      header.dtheta = params->dtheta;
+      header.df107 = params->df107;
+
+      if (ftruncate(w->fd, (off_t) w->size) != 0)
+        return -1;
+
+      if (pwrite(w->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header))
+        return -1;
+
+      return 0;
+    }
+
+  if ((size_t) st.st_size != w->size)
+    return -1;
+
+  if (pread(w->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header))
+    return -1;
+
+  if (memcmp(header.magic, SIGMA_CACHE_MAGIC, 8) != 0 ||
+      header.version != SIGMA_CACHE_VERSION ||
+      header.nslots != params->nslots ||
+      header.nalt != w->nalt ||
+      fabs(header.altmin - altmin) > 1.0e-9 ||
+      fabs(header.altstp - altstp) > 1.0e-9 ||
+      header.dt != params->dt ||
+      header.dlon != params->dlon ||
+      header.dtheta != params->dtheta ||
+      header.df107 != params->df107)
+    return -1;
+
+  return 0;
+} /* sigma_cache_init() */
+
+static size_t
+sigma_cache_hash(const sigma_cache_key *key, const size_t nslots)
+{
+  unsigned long h = 14695981039346656037UL;
+
+  h = (h ^ (unsigned long) key->t) * 1099511628211UL;
+  h = (h ^ (unsigned long) key->lon) * 1099511628211UL;
+  h = (h ^ (unsigned long) key->theta) * 1099511628211UL;
+  h = (h ^ (unsigned long) key->f107) * 1099511628211UL;
+
+  return (size_t) (h % nslots);
+}
+
+static int
+sigma_cache_equal(const sigma_cache_key *a, const sigma_cache_key *b)
+{
+  return (a->t == b->t && a->lon == b->lon &&
+          a->theta == b->theta && a->f107 == b->f107);
+}
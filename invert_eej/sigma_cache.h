@@ -0,0 +1,97 @@
+/*
+ * sigma_cache.h
+ */
+
+#ifndef INCLUDED_sigma_cache_h
+#define INCLUDED_sigma_cache_h
+
+#include <stddef.h>
+
+#define SIGMA_CACHE_MAGIC          "SIGCACHE"
+#define SIGMA_CACHE_VERSION        2
+
+/* size of file header; profile table starts at this offset */
+#define SIGMA_CACHE_HEADER_SIZE    4096
+
+/* maximum number of slots to probe during lookup/insert */
+#define SIGMA_CACHE_MAX_PROBE      64
+
+/* slot states, stored in the low bits of the slot state word */
+#define SIGMA_CACHE_EMPTY          0
+#define SIGMA_CACHE_BUSY           1
+#define SIGMA_CACHE_VALID          2
+#define SIGMA_CACHE_FLAG_MASK      3
+
+/* seconds after which a busy slot is assumed to be left by a killed writer */
+#define SIGMA_CACHE_BUSY_TIMEOUT   60
+
+typedef struct
+{
+  size_t nslots;     /* number of table slots */
+  double dt;         /* time bucket width (seconds) */
+  double dlon;       /* longitude bin width (radians) */
+  double dtheta;     /* colatitude bin width (radians) */
+  double df107;      /* F10.7 bin width (sfu) */
+  int interp;        /* interpolate linearly in colatitude between bins */
+} sigma_cache_parameters;
+
+/* quantized key of a conductivity profile */
+typedef struct
+{
+  long t;            /* time bucket */
+  int lon;           /* longitude bin */
+  int theta;         /* colatitude bin */
+  int f107;          /* F10.7 bin */
+  int pad;
+} sigma_cache_key;
+
+/* table slot; followed in the file by s0, s1 and s2 profiles of length nalt */
+typedef struct
+{
+  long state;        /* SIGMA_CACHE_xxx; a busy slot also holds (claim time << 2) */
+  sigma_cache_key key;
+} sigma_cache_entry;
+
+/* file header, stored at offset 0 */
+typedef struct
+{
+  char magic[8];
+  int version;
+  int pad;
+  size_t nslots;
+  size_t nalt;
+  double altmin;     /* minimum altitude (km) */
+  double altstp;     /* altitude step (km) */
+  double dt;
+  double dlon;
+  double dtheta;
+  double df107;
+} sigma_cache_header;
+
+typedef struct
+{
+  sigma_cache_parameters params;
+  size_t nalt;       /* number of altitude points in each profile */
+  size_t slot_size;  /* bytes per slot */
+  size_t size;       /* size of mapped file in bytes */
+  int fd;            /* file descriptor */
+  char *map;         /* mapped file */
+} sigma_cache_workspace;
+
+/*
+ * Prototypes
+ */
+
+sigma_cache_parameters sigma_cache_default_parameters(void);
+sigma_cache_workspace *sigma_cache_alloc(const char *filename,
+                                         const sigma_cache_parameters *params,
+                                         const size_t nalt, const double altmin,
+                                         const double altstp);
+void sigma_cache_free(sigma_cache_workspace *w);
+int sigma_cache_lookup(const sigma_cache_key *key, double *s0, double *s1,
+                       double *s2, sigma_cache_workspace *w);
+int sigma_cache_insert(const sigma_cache_key *key, const double *s0,
+                       const double *s1, const double *s2,
+                       sigma_cache_workspace *w);
+
+#endif /* INCLUDED_sigma_cache_h */
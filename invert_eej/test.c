@@ -0,0 +1,586 @@
+/*
+ * test.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_test.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_spmatrix.h>
+
+#include <indices/indices.h>
+
+#include <common/common.h>
+
+#include "pde.h"
+#include "pde_solver.h"
+#include "sigma.h"
+#include "sigma_cache.h"
+
+/* same domain as mag_alloc() on a smaller grid */
+static void
+test_pde_params(const size_t model_nprocs, pde_parameters *params)
+{
+  memset(params, 0, sizeof(pde_parameters));
+  params->rmin = (R_EARTH_KM + 65.0) * 1.0e3;
+  params->rmax = (R_EARTH_KM + 500.0) * 1.0e3;
+  params->nr = 50;
+  params->theta_min = 65.0 * M_PI / 180.0;
+  params->theta_max = 115.0 * M_PI / 180.0;
+  params->ntheta = 31;
+  params->f107_file = F107_IDX_FILE;
+  params->model_nprocs = model_nprocs;
+  params->solver_params = pde_solver_default_parameters();
+}
+
+/* compare results of model server pool against serial evaluation */
+static int
+test_pool(const time_t t, const double longitude)
+{
+  int s = 0;
+  const size_t nprocs = 3;
+  pde_parameters params;
+  pde_workspace *pde_serial, *pde_pool;
+  size_t i, j;
+
+  test_pde_params(0, &params);
+  pde_serial = pde_alloc(&params);
+
+  test_pde_params(nprocs, &params);
+  pde_pool = pde_alloc(&params);
+
+  /* sigma_calc() */
+  s += sigma_calc(t, longitude, pde_serial->sigma_workspace_p);
+  s += sigma_calc(t, longitude, pde_pool->sigma_workspace_p);
+
+  for (i = 0; i < params.nr; ++i)
+    {
+      for (j = 0; j < params.ntheta; ++j)
+        {
+          double a0, a1, a2, b0, b1, b2;
+
+          sigma_result(i, j, &a0, &a1, &a2, pde_serial->sigma_workspace_p);
+          sigma_result(i, j, &b0, &b1, &b2, pde_pool->sigma_workspace_p);
+
+          gsl_test_rel(b0, a0, 1.0e-14, "pool sigma_0 i=%zu j=%zu", i, j);
+          gsl_test_rel(b1, a1, 1.0e-14, "pool sigma_1 i=%zu j=%zu", i, j);
+          gsl_test_rel(b2, a2, 1.0e-14, "pool sigma_2 i=%zu j=%zu", i, j);
+        }
+    }
+
+  /* pde_proc() also evaluates the HWM winds in pde_compute_wind() */
+  s += pde_proc(t, longitude, pde_serial);
+  s += pde_proc(t, longitude, pde_pool);
+
+  for (i = 0; i < params.nr * params.ntheta; ++i)
+    {
+      gsl_test_rel(pde_pool->zwind[i], pde_serial->zwind[i], 1.0e-14, "pool zwind k=%zu", i);
+      gsl_test_rel(pde_pool->mwind[i], pde_serial->mwind[i], 1.0e-14, "pool mwind k=%zu", i);
+    }
+
+  for (j = 0; j < params.ntheta; ++j)
+    {
+      gsl_test_rel(gsl_vector_get(pde_pool->J_lat_E, j),
+                   gsl_vector_get(pde_serial->J_lat_E, j), 1.0e-10, "pool J_lat_E j=%zu", j);
+      gsl_test_rel(gsl_vector_get(pde_pool->J_lat_u, j),
+                   gsl_vector_get(pde_serial->J_lat_u, j), 1.0e-10, "pool J_lat_u j=%zu", j);
+    }
+
+  pde_free(pde_serial);
+  pde_free(pde_pool);
+
+  return s;
+}
+
+/* fill profiles of a test key with values unique to the key */
+static void
+test_cache_profile(const sigma_cache_key *key, const size_t nalt,
+                   double *s0, double *s1, double *s2)
+{
+  size_t i;
+
+  for (i = 0; i < nalt; ++i)
+    {
+      double x = key->t + 1.0e-3 * key->lon + 1.0e-6 * key->theta + 1.0e-9 * i;
+
+      s0[i] = x;
+      s1[i] = -x;
+      s2[i] = 2.0 * x + key->f107;
+    }
+}
+
+/*
+ * insert/lookup round trip on a small table (so that probing wraps
+ * around), persistence across reopening, and rejection of files
+ * with a different grid, bin widths or a corrupt header
+ */
+static int
+test_sigma_cache(void)
+{
+  int s = 0;
+  const size_t nalt = 20;
+  const double altmin = 80.0;
+  const double altstp = 5.0;
+  const size_t nkeys = 48;
+  char filename[] = "/tmp/sigma_cache_test_XXXXXX";
+  sigma_cache_parameters params = sigma_cache_default_parameters();
+  sigma_cache_parameters params2;
+  sigma_cache_workspace *w;
+  sigma_cache_key key;
+  double s0[20], s1[20], s2[20];
+  double t0[20], t1[20], t2[20];
+  size_t i, j;
+  int fd;
+
+  fd = mkstemp(filename);
+  if (fd < 0)
+    return -1;
+
+  close(fd);
+
+  params.nslots = 64;
+
+  w = sigma_cache_alloc(filename, &params, nalt, altmin, altstp);
+  gsl_test(w == NULL, "sigma_cache_alloc new file");
+  if (!w)
+    {
+      unlink(filename);
+      return -1;
+    }
+
+  memset(&key, 0, sizeof(key));
+
+  for (i = 0; i < nkeys; ++i)
+    {
+      key.t = 1000 + (long) i;
+      key.lon = (int) (i % 7);
+      key.theta = (int) (i % 5) - 2;
+      key.f107 = 150;
+
+      test_cache_profile(&key, nalt, s0, s1, s2);
+      s += sigma_cache_insert(&key, s0, s1, s2, w);
+
+      /* inserting the same key again is a no-op */
+      s += sigma_cache_insert(&key, s0, s1, s2, w);
+    }
+
+  for (i = 0; i < nkeys; ++i)
+    {
+      key.t = 1000 + (long) i;
+      key.lon = (int) (i % 7);
+      key.theta = (int) (i % 5) - 2;
+      key.f107 = 150;
+
+      test_cache_profile(&key, nalt, s0, s1, s2);
+      gsl_test(sigma_cache_lookup(&key, t0, t1, t2, w) != 1, "sigma_cache lookup i=%zu", i);
+
+      for (j = 0; j < nalt; ++j)
+        {
+          gsl_test(t0[j] != s0[j], "sigma_cache s0 i=%zu j=%zu", i, j);
+          gsl_test(t1[j] != s1[j], "sigma_cache s1 i=%zu j=%zu", i, j);
+          gsl_test(t2[j] != s2[j], "sigma_cache s2 i=%zu j=%zu", i, j);
+        }
+    }
+
+  /* key which differs only in F10.7 bin */
+  key.f107 = 151;
+  gsl_test(sigma_cache_lookup(&key, t0, t1, t2, w) != 0, "sigma_cache lookup missing key");
+
+  sigma_cache_free(w);
+
+  /* reopen with the same configuration and find the stored profiles */
+  w = sigma_cache_alloc(filename, &params, nalt, altmin, altstp);
+  gsl_test(w == NULL, "sigma_cache_alloc existing file");
+  if (w)
+    {
+      key.t = 1000 + (long) (nkeys - 1);
+      key.lon = (int) ((nkeys - 1) % 7);
+      key.theta = (int) ((nkeys - 1) % 5) - 2;
+      key.f107 = 150;
+
+      test_cache_profile(&key, nalt, s0, s1, s2);
+      gsl_test(sigma_cache_lookup(&key, t0, t1, t2, w) != 1 ||
+               memcmp(t2, s2, nalt * sizeof(double)) != 0, "sigma_cache lookup after reopen");
+
+      sigma_cache_free(w);
+    }
+
+  /* incompatible configurations must be rejected */
+  w = sigma_cache_alloc(filename, &params, nalt + 1, altmin, altstp);
+  gsl_test(w != NULL, "sigma_cache_alloc different nalt");
+  if (w)
+    sigma_cache_free(w);
+
+  w = sigma_cache_alloc(filename, &params, nalt, altmin + altstp, altstp);
+  gsl_test(w != NULL, "sigma_cache_alloc different altmin");
+  if (w)
+    sigma_cache_free(w);
+
+  params2 = params;
+  params2.dt *= 2.0;
+  w = sigma_cache_alloc(filename, &params2, nalt, altmin, altstp);
+  gsl_test(w != NULL, "sigma_cache_alloc different dt");
+  if (w)
+    sigma_cache_free(w);
+
+  /* corrupt the magic string */
+  fd = open(filename, O_WRONLY);
+  if (fd >= 0)
+    {
+      s += (pwrite(fd, "XXXXXXXX", 8, 0) != 8);
+      close(fd);
+    }
+
+  w = sigma_cache_alloc(filename, &params, nalt, altmin, altstp);
+  gsl_test(w != NULL, "sigma_cache_alloc bad header");
+  if (w)
+    sigma_cache_free(w);
+
+  unlink(filename);
+
+  return s;
+} /* test_sigma_cache() */
+
+/* set the state word of every slot in the table */
+static void
+test_cache_set_state(const long state, sigma_cache_workspace *w)
+{
+  size_t i;
+
+  for (i = 0; i < w->params.nslots; ++i)
+    {
+      char *ptr = w->map + SIGMA_CACHE_HEADER_SIZE + i * w->slot_size;
+      ((sigma_cache_entry *) ptr)->state = state;
+    }
+}
+
+/*
+ * a table whose slots are all busy rejects inserts, unless the slots
+ * were claimed longer than SIGMA_CACHE_BUSY_TIMEOUT ago by a writer
+ * which never finished
+ */
+static int
+test_sigma_cache_busy(void)
+{
+  int s = 0;
+  const size_t nalt = 20;
+  const long now = (long) time(NULL);
+  char filename[] = "/tmp/sigma_cache_busy_XXXXXX";
+  sigma_cache_parameters params = sigma_cache_default_parameters();
+  sigma_cache_workspace *w;
+  sigma_cache_key key;
+  double s0[20], s1[20], s2[20];
+  double t0[20], t1[20], t2[20];
+  int fd;
+
+  fd = mkstemp(filename);
+  if (fd < 0)
+    return -1;
+
+  close(fd);
+
+  params.nslots = 16;
+
+  w = sigma_cache_alloc(filename, &params, nalt, 80.0, 5.0);
+  if (!w)
+    {
+      unlink(filename);
+      return -1;
+    }
+
+  memset(&key, 0, sizeof(key));
+  key.t = 1000;
+  key.lon = 3;
+  key.theta = -1;
+  key.f107 = 150;
+  test_cache_profile(&key, nalt, s0, s1, s2);
+
+  /* slots being written by live processes */
+  test_cache_set_state((now << 2) | SIGMA_CACHE_BUSY, w);
+  gsl_test(sigma_cache_insert(&key, s0, s1, s2, w) != -1, "sigma_cache insert into busy table");
+  gsl_test(sigma_cache_lookup(&key, t0, t1, t2, w) != 0, "sigma_cache lookup in busy table");
+
+  /* slots left by killed writers */
+  test_cache_set_state(((now - 2 * SIGMA_CACHE_BUSY_TIMEOUT) << 2) | SIGMA_CACHE_BUSY, w);
+  s += sigma_cache_insert(&key, s0, s1, s2, w);
+  gsl_test(sigma_cache_lookup(&key, t0, t1, t2, w) != 1 ||
+           memcmp(t0, s0, nalt * sizeof(double)) != 0 ||
+           memcmp(t1, s1, nalt * sizeof(double)) != 0 ||
+           memcmp(t2, s2, nalt * sizeof(double)) != 0, "sigma_cache lookup in reclaimed slot");
+
+  sigma_cache_free(w);
+  unlink(filename);
+
+  return s;
+} /* test_sigma_cache_busy() */
+
+/*
+ * run sigma_calc() without a cache, then twice with a new cache file:
+ * the first cached run computes and stores the bin profiles and the
+ * second reads them back, so the two must agree exactly, and the
+ * profiles interpolated between bins must match the uncached ones
+ */
+static int
+test_sigma_calc_cache(const time_t t, const double longitude)
+{
+  int s = 0;
+  const double tol = 1.0e-3;
+  char filename[] = "/tmp/sigma_calc_cache_XXXXXX";
+  sigma_cache_parameters cache_params = sigma_cache_default_parameters();
+  pde_parameters params;
+  pde_workspace *w;
+  sigma_workspace *sigma_p;
+  gsl_matrix *S[3], *C[3];
+  size_t i, j, k;
+  int fd;
+
+  fd = mkstemp(filename);
+  if (fd < 0)
+    return -1;
+
+  close(fd);
+
+  test_pde_params(0, &params);
+  w = pde_alloc(&params);
+  sigma_p = w->sigma_workspace_p;
+
+  for (k = 0; k < 3; ++k)
+    {
+      S[k] = gsl_matrix_alloc(params.nr, params.ntheta);
+      C[k] = gsl_matrix_alloc(params.nr, params.ntheta);
+    }
+
+  /* uncached */
+  s += sigma_calc(t, longitude, sigma_p);
+  gsl_matrix_memcpy(S[0], sigma_p->s0);
+  gsl_matrix_memcpy(S[1], sigma_p->s1);
+  gsl_matrix_memcpy(S[2], sigma_p->s2);
+
+  s += sigma_set_cache(filename, &cache_params, sigma_p);
+
+  /* cache misses; profiles are computed and stored */
+  s += sigma_calc(t, longitude, sigma_p);
+  gsl_matrix_memcpy(C[0], sigma_p->s0);
+  gsl_matrix_memcpy(C[1], sigma_p->s1);
+  gsl_matrix_memcpy(C[2], sigma_p->s2);
+
+  /* cache hits */
+  s += sigma_calc(t, longitude, sigma_p);
+
+  for (i = 0; i < params.nr; ++i)
+    {
+      for (j = 0; j < params.ntheta; ++j)
+        {
+          gsl_test(gsl_matrix_get(sigma_p->s0, i, j) != gsl_matrix_get(C[0], i, j),
+                   "sigma_calc cache hit sigma_0 i=%zu j=%zu", i, j);
+          gsl_test(gsl_matrix_get(sigma_p->s1, i, j) != gsl_matrix_get(C[1], i, j),
+                   "sigma_calc cache hit sigma_1 i=%zu j=%zu", i, j);
+          gsl_test(gsl_matrix_get(sigma_p->s2, i, j) != gsl_matrix_get(C[2], i, j),
+                   "sigma_calc cache hit sigma_2 i=%zu j=%zu", i, j);
+        }
+    }
+
+  /* interpolated against uncached, relative to the largest conductivity */
+  for (k = 0; k < 3; ++k)
+    {
+      double smax = GSL_MAX(fabs(gsl_matrix_max(S[k])), fabs(gsl_matrix_min(S[k])));
+      double err = 0.0;
+
+      for (i = 0; i < params.nr; ++i)
+        {
+          for (j = 0; j < params.ntheta; ++j)
+            err = GSL_MAX(err, fabs(gsl_matrix_get(C[k], i, j) - gsl_matrix_get(S[k], i, j)));
+        }
+
+      gsl_test(err > tol * smax, "sigma_calc cached sigma_%zu error = %.2e (max %.2e)", k, err, smax);
+    }
+
+  for (k = 0; k < 3; ++k)
+    {
+      gsl_matrix_free(S[k]);
+      gsl_matrix_free(C[k]);
+    }
+
+  pde_free(w);
+  unlink(filename);
+
+  return s;
+} /* test_sigma_calc_cache() */
+
+/*
+test_matrix_triplet()
+  Reference assembly of the PDE matrix from w->DC, one element at
+a time into a triplet matrix
+*/
+
+static gsl_spmatrix *
+test_matrix_triplet(const pde_workspace *w)
+{
+  const size_t nrt = w->nr * w->ntheta;
+  gsl_spmatrix *T = gsl_spmatrix_alloc(nrt, nrt);
+  size_t i, j, k;
+
+  /* interior theta grid points */
+  for (i = 0; i < w->nr; ++i)
+    {
+      for (j = 1; j < w->ntheta - 1; ++j)
+        {
+          k = PDE_IDX(i, j, w);
+
+          gsl_spmatrix_set(T, k, PDE_IDX(i, j - 1, w), w->DC[1][k]);
+          gsl_spmatrix_set(T, k, PDE_IDX(i, j, w), w->DC[4][k]);
+          gsl_spmatrix_set(T, k, PDE_IDX(i, j + 1, w), w->DC[7][k]);
+
+          if (i > 0)
+            {
+              gsl_spmatrix_set(T, k, PDE_IDX(i - 1, j - 1, w), w->DC[0][k]);
+              gsl_spmatrix_set(T, k, PDE_IDX(i - 1, j, w), w->DC[3][k]);
+              gsl_spmatrix_set(T, k, PDE_IDX(i - 1, j + 1, w), w->DC[6][k]);
+            }
+
+          if (i < w->nr - 1)
+            {
+              gsl_spmatrix_set(T, k, PDE_IDX(i + 1, j - 1, w), w->DC[2][k]);
+              gsl_spmatrix_set(T, k, PDE_IDX(i + 1, j, w), w->DC[5][k]);
+              gsl_spmatrix_set(T, k, PDE_IDX(i + 1, j + 1, w), w->DC[8][k]);
+            }
+        }
+    }
+
+  /* theta boundaries */
+  for (i = 0; i < w->nr; ++i)
+    {
+      /* northern boundary */
+      j = 0;
+      k = PDE_IDX(i, j, w);
+
+      gsl_spmatrix_set(T, k, PDE_IDX(i, j, w), w->DC[1][k] + w->DC[4][k]);
+      gsl_spmatrix_set(T, k, PDE_IDX(i, j + 1, w), w->DC[7][k]);
+
+      if (i > 0)
+        {
+          gsl_spmatrix_set(T, k, PDE_IDX(i - 1, j, w), w->DC[0][k] + w->DC[3][k]);
+          gsl_spmatrix_set(T, k, PDE_IDX(i - 1, j + 1, w), w->DC[6][k]);
+        }
+
+      if (i < w->nr - 1)
+        {
+          gsl_spmatrix_set(T, k, PDE_IDX(i + 1, j, w), w->DC[2][k] + w->DC[5][k]);
+          gsl_spmatrix_set(T, k, PDE_IDX(i + 1, j + 1, w), w->DC[8][k]);
+        }
+
+      /* southern boundary */
+      j = w->ntheta - 1;
+      k = PDE_IDX(i, j, w);
+
+      gsl_spmatrix_set(T, k, PDE_IDX(i, j - 1, w), w->DC[1][k]);
+      gsl_spmatrix_set(T, k, PDE_IDX(i, j, w), w->DC[4][k] + w->DC[7][k]);
+
+      if (i > 0)
+        {
+          gsl_spmatrix_set(T, k, PDE_IDX(i - 1, j - 1, w), w->DC[0][k]);
+          gsl_spmatrix_set(T, k, PDE_IDX(i - 1, j, w), w->DC[3][k] + w->DC[6][k]);
+        }
+
+      if (i < w->nr - 1)
+        {
+          gsl_spmatrix_set(T, k, PDE_IDX(i + 1, j - 1, w), w->DC[2][k]);
+          gsl_spmatrix_set(T, k, PDE_IDX(i + 1, j, w), w->DC[5][k] + w->DC[8][k]);
+        }
+    }
+
+  return T;
+} /* test_matrix_triplet() */
+
+/*
+ * compare the compressed row matrix built by pde_matrix(), and its
+ * compressed column copy from pde_solver_ccs(), against the triplet
+ * assembly; both must contain exactly the triplet elements, with
+ * strictly increasing indices within each row/column
+ */
+static int
+test_matrix(const time_t t, const double longitude)
+{
+  int s = 0;
+  pde_parameters params;
+  pde_workspace *w;
+  gsl_spmatrix *T, *C;
+  size_t i, k;
+
+  test_pde_params(0, &params);
+  params.nr = 12;
+  params.ntheta = 9;
+  w = pde_alloc(&params);
+
+  /* pde_proc() leaves the coefficients w->DC and matrix w->S of the last solve */
+  s += pde_proc(t, longitude, w);
+
+  T = test_matrix_triplet(w);
+  C = pde_solver_ccs(w->S);
+
+  gsl_test(!GSL_SPMATRIX_ISCRS(w->S), "matrix format");
+  gsl_test(C == NULL, "pde_solver_ccs");
+  gsl_test(w->S->nz != T->nz, "matrix nz %zu/%zu", w->S->nz, T->nz);
+
+  for (i = 0; i < w->S->size1; ++i)
+    {
+      for (k = w->S->p[i]; k < w->S->p[i + 1]; ++k)
+        {
+          size_t j = w->S->i[k];
+
+          gsl_test(k > w->S->p[i] && j <= w->S->i[k - 1], "matrix row %zu sorted", i);
+          gsl_test(w->S->data[k] != gsl_spmatrix_get(T, i, j),
+                   "matrix CRS (%zu,%zu) = %.12e/%.12e", i, j,
+                   w->S->data[k], gsl_spmatrix_get(T, i, j));
+        }
+    }
+
+  if (C)
+    {
+      size_t j;
+
+      gsl_test(C->nz != T->nz, "matrix CCS nz %zu/%zu", C->nz, T->nz);
+
+      for (j = 0; j < C->size2; ++j)
+        {
+          for (k = C->p[j]; k < C->p[j + 1]; ++k)
+            {
+              i = C->i[k];
+
+              gsl_test(k > C->p[j] && i <= C->i[k - 1], "matrix column %zu sorted", j);
+              gsl_test(C->data[k] != gsl_spmatrix_get(T, i, j),
+                       "matrix CCS (%zu,%zu) = %.12e/%.12e", i, j,
+                       C->data[k], gsl_spmatrix_get(T, i, j));
+            }
+        }
+
+      gsl_spmatrix_free(C);
+    }
+
+  gsl_spmatrix_free(T);
+  pde_free(w);
+
+  return s;
+} /* test_matrix() */
+
+int
+main()
+{
+  const time_t t = 1112076000; /* Mar 29 06:00:00 2005 */
+  const double longitude = 280.0 * M_PI / 180.0;
+
+  gsl_test(test_sigma_cache(), "sigma cache");
+  gsl_test(test_sigma_cache_busy(), "sigma cache busy slots");
+  gsl_test(test_sigma_calc_cache(t, longitude), "sigma_calc with cache");
+  gsl_test(test_matrix(t, longitude), "PDE matrix assembly");
+  gsl_test(test_pool(t, longitude), "model pool");
+
+  exit (gsl_test_summary());
+} /* main() */
@@ -0,0 +1,340 @@
+/*
+ * lapack_rsvd.c
+ *
+ * Randomized truncated SVD (Halko, Martinsson and Tropp, 2011)
+ *
+ * For an M-by-N matrix A, the leading k singular triplets are computed
+ * from a random sketch of the range of A:
+ *
+ * 1. Y = A Omega, with Omega an N-by-l Gaussian matrix, l = k + p
+ * 2. q power iterations Y = A (A^H Y) to sharpen the spectrum
+ * 3. Q = orth(Y), B = Q^H A (l-by-N)
+ * 4. B = Ub S V^H (small SVD), U = Q Ub
+ *
+ * The cost is O(M N l (q + 1)) instead of O(M N min(M,N)) for the
+ * full SVD.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <lapacke/lapacke.h>
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_complex.h>
+#include <gsl/gsl_complex_math.h>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+#include <gsl/gsl_errno.h>
+
+#include "lapack_wrapper.h"
+
+static int rsvd_orth(gsl_matrix * Y);
+static int rsvd_complex_orth(gsl_matrix_complex * Y);
+
+/*
+lapack_svd_rand()
+  Compute leading k singular triplets of M-by-N matrix A with a
+randomized range finder
+
+Inputs: A - M-by-N matrix
+        p - oversampling parameter (5 to 10 is usually sufficient)
+        q - number of power iterations (1 or 2 for slowly decaying spectra)
+        S - (output) k vector of leading singular values
+        U - (output) M-by-k matrix of left singular vectors
+        V - (output) N-by-k matrix of right singular vectors
+
+Return: success/error
+
+Notes:
+1) k is given by the length of S
+
+2) The random test matrix uses a fixed seed, so results are reproducible
+*/
+
+int
+lapack_svd_rand(const gsl_matrix * A, const size_t p, const size_t q,
+                gsl_vector * S, gsl_matrix * U, gsl_matrix * V)
+{
+  const size_t M = A->size1;
+  const size_t N = A->size2;
+  const size_t k = S->size;
+  const size_t l = GSL_MIN(k + p, GSL_MIN(M, N));
+
+  if (k > l)
+    {
+      GSL_ERROR ("k must be less than or equal to min(M,N)", GSL_EBADLEN);
+    }
+  else if ((U->size1 != M) || (U->size2 != k))
+    {
+      GSL_ERROR ("U matrix must be M-by-k", GSL_EBADLEN);
+    }
+  else if ((V->size1 != N) || (V->size2 != k))
+    {
+      GSL_ERROR ("V matrix must be N-by-k", GSL_EBADLEN);
+    }
+  else
+    {
+      int s = 0;
+      gsl_rng *r = gsl_rng_alloc(gsl_rng_default);
+      gsl_matrix *Omega = gsl_matrix_alloc(N, l);
+      gsl_matrix *Y = gsl_matrix_alloc(M, l);
+      gsl_matrix *Z = gsl_matrix_alloc(N, l);
+      gsl_matrix *Bt = gsl_matrix_alloc(N, l);  /* B^T, column-major B */
+      gsl_matrix *Ubt = gsl_matrix_alloc(l, l); /* Ub^T, column-major Ub */
+      gsl_matrix *W = gsl_matrix_alloc(N, l);   /* column-major V^T */
+      gsl_vector *work_S = gsl_vector_alloc(l);
+      gsl_matrix_view Ubk = gsl_matrix_submatrix(Ubt, 0, 0, k, l);
+      gsl_matrix_view Wk = gsl_matrix_submatrix(W, 0, 0, N, k);
+      gsl_vector_view Sk = gsl_vector_subvector(work_S, 0, k);
+      size_t i, j;
+
+      /* Gaussian test matrix */
+      for (i = 0; i < N; ++i)
+        {
+          for (j = 0; j < l; ++j)
+            gsl_matrix_set(Omega, i, j, gsl_ran_gaussian(r, 1.0));
+        }
+
+      /* Y = orth(A Omega) */
+      gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1.0, A, Omega, 0.0, Y);
+      s += rsvd_orth(Y);
+
+      /* power iterations, re-orthogonalizing at each step for stability */
+      for (i = 0; i < q; ++i)
+        {
+          gsl_blas_dgemm(CblasTrans, CblasNoTrans, 1.0, A, Y, 0.0, Z);
+          s += rsvd_orth(Z);
+
+          gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1.0, A, Z, 0.0, Y);
+          s += rsvd_orth(Y);
+        }
+
+      /* B^T = A^T Y (N-by-l), which is B in column-major storage */
+      gsl_blas_dgemm(CblasTrans, CblasNoTrans, 1.0, A, Y, 0.0, Bt);
+
+      /* SVD of small l-by-N matrix B */
+      s += LAPACKE_dgesdd(LAPACK_COL_MAJOR,
+                          'S',
+                          (lapack_int) l,
+                          (lapack_int) N,
+                          Bt->data,
+                          (lapack_int) l,
+                          work_S->data,
+                          Ubt->data,
+                          (lapack_int) l,
+                          W->data,
+                          (lapack_int) l);
+
+      /* U = Y Ub(:,1:k), V = (V^T)^T(:,1:k) */
+      gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, Y, &Ubk.matrix, 0.0, U);
+      gsl_matrix_memcpy(V, &Wk.matrix);
+      gsl_vector_memcpy(S, &Sk.vector);
+
+      gsl_rng_free(r);
+      gsl_matrix_free(Omega);
+      gsl_matrix_free(Y);
+      gsl_matrix_free(Z);
+      gsl_matrix_free(Bt);
+      gsl_matrix_free(Ubt);
+      gsl_matrix_free(W);
+      gsl_vector_free(work_S);
+
+      return s;
+    }
+}
+
+/*
+lapack_complex_svd_rand()
+  Compute leading k singular triplets of complex M-by-N matrix A with
+a randomized range finder
+
+Inputs: A - M-by-N complex matrix
+        p - oversampling parameter (5 to 10 is usually sufficient)
+        q - number of power iterations (1 or 2 for slowly decaying spectra)
+        S - (output) k vector of leading singular values
+        U - (output) M-by-k complex matrix of left singular vectors
+        V - (output) N-by-k complex matrix of right singular vectors
+
+Return: success/error
+
+Notes:
+1) k is given by the length of S
+
+2) A ~= U diag(S) V^H
+
+3) The random test matrix uses a fixed seed, so results are reproducible
+*/
+
+int
+lapack_complex_svd_rand(const gsl_matrix_complex * A, const size_t p, const size_t q,
+                        gsl_vector * S, gsl_matrix_complex * U, gsl_matrix_complex * V)
+{
+  const size_t M = A->size1;
+  const size_t N = A->size2;
+  const size_t k = S->size;
+  const size_t l = GSL_MIN(k + p, GSL_MIN(M, N));
+
+  if (k > l)
+    {
+      GSL_ERROR ("k must be less than or equal to min(M,N)", GSL_EBADLEN);
+    }
+  else if ((U->size1 != M) || (U->size2 != k))
+    {
+      GSL_ERROR ("U matrix must be M-by-k", GSL_EBADLEN);
+    }
+  else if ((V->size1 != N) || (V->size2 != k))
+    {
+      GSL_ERROR ("V matrix must be N-by-k", GSL_EBADLEN);
+    }
+  else
+    {
+      int s = 0;
+      const gsl_complex one = GSL_COMPLEX_ONE;
+      const gsl_complex zero = GSL_COMPLEX_ZERO;
+      const double sigma = M_SQRT1_2; /* unit variance complex Gaussian */
+      gsl_rng *r = gsl_rng_alloc(gsl_rng_default);
+      gsl_matrix_complex *Omega = gsl_matrix_complex_alloc(N, l);
+      gsl_matrix_complex *Y = gsl_matrix_complex_alloc(M, l);
+      gsl_matrix_complex *Z = gsl_matrix_complex_alloc(N, l);
+      gsl_matrix_complex *B = gsl_matrix_complex_alloc(l, N);
+      gsl_matrix_complex *Bt = gsl_matrix_complex_alloc(N, l);  /* column-major B */
+      gsl_matrix_complex *Ubt = gsl_matrix_complex_alloc(l, l); /* column-major Ub */
+      gsl_matrix_complex *W = gsl_matrix_complex_alloc(N, l);   /* column-major V^H */
+      gsl_vector *work_S = gsl_vector_alloc(l);
+      gsl_matrix_complex_view Ubk = gsl_matrix_complex_submatrix(Ubt, 0, 0, k, l);
+      gsl_vector_view Sk = gsl_vector_subvector(work_S, 0, k);
+      size_t i, j;
+
+      /* Gaussian test matrix */
+      for (i = 0; i < N; ++i)
+        {
+          for (j = 0; j < l; ++j)
+            {
+              gsl_complex z = gsl_complex_rect(gsl_ran_gaussian(r, sigma),
+                                               gsl_ran_gaussian(r, sigma));
+              gsl_matrix_complex_set(Omega, i, j, z);
+            }
+        }
+
+      /* Y = orth(A Omega) */
+      gsl_blas_zgemm(CblasNoTrans, CblasNoTrans, one, A, Omega, zero, Y);
+      s += rsvd_complex_orth(Y);
+
+      /* power iterations, re-orthogonalizing at each step for stability */
+      for (i = 0; i < q; ++i)
+        {
+          gsl_blas_zgemm(CblasConjTrans, CblasNoTrans, one, A, Y, zero, Z);
+          s += rsvd_complex_orth(Z);
+
+          gsl_blas_zgemm(CblasNoTrans, CblasNoTrans, one, A, Z, zero, Y);
+          s += rsvd_complex_orth(Y);
+        }
+
+      /* B = Y^H A (l-by-N) */
+      gsl_blas_zgemm(CblasConjTrans, CblasNoTrans, one, Y, A, zero, B);
+      gsl_matrix_complex_transpose_memcpy(Bt, B);
+
+      /* SVD of small l-by-N matrix B */
+      s += LAPACKE_zgesdd(LAPACK_COL_MAJOR,
+                          'S',
+                          (lapack_int) l,
+                          (lapack_int) N,
+                          (lapack_complex_double *) Bt->data,
+                          (lapack_int) l,
+                          work_S->data,
+                          (lapack_complex_double *) Ubt->data,
+                          (lapack_int) l,
+                          (lapack_complex_double *) W->data,
+                          (lapack_int) l);
+
+      /* U = Y Ub(:,1:k) */
+      gsl_blas_zgemm(CblasNoTrans, CblasTrans, one, Y, &Ubk.matrix, zero, U);
+
+      /* W(j,i) = (V^H)(i,j) = conj(V(j,i)) */
+      for (i = 0; i < N; ++i)
+        {
+          for (j = 0; j < k; ++j)
+            {
+              gsl_complex z = gsl_matrix_complex_get(W, i, j);
+              gsl_matrix_complex_set(V, i, j, gsl_complex_conjugate(z));
+            }
+        }
+
+      gsl_vector_memcpy(S, &Sk.vector);
+
+      gsl_rng_free(r);
+      gsl_matrix_complex_free(Omega);
+      gsl_matrix_complex_free(Y);
+      gsl_matrix_complex_free(Z);
+      gsl_matrix_complex_free(B);
+      gsl_matrix_complex_free(Bt);
+      gsl_matrix_complex_free(Ubt);
+      gsl_matrix_complex_free(W);
+      gsl_vector_free(work_S);
+
+      return s;
+    }
+}
+
+/*
+rsvd_orth()
+  Replace columns of M-by-l matrix Y (M >= l) with an orthonormal basis
+for their span, using a Householder QR decomposition
+*/
+
+static int
+rsvd_orth(gsl_matrix * Y)
+{
+  const lapack_int M = (lapack_int) Y->size1;
+  const lapack_int l = (lapack_int) Y->size2;
+  gsl_matrix *work_Y = gsl_matrix_alloc(Y->size2, Y->size1);
+  gsl_vector *tau = gsl_vector_alloc(Y->size2);
+  int s;
+
+  gsl_matrix_transpose_memcpy(work_Y, Y);
+
+  s = LAPACKE_dgeqrf(LAPACK_COL_MAJOR, M, l, work_Y->data, M, tau->data);
+  s += LAPACKE_dorgqr(LAPACK_COL_MAJOR, M, l, l, work_Y->data, M, tau->data);
+
+  gsl_matrix_transpose_memcpy(Y, work_Y);
+
+  gsl_matrix_free(work_Y);
+  gsl_vector_free(tau);
+
+  return s;
+}
+
+/*
+rsvd_complex_orth()
+  Replace columns of complex M-by-l matrix Y (M >= l) with an orthonormal
+basis for their span, using a Householder QR decomposition
+*/
+
+static int
+rsvd_complex_orth(gsl_matrix_complex * Y)
+{
+  const lapack_int M = (lapack_int) Y->size1;
+  const lapack_int l = (lapack_int) Y->size2;
+  gsl_matrix_complex *work_Y = gsl_matrix_complex_alloc(Y->size2, Y->size1);
+  gsl_vector_complex *tau = gsl_vector_complex_alloc(Y->size2);
+  int s;
+
+  gsl_matrix_complex_transpose_memcpy(work_Y, Y);
+
+  s = LAPACKE_zgeqrf(LAPACK_COL_MAJOR, M, l, (lapack_complex_double *) work_Y->data,
+                     M, (lapack_complex_double *) tau->data);
+  s += LAPACKE_zungqr(LAPACK_COL_MAJOR, M, l, l, (lapack_complex_double *) work_Y->data,
+                      M, (lapack_complex_double *) tau->data);
+
+  gsl_matrix_complex_transpose_memcpy(Y, work_Y);
+
+  gsl_matrix_complex_free(work_Y);
+  gsl_vector_complex_free(tau);
+
+  return s;
+}
@@ -87,6 +87,62 @@ lapack_lls(const gsl_matrix * A, const gsl_matrix * B, gsl_matrix * X, int *rank
   return s;
 }
 
+/* minimize || A X - B || for many right hand sides
+ *
+ * The right hand sides are supplied transposed, which is the
+ * column-major layout LAPACK expects, so the (possibly very large)
+ * right hand side matrix is neither copied nor transposed
+ *
+ * Inputs: A    - M-by-N least squares matrix
+ *         Bt   - (input/output) NRHS-by-max(M,N) matrix; on input the
+ *                first M columns contain B^T; on output the first N
+ *                columns contain the solution X^T
+ *         rank - (output) effective rank of A
+ */
+int
+lapack_lls_t(const gsl_matrix * A, gsl_matrix * Bt, int *rank)
+{
+  int s;
+  lapack_int m = A->size1;
+  lapack_int n = A->size2;
+  lapack_int nrhs = Bt->size1;
+  lapack_int lda = A->size1;
+  lapack_int ldb = Bt->tda;
+  lapack_int lrank;
+  lapack_int *jpvt;
+  gsl_matrix *work_A;
+  double rcond = 1.0e-6;
+
+  if (Bt->size2 < GSL_MAX(A->size1, A->size2))
+    {
+      GSL_ERROR ("Bt must have max(M,N) columns", GSL_EBADLEN);
+    }
+
+  jpvt = calloc(n, sizeof(lapack_int));
+  work_A = gsl_matrix_alloc(A->size2, A->size1);
+
+  gsl_matrix_transpose_memcpy(work_A, A);
+
+  s = LAPACKE_dgelsy(LAPACK_COL_MAJOR,
+                     m,
+                     n,
+                     nrhs,
+                     work_A->data,
+                     lda,
+                     Bt->data,
+                     ldb,
+                     jpvt,
+                     rcond,
+                     &lrank);
+
+  *rank = lrank;
+
+  gsl_matrix_free(work_A);
+  free(jpvt);
+
+  return s;
+}
+
 /* minimize || A x - b || */
 int
 lapack_lls2(const gsl_matrix * A, const gsl_vector * b, gsl_vector * x,
@@ -12,6 +12,7 @@
 /* Prototypes */
 
 int lapack_lls(const gsl_matrix * A, const gsl_matrix * B, gsl_matrix * X, int *rank);
+int lapack_lls_t(const gsl_matrix * A, gsl_matrix * Bt, int *rank);
 int lapack_lls2(const gsl_matrix * A, const gsl_vector * b, gsl_vector * x,
                 int *rank);
 int lapack_complex_lls(const gsl_matrix_complex * A, const gsl_matrix_complex * B,
@@ -38,4 +39,10 @@ int lapack_complex_cholesky_invert(gsl_matrix_complex * A);
 int lapack_complex_zposv(const gsl_vector_complex * b, gsl_matrix_complex * A,
                          gsl_vector_complex *x, double * rcond);
 
+/* lapack_rsvd.c */
+int lapack_svd_rand(const gsl_matrix * A, const size_t p, const size_t q,
+                    gsl_vector * S, gsl_matrix * U, gsl_matrix * V);
+int lapack_complex_svd_rand(const gsl_matrix_complex * A, const size_t p, const size_t q,
+                            gsl_vector * S, gsl_matrix_complex * U, gsl_matrix_complex * V);
+
 #endif /* INCLUDED_lapack_wrapper_h */
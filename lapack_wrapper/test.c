@@ -0,0 +1,221 @@
+/*
+ * test.c
+ *
+ * Test randomized SVD against the full/thin LAPACK SVD
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+#include <gsl/gsl_complex.h>
+#include <gsl/gsl_complex_math.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_test.h>
+
+#include "lapack_wrapper.h"
+
+/* construct M-by-N matrix of given rank with singular values decaying as 2^{-i} */
+static void
+random_lowrank(const size_t rank, gsl_matrix *A, gsl_rng *r)
+{
+  const size_t M = A->size1;
+  const size_t N = A->size2;
+  gsl_matrix *X = gsl_matrix_alloc(M, rank);
+  gsl_matrix *Y = gsl_matrix_alloc(rank, N);
+  size_t i, j;
+
+  for (i = 0; i < M; ++i)
+    for (j = 0; j < rank; ++j)
+      gsl_matrix_set(X, i, j, gsl_ran_gaussian(r, 1.0) * pow(0.5, (double) j));
+
+  for (i = 0; i < rank; ++i)
+    for (j = 0; j < N; ++j)
+      gsl_matrix_set(Y, i, j, gsl_ran_gaussian(r, 1.0));
+
+  gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1.0, X, Y, 0.0, A);
+
+  gsl_matrix_free(X);
+  gsl_matrix_free(Y);
+}
+
+static void
+random_complex_lowrank(const size_t rank, gsl_matrix_complex *A, gsl_rng *r)
+{
+  const size_t M = A->size1;
+  const size_t N = A->size2;
+  gsl_matrix_complex *X = gsl_matrix_complex_alloc(M, rank);
+  gsl_matrix_complex *Y = gsl_matrix_complex_alloc(rank, N);
+  size_t i, j;
+
+  for (i = 0; i < M; ++i)
+    {
+      for (j = 0; j < rank; ++j)
+        {
+          double fac = pow(0.5, (double) j);
+          gsl_complex z = gsl_complex_rect(fac * gsl_ran_gaussian(r, 1.0),
+                                           fac * gsl_ran_gaussian(r, 1.0));
+          gsl_matrix_complex_set(X, i, j, z);
+        }
+    }
+
+  for (i = 0; i < rank; ++i)
+    {
+      for (j = 0; j < N; ++j)
+        {
+          gsl_complex z = gsl_complex_rect(gsl_ran_gaussian(r, 1.0),
+                                           gsl_ran_gaussian(r, 1.0));
+          gsl_matrix_complex_set(Y, i, j, z);
+        }
+    }
+
+  gsl_blas_zgemm(CblasNoTrans, CblasNoTrans, GSL_COMPLEX_ONE, X, Y, GSL_COMPLEX_ZERO, A);
+
+  gsl_matrix_complex_free(X);
+  gsl_matrix_complex_free(Y);
+}
+
+static void
+test_svd_rand(const size_t M, const size_t N, const size_t k, gsl_rng *r)
+{
+  const double tol = 1.0e-10;
+  gsl_matrix *A = gsl_matrix_alloc(M, N);
+  gsl_matrix *A_rec = gsl_matrix_alloc(M, N);
+  gsl_vector *S_exact = gsl_vector_alloc(GSL_MIN(M, N));
+  gsl_matrix *U_exact = gsl_matrix_alloc(M, M);
+  gsl_matrix *V_exact = gsl_matrix_alloc(N, N);
+  gsl_vector *S = gsl_vector_alloc(k);
+  gsl_matrix *U = gsl_matrix_alloc(M, k);
+  gsl_matrix *V = gsl_matrix_alloc(N, k);
+  gsl_matrix *US = gsl_matrix_alloc(M, k);
+  size_t i, j;
+
+  /* matrix of rank k, so the randomized SVD is exact up to rounding */
+  random_lowrank(k, A, r);
+
+  lapack_svd(A, S_exact, U_exact, V_exact);
+  lapack_svd_rand(A, 5, 2, S, U, V);
+
+  for (i = 0; i < k; ++i)
+    {
+      gsl_test_rel(gsl_vector_get(S, i), gsl_vector_get(S_exact, i), tol,
+                   "svd_rand M=%zu N=%zu k=%zu S[%zu]", M, N, k, i);
+    }
+
+  /* A = U diag(S) V^T */
+  gsl_matrix_memcpy(US, U);
+  for (j = 0; j < k; ++j)
+    {
+      gsl_vector_view c = gsl_matrix_column(US, j);
+      gsl_vector_scale(&c.vector, gsl_vector_get(S, j));
+    }
+
+  gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, US, V, 0.0, A_rec);
+
+  for (i = 0; i < M; ++i)
+    {
+      for (j = 0; j < N; ++j)
+        {
+          double aij = gsl_matrix_get(A, i, j);
+          double bij = gsl_matrix_get(A_rec, i, j);
+
+          gsl_test_abs(bij, aij, tol * gsl_vector_get(S_exact, 0),
+                       "svd_rand M=%zu N=%zu k=%zu A(%zu,%zu)", M, N, k, i, j);
+        }
+    }
+
+  gsl_matrix_free(A);
+  gsl_matrix_free(A_rec);
+  gsl_vector_free(S_exact);
+  gsl_matrix_free(U_exact);
+  gsl_matrix_free(V_exact);
+  gsl_vector_free(S);
+  gsl_matrix_free(U);
+  gsl_matrix_free(V);
+  gsl_matrix_free(US);
+}
+
+static void
+test_complex_svd_rand(const size_t M, const size_t N, const size_t k, gsl_rng *r)
+{
+  const double tol = 1.0e-10;
+  const size_t minMN = GSL_MIN(M, N);
+  gsl_matrix_complex *A = gsl_matrix_complex_alloc(M, N);
+  gsl_matrix_complex *A_rec = gsl_matrix_complex_alloc(M, N);
+  gsl_vector *S_exact = gsl_vector_alloc(minMN);
+  gsl_matrix_complex *U_exact = gsl_matrix_complex_alloc(M, minMN);
+  gsl_matrix_complex *V_exact = gsl_matrix_complex_alloc(minMN, N);
+  gsl_vector *S = gsl_vector_alloc(k);
+  gsl_matrix_complex *U = gsl_matrix_complex_alloc(M, k);
+  gsl_matrix_complex *V = gsl_matrix_complex_alloc(N, k);
+  gsl_matrix_complex *US = gsl_matrix_complex_alloc(M, k);
+  size_t i, j;
+
+  random_complex_lowrank(k, A, r);
+
+  lapack_complex_svd_thin(A, S_exact, U_exact, V_exact);
+  lapack_complex_svd_rand(A, 5, 2, S, U, V);
+
+  for (i = 0; i < k; ++i)
+    {
+      gsl_test_rel(gsl_vector_get(S, i), gsl_vector_get(S_exact, i), tol,
+                   "complex_svd_rand M=%zu N=%zu k=%zu S[%zu]", M, N, k, i);
+    }
+
+  /* A = U diag(S) V^H */
+  gsl_matrix_complex_memcpy(US, U);
+  for (j = 0; j < k; ++j)
+    {
+      gsl_vector_complex_view c = gsl_matrix_complex_column(US, j);
+      gsl_blas_zdscal(gsl_vector_get(S, j), &c.vector);
+    }
+
+  gsl_blas_zgemm(CblasNoTrans, CblasConjTrans, GSL_COMPLEX_ONE, US, V, GSL_COMPLEX_ZERO, A_rec);
+
+  for (i = 0; i < M; ++i)
+    {
+      for (j = 0; j < N; ++j)
+        {
+          gsl_complex aij = gsl_matrix_complex_get(A, i, j);
+          gsl_complex bij = gsl_matrix_complex_get(A_rec, i, j);
+
+          gsl_test_abs(GSL_REAL(bij), GSL_REAL(aij), tol * gsl_vector_get(S_exact, 0),
+                       "complex_svd_rand M=%zu N=%zu k=%zu real A(%zu,%zu)", M, N, k, i, j);
+          gsl_test_abs(GSL_IMAG(bij), GSL_IMAG(aij), tol * gsl_vector_get(S_exact, 0),
+                       "complex_svd_rand M=%zu N=%zu k=%zu imag A(%zu,%zu)", M, N, k, i, j);
+        }
+    }
+
+  gsl_matrix_complex_free(A);
+  gsl_matrix_complex_free(A_rec);
+  gsl_vector_free(S_exact);
+  gsl_matrix_complex_free(U_exact);
+  gsl_matrix_complex_free(V_exact);
+  gsl_vector_free(S);
+  gsl_matrix_complex_free(U);
+  gsl_matrix_complex_free(V);
+  gsl_matrix_complex_free(US);
+}
+
+int
+main(int argc, char *argv[])
+{
+  gsl_rng *r = gsl_rng_alloc(gsl_rng_default);
+
+  test_svd_rand(50, 20, 5, r);
+  test_svd_rand(20, 50, 5, r);
+  test_svd_rand(200, 30, 10, r);
+
+  test_complex_svd_rand(50, 20, 5, r);
+  test_complex_svd_rand(20, 50, 5, r);
+  test_complex_svd_rand(300, 40, 10, r);
+
+  gsl_rng_free(r);
+
+  exit (gsl_test_summary());
+}
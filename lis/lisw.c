@@ -9,12 +9,16 @@
 #include <math.h>
 #include <string.h>
 
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_errno.h>
 #include <gsl/gsl_blas.h>
 #include <gsl/gsl_spmatrix.h>
 #include <gsl/gsl_spblas.h>
 
 #include "lisw.h"
 
+static int lis_convert_matrix(const gsl_spmatrix *S, LIS_MATRIX A);
+
 lis_workspace *
 lis_alloc(int size1, int size2)
 {
@@ -27,6 +31,8 @@ lis_alloc(int size1, int size2)
   w->size1 = size1;
   w->size2 = size2;
 
+  lis_set_options(LIS_DEFAULT_OPTIONS, w);
+
   return w;
 } /* lis_alloc() */
 
@@ -36,11 +42,38 @@ mylis_free(lis_workspace *w)
   free(w);
 } /* lis_free() */
 
+/*
+lis_set_options()
+  Set the lis solver and preconditioner options, for example
+
+  "-i fgmres -p ilut"                     GMRES with ILUT
+  "-i bicgstab -p ilu -ilu_fill 2"        BiCGSTAB with ILU(2)
+  "-i bicgstab -p saamg -saamg_unsym true" BiCGSTAB with algebraic multigrid
+
+Inputs: options - option string in lis command line syntax
+        w       - workspace
+
+Return: success or GSL_EINVAL if the string is too long
+*/
+
+int
+lis_set_options(const char *options, lis_workspace *w)
+{
+  if (strlen(options) >= LIS_MAX_OPTIONS)
+    {
+      GSL_ERROR("option string too long", GSL_EINVAL);
+    }
+
+  strcpy(w->options, options);
+
+  return GSL_SUCCESS;
+} /* lis_set_options() */
+
 /*
 lis_proc()
   Solve the system A x = b through QR reduction
 
-Inputs: S   - sparse matrix in triplet format
+Inputs: S   - sparse matrix in triplet or compressed row format
         rhs - right hand side vector b
         tol - relative tolerance in solution
         sol - (output) where to store solution x
@@ -75,25 +108,30 @@ lis_proc(const gsl_spmatrix *S, const double *rhs, const double tol,
 
   lis_solver_create(&solver);
 
-  /* set solver parameters */
-  lis_solver_set_option("-i fgmres -p ilut -f double", solver);
+  /* set solver parameters; defaults first so w->options can override them */
   lis_solver_set_option("-maxiter 2000", solver);
+  lis_solver_set_option(w->options, solver);
   lis_solver_set_option("-print 1", solver);
   sprintf(str, "-tol %e\n", tol);
   lis_solver_set_option(str, solver);
   /*lis_solver_set_optionC(solver);*/
 
   /* construct LIS_MATRIX type from A */
-  for (i = 0; i < S->nz; ++i)
-    lis_matrix_set_value(LIS_INS_VALUE, S->i[i], S->p[i], S->data[i], A);
+  s = lis_convert_matrix(S, A);
+  if (s)
+    {
+      lis_matrix_destroy(A);
+      lis_vector_destroy(b);
+      lis_vector_destroy(x);
+      lis_solver_destroy(solver);
+      lis_finalize();
+      return s;
+    }
 
   /* construct RHS */
   for (i = 0; i < w->size1; ++i)
     lis_vector_set_value(LIS_INS_VALUE, i, rhs[i], b);
 
-  lis_matrix_set_type(A, LIS_MATRIX_CSR);
-  lis_matrix_assemble(A);
-
   s = lis_solve(A, b, x, solver);
   s = solver->retcode; /*XXX bug in lis_solve */
 
@@ -101,6 +139,16 @@ lis_proc(const gsl_spmatrix *S, const double *rhs, const double tol,
   if (s != 0)
     fprintf(stderr, "lis_proc: error: status = %d\n", s);
 
+  {
+    LIS_INT iter;
+    double ptime;
+
+    lis_solver_get_iter(solver, &iter);
+    lis_solver_get_ptime(solver, &ptime);
+    w->iter = (int) iter;
+    w->ptime = ptime;
+  }
+
   for (i = 0; i < w->size1; ++i)
     lis_vector_get_value(x, i, &sol[i]);
 
@@ -129,3 +177,226 @@ lis_proc(const gsl_spmatrix *S, const double *rhs, const double tol,
 
   return s;
 } /* lis_proc() */
+
+/*
+lis_proc_multi()
+  Solve the systems A x_k = b_k for multiple right hand sides,
+assembling the lis matrix, solver and preconditioner only once
+
+Inputs: S     - sparse matrix in triplet or compressed row format
+        nrhs  - number of right hand sides
+        rhs   - right hand side vectors b_k, stored consecutively
+                (length size1 * nrhs)
+        tol   - relative tolerance in solution
+        sol   - (output) solution vectors x_k, stored consecutively
+                (length size2 * nrhs)
+        rnorm - (output) residual norms || b_k - A x_k ||, length nrhs
+        w     - workspace
+
+Return: 0 on success, or the first nonzero solver status
+
+Notes:
+1) lis_solve() rebuilds the preconditioner on each call, so the
+preconditioner is built here once with lis_precon_create() and
+each right hand side is solved with lis_solve_kernel()
+
+2) On output, w->iter is the largest iteration count and w->ptime
+the preconditioner setup time
+*/
+
+int
+lis_proc_multi(const gsl_spmatrix *S, const size_t nrhs, const double *rhs,
+               const double tol, double *sol, double *rnorm, lis_workspace *w)
+{
+  int status = 0;
+  size_t nrhs_solve = nrhs;
+  size_t i, k;
+  LIS_MATRIX A;
+  LIS_VECTOR b, x;
+  LIS_SOLVER solver;
+  LIS_PRECON precon = NULL;
+  LIS_INT size1 = w->size1;
+  LIS_INT size2 = w->size2;
+  LIS_REAL rrnorm; /* || b - Ax || / ||b|| */
+  int argc = 0;
+  char **argv = NULL;
+  char str[2048];
+  double ptime;
+  gsl_vector *r = gsl_vector_alloc(w->size1);
+
+  lis_initialize(&argc, &argv);
+
+  lis_matrix_create(0, &A);
+  lis_matrix_set_size(A, 0, size1);
+
+  lis_vector_create(0, &b);
+  lis_vector_create(0, &x);
+  lis_vector_set_size(b, 0, size1);
+  lis_vector_set_size(x, 0, size2);
+
+  lis_solver_create(&solver);
+
+  /* set solver parameters; defaults first so w->options can override them */
+  lis_solver_set_option("-maxiter 2000", solver);
+  lis_solver_set_option(w->options, solver);
+  lis_solver_set_option("-print 1", solver);
+  sprintf(str, "-tol %e\n", tol);
+  lis_solver_set_option(str, solver);
+
+  w->rnorm = 0.0;
+  w->rrnorm = 0.0;
+  w->iter = 0;
+  w->ptime = 0.0;
+
+  /* construct LIS_MATRIX type from A */
+  status = lis_convert_matrix(S, A);
+  if (status)
+    nrhs_solve = 0;
+
+  if (nrhs_solve > 0)
+    {
+      /* build preconditioner from A once for all right hand sides */
+      solver->A = A;
+      solver->b = b;
+
+      ptime = lis_wtime();
+      status = lis_precon_create(solver, &precon);
+      w->ptime = lis_wtime() - ptime;
+
+      if (status)
+        {
+          fprintf(stderr, "lis_proc_multi: error: preconditioner status = %d\n", status);
+          precon = NULL;
+          nrhs_solve = 0;
+        }
+    }
+
+  for (k = 0; k < nrhs_solve; ++k)
+    {
+      const double *rhs_k = rhs + k * w->size1;
+      double *sol_k = sol + k * w->size2;
+      gsl_vector_const_view bv = gsl_vector_const_view_array(rhs_k, w->size1);
+      gsl_vector_view xv = gsl_vector_view_array(sol_k, w->size2);
+      int s;
+      LIS_INT iter;
+
+      /* construct RHS */
+      for (i = 0; i < w->size1; ++i)
+        lis_vector_set_value(LIS_INS_VALUE, i, rhs_k[i], b);
+
+      lis_solve_kernel(A, b, x, solver, precon);
+
+      lis_solver_get_iter(solver, &iter);
+      w->iter = GSL_MAX(w->iter, (int) iter);
+
+      lis_solver_get_status(solver, &s);
+      if (s != 0)
+        {
+          fprintf(stderr, "lis_proc_multi: error: rhs %zu: status = %d\n", k, s);
+          if (status == 0)
+            status = s;
+        }
+
+      for (i = 0; i < w->size1; ++i)
+        lis_vector_get_value(x, i, &sol_k[i]);
+
+      lis_solver_get_residualnorm(solver, &rrnorm);
+      w->rrnorm = GSL_MAX(w->rrnorm, rrnorm);
+
+      /* compute residual norm */
+      gsl_vector_memcpy(r, &bv.vector);
+      gsl_spblas_dgemv(CblasNoTrans, 1.0, S, &xv.vector, -1.0, r);
+      rnorm[k] = gsl_blas_dnrm2(r);
+      w->rnorm = GSL_MAX(w->rnorm, rnorm[k]);
+    }
+
+  gsl_vector_free(r);
+
+  if (precon)
+    lis_precon_destroy(precon);
+
+  lis_matrix_destroy(A);
+  lis_vector_destroy(b);
+  lis_vector_destroy(x);
+  lis_solver_destroy(solver);
+
+  lis_finalize();
+
+  return status;
+} /* lis_proc_multi() */
+
+/*
+lis_convert_matrix()
+  Convert a GSL sparse matrix to an assembled lis CSR matrix
+
+Inputs: S - sparse matrix in triplet or compressed row format
+        A - lis matrix, with size already set
+
+Return: success or error
+
+Notes:
+1) A compressed row matrix is handed to lis directly through
+lis_matrix_set_csr(), avoiding the element-by-element insertion
+needed for triplets; lis takes ownership of the index and value
+arrays, which are freed by lis_matrix_destroy()
+*/
+
+static int
+lis_convert_matrix(const gsl_spmatrix *S, LIS_MATRIX A)
+{
+  size_t i;
+
+  if (GSL_SPMATRIX_ISCRS(S))
+    {
+      const size_t nz = S->p[S->size1];
+      LIS_INT *ptr = malloc((S->size1 + 1) * sizeof(LIS_INT));
+      LIS_INT *index = malloc(GSL_MAX(nz, 1) * sizeof(LIS_INT));
+      LIS_SCALAR *value = malloc(GSL_MAX(nz, 1) * sizeof(LIS_SCALAR));
+
+      if (!ptr || !index || !value)
+        {
+          free(ptr);
+          free(index);
+          free(value);
+          GSL_ERROR("failed to allocate CSR arrays", GSL_ENOMEM);
+        }
+
+      for (i = 0; i <= S->size1; ++i)
+        ptr[i] = (LIS_INT) S->p[i];
+
+      for (i = 0; i < nz; ++i)
+        {
+          index[i] = (LIS_INT) S->i[i];
+          value[i] = S->data[i];
+        }
+
+      if (lis_matrix_set_csr((LIS_INT) nz, ptr, index, value, A) != LIS_SUCCESS)
+        {
+          /* A does not own the arrays unless lis_matrix_set_csr() succeeded */
+          free(ptr);
+          free(index);
+          free(value);
+          fprintf(stderr, "lis_convert_matrix: lis_matrix_set_csr failed\n");
+          return GSL_EFAILED;
+        }
+    }
+  else if (GSL_SPMATRIX_ISTRIPLET(S))
+    {
+      for (i = 0; i < S->nz; ++i)
+        lis_matrix_set_value(LIS_INS_VALUE, S->i[i], S->p[i], S->data[i], A);
+
+      lis_matrix_set_type(A, LIS_MATRIX_CSR);
+    }
+  else
+    {
+      GSL_ERROR("matrix must be in triplet or compressed row format", GSL_EINVAL);
+    }
+
+  if (lis_matrix_assemble(A) != LIS_SUCCESS)
+    {
+      fprintf(stderr, "lis_convert_matrix: lis_matrix_assemble failed\n");
+      return GSL_EFAILED;
+    }
+
+  return GSL_SUCCESS;
+} /* lis_convert_matrix() */
@@ -10,12 +10,20 @@
 
 #include "lis.h"
 
+/* default solver and preconditioner */
+#define LIS_DEFAULT_OPTIONS     "-i fgmres -p ilut -f double"
+
+#define LIS_MAX_OPTIONS         1024
+
 typedef struct
 {
   int size1;     /* number of rows */
   int size2;     /* number of columns */
   double rnorm;  /* || b - A*x || */
   double rrnorm; /* || b - A*x || / || b || */
+  int iter;      /* number of iterations (maximum over right hand sides) */
+  double ptime;  /* time spent building preconditioner (seconds) */
+  char options[LIS_MAX_OPTIONS]; /* lis solver/preconditioner options */
 } lis_workspace;
 
 /*
@@ -24,7 +32,10 @@ typedef struct
 
 lis_workspace *lis_alloc(int size1, int size2);
 void mylis_free(lis_workspace *w);
+int lis_set_options(const char *options, lis_workspace *w);
 int lis_proc(const gsl_spmatrix *A, const double *rhs, const double tol,
              double *sol, lis_workspace *w);
+int lis_proc_multi(const gsl_spmatrix *S, const size_t nrhs, const double *rhs,
+                   const double tol, double *sol, double *rnorm, lis_workspace *w);
 
 #endif /* INCLUDED_lisw_h */
@@ -184,6 +184,33 @@ main(int argc, char *argv[])
   printf("residual norm = %.12e\n", w->rnorm);
   printf("relative residual norm = %.12e\n", w->rrnorm);
 
+  /* same system with other solver/preconditioner combinations */
+  {
+    const char *options[] = { "-i fgmres -p ilu -ilu_fill 0",
+                              "-i bicgstab -p ilu -ilu_fill 2",
+                              "-i gmres -p ilut" };
+
+    for (i = 0; i < 3; ++i)
+      {
+        lis_set_options(options[i], w);
+        lis_proc(A, rhs, 1.0e-12, sol, w);
+        test_vectors(sol, x, n);
+        gsl_test(w->iter <= 0, "lis iteration count (%s)", options[i]);
+      }
+
+    lis_set_options(LIS_DEFAULT_OPTIONS, w);
+  }
+
+  /* same system in compressed row format */
+  {
+    gsl_spmatrix *C = gsl_spmatrix_crs(A);
+
+    lis_proc(C, rhs, 1.0e-12, sol, w);
+    test_vectors(sol, x, n);
+
+    gsl_spmatrix_free(C);
+  }
+
   test_lis();
 
   mylis_free(w);
@@ -26,6 +26,7 @@
 
 static double mageq_func_Br(double x, void *params);
 static double mageq_func_lat(double phi, void *params);
+static double mageq_calc_direct(double longitude, double r, double t, mageq_workspace *w);
 
 mageq_workspace *
 mageq_alloc()
@@ -62,44 +63,21 @@ Inputs: longitude - geographic longitude (radians)
         w         - mageq workspace
 
 Return: geocentric latitude in radians
+
+Notes:
+1) If a lookup table was set with mageq_set_table() and covers
+(r,t), the latitude is interpolated from the table
 */
 
 double
 mageq_calc(double longitude, double r, double t, mageq_workspace *w)
 {
-  int status;
-  int iter = 0, max_iter = 100;
-  double m = M_PI / 2.0;
-  double a = M_PI / 2.0 - 70.0 * M_PI / 180.0;
-  double b = M_PI / 2.0 + 70.0 * M_PI / 180.0;
-  gsl_function F;
-  mageq_params params;
-
-  params.r = r;
-  params.phi = longitude;
-  params.t = t;
-  params.w = w;
-
-  F.function = &mageq_func_Br;
-  F.params = &params;
-
-  gsl_min_fminimizer_set (w->s, &F, m, a, b);
-
-  do
-    {
-      iter++;
-      status = gsl_min_fminimizer_iterate (w->s);
+  double lat;
 
-      m = gsl_min_fminimizer_x_minimum (w->s);
-      a = gsl_min_fminimizer_x_lower (w->s);
-      b = gsl_min_fminimizer_x_upper (w->s);
+  if (w->table && mageq_table_eval(longitude, r, t, &lat, NULL, w->table) == GSL_SUCCESS)
+    return lat;
 
-      status = gsl_min_test_interval (a, b, 1.0e-5, 0.0);
-    }
-  while (status == GSL_CONTINUE && iter < max_iter);
-
-  /* m is theta, convert to latitude */
-  return (M_PI / 2.0 - m);
+  return mageq_calc_direct(longitude, r, t, w);
 } /* mageq_calc() */
 
 /*
@@ -113,6 +91,10 @@ Inputs: longitude - geographic longitude in radians
         w         - mageq workspace
 
 Return: angle in radians
+
+Notes:
+1) If a lookup table was set with mageq_set_table() and covers
+(r,t), the angle is interpolated from the table
 */
 
 double
@@ -122,6 +104,9 @@ mageq_angle(double longitude, double r, double t, mageq_workspace *w)
   mageq_params params;
   double result, abserr;
 
+  if (w->table && mageq_table_eval(longitude, r, t, NULL, &result, w->table) == GSL_SUCCESS)
+    return result;
+
   params.r = r;
   params.phi = longitude;
   params.t = t;
@@ -135,6 +120,85 @@ mageq_angle(double longitude, double r, double t, mageq_workspace *w)
   return (atan(result));
 } /* mageq_angle() */
 
+/*
+mageq_set_table()
+  Use a precomputed lookup table in mageq_calc() and mageq_angle()
+
+Inputs: tab       - table computed by mageq_table_build() or read
+                    with mageq_table_read(); NULL to disable
+        tol_lat   - maximum allowed interpolation error of latitude (radians)
+        tol_angle - maximum allowed interpolation error of angle (radians)
+        w         - workspace
+
+Return: success, or GSL_ETOL if the table's error bound exceeds the
+tolerances, in which case the table is not used
+
+Notes:
+1) The table is not copied and must remain valid until it is unset
+or w is freed; mageq_free() does not free it
+
+2) Queries outside the table's radius/time range are computed directly
+*/
+
+int
+mageq_set_table(const mageq_table *tab, const double tol_lat,
+                const double tol_angle, mageq_workspace *w)
+{
+  if (tab && (tab->err_lat > tol_lat || tab->err_angle > tol_angle))
+    {
+      w->table = NULL;
+      return GSL_ETOL;
+    }
+
+  w->table = tab;
+
+  return GSL_SUCCESS;
+} /* mageq_set_table() */
+
+/*
+mageq_calc_direct()
+  Calculate latitude of magnetic equator by minimizing |B_r| along
+a meridian
+*/
+
+static double
+mageq_calc_direct(double longitude, double r, double t, mageq_workspace *w)
+{
+  int status;
+  int iter = 0, max_iter = 100;
+  double m = M_PI / 2.0;
+  double a = M_PI / 2.0 - 70.0 * M_PI / 180.0;
+  double b = M_PI / 2.0 + 70.0 * M_PI / 180.0;
+  gsl_function F;
+  mageq_params params;
+
+  params.r = r;
+  params.phi = longitude;
+  params.t = t;
+  params.w = w;
+
+  F.function = &mageq_func_Br;
+  F.params = &params;
+
+  gsl_min_fminimizer_set (w->s, &F, m, a, b);
+
+  do
+    {
+      iter++;
+      status = gsl_min_fminimizer_iterate (w->s);
+
+      m = gsl_min_fminimizer_x_minimum (w->s);
+      a = gsl_min_fminimizer_x_lower (w->s);
+      b = gsl_min_fminimizer_x_upper (w->s);
+
+      status = gsl_min_test_interval (a, b, 1.0e-5, 0.0);
+    }
+  while (status == GSL_CONTINUE && iter < max_iter);
+
+  /* m is theta, convert to latitude */
+  return (M_PI / 2.0 - m);
+} /* mageq_calc_direct() */
+
 static double
 mageq_func_Br(double theta, void *params)
 {
@@ -154,7 +218,7 @@ mageq_func_lat(double phi, void *params)
   mageq_params *p = (mageq_params *) params;
   double lat;
 
-  lat = mageq_calc(phi, p->r, p->t, p->w);
+  lat = mageq_calc_direct(phi, p->r, p->t, p->w);
 
   return lat;
 } /* mageq_func_lat() */
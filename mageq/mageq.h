@@ -15,10 +15,32 @@
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_min.h>
 
+/* tabulated dip equator latitude and EEJ angle */
+typedef struct
+{
+  size_t nlon;       /* number of longitude grid points on [-pi,pi) */
+  size_t nr;         /* number of radial grid points */
+  size_t nt;         /* number of time grid points */
+  double r_min;      /* minimum geocentric radius (km) */
+  double r_max;      /* maximum geocentric radius (km) */
+  double t_min;      /* minimum decimal year */
+  double t_max;      /* maximum decimal year */
+  double dlon;       /* longitude step (radians) */
+  double dr;         /* radial step (km) */
+  double dt;         /* time step (years) */
+  double err_lat;    /* maximum interpolation error of latitude (radians) */
+  double err_angle;  /* maximum interpolation error of angle (radians) */
+  double *lat;       /* latitude of dip equator, size nlon*nr*nt */
+  double *angle;     /* EEJ angle, size nlon*nr*nt */
+} mageq_table;
+
+#define MAGEQ_TABLE_IDX(i, j, k, tab)   (((k) * (tab)->nr + (j)) * (tab)->nlon + (i))
+
 typedef struct
 {
   gsl_min_fminimizer *s;
   msynth_workspace *msynth_workspace_p;
+  const mageq_table *table; /* lookup table, or NULL */
 } mageq_workspace;
 
 typedef struct
@@ -39,5 +61,21 @@ double mageq_calc(double longitude, double altitude, double t,
                   mageq_workspace *w);
 double mageq_angle(double longitude, double altitude, double t,
                    mageq_workspace *w);
+int mageq_set_table(const mageq_table *tab, const double tol_lat,
+                    const double tol_angle, mageq_workspace *w);
+
+/* mageq_table.c */
+mageq_table *mageq_table_alloc(const size_t nlon, const double r_min,
+                               const double r_max, const size_t nr,
+                               const double t_min, const double t_max,
+                               const size_t nt);
+void mageq_table_free(mageq_table *tab);
+int mageq_table_build(mageq_table *tab, mageq_workspace *w);
+int mageq_table_eval(const double longitude, const double r, const double t,
+                     double *lat, double *angle, const mageq_table *tab);
+int mageq_table_covers(const double r, const double t_min, const double t_max,
+                       const mageq_table *tab);
+int mageq_table_write(const char *filename, const mageq_table *tab);
+mageq_table *mageq_table_read(const char *filename);
 
 #endif /* INCLUDED_mageq_h */
@@ -0,0 +1,437 @@
+/*
+ * mageq_table.c
+ *
+ * Lookup table of the dip equator latitude and EEJ angle on a
+ * (longitude, radius, time) grid. Each grid point requires a
+ * Brent minimization of |B_r| (and several more for the angle),
+ * so for repeated processing the table is computed once with
+ * mageq_table_build(), saved with mageq_table_write(), and
+ * attached to a workspace with mageq_set_table(); mageq_calc()
+ * and mageq_angle() then interpolate trilinearly.
+ *
+ * The interpolation error is estimated during the build by comparing
+ * with direct calculations at the centers of the grid cells.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_errno.h>
+
+#include <common/common.h>
+
+#include "fileio.h"
+#include "mageq.h"
+
+#define MAGEQ_TABLE_MAGIC          "MAGEQTAB"
+
+/* tolerance for matching radius on a single-radius table (km) */
+#define MAGEQ_TABLE_RTOL           1.0e-6
+
+static int mageq_table_axis(const double x, const double xmin, const double dx,
+                            const size_t n, size_t *idx, double *frac);
+
+/*
+mageq_table_alloc()
+  Allocate a lookup table
+
+Inputs: nlon  - number of longitude points, uniformly spaced on [-pi,pi)
+        r_min - minimum geocentric radius (km)
+        r_max - maximum geocentric radius (km)
+        nr    - number of radial points; if 1, r_max is ignored
+        t_min - minimum decimal year
+        t_max - maximum decimal year
+        nt    - number of time points; if 1, t_max is ignored
+
+Return: pointer to table
+*/
+
+mageq_table *
+mageq_table_alloc(const size_t nlon, const double r_min,
+                  const double r_max, const size_t nr,
+                  const double t_min, const double t_max,
+                  const size_t nt)
+{
+  mageq_table *tab;
+  const size_t n = nlon * nr * nt;
+
+  if (nlon < 2 || nr == 0 || nt == 0)
+    {
+      GSL_ERROR_NULL("invalid table dimensions", GSL_EINVAL);
+    }
+
+  tab = calloc(1, sizeof(mageq_table));
+  if (!tab)
+    {
+      fprintf(stderr, "mageq_table_alloc: calloc failed: %s\n", strerror(errno));
+      return 0;
+    }
+
+  tab->nlon = nlon;
+  tab->nr = nr;
+  tab->nt = nt;
+  tab->r_min = r_min;
+  tab->r_max = (nr > 1) ? r_max : r_min;
+  tab->t_min = t_min;
+  tab->t_max = (nt > 1) ? t_max : t_min;
+  tab->dlon = 2.0 * M_PI / nlon;
+  tab->dr = (nr > 1) ? (r_max - r_min) / (nr - 1.0) : 0.0;
+  tab->dt = (nt > 1) ? (t_max - t_min) / (nt - 1.0) : 0.0;
+  tab->err_lat = GSL_POSINF;
+  tab->err_angle = GSL_POSINF;
+
+  tab->lat = malloc(n * sizeof(double));
+  tab->angle = malloc(n * sizeof(double));
+  if (!tab->lat || !tab->angle)
+    {
+      mageq_table_free(tab);
+      return 0;
+    }
+
+  return tab;
+} /* mageq_table_alloc() */
+
+void
+mageq_table_free(mageq_table *tab)
+{
+  if (tab->lat)
+    free(tab->lat);
+
+  if (tab->angle)
+    free(tab->angle);
+
+  free(tab);
+} /* mageq_table_free() */
+
+/*
+mageq_table_build()
+  Compute the table entries and estimate the interpolation error
+
+Inputs: tab - table
+        w   - mageq workspace used for direct calculations
+
+Return: success or error
+
+Notes:
+1) tab->err_lat and tab->err_angle are set to the maximum absolute
+difference between interpolated and direct values at the centers of
+all grid cells
+*/
+
+int
+mageq_table_build(mageq_table *tab, mageq_workspace *w)
+{
+  const mageq_table *table_save = w->table;
+  const size_t nrc = GSL_MAX(tab->nr - 1, 1);  /* number of cells in r */
+  const size_t ntc = GSL_MAX(tab->nt - 1, 1);  /* number of cells in t */
+  struct timeval tv0, tv1;
+  size_t i, j, k;
+
+  /* force direct calculations */
+  w->table = NULL;
+
+  fprintf(stderr, "mageq_table_build: computing %zu grid points...",
+          tab->nlon * tab->nr * tab->nt);
+  gettimeofday(&tv0, NULL);
+
+  for (k = 0; k < tab->nt; ++k)
+    {
+      double t = tab->t_min + k * tab->dt;
+
+      for (j = 0; j < tab->nr; ++j)
+        {
+          double r = tab->r_min + j * tab->dr;
+
+          for (i = 0; i < tab->nlon; ++i)
+            {
+              double lon = -M_PI + i * tab->dlon;
+              size_t idx = MAGEQ_TABLE_IDX(i, j, k, tab);
+
+              tab->lat[idx] = mageq_calc(lon, r, t, w);
+              tab->angle[idx] = mageq_angle(lon, r, t, w);
+            }
+        }
+    }
+
+  gettimeofday(&tv1, NULL);
+  fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+
+  fprintf(stderr, "mageq_table_build: checking interpolation error...");
+  gettimeofday(&tv0, NULL);
+
+  tab->err_lat = 0.0;
+  tab->err_angle = 0.0;
+
+  for (k = 0; k < ntc; ++k)
+    {
+      double t = tab->t_min + (k + 0.5) * tab->dt;
+
+      for (j = 0; j < nrc; ++j)
+        {
+          double r = tab->r_min + (j + 0.5) * tab->dr;
+
+          for (i = 0; i < tab->nlon; ++i)
+            {
+              double lon = -M_PI + (i + 0.5) * tab->dlon;
+              double lat, angle;
+
+              mageq_table_eval(lon, r, t, &lat, &angle, tab);
+
+              tab->err_lat = GSL_MAX(tab->err_lat, fabs(lat - mageq_calc(lon, r, t, w)));
+              tab->err_angle = GSL_MAX(tab->err_angle, fabs(angle - mageq_angle(lon, r, t, w)));
+            }
+        }
+    }
+
+  gettimeofday(&tv1, NULL);
+  fprintf(stderr, "done (%g seconds, max error lat = %.2e deg, angle = %.2e deg)\n",
+          time_diff(tv0, tv1),
+          tab->err_lat * 180.0 / M_PI,
+          tab->err_angle * 180.0 / M_PI);
+
+  w->table = table_save;
+
+  return GSL_SUCCESS;
+} /* mageq_table_build() */
+
+/*
+mageq_table_eval()
+  Interpolate dip equator latitude and EEJ angle from table
+
+Inputs: longitude - geographic longitude (radians)
+        r         - geocentric radius (km)
+        t         - decimal year
+        lat       - (output) geocentric latitude of dip equator (radians),
+                    may be NULL
+        angle     - (output) EEJ angle (radians), may be NULL
+        tab       - table
+
+Return: success, or GSL_EDOM if (r,t) is outside the table
+*/
+
+int
+mageq_table_eval(const double longitude, const double r, const double t,
+                 double *lat, double *angle, const mageq_table *tab)
+{
+  size_t i0, i1, j0, k0;
+  double fi, fj, fk;
+  double x;
+  double lat_sum = 0.0, angle_sum = 0.0;
+  size_t dj, dk;
+
+  if (mageq_table_axis(r, tab->r_min, tab->dr, tab->nr, &j0, &fj) ||
+      mageq_table_axis(t, tab->t_min, tab->dt, tab->nt, &k0, &fk))
+    return GSL_EDOM;
+
+  /* longitude is periodic */
+  x = (longitude + M_PI) / tab->dlon;
+  x -= tab->nlon * floor(x / tab->nlon);
+  i0 = (size_t) x;
+  fi = x - (double) i0;
+  if (i0 >= tab->nlon)
+    {
+      i0 = 0;
+      fi = 0.0;
+    }
+
+  i1 = (i0 + 1) % tab->nlon;
+
+  for (dk = 0; dk < 2; ++dk)
+    {
+      double wk = dk ? fk : 1.0 - fk;
+
+      if (wk == 0.0)
+        continue;
+
+      for (dj = 0; dj < 2; ++dj)
+        {
+          double wjk = (dj ? fj : 1.0 - fj) * wk;
+          size_t idx0, idx1;
+
+          if (wjk == 0.0)
+            continue;
+
+          idx0 = MAGEQ_TABLE_IDX(i0, j0 + dj, k0 + dk, tab);
+          idx1 = MAGEQ_TABLE_IDX(i1, j0 + dj, k0 + dk, tab);
+
+          lat_sum += wjk * ((1.0 - fi) * tab->lat[idx0] + fi * tab->lat[idx1]);
+          angle_sum += wjk * ((1.0 - fi) * tab->angle[idx0] + fi * tab->angle[idx1]);
+        }
+    }
+
+  if (lat)
+    *lat = lat_sum;
+
+  if (angle)
+    *angle = angle_sum;
+
+  return GSL_SUCCESS;
+} /* mageq_table_eval() */
+
+/*
+mageq_table_covers()
+  Check if a table contains radius r and time interval [t_min,t_max]
+
+Return: 1 if covered, 0 if not
+*/
+
+int
+mageq_table_covers(const double r, const double t_min, const double t_max,
+                   const mageq_table *tab)
+{
+  size_t idx;
+  double frac;
+
+  return (mageq_table_axis(r, tab->r_min, tab->dr, tab->nr, &idx, &frac) == 0 &&
+          mageq_table_axis(t_min, tab->t_min, tab->dt, tab->nt, &idx, &frac) == 0 &&
+          mageq_table_axis(t_max, tab->t_min, tab->dt, tab->nt, &idx, &frac) == 0);
+} /* mageq_table_covers() */
+
+/*
+mageq_table_write()
+  Save a table to disk
+
+Inputs: filename - output file
+        tab      - table
+
+Return: success or error
+*/
+
+int
+mageq_table_write(const char *filename, const mageq_table *tab)
+{
+  const size_t n = tab->nlon * tab->nr * tab->nt;
+  char tmpname[PATH_MAX];
+  size_t nwrite = 0;
+  FILE *fp;
+
+  fp = fileio_open(filename, tmpname);
+  if (!fp)
+    return GSL_FAILURE;
+
+  nwrite += fwrite(MAGEQ_TABLE_MAGIC, 1, 8, fp);
+  nwrite += fwrite(&(tab->nlon), sizeof(size_t), 1, fp);
+  nwrite += fwrite(&(tab->nr), sizeof(size_t), 1, fp);
+  nwrite += fwrite(&(tab->nt), sizeof(size_t), 1, fp);
+  nwrite += fwrite(&(tab->r_min), sizeof(double), 1, fp);
+  nwrite += fwrite(&(tab->r_max), sizeof(double), 1, fp);
+  nwrite += fwrite(&(tab->t_min), sizeof(double), 1, fp);
+  nwrite += fwrite(&(tab->t_max), sizeof(double), 1, fp);
+  nwrite += fwrite(&(tab->err_lat), sizeof(double), 1, fp);
+  nwrite += fwrite(&(tab->err_angle), sizeof(double), 1, fp);
+  nwrite += fwrite(tab->lat, sizeof(double), n, fp);
+  nwrite += fwrite(tab->angle, sizeof(double), n, fp);
+
+  if (fileio_close(fp, nwrite == 17 + 2 * n, tmpname, filename) != 0)
+    return GSL_FAILURE;
+
+  return GSL_SUCCESS;
+} /* mageq_table_write() */
+
+/*
+mageq_table_read()
+  Read a table previously saved with mageq_table_write()
+
+Return: pointer to table, or NULL if the file does not exist or
+is not a valid table
+*/
+
+mageq_table *
+mageq_table_read(const char *filename)
+{
+  mageq_table *tab;
+  FILE *fp;
+  char magic[8];
+  size_t nlon, nr, nt, n;
+  double r_min, r_max, t_min, t_max;
+  size_t nread = 0;
+
+  fp = fopen(filename, "r");
+  if (!fp)
+    return 0;
+
+  nread += fread(magic, 1, 8, fp);
+  nread += fread(&nlon, sizeof(size_t), 1, fp);
+  nread += fread(&nr, sizeof(size_t), 1, fp);
+  nread += fread(&nt, sizeof(size_t), 1, fp);
+  nread += fread(&r_min, sizeof(double), 1, fp);
+  nread += fread(&r_max, sizeof(double), 1, fp);
+  nread += fread(&t_min, sizeof(double), 1, fp);
+  nread += fread(&t_max, sizeof(double), 1, fp);
+
+  if (nread != 15 || memcmp(magic, MAGEQ_TABLE_MAGIC, 8) != 0)
+    {
+      fprintf(stderr, "mageq_table_read: %s is not a mageq table\n", filename);
+      fclose(fp);
+      return 0;
+    }
+
+  tab = mageq_table_alloc(nlon, r_min, r_max, nr, t_min, t_max, nt);
+  if (!tab)
+    {
+      fclose(fp);
+      return 0;
+    }
+
+  n = nlon * nr * nt;
+
+  nread = fread(&(tab->err_lat), sizeof(double), 1, fp);
+  nread += fread(&(tab->err_angle), sizeof(double), 1, fp);
+  nread += fread(tab->lat, sizeof(double), n, fp);
+  nread += fread(tab->angle, sizeof(double), n, fp);
+
+  fclose(fp);
+
+  if (nread != 2 + 2 * n)
+    {
+      fprintf(stderr, "mageq_table_read: %s is truncated\n", filename);
+      mageq_table_free(tab);
+      return 0;
+    }
+
+  return tab;
+} /* mageq_table_read() */
+
+/*
+mageq_table_axis()
+  Locate x on a uniform grid axis
+
+Inputs: x    - point
+        xmin - first grid point
+        dx   - grid spacing
+        n    - number of grid points
+        idx  - (output) index of grid point to the left of x
+        frac - (output) fractional distance of x from idx
+
+Return: success, or GSL_EDOM if x is outside the grid; a single-point
+axis matches only x = xmin
+*/
+
+static int
+mageq_table_axis(const double x, const double xmin, const double dx,
+                 const size_t n, size_t *idx, double *frac)
+{
+  double u;
+
+  if (n == 1)
+    {
+      *idx = 0;
+      *frac = 0.0;
+      return (fabs(x - xmin) <= MAGEQ_TABLE_RTOL) ? GSL_SUCCESS : GSL_EDOM;
+    }
+
+  u = (x - xmin) / dx;
+  if (u < 0.0 || u > n - 1.0)
+    return GSL_EDOM;
+
+  *idx = GSL_MIN((size_t) u, n - 2);
+  *frac = u - (double) *idx;
+
+  return GSL_SUCCESS;
+} /* mageq_table_axis() */
@@ -6,11 +6,103 @@
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <gsl/gsl_math.h>
+#include <gsl/gsl_test.h>
 
 #include "mageq.h"
 
+/*
+ * compare table interpolation against direct calculation at the
+ * centers of the grid cells, where the linear interpolation error
+ * is largest, and check the table survives a write/read round trip
+ */
+static int
+test_table(const double r, const double t_min, const double t_max, mageq_workspace *w)
+{
+  int s = 0;
+  const size_t nlon = 180;
+  const double tol_lat = 0.05 * M_PI / 180.0;
+  const double tol_angle = 0.5 * M_PI / 180.0;
+  const double t = 0.5 * (t_min + t_max);
+  char filename[] = "/tmp/mageq_test_XXXXXX";
+  mageq_table *tab, *tab2;
+  double err_lat = 0.0, err_angle = 0.0;
+  size_t i;
+  int fd;
+
+  tab = mageq_table_alloc(nlon, r, r, 1, t_min, t_max, 2);
+  s += mageq_table_build(tab, w);
+
+  gsl_test(tab->err_lat > tol_lat, "table err_lat = %.2e deg", tab->err_lat * 180.0 / M_PI);
+  gsl_test(tab->err_angle > tol_angle, "table err_angle = %.2e deg", tab->err_angle * 180.0 / M_PI);
+
+  for (i = 0; i < nlon; ++i)
+    {
+      double lon = -M_PI + (i + 0.5) * tab->dlon;
+      double lat_direct, angle_direct, lat, angle;
+
+      mageq_set_table(NULL, 0.0, 0.0, w);
+      lat_direct = mageq_calc(lon, r, t, w);
+      angle_direct = mageq_angle(lon, r, t, w);
+
+      s += mageq_set_table(tab, tol_lat, tol_angle, w);
+      lat = mageq_calc(lon, r, t, w);
+      angle = mageq_angle(lon, r, t, w);
+
+      err_lat = GSL_MAX(err_lat, fabs(lat - lat_direct));
+      err_angle = GSL_MAX(err_angle, fabs(angle - angle_direct));
+    }
+
+  mageq_set_table(NULL, 0.0, 0.0, w);
+
+  /* the table's own error bound must cover the cell centers */
+  gsl_test(err_lat > tab->err_lat * (1.0 + 1.0e-12), "table lat error %.2e > bound %.2e",
+           err_lat, tab->err_lat);
+  gsl_test(err_angle > tab->err_angle * (1.0 + 1.0e-12), "table angle error %.2e > bound %.2e",
+           err_angle, tab->err_angle);
+
+  /* mageq_table_covers() */
+  gsl_test(!mageq_table_covers(r, t_min, t_max, tab), "table covers");
+  gsl_test(mageq_table_covers(r + 1.0, t_min, t_max, tab), "table covers r");
+  gsl_test(mageq_table_covers(r, t_min, t_max + 1.0, tab), "table covers t");
+
+  fd = mkstemp(filename);
+  if (fd < 0)
+    {
+      mageq_table_free(tab);
+      return -1;
+    }
+
+  close(fd);
+
+  s += mageq_table_write(filename, tab);
+  tab2 = mageq_table_read(filename);
+  unlink(filename);
+
+  gsl_test(tab2 == NULL, "mageq_table_read");
+  if (tab2)
+    {
+      gsl_test(tab2->nlon != tab->nlon || tab2->nr != tab->nr || tab2->nt != tab->nt,
+               "table read dimensions");
+      gsl_test(tab2->err_lat != tab->err_lat, "table read err_lat");
+      gsl_test(tab2->err_angle != tab->err_angle, "table read err_angle");
+
+      for (i = 0; i < nlon * tab->nr * tab->nt; ++i)
+        {
+          gsl_test(tab2->lat[i] != tab->lat[i], "table read lat i=%zu", i);
+          gsl_test(tab2->angle[i] != tab->angle[i], "table read angle i=%zu", i);
+        }
+
+      mageq_table_free(tab2);
+    }
+
+  mageq_table_free(tab);
+
+  return s;
+} /* test_table() */
+
 int
 main()
 {
@@ -38,7 +130,9 @@ main()
              angle * 180.0 / M_PI);
     }
 
+  gsl_test(test_table(r, t, t + 1.0, w), "mageq table");
+
   mageq_free(w);
 
-  return 0;
+  exit (gsl_test_summary());
 }
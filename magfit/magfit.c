@@ -101,6 +101,7 @@ magfit_default_parameters(void)
   params.lon_max = 0.0;
   params.R = R_EARTH_KM + 110.0;
   params.lmax = MAGFIT_SECS_LMAX;
+  params.secs2d_cutoff = 0.0;
 
   params.pca_modes = 16;
 
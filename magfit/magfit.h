@@ -39,6 +39,7 @@ typedef struct
   double lon_max;        /* maximum longitude for SECS poles (degrees) */
   double R;              /* reference radius (km) */
   size_t lmax;           /* maximum spherical harmonic degree for 1D SECS expansion */
+  double secs2d_cutoff;  /* angular distance beyond which 2D SECS Green's functions are truncated (degrees); 0 for dense system */
 
   /* PCA parameters */
   size_t pca_modes;      /* number of PCA modes to use */
@@ -50,6 +50,7 @@ typedef struct
   size_t downsample;  /* downsampling factor */
   double alpha;       /* smoothing factor for high latitudes */
   double thresh[4];   /* rms thresholds */
+  double secs2d_cutoff; /* 2D SECS Green's function cutoff (deg); 0 for dense system */
 } preprocess_parameters;
 
 satdata_mag *
@@ -257,7 +258,7 @@ subtract_RC(const char *filename, satdata_mag *data, track_workspace *w)
 }
 
 int
-main_proc(satdata_mag *data[3], track_workspace *track[3])
+main_proc(const preprocess_parameters *params, satdata_mag *data[3], track_workspace *track[3])
 {
   int s = 0;
   size_t i, j, k;
@@ -283,6 +284,8 @@ main_proc(satdata_mag *data[3], track_workspace *track[3])
   mageq_workspace *mageq_p = mageq_alloc();
   const double dlon = 8.0;
 
+  magfit_params.secs2d_cutoff = params->secs2d_cutoff;
+
   if (T == magfit_secs1d)
     {
       magfit_params.flags |= MAGFIT_FLG_SECS_FIT_DF | MAGFIT_FLG_SECS_FIT_CF;
@@ -563,6 +566,7 @@ print_help(char *argv[])
   fprintf(stderr, "\t --kp_min | -v kp_min                        - kp minimum\n");
   fprintf(stderr, "\t --kp_max | -w kp_max                        - kp maximum\n");
   fprintf(stderr, "\t --alpha | -q alpha                          - smoothing factor for high latitudes\n");
+  fprintf(stderr, "\t --secs2d_cutoff | -y cutoff                 - 2D SECS Green's function cutoff (deg); 0 for dense system\n");
 }
 
 int
@@ -593,6 +597,7 @@ main(int argc, char *argv[])
   params.thresh[1] = 170.0;
   params.thresh[2] = 150.0;
   params.thresh[3] = 160.0;
+  params.secs2d_cutoff = 0.0;
 
   while (1)
     {
@@ -614,10 +619,11 @@ main(int argc, char *argv[])
           { "kp_min", required_argument, NULL, 'v' },
           { "kp_max", required_argument, NULL, 'w' },
           { "alpha", required_argument, NULL, 'q' },
+          { "secs2d_cutoff", required_argument, NULL, 'y' },
           { 0, 0, 0, 0 }
         };
 
-      c = getopt_long(argc, argv, "ab:c:d:j:k:l:m:q:r:s:t:u:v:x:", long_options, &option_index);
+      c = getopt_long(argc, argv, "ab:c:d:j:k:l:m:q:r:s:t:u:v:x:y:", long_options, &option_index);
       if (c == -1)
         break;
 
@@ -711,6 +717,10 @@ main(int argc, char *argv[])
             params.alpha = atof(optarg);
             break;
 
+          case 'y':
+            params.secs2d_cutoff = atof(optarg);
+            break;
+
           default:
             break;
         }
@@ -733,6 +743,7 @@ main(int argc, char *argv[])
   fprintf(stderr, "main: kp minimum       = %.1f\n", params.kp_min);
   fprintf(stderr, "main: kp maximum       = %.1f\n", params.kp_max);
   fprintf(stderr, "main: smoothing alpha  = %f\n", params.alpha);
+  fprintf(stderr, "main: 2D SECS cutoff   = %.1f [deg]\n", params.secs2d_cutoff);
 
   if (lp_data)
     {
@@ -748,7 +759,7 @@ main(int argc, char *argv[])
         track_p[i] = preprocess_data(&params, data[i]);
     }
 
-  main_proc(data, track_p);
+  main_proc(&params, data, track_p);
 
   for (i = 0; i < 3; ++i)
     {
@@ -9,6 +9,7 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <sys/time.h>
 
 #include <satdata/satdata.h>
 #include <indices/indices.h>
@@ -21,6 +22,8 @@
 #include <gsl/gsl_statistics.h>
 #include <gsl/gsl_multifit.h>
 #include <gsl/gsl_blas.h>
+#include <gsl/gsl_spmatrix.h>
+#include <gsl/gsl_spblas.h>
 
 #include <common/common.h>
 #include <common/interp.h>
@@ -49,6 +52,7 @@ typedef struct
   size_t cf_offset; /* offset in 'c' of CF coefficients */
 
   double R;         /* radius of ionosphere (km) */
+  double cutoff;    /* truncation distance for Green's functions (radians); 0 for dense system */
 
   double *theta0;   /* theta pole locations, size ntheta */
   double *phi0;     /* phi pole locations, size nphi */
@@ -65,6 +69,12 @@ typedef struct
    */
   gsl_vector *c;    /* solution vector */
 
+  /*
+   * if cutoff > 0, the LS matrix is stored in Xs in triplet format, and
+   * X contains only 3 rows for use as workspace by the eval functions
+   */
+  gsl_spmatrix *Xs; /* sparse LS matrix */
+
   gsl_multifit_linear_workspace *multifit_p;
 } secs2d_state_t;
 
@@ -75,6 +85,10 @@ static size_t secs2d_ncoeff(void * vstate);
 static int secs2d_add_datum(const double t, const double r, const double theta, const double phi,
                             const double qdlat, const double B[3], void * vstate);
 static int secs2d_fit(double * rnorm, double * snorm, void * vstate);
+static int secs2d_fit_dense(double * rnorm, double * snorm, secs2d_state_t * state);
+static int secs2d_fit_sparse(double * rnorm, double * snorm, secs2d_state_t * state);
+static int secs2d_lsqr(const double lambda, const gsl_spmatrix * A, const gsl_vector * b,
+                       gsl_vector * x, size_t * niter);
 static int secs2d_eval_B(const double t, const double r, const double theta, const double phi,
                          double B[3], void * vstate);
 static int secs2d_eval_J(const double r, const double theta, const double phi,
@@ -87,6 +101,8 @@ static int secs2d_green_df_J(const double theta, const double phi, const double
                              double K[3], secs2d_state_t *state);
 static int secs2d_matrix_row_df(const double r, const double theta, const double phi,
                                 gsl_vector *X, gsl_vector *Y, gsl_vector *Z, secs2d_state_t *state);
+static int secs2d_matrix_row_df_sparse(const double r, const double theta, const double phi,
+                                       const size_t rowidx, secs2d_state_t *state);
 static int secs2d_matrix_row_cf(const double r, const double theta,
                                 gsl_vector *Y, secs2d_state_t *state);
 static int secs2d_matrix_row_df_J(const double theta, const double phi,
@@ -144,6 +160,7 @@ secs2d_alloc(const void * params)
   state->ntheta = ntheta;
   state->nphi = nphi;
   state->R = mparams->R;
+  state->cutoff = mparams->secs2d_cutoff * M_PI / 180.0;
   state->flags = flags;
   state->df_offset = 0;
   state->cf_offset = 0;
@@ -160,12 +177,22 @@ secs2d_alloc(const void * params)
       state->p += npoles;
     }
 
-  state->X = gsl_matrix_alloc(state->nmax, state->p);
   state->c = gsl_vector_alloc(state->p);
   state->rhs = gsl_vector_alloc(state->nmax);
   state->wts = gsl_vector_alloc(state->nmax);
-  state->cov = gsl_matrix_alloc(state->p, state->p);
-  state->multifit_p = gsl_multifit_linear_alloc(state->nmax, state->p);
+
+  if (state->cutoff > 0.0)
+    {
+      /* triplet storage grows as needed; start with room for ~10 poles per row */
+      state->X = gsl_matrix_alloc(3, state->p);
+      state->Xs = gsl_spmatrix_alloc_nzmax(state->nmax, state->p, 10 * state->nmax, GSL_SPMATRIX_TRIPLET);
+    }
+  else
+    {
+      state->X = gsl_matrix_alloc(state->nmax, state->p);
+      state->cov = gsl_matrix_alloc(state->p, state->p);
+      state->multifit_p = gsl_multifit_linear_alloc(state->nmax, state->p);
+    }
 
   state->theta0 = malloc(ntheta * sizeof(double));
   state->phi0 = malloc(nphi * sizeof(double));
@@ -204,6 +231,9 @@ secs2d_alloc(const void * params)
   fprintf(stderr, "secs2d_alloc: nphi   = %zu\n", state->nphi);
   fprintf(stderr, "secs2d_alloc: ncoeff = %zu\n", state->p);
 
+  if (state->cutoff > 0.0)
+    fprintf(stderr, "secs2d_alloc: using sparse system with cutoff = %g [deg]\n", mparams->secs2d_cutoff);
+
   return state;
 }
 
@@ -236,6 +266,9 @@ secs2d_free(void * vstate)
   if (state->multifit_p)
     gsl_multifit_linear_free(state->multifit_p);
 
+  if (state->Xs)
+    gsl_spmatrix_free(state->Xs);
+
   free(state);
 }
 
@@ -245,6 +278,10 @@ secs2d_reset(void * vstate)
 {
   secs2d_state_t *state = (secs2d_state_t *) vstate;
   state->n = 0;
+
+  if (state->Xs)
+    gsl_spmatrix_set_zero(state->Xs);
+
   return 0;
 }
 
@@ -280,9 +317,6 @@ secs2d_add_datum(const double t, const double r, const double theta, const doubl
   secs2d_state_t *state = (secs2d_state_t *) vstate;
   size_t rowidx = state->n;
   double wi = 1.0;
-  gsl_vector_view vx = gsl_matrix_row(state->X, rowidx);
-  gsl_vector_view vy = gsl_matrix_row(state->X, rowidx + 1);
-  gsl_vector_view vz = gsl_matrix_row(state->X, rowidx + 2);
 
   (void) t;
 
@@ -303,7 +337,18 @@ secs2d_add_datum(const double t, const double r, const double theta, const doubl
       gsl_vector_set(state->wts, rowidx + 2, wi);
 
       /* build 3 rows of the LS matrix for DF SECS */
-      secs2d_matrix_row_df(r, theta, phi, &vx.vector, &vy.vector, &vz.vector, state);
+      if (state->Xs)
+        {
+          secs2d_matrix_row_df_sparse(r, theta, phi, rowidx, state);
+        }
+      else
+        {
+          gsl_vector_view vx = gsl_matrix_row(state->X, rowidx);
+          gsl_vector_view vy = gsl_matrix_row(state->X, rowidx + 1);
+          gsl_vector_view vz = gsl_matrix_row(state->X, rowidx + 2);
+
+          secs2d_matrix_row_df(r, theta, phi, &vx.vector, &vy.vector, &vz.vector, state);
+        }
 
       rowidx += 3;
     }
@@ -331,12 +376,36 @@ Return: success/error
 Notes:
 1) Data must be added to workspace via
 secs2d_add_datum()
+
+2) If a cutoff distance is set, the sparse system is solved
+with secs2d_fit_sparse(), otherwise with secs2d_fit_dense()
 */
 
 static int
 secs2d_fit(double * rnorm, double * snorm, void * vstate)
 {
   secs2d_state_t *state = (secs2d_state_t *) vstate;
+
+  if (state->Xs)
+    return secs2d_fit_sparse(rnorm, snorm, state);
+  else
+    return secs2d_fit_dense(rnorm, snorm, state);
+}
+
+/*
+secs2d_fit_dense()
+  Fit 2D SECS to previously added tracks using a dense SVD
+of the full LS matrix, with the regularization parameter chosen
+from the L-curve
+
+Inputs: rnorm  - residual norm || y - A x ||
+        snorm  - solution norm || x ||
+        state  - state
+*/
+
+static int
+secs2d_fit_dense(double * rnorm, double * snorm, secs2d_state_t * state)
+{
   const size_t npts = 200;
   /* Note: to get a reasonable current map, use tol = 3e-1 */
 #if 0
@@ -442,6 +511,233 @@ secs2d_fit(double * rnorm, double * snorm, void * vstate)
   return 0;
 }
 
+/*
+secs2d_fit_sparse()
+  Fit 2D SECS to previously added tracks using the sparse LS
+matrix built with a truncated Green's function
+
+Inputs: rnorm  - residual norm || y - A x ||
+        snorm  - solution norm || x ||
+        state  - state
+
+Notes:
+1) The L-curve requires an SVD of the full matrix, so here the
+regularization parameter is set to the lower bound used by
+secs2d_fit_dense(), lambda = tol * s0, where the largest singular
+value s0 is estimated by power iteration on A^T A
+
+2) The regularized system is solved with LSQR, which only requires
+products with A and A^T; memory usage is O(nnz(A) + n + p)
+
+3) The weights are applied to the compressed copy of the matrix,
+so state->Xs is unchanged and the system may be refit
+*/
+
+static int
+secs2d_fit_sparse(double * rnorm, double * snorm, secs2d_state_t * state)
+{
+  const double tol = 1.0e-1;
+  const size_t max_power = 30;
+  gsl_spmatrix *Xs = state->Xs;
+  gsl_spmatrix *A;
+  gsl_vector *b, *u, *v;
+  double s0, lambda;
+  size_t i, niter;
+  struct timeval tv0, tv1;
+
+  if (state->n < state->p)
+    return -1;
+
+  fprintf(stderr, "\n");
+  fprintf(stderr, "\t n = %zu\n", state->n);
+  fprintf(stderr, "\t p = %zu\n", state->p);
+  fprintf(stderr, "\t nnz = %zu (%.2f%%)\n", gsl_spmatrix_nnz(Xs),
+          (double) gsl_spmatrix_nnz(Xs) / ((double) state->n * (double) state->p) * 100.0);
+
+  /* rows of Xs beyond state->n are empty, so vectors of length nmax can be used */
+  b = gsl_vector_calloc(Xs->size1);
+  u = gsl_vector_alloc(Xs->size1);
+  v = gsl_vector_alloc(Xs->size2);
+
+  /* compressed row storage for fast matrix-vector products */
+  A = gsl_spmatrix_crs(Xs);
+
+  /* convert to standard form: A <- sqrt(W) A, b <- sqrt(W) b */
+  for (i = 0; i < state->n; ++i)
+    {
+      const double swi = sqrt(gsl_vector_get(state->wts, i));
+      size_t k;
+
+      for (k = A->p[i]; k < A->p[i + 1]; ++k)
+        A->data[k] *= swi;
+
+      gsl_vector_set(b, i, swi * gsl_vector_get(state->rhs, i));
+    }
+
+  /* estimate largest singular value of A */
+  gsl_vector_set_all(v, 1.0 / sqrt((double) state->p));
+  s0 = 0.0;
+  for (i = 0; i < max_power; ++i)
+    {
+      double vnorm;
+
+      gsl_spblas_dgemv(CblasNoTrans, 1.0, A, v, 0.0, u);
+      gsl_spblas_dgemv(CblasTrans, 1.0, A, u, 0.0, v);
+
+      vnorm = gsl_blas_dnrm2(v);
+      if (vnorm == 0.0)
+        break;
+
+      gsl_vector_scale(v, 1.0 / vnorm);
+      s0 = sqrt(vnorm);
+    }
+
+  lambda = tol * s0;
+
+  fprintf(stderr, "\t solving sparse system with LSQR...");
+  gettimeofday(&tv0, NULL);
+  secs2d_lsqr(lambda, A, b, state->c, &niter);
+  gettimeofday(&tv1, NULL);
+  fprintf(stderr, "done (%zu iterations, %g seconds)\n", niter, time_diff(tv0, tv1));
+
+  /* compute residual norm || b - A c || */
+  gsl_spblas_dgemv(CblasNoTrans, -1.0, A, state->c, 1.0, b);
+  *rnorm = gsl_blas_dnrm2(b);
+  *snorm = gsl_blas_dnrm2(state->c);
+
+  fprintf(stderr, "\t s0 = %.12e\n", s0);
+  fprintf(stderr, "\t lambda = %.12e\n", lambda);
+  fprintf(stderr, "\t rnorm = %.12e\n", *rnorm);
+  fprintf(stderr, "\t snorm = %.12e\n", *snorm);
+
+  gsl_spmatrix_free(A);
+  gsl_vector_free(b);
+  gsl_vector_free(u);
+  gsl_vector_free(v);
+
+  return 0;
+}
+
+/*
+secs2d_lsqr()
+  Solve the regularized least squares problem
+
+min_x || b - A x ||^2 + lambda^2 || x ||^2
+
+with the LSQR algorithm of Paige and Saunders (1982)
+
+Inputs: lambda - regularization parameter
+        A      - sparse matrix, n-by-p
+        b      - right hand side vector, length n
+        x      - (output) solution vector, length p
+        niter  - (output) number of iterations
+
+Return: success/error
+*/
+
+static int
+secs2d_lsqr(const double lambda, const gsl_spmatrix * A, const gsl_vector * b,
+            gsl_vector * x, size_t * niter)
+{
+  const size_t n = A->size1;
+  const size_t p = A->size2;
+  const size_t max_iter = 2 * p;
+  const double atol = 1.0e-8;
+  const double btol = 1.0e-8;
+  const double damp2 = lambda * lambda;
+  gsl_vector *u = gsl_vector_alloc(n);
+  gsl_vector *v = gsl_vector_alloc(p);
+  gsl_vector *w = gsl_vector_alloc(p);
+  double alpha, beta, bnorm, anorm = 0.0, xnorm;
+  double rhobar, phibar, res2 = 0.0;
+  size_t iter;
+
+  gsl_vector_set_zero(x);
+  *niter = 0;
+
+  /* beta u = b, alpha v = A^T u */
+  gsl_vector_memcpy(u, b);
+  beta = bnorm = gsl_blas_dnrm2(u);
+  if (beta == 0.0)
+    {
+      gsl_vector_free(u);
+      gsl_vector_free(v);
+      gsl_vector_free(w);
+      return GSL_SUCCESS;
+    }
+
+  gsl_vector_scale(u, 1.0 / beta);
+  gsl_spblas_dgemv(CblasTrans, 1.0, A, u, 0.0, v);
+  alpha = gsl_blas_dnrm2(v);
+  if (alpha > 0.0)
+    gsl_vector_scale(v, 1.0 / alpha);
+
+  gsl_vector_memcpy(w, v);
+  rhobar = alpha;
+  phibar = beta;
+
+  for (iter = 0; iter < max_iter && alpha > 0.0; ++iter)
+    {
+      double rhobar1, cs1, sn1, psi, rho, cs, sn, theta, phi, tau;
+      double rnorm, arnorm;
+
+      /* bidiagonalization: beta u = A v - alpha u, alpha v = A^T u - beta v */
+      gsl_spblas_dgemv(CblasNoTrans, 1.0, A, v, -alpha, u);
+      beta = gsl_blas_dnrm2(u);
+      if (beta > 0.0)
+        gsl_vector_scale(u, 1.0 / beta);
+
+      anorm = sqrt(anorm * anorm + alpha * alpha + beta * beta + damp2);
+
+      gsl_spblas_dgemv(CblasTrans, 1.0, A, u, -beta, v);
+      alpha = gsl_blas_dnrm2(v);
+      if (alpha > 0.0)
+        gsl_vector_scale(v, 1.0 / alpha);
+
+      /* eliminate damping parameter */
+      rhobar1 = gsl_hypot(rhobar, lambda);
+      cs1 = rhobar / rhobar1;
+      sn1 = lambda / rhobar1;
+      psi = sn1 * phibar;
+      phibar *= cs1;
+
+      /* eliminate subdiagonal of bidiagonal matrix */
+      rho = gsl_hypot(rhobar1, beta);
+      cs = rhobar1 / rho;
+      sn = beta / rho;
+      theta = sn * alpha;
+      rhobar = -cs * alpha;
+      phi = cs * phibar;
+      phibar *= sn;
+      tau = sn * phi;
+
+      /* x = x + (phi/rho) w, w = v - (theta/rho) w */
+      gsl_blas_daxpy(phi / rho, w, x);
+      gsl_vector_scale(w, -theta / rho);
+      gsl_vector_add(w, v);
+
+      *niter = iter + 1;
+
+      /* stopping criteria */
+      res2 += psi * psi;
+      rnorm = sqrt(phibar * phibar + res2);
+      arnorm = alpha * fabs(tau);
+      xnorm = gsl_blas_dnrm2(x);
+
+      if (arnorm <= atol * anorm * rnorm)
+        break;
+
+      if (rnorm <= btol * bnorm + atol * anorm * xnorm)
+        break;
+    }
+
+  gsl_vector_free(u);
+  gsl_vector_free(v);
+  gsl_vector_free(w);
+
+  return GSL_SUCCESS;
+}
+
 /*
 secs2d_eval_B()
   Evaluate magnetic field at a given (r,theta) using
@@ -736,6 +1032,56 @@ secs2d_matrix_row_df(const double r, const double theta, const double phi,
   return 0;
 }
 
+/*
+secs2d_matrix_row_df_sparse()
+  Build sparse matrix rows corresponding to DF SECS, keeping only
+poles within the cutoff distance of the observation point
+
+Inputs: r      - radius (km)
+        theta  - colatitude (radians)
+        phi    - longitude (radians)
+        rowidx - index of X row in state->Xs; the Y and Z rows are
+                 rowidx + 1 and rowidx + 2
+        state  - state
+*/
+
+static int
+secs2d_matrix_row_df_sparse(const double r, const double theta, const double phi,
+                            const size_t rowidx, secs2d_state_t *state)
+{
+  size_t i, j, k;
+
+  for (i = 0; i < state->ntheta; ++i)
+    {
+      double theta0 = state->theta0[i];
+
+      /* the angular distance is at least |theta - theta0| */
+      if (fabs(theta - theta0) > state->cutoff)
+        continue;
+
+      for (j = 0; j < state->nphi; ++j)
+        {
+          double phi0 = state->phi0[j];
+          size_t pole_idx = secs2d_idx(i, j, state);
+          double thetap, B[3];
+
+          secs2d_transform(theta0, phi0, theta, phi, &thetap);
+          if (thetap > state->cutoff)
+            continue;
+
+          secs2d_green_df(r, theta, phi, theta0, phi0, B, state);
+
+          for (k = 0; k < 3; ++k)
+            {
+              if (B[k] != 0.0)
+                gsl_spmatrix_set(state->Xs, rowidx + k, state->df_offset + pole_idx, B[k]);
+            }
+        }
+    }
+
+  return 0;
+}
+
 /*
 secs2d_matrix_row_cf()
   Build matrix rows corresponding to CF SECS
@@ -0,0 +1,145 @@
+/*
+ * test.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_test.h>
+
+#include <common/common.h>
+
+#include "magfit.h"
+
+/* synthetic EEJ-like signal at (theta,phi) */
+static void
+test_field(const double theta, const double phi, double B[3])
+{
+  const double lat = 90.0 - theta * 180.0 / M_PI;
+  const double f = exp(-lat * lat / 50.0);
+
+  B[0] = -20.0 * f * (1.0 + 0.2 * cos(phi));
+  B[1] = 2.0 * f * sin(phi);
+  B[2] = 4.0 * lat * f;
+}
+
+/* add synthetic data on a regular grid covering the pole grid */
+static int
+test_add_data(const double r, magfit_workspace *w)
+{
+  int s = 0;
+  double lat, lon;
+
+  for (lat = -20.0; lat <= 20.0; lat += 2.0)
+    {
+      for (lon = -10.0; lon <= 30.0; lon += 2.0)
+        {
+          double theta = M_PI / 2.0 - lat * M_PI / 180.0;
+          double phi = lon * M_PI / 180.0;
+          double B[3];
+
+          test_field(theta, phi, B);
+          s += magfit_add_datum(0.0, r, theta, phi, lat, B, w);
+        }
+    }
+
+  return s;
+}
+
+/* maximum difference in the model field of two fits at the data points */
+static double
+test_diff(const double r, magfit_workspace *w1, magfit_workspace *w2)
+{
+  double lat, lon;
+  double err = 0.0;
+
+  for (lat = -20.0; lat <= 20.0; lat += 2.0)
+    {
+      for (lon = -10.0; lon <= 30.0; lon += 2.0)
+        {
+          double theta = M_PI / 2.0 - lat * M_PI / 180.0;
+          double phi = lon * M_PI / 180.0;
+          double B1[3], B2[3];
+          size_t j;
+
+          magfit_eval_B(0.0, r, theta, phi, B1, w1);
+          magfit_eval_B(0.0, r, theta, phi, B2, w2);
+
+          for (j = 0; j < 3; ++j)
+            err = GSL_MAX(err, fabs(B1[j] - B2[j]));
+        }
+    }
+
+  return err;
+}
+
+/*
+ * compare the sparse 2D SECS fit against the dense fit with a
+ * cutoff larger than the grid extent, so both solve the same LS
+ * system, and check a second sparse fit reproduces the first
+ */
+static int
+test_secs2d_sparse(void)
+{
+  int s = 0;
+  const double r = R_EARTH_KM + 450.0;
+  const double tol = 1.0e-2;   /* tolerance in nT relative to peak signal */
+  const double tol_refit = 1.0e-10;
+  magfit_parameters params = magfit_default_parameters();
+  magfit_workspace *dense_p, *sparse_p, *refit_p;
+  double rnorm_dense, snorm_dense;
+  double rnorm_sparse, snorm_sparse;
+  double rnorm_refit, snorm_refit;
+  double err;
+
+  params.flags = MAGFIT_FLG_FIT_X | MAGFIT_FLG_FIT_Y | MAGFIT_FLG_FIT_Z | MAGFIT_FLG_SECS_FIT_DF;
+  params.lat_spacing2d = 5.0;
+  params.lat_min = -10.0;
+  params.lat_max = 10.0;
+  params.lon_spacing = 5.0;
+  params.lon_min = 0.0;
+  params.lon_max = 20.0;
+
+  params.secs2d_cutoff = 0.0;
+  dense_p = magfit_alloc(magfit_secs2d, &params);
+
+  params.secs2d_cutoff = 90.0;
+  sparse_p = magfit_alloc(magfit_secs2d, &params);
+  refit_p = magfit_alloc(magfit_secs2d, &params);
+
+  s += test_add_data(r, dense_p);
+  s += test_add_data(r, sparse_p);
+  s += test_add_data(r, refit_p);
+
+  s += magfit_fit(&rnorm_dense, &snorm_dense, dense_p);
+  s += magfit_fit(&rnorm_sparse, &snorm_sparse, sparse_p);
+
+  /* fit twice; the second fit must not reapply the weights */
+  s += magfit_fit(&rnorm_refit, &snorm_refit, refit_p);
+  s += magfit_fit(&rnorm_refit, &snorm_refit, refit_p);
+
+  err = test_diff(r, dense_p, sparse_p);
+  gsl_test(err > tol * 20.0, "secs2d sparse/dense max field difference = %.2e [nT]", err);
+  gsl_test_rel(rnorm_sparse, rnorm_dense, tol, "secs2d sparse/dense rnorm");
+
+  err = test_diff(r, sparse_p, refit_p);
+  gsl_test(err > tol_refit, "secs2d sparse refit max field difference = %.2e [nT]", err);
+  gsl_test_rel(rnorm_refit, rnorm_sparse, tol_refit, "secs2d sparse refit rnorm");
+  gsl_test_rel(snorm_refit, snorm_sparse, tol_refit, "secs2d sparse refit snorm");
+
+  magfit_free(dense_p);
+  magfit_free(sparse_p);
+  magfit_free(refit_p);
+
+  return s;
+}
+
+int
+main(void)
+{
+  gsl_test(test_secs2d_sparse(), "secs2d sparse");
+
+  exit (gsl_test_summary());
+}
@@ -104,6 +104,9 @@ mfield_alloc(const mfield_parameters *params)
 
   w->params = *params;
 
+  w->myid = mfield_mpi_rank();
+  w->nprocs = mfield_mpi_size();
+
   w->weight_workspace_p = track_weight_alloc(ntheta, nphi);
 
   w->nbins_euler = calloc(1, w->nsat * sizeof(size_t));
@@ -260,8 +263,12 @@ mfield_alloc(const mfield_parameters *params)
   w->c = gsl_vector_calloc(w->p);
   w->c_copy = gsl_vector_alloc(w->p);
 
-  /* covariance matrix of the internal field coefficients */
-  w->covar = gsl_matrix_alloc(w->p_int, w->p_int);
+  /*
+   * covariance matrix of the internal field coefficients; the iterative
+   * solver keeps memory use O(n + p) and does not compute it
+   */
+  if (!params->iter_solver)
+    w->covar = gsl_matrix_alloc(w->p_int, w->p_int);
 
   w->dX = malloc(w->nnm_mf * sizeof(double));
   w->dY = malloc(w->nnm_mf * sizeof(double));
@@ -290,7 +297,9 @@ mfield_alloc(const mfield_parameters *params)
 
   w->niter = 0;
 
-  w->JTJ_vec = gsl_matrix_alloc(w->p_int, w->p_int);
+  /* the iterative solver never forms J^T J, so skip the p_int-by-p_int allocation */
+  if (!params->iter_solver)
+    w->JTJ_vec = gsl_matrix_alloc(w->p_int, w->p_int);
 
   w->eigen_workspace_p = gsl_eigen_symm_alloc(w->p);
 
@@ -330,8 +339,17 @@ mfield_alloc(const mfield_parameters *params)
       {
         w->green_array_p[i] = green_alloc(w->nmax_mf, w->nmax_mf, w->R);
         w->omp_J[i] = gsl_matrix_alloc(ncomp * w->data_block, w->p_int);
-        w->omp_GTG[i] = gsl_matrix_alloc(w->nnm_mf, w->nnm_mf);
-        w->omp_JTJ[i] = gsl_matrix_alloc(w->p_int, w->p_int);
+
+        if (!params->iter_solver)
+          {
+            w->omp_GTG[i] = gsl_matrix_alloc(w->nnm_mf, w->nnm_mf);
+            w->omp_JTJ[i] = gsl_matrix_alloc(w->p_int, w->p_int);
+          }
+        else
+          {
+            w->omp_GTG[i] = NULL;
+            w->omp_JTJ[i] = NULL;
+          }
       }
   }
 
@@ -456,8 +474,12 @@ mfield_free(mfield_workspace *w)
       {
         green_free(w->green_array_p[i]);
         gsl_matrix_free(w->omp_J[i]);
-        gsl_matrix_free(w->omp_GTG[i]);
-        gsl_matrix_free(w->omp_JTJ[i]);
+
+        if (w->omp_GTG[i])
+          gsl_matrix_free(w->omp_GTG[i]);
+
+        if (w->omp_JTJ[i])
+          gsl_matrix_free(w->omp_JTJ[i]);
       }
 
     free(w->green_array_p);
@@ -490,6 +512,7 @@ mfield_init_params(mfield_parameters * params)
   params->scale_time = 0;
   params->regularize = 0;
   params->use_weights = 0;
+  params->iter_solver = 0;
   params->lambda_sa = 0.0;
   params->weight_X = 0.0;
   params->weight_Y = 0.0;
@@ -652,6 +675,7 @@ mfield_init(mfield_workspace *w)
     }
 
   /* compute data weights with histogram */
+  mfield_mpi_histogram(w->weight_workspace_p);
   track_weight_calc(w->weight_workspace_p);
 
   mfield_init_nonlinear(w);
@@ -681,6 +705,11 @@ int
 mfield_calc_uncertainties(mfield_workspace *w)
 {
   int s = GSL_SUCCESS;
+
+  /* covariance matrix is not allocated for the iterative solver */
+  if (w->covar == NULL)
+    return s;
+
 #if 0 /* XXX */
   /*
    * compute uncertainties only for internal field coefficients; the
@@ -1310,7 +1339,9 @@ mfield_write(const char *filename, mfield_workspace *w)
    */
   fwrite(w->c->data, sizeof(double), w->p_int, fp);
 
-  gsl_matrix_fwrite(fp, w->covar);
+  /* covariance matrix is not computed by the iterative solver (params.iter_solver) */
+  if (w->covar)
+    gsl_matrix_fwrite(fp, w->covar);
 
   fclose(fp);
 
@@ -1342,7 +1373,9 @@ mfield_read(const char *filename)
   fread(&(w->t_sigma), sizeof(double), 1, fp);
   fread(&(w->t0_data), sizeof(double), 1, fp);
   fread(w->c->data, sizeof(double), w->p_int, fp);
-  gsl_matrix_fread(fp, w->covar);
+
+  if (w->covar)
+    gsl_matrix_fread(fp, w->covar);
 
   fclose(fp);
 
@@ -1362,7 +1395,6 @@ mfield_write_ascii(const char *filename, const double epoch,
   const mfield_parameters *params = &(w->params);
   FILE *fp;
   size_t n, i;
-  gsl_vector_view v = gsl_matrix_diagonal(w->covar);
   gsl_vector_view cov = gsl_vector_subvector(w->c_copy, 0, w->p_int);
 
   fp = fopen(filename, "w");
@@ -1376,7 +1408,17 @@ mfield_write_ascii(const char *filename, const double epoch,
   /* convert coefficients to physical time units */
   mfield_coeffs(1, w->c, w->c, w);
 
-  gsl_vector_memcpy(&cov.vector, &v.vector);
+  if (w->covar)
+    {
+      gsl_vector_view v = gsl_matrix_diagonal(w->covar);
+      gsl_vector_memcpy(&cov.vector, &v.vector);
+    }
+  else
+    {
+      /* no covariance matrix with iterative solver */
+      gsl_vector_set_zero(&cov.vector);
+    }
+
   for (i = 0; i < w->p_int; ++i)
     {
       double ci = gsl_vector_get(&cov.vector, i);
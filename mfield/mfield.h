@@ -18,6 +18,7 @@
 
 #include "mfield_data.h"
 #include "mfield_green.h"
+#include "mfield_mpi.h"
 
 #include "green.h"
 #include "track_weight.h"
@@ -70,6 +71,7 @@ typedef struct
 
   int scale_time;                       /* scale time into dimensionless units */
   int use_weights;                      /* use weights in the fitting */
+  int iter_solver;                      /* use matrix-free PCG solver instead of forming J^T J */
 
   int regularize;                       /* regularize the solution vector */
   double lambda_sv;                     /* secular variation damping factor */
@@ -218,6 +220,9 @@ typedef struct
 
   int lls_solution;        /* 1 if inverse problem is linear (no scalar residuals or Euler angles) */
 
+  int myid;                /* MPI id */
+  int nprocs;              /* number of MPI processes */
+
   gsl_vector *fvec;        /* residual vector for robust weights */
   gsl_vector *wfvec;       /* weighted residual vector */
   gsl_multifit_robust_workspace *robust_workspace_p;
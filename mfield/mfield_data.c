@@ -20,6 +20,7 @@
 #include <common/common.h>
 
 #include "mfield_data.h"
+#include "mfield_mpi.h"
 
 /*
 mfield_data_alloc()
@@ -296,6 +297,8 @@ Notes:
 3) w->t1_data is initialized to the timestamp of the last data point (CDF_EPOCH)
 
 3) w->t0 and w->t1 are initialized to the first/last timestamps of each satellite
+
+4) With MFIELD_MPI, all quantities are computed over the data of all processes
 */
 
 int
@@ -306,22 +309,26 @@ mfield_data_init(mfield_data_workspace *w)
 
   gsl_rstat_reset(w->rstat_workspace_p);
 
+  for (i = 0; i < w->nsources; ++i)
+    {
+      magdata *mptr = mfield_data_ptr(i, w);
+      magdata_t(&(w->t0[i]), &(w->t1[i]), mptr);
+    }
+
+  /* with MPI, each process holds only part of each satellite's data */
+  mfield_mpi_trange(w->nsources, w->t0, w->t1);
+
   w->t0_data = 1.0e15;
   w->t1_data = -1.0e15;
   for (i = 0; i < w->nsources; ++i)
     {
       magdata *mptr = mfield_data_ptr(i, w);
 
-      magdata_t(&(w->t0[i]), &(w->t1[i]), mptr);
-
-      if (mptr->n != 0)
-        {
-          if (w->t0[i] > 0.0)
-            w->t0_data = GSL_MIN(w->t0_data, w->t0[i]);
+      if (w->t0[i] > 0.0)
+        w->t0_data = GSL_MIN(w->t0_data, w->t0[i]);
 
-          if (w->t1[i] > 0.0)
-            w->t1_data = GSL_MAX(w->t1_data, w->t1[i]);
-        }
+      if (w->t1[i] > 0.0)
+        w->t1_data = GSL_MAX(w->t1_data, w->t1[i]);
 
       for (j = 0; j < mptr->n; ++j)
         {
@@ -335,8 +342,10 @@ mfield_data_init(mfield_data_workspace *w)
         }
     }
 
-  w->t_mu = gsl_rstat_mean(w->rstat_workspace_p);
-  w->t_sigma = gsl_rstat_sd(w->rstat_workspace_p);
+  {
+    size_t n;
+    mfield_mpi_rstat(w->rstat_workspace_p, &n, &(w->t_mu), &(w->t_sigma));
+  }
 
   if (w->t_sigma == 0.0)
     {
@@ -0,0 +1,768 @@
+/*
+ * mfield_iter.c
+ *
+ * Matrix-free solver for the main field inverse problem, for use
+ * when the number of model parameters p is too large to store and
+ * factor the dense p-by-p J^T J matrix. The Jacobian is applied
+ * through the J u and J^T u paths of mfield_calc_df2(), and the
+ * Gauss-Newton step is computed with preconditioned conjugate
+ * gradients on the regularized normal equations:
+
+[ J^T W J + L^T L ] dx = - [ J^T W f + L^T L x ]
+
+ * The preconditioner is block diagonal. Each internal coefficient
+ * (n,m) has a block of up to 3x3 coupling its MF, SV and SA terms,
+ * averaged over the orders m of degree n; each Euler angle bin has
+ * a 3x3 block for (alpha,beta,gamma); external field parameters have
+ * 1x1 blocks. diag(L^T L) is added to the block diagonals. Memory
+ * use is O(n + p).
+ *
+ * This path is enabled with the iter_solver configuration parameter.
+ */
+
+static int mfield_calc_nonlinear_iter(const gsl_vector *c, mfield_workspace *w);
+static int mfield_iter_apply(const gsl_vector *x, const gsl_vector *u, gsl_vector *Ju,
+                             gsl_vector *v, mfield_workspace *w);
+static size_t mfield_iter_nblock(const mfield_workspace *w);
+static size_t mfield_iter_block_idx(const size_t b, size_t idx[3], const mfield_workspace *w);
+static int mfield_iter_precond(const gsl_vector *x, gsl_vector *M, mfield_workspace *w);
+static int mfield_iter_precond_apply(const gsl_vector *M, const gsl_vector *r, gsl_vector *z,
+                                     const mfield_workspace *w);
+static int mfield_iter_cg(const gsl_vector *x, const gsl_vector *g, const gsl_vector *M,
+                          gsl_vector *dx, gsl_vector *Ju, size_t *niter, mfield_workspace *w);
+static inline void mfield_iter_block_int(const double t, const double weight, const gsl_vector *g,
+                                         const double t_grad, const gsl_vector *g_grad,
+                                         gsl_vector *d, const mfield_workspace *w);
+static int mfield_iter_block_degree(gsl_vector *d, const mfield_workspace *w);
+static int mfield_iter_block_chol(double *B, const size_t nb);
+
+/*
+mfield_calc_nonlinear_iter()
+  Calculate a solution to current inverse problem using a
+matrix-free Gauss-Newton method with PCG inner iterations
+
+Inputs: c - initial coefficient vector (dimensionless units)
+        w - workspace
+
+Notes:
+1) w->wts_final must be initialized prior to calling this function
+2) On output, w->c contains the solution coefficients in dimensionless units
+3) For a linear problem (w->lls_solution = 1) a single Gauss-Newton
+step is taken
+4) If no step halving reduces the cost function, w->c is left at
+the previous iterate and the iteration stops
+*/
+
+static int
+mfield_calc_nonlinear_iter(const gsl_vector *c, mfield_workspace *w)
+{
+  int s = 0;
+  const size_t p = w->p;
+  const size_t max_iter = (w->lls_solution == 1) ? 1 : 20;
+  const double xtol = 1.0e-6;
+  gsl_vector *g, *dx, *M, *x_trial, *Ju;
+  struct timeval tv0, tv1;
+  double fnorm, fnorm0;
+  size_t iter;
+
+  if (w->nprocs > 1)
+    {
+      fprintf(stderr, "mfield_calc_nonlinear_iter: error: iterative solver not supported with %d MPI processes\n",
+              w->nprocs);
+      return GSL_EINVAL;
+    }
+
+  g = gsl_vector_alloc(p);              /* gradient J^T W f + L^T L x */
+  dx = gsl_vector_alloc(p);             /* Gauss-Newton step */
+  M = gsl_vector_alloc(9 * mfield_iter_nblock(w)); /* preconditioner blocks */
+  x_trial = gsl_vector_alloc(p);
+  Ju = gsl_vector_alloc(w->nres_tot);
+
+  gsl_vector_memcpy(w->c, c);
+
+  mfield_calc_Wf(w->c, w, w->wfvec);
+  fnorm = fnorm0 = gsl_blas_dnrm2(w->wfvec);
+
+  for (iter = 0; iter < max_iter; ++iter)
+    {
+      size_t ncg;
+      double dxnorm, xnorm;
+      double fnorm_trial;
+      int accepted = 0;
+      int k;
+
+      /* preconditioner depends on x only through scalar residuals and Euler angles */
+      if (iter == 0 || w->lls_solution == 0)
+        {
+          fprintf(stderr, "mfield_calc_nonlinear_iter: computing preconditioner...");
+          gettimeofday(&tv0, NULL);
+          mfield_iter_precond(w->c, M, w);
+          gettimeofday(&tv1, NULL);
+          fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+        }
+
+      /* g = J^T W f + L^T L x; the regularization rows of wfvec are not used by mfield_calc_df2() */
+      mfield_calc_df2(CblasTrans, w->c, w->wfvec, w, g, NULL);
+      gsl_vector_memcpy(x_trial, w->c);
+      gsl_vector_mul(x_trial, w->LTL);
+      gsl_vector_add(g, x_trial);
+
+      fprintf(stderr, "mfield_calc_nonlinear_iter: solving normal equations with PCG...");
+      gettimeofday(&tv0, NULL);
+      s = mfield_iter_cg(w->c, g, M, dx, Ju, &ncg, w);
+      gettimeofday(&tv1, NULL);
+      fprintf(stderr, "done (%zu iterations, %g seconds)\n", ncg, time_diff(tv0, tv1));
+
+      if (s == GSL_EMAXITER)
+        {
+          /* a truncated PCG step is still a descent direction */
+          fprintf(stderr, "mfield_calc_nonlinear_iter: warning: PCG did not converge in %zu iterations\n", ncg);
+          s = GSL_SUCCESS;
+        }
+      else if (s)
+        {
+          fprintf(stderr, "mfield_calc_nonlinear_iter: error: PCG failed: %s\n", gsl_strerror(s));
+          break;
+        }
+
+      /* take step, halving it if the cost function does not decrease */
+      for (k = 0; k < 10; ++k)
+        {
+          gsl_vector_memcpy(x_trial, w->c);
+          gsl_vector_add(x_trial, dx);
+
+          mfield_calc_Wf(x_trial, w, w->wfvec);
+          fnorm_trial = gsl_blas_dnrm2(w->wfvec);
+
+          if (w->lls_solution == 1 || fnorm_trial <= fnorm)
+            {
+              accepted = 1;
+              break;
+            }
+
+          gsl_vector_scale(dx, 0.5);
+        }
+
+      if (!accepted)
+        {
+          fprintf(stderr, "mfield_calc_nonlinear_iter: warning: step did not reduce cost function, stopping\n");
+
+          /* restore residuals at the current iterate */
+          mfield_calc_Wf(w->c, w, w->wfvec);
+          break;
+        }
+
+      gsl_vector_memcpy(w->c, x_trial);
+      fnorm = fnorm_trial;
+
+      dxnorm = gsl_blas_dnrm2(dx);
+      xnorm = gsl_blas_dnrm2(w->c);
+
+      fprintf(stderr, "mfield_calc_nonlinear_iter: iter %zu: |f| = %.12e, |dx| = %.12e\n",
+              iter + 1, fnorm, dxnorm);
+
+      if (dxnorm <= xtol * (xnorm + xtol))
+        break;
+    }
+
+  fprintf(stderr, "mfield_calc_nonlinear_iter: initial |f(x)|: %.12e\n", fnorm0);
+  fprintf(stderr, "mfield_calc_nonlinear_iter: final   |f(x)|: %.12e\n", fnorm);
+
+  gsl_vector_free(g);
+  gsl_vector_free(dx);
+  gsl_vector_free(M);
+  gsl_vector_free(x_trial);
+  gsl_vector_free(Ju);
+
+  return s;
+} /* mfield_calc_nonlinear_iter() */
+
+/*
+mfield_iter_apply()
+  Compute v = [ J^T W J + L^T L ] u without forming J^T J
+
+Inputs: x  - current model parameters, length p
+        u  - input vector, length p
+        Ju - (output) workspace for sqrt(W) J u, length nres_tot
+        v  - (output) result vector, length p
+        w  - workspace
+*/
+
+static int
+mfield_iter_apply(const gsl_vector *x, const gsl_vector *u, gsl_vector *Ju,
+                  gsl_vector *v, mfield_workspace *w)
+{
+  int s;
+  size_t i;
+
+  s = mfield_calc_df2(CblasNoTrans, x, u, w, Ju, NULL);
+  if (s)
+    return s;
+
+  s = mfield_calc_df2(CblasTrans, x, Ju, w, v, NULL);
+  if (s)
+    return s;
+
+  for (i = 0; i < w->p; ++i)
+    {
+      double *vi = gsl_vector_ptr(v, i);
+      *vi += gsl_vector_get(w->LTL, i) * gsl_vector_get(u, i);
+    }
+
+  return s;
+}
+
+/*
+mfield_iter_cg()
+  Solve [ J^T W J + L^T L ] dx = -g with block-Jacobi
+preconditioned conjugate gradients
+
+Inputs: x     - current model parameters
+        g     - gradient vector
+        M     - factored preconditioner blocks from mfield_iter_precond()
+        dx    - (output) solution vector
+        Ju    - workspace, length nres_tot
+        niter - (output) number of CG iterations
+        w     - workspace
+
+Return: success/error; GSL_EMAXITER if the residual tolerance was
+not reached within the iteration limit, in which case dx contains
+the last CG iterate
+*/
+
+static int
+mfield_iter_cg(const gsl_vector *x, const gsl_vector *g, const gsl_vector *M,
+               gsl_vector *dx, gsl_vector *Ju, size_t *niter, mfield_workspace *w)
+{
+  int s = GSL_SUCCESS;
+  const size_t p = w->p;
+  const size_t max_iter = GSL_MIN(p, 500);
+  const double tol = 1.0e-8;
+  gsl_vector *r = gsl_vector_alloc(p);
+  gsl_vector *z = gsl_vector_alloc(p);
+  gsl_vector *d = gsl_vector_alloc(p);
+  gsl_vector *q = gsl_vector_alloc(p);
+  const double gnorm = gsl_blas_dnrm2(g);
+  double rz, rz_new, dq, alpha, beta;
+  int converged = (gnorm == 0.0);
+  size_t iter;
+
+  gsl_vector_set_zero(dx);
+  *niter = 0;
+
+  /* r = -g, z = M^{-1} r, d = z */
+  gsl_vector_memcpy(r, g);
+  gsl_vector_scale(r, -1.0);
+  mfield_iter_precond_apply(M, r, z, w);
+  gsl_vector_memcpy(d, z);
+  gsl_blas_ddot(r, z, &rz);
+
+  for (iter = 0; iter < max_iter && gnorm > 0.0; ++iter)
+    {
+      s = mfield_iter_apply(x, d, Ju, q, w);
+      if (s)
+        break;
+
+      gsl_blas_ddot(d, q, &dq);
+      if (dq <= 0.0)
+        {
+          /* loss of positive definiteness; keep current iterate */
+          converged = 1;
+          break;
+        }
+
+      alpha = rz / dq;
+
+      gsl_blas_daxpy(alpha, d, dx);
+      gsl_blas_daxpy(-alpha, q, r);
+
+      *niter = iter + 1;
+
+      if (gsl_blas_dnrm2(r) <= tol * gnorm)
+        {
+          converged = 1;
+          break;
+        }
+
+      mfield_iter_precond_apply(M, r, z, w);
+      gsl_blas_ddot(r, z, &rz_new);
+
+      beta = rz_new / rz;
+      rz = rz_new;
+
+      /* d = z + beta d */
+      gsl_vector_scale(d, beta);
+      gsl_vector_add(d, z);
+    }
+
+  gsl_vector_free(r);
+  gsl_vector_free(z);
+  gsl_vector_free(d);
+  gsl_vector_free(q);
+
+  if (s == GSL_SUCCESS && !converged)
+    s = GSL_EMAXITER;
+
+  return s;
+}
+
+/*
+mfield_iter_nblock()
+  Return number of preconditioner blocks: one per internal (n,m)
+coefficient, one per Euler angle bin and one per external parameter
+*/
+
+static size_t
+mfield_iter_nblock(const mfield_workspace *w)
+{
+  return w->nnm_mf + w->neuler / 3 + w->next;
+}
+
+/*
+mfield_iter_block_idx()
+  Return parameter indices of preconditioner block b
+
+Inputs: b   - block index in [0,nblock-1]
+        idx - (output) indices into coefficient vector
+        w   - workspace
+
+Return: block size (1, 2 or 3)
+
+Notes:
+1) Internal blocks are ordered [ MF_k, SV_k, SA_k ], with the SV and
+SA entries present only for k < nnm_sv and k < nnm_sa
+*/
+
+static size_t
+mfield_iter_block_idx(const size_t b, size_t idx[3], const mfield_workspace *w)
+{
+  size_t nb = 0;
+
+  if (b < w->nnm_mf)
+    {
+      idx[nb++] = b;
+
+      if (b < w->nnm_sv)
+        idx[nb++] = w->sv_offset + b;
+
+      if (b < w->nnm_sa)
+        idx[nb++] = w->sa_offset + b;
+    }
+  else if (b < w->nnm_mf + w->neuler / 3)
+    {
+      size_t k = w->euler_offset + 3 * (b - w->nnm_mf);
+
+      idx[nb++] = k;
+      idx[nb++] = k + 1;
+      idx[nb++] = k + 2;
+    }
+  else
+    {
+      idx[nb++] = w->ext_offset + (b - w->nnm_mf - w->neuler / 3);
+    }
+
+  return nb;
+}
+
+/*
+mfield_iter_precond()
+  Compute block diagonal preconditioner for mfield_iter_cg()
+
+Inputs: x - current model parameters
+        M - (output) Cholesky factors of preconditioner blocks,
+            length 9*nblock; block b is stored row-major in
+            M[9*b:9*b+8] with its factor in the lower triangle
+        w - workspace
+
+Notes:
+1) The internal field blocks of J^T W J are averaged over the
+orders m of each degree n
+
+2) Blocks which are not positive definite are reduced to their
+diagonal; parameters not constrained by any data get unit diagonal
+*/
+
+static int
+mfield_iter_precond(const gsl_vector *x, gsl_vector *M, mfield_workspace *w)
+{
+  const size_t nblock = mfield_iter_nblock(w);
+  gsl_matrix *D = gsl_matrix_calloc(w->max_threads, 9 * nblock); /* per-thread blocks of J^T W J */
+  size_t i, j, k;
+
+  for (i = 0; i < w->nsat; ++i)
+    {
+      magdata *mptr = mfield_data_ptr(i, w->data_workspace_p);
+      int fit_euler = w->params.fit_euler && (mptr->global_flags & MAGDATA_GLOBFLG_EULER);
+
+#pragma omp parallel for private(j)
+      for (j = 0; j < mptr->n; ++j)
+        {
+          int thread_id = omp_get_thread_num();
+          gsl_vector_view d = gsl_matrix_row(D, thread_id);
+          double t = mptr->ts[j];
+          size_t ridx = mptr->index[j];
+          double B_nec[3][3];    /* Euler angle derivatives: B_nec[component][angle] */
+          size_t euler_idx = 0;
+          gsl_vector_view vx = gsl_matrix_row(w->omp_dX, thread_id);
+          gsl_vector_view vy = gsl_matrix_row(w->omp_dY, thread_id);
+          gsl_vector_view vz = gsl_matrix_row(w->omp_dZ, thread_id);
+          gsl_vector_view vx_grad = gsl_matrix_row(w->omp_dX_grad, thread_id);
+          gsl_vector_view vy_grad = gsl_matrix_row(w->omp_dY_grad, thread_id);
+          gsl_vector_view vz_grad = gsl_matrix_row(w->omp_dZ_grad, thread_id);
+          gsl_vector *vg[3];
+          size_t comp;
+
+          if (MAGDATA_Discarded(mptr->flags[j]))
+            continue;
+
+          vg[0] = &vx.vector;
+          vg[1] = &vy.vector;
+          vg[2] = &vz.vector;
+
+          green_calc_int(mptr->r[j], mptr->theta[j], mptr->phi[j],
+                         vx.vector.data, vy.vector.data, vz.vector.data,
+                         w->green_array_p[thread_id]);
+
+          if (mptr->flags[j] & (MAGDATA_FLG_DX_NS | MAGDATA_FLG_DY_NS | MAGDATA_FLG_DZ_NS |
+                                MAGDATA_FLG_DX_EW | MAGDATA_FLG_DY_EW | MAGDATA_FLG_DZ_EW))
+            {
+              green_calc_int(mptr->r_ns[j], mptr->theta_ns[j], mptr->phi_ns[j],
+                             vx_grad.vector.data, vy_grad.vector.data, vz_grad.vector.data,
+                             w->green_array_p[thread_id]);
+            }
+
+          if (fit_euler)
+            {
+              const double *q = &(mptr->q[4*j]);
+              double alpha, beta, gamma, B_vfm[3], B_deriv[3];
+              size_t a;
+
+              euler_idx = mfield_euler_idx(i, mptr->t[j], w);
+              alpha = gsl_vector_get(x, euler_idx);
+              beta = gsl_vector_get(x, euler_idx + 1);
+              gamma = gsl_vector_get(x, euler_idx + 2);
+
+              B_vfm[0] = mptr->Bx_vfm[j];
+              B_vfm[1] = mptr->By_vfm[j];
+              B_vfm[2] = mptr->Bz_vfm[j];
+
+              for (a = 0; a < 3; ++a)
+                {
+                  const size_t deriv_flag[3] = { EULER_FLG_DERIV_ALPHA, EULER_FLG_DERIV_BETA, EULER_FLG_DERIV_GAMMA };
+
+                  euler_vfm2nec(mptr->euler_flags | deriv_flag[a], alpha, beta, gamma, q, B_vfm, B_deriv);
+
+                  for (comp = 0; comp < 3; ++comp)
+                    B_nec[comp][a] = B_deriv[comp];
+                }
+            }
+
+          /* vector residuals */
+          for (comp = 0; comp < 3; ++comp)
+            {
+              const size_t flag[3] = { MAGDATA_FLG_X, MAGDATA_FLG_Y, MAGDATA_FLG_Z };
+
+              if (mptr->flags[j] & flag[comp])
+                {
+                  double wj = gsl_vector_get(w->wts_final, ridx);
+
+                  if (MAGDATA_FitMF(mptr->flags[j]))
+                    mfield_iter_block_int(t, wj, vg[comp], 0.0, NULL, &d.vector, w);
+
+                  if (fit_euler && MAGDATA_FitEuler(mptr->flags[j]))
+                    {
+                      size_t b = w->nnm_mf + (euler_idx - w->euler_offset) / 3;
+                      double *B = gsl_vector_ptr(&d.vector, 9 * b);
+                      size_t l;
+
+                      for (k = 0; k < 3; ++k)
+                        {
+                          for (l = 0; l < 3; ++l)
+                            B[3 * k + l] += wj * B_nec[comp][k] * B_nec[comp][l];
+                        }
+                    }
+
+                  ++ridx;
+                }
+            }
+
+          /* scalar residual */
+          if (MAGDATA_ExistScalar(mptr->flags[j]) &&
+              MAGDATA_FitMF(mptr->flags[j]))
+            {
+              double wj = gsl_vector_get(w->wts_final, ridx);
+              gsl_vector_view vF = gsl_matrix_subrow(w->omp_J[thread_id], 0, 0, w->nnm_mf);
+              double B_total[4], b[3];
+
+              B_total[0] = mfield_nonlinear_model_int(t, &vx.vector, x, w) + mptr->Bx_model[j];
+              B_total[1] = mfield_nonlinear_model_int(t, &vy.vector, x, w) + mptr->By_model[j];
+              B_total[2] = mfield_nonlinear_model_int(t, &vz.vector, x, w) + mptr->Bz_model[j];
+              B_total[3] = gsl_hypot3(B_total[0], B_total[1], B_total[2]);
+
+              for (k = 0; k < 3; ++k)
+                b[k] = B_total[k] / B_total[3];
+
+              /* omp_J is not otherwise used here, so borrow its first row */
+              for (k = 0; k < w->nnm_mf; ++k)
+                {
+                  gsl_vector_set(&vF.vector, k, b[0] * gsl_vector_get(&vx.vector, k) +
+                                                b[1] * gsl_vector_get(&vy.vector, k) +
+                                                b[2] * gsl_vector_get(&vz.vector, k));
+                }
+
+              mfield_iter_block_int(t, wj, &vF.vector, 0.0, NULL, &d.vector, w);
+
+              ++ridx;
+            }
+
+          /* vector gradient residuals */
+          for (comp = 0; comp < 3; ++comp)
+            {
+              const size_t flag[3] = { MAGDATA_FLG_DX_NS | MAGDATA_FLG_DX_EW,
+                                       MAGDATA_FLG_DY_NS | MAGDATA_FLG_DY_EW,
+                                       MAGDATA_FLG_DZ_NS | MAGDATA_FLG_DZ_EW };
+              gsl_vector *vg_grad[3];
+
+              vg_grad[0] = &vx_grad.vector;
+              vg_grad[1] = &vy_grad.vector;
+              vg_grad[2] = &vz_grad.vector;
+
+              if (mptr->flags[j] & flag[comp])
+                {
+                  double wj = gsl_vector_get(w->wts_final, ridx);
+
+                  if (MAGDATA_FitMF(mptr->flags[j]))
+                    mfield_iter_block_int(t, wj, vg[comp], mptr->ts_ns[j], vg_grad[comp], &d.vector, w);
+
+                  ++ridx;
+                }
+            }
+        }
+    }
+
+  /* sum thread contributions */
+  gsl_vector_set_zero(M);
+  for (i = 0; i < w->max_threads; ++i)
+    {
+      gsl_vector_view d = gsl_matrix_row(D, i);
+      gsl_vector_add(M, &d.vector);
+    }
+
+  /* average internal field blocks over each degree */
+  mfield_iter_block_degree(M, w);
+
+  for (i = 0; i < nblock; ++i)
+    {
+      double *B = gsl_vector_ptr(M, 9 * i);
+      double Bsave[9];
+      size_t idx[3];
+      size_t nb = mfield_iter_block_idx(i, idx, w);
+
+      for (k = 0; k < nb; ++k)
+        {
+          B[4 * k] += gsl_vector_get(w->LTL, idx[k]);
+
+          /* guard against parameters not constrained by any data */
+          if (B[4 * k] <= 0.0)
+            {
+              for (j = 0; j < nb; ++j)
+                B[3 * k + j] = B[3 * j + k] = 0.0;
+
+              B[4 * k] = 1.0;
+            }
+        }
+
+      for (k = 0; k < 9; ++k)
+        Bsave[k] = B[k];
+
+      if (mfield_iter_block_chol(B, nb))
+        {
+          /* not positive definite: fall back to the block diagonal */
+          for (k = 0; k < 9; ++k)
+            B[k] = (k % 4 == 0) ? Bsave[k] : 0.0;
+
+          mfield_iter_block_chol(B, nb);
+        }
+    }
+
+  gsl_matrix_free(D);
+
+  return GSL_SUCCESS;
+}
+
+/*
+mfield_iter_precond_apply()
+  Compute z = M^{-1} r with the block Cholesky factors from
+mfield_iter_precond()
+*/
+
+static int
+mfield_iter_precond_apply(const gsl_vector *M, const gsl_vector *r, gsl_vector *z,
+                          const mfield_workspace *w)
+{
+  const size_t nblock = mfield_iter_nblock(w);
+  size_t i;
+
+  for (i = 0; i < nblock; ++i)
+    {
+      const double *L = gsl_vector_const_ptr(M, 9 * i);
+      size_t idx[3];
+      size_t nb = mfield_iter_block_idx(i, idx, w);
+      double y[3];
+      size_t j, k;
+
+      /* solve L y = r */
+      for (j = 0; j < nb; ++j)
+        {
+          double sum = gsl_vector_get(r, idx[j]);
+
+          for (k = 0; k < j; ++k)
+            sum -= L[3 * j + k] * y[k];
+
+          y[j] = sum / L[4 * j];
+        }
+
+      /* solve L^T z = y */
+      for (j = nb; j-- > 0; )
+        {
+          double sum = y[j];
+
+          for (k = j + 1; k < nb; ++k)
+            sum -= L[3 * k + j] * y[k];
+
+          y[j] = sum / L[4 * j];
+        }
+
+      for (j = 0; j < nb; ++j)
+        gsl_vector_set(z, idx[j], y[j]);
+    }
+
+  return GSL_SUCCESS;
+}
+
+/*
+mfield_iter_block_int()
+  Add internal field contributions of a single residual to the
+MF/SV/SA preconditioner blocks
+
+Inputs: t      - scaled timestamp
+        weight - residual weight
+        g      - internal Green's functions, length nnm_mf
+        t_grad - scaled timestamp of gradient point
+        g_grad - internal Green's functions of gradient point, or
+                 NULL for non-gradient residuals
+        d      - (output) preconditioner blocks, length 9*nblock
+        w      - workspace
+*/
+
+static inline void
+mfield_iter_block_int(const double t, const double weight, const gsl_vector *g,
+                      const double t_grad, const gsl_vector *g_grad,
+                      gsl_vector *d, const mfield_workspace *w)
+{
+  size_t k;
+
+  for (k = 0; k < w->nnm_mf; ++k)
+    {
+      double gk = gsl_vector_get(g, k);
+      double dgk = g_grad ? gsl_vector_get(g_grad, k) : 0.0;
+      double *B = gsl_vector_ptr(d, 9 * k);
+      double a[3];
+      size_t nb = 0;
+      size_t i, j;
+
+      a[nb++] = g_grad ? (dgk - gk) : gk;
+
+      if (k < w->nnm_sv)
+        a[nb++] = g_grad ? (t_grad * dgk - t * gk) : t * gk;
+
+      if (k < w->nnm_sa)
+        a[nb++] = g_grad ? 0.5 * (t_grad * t_grad * dgk - t * t * gk) : 0.5 * t * t * gk;
+
+      for (i = 0; i < nb; ++i)
+        {
+          for (j = 0; j < nb; ++j)
+            B[3 * i + j] += weight * a[i] * a[j];
+        }
+    }
+}
+
+/*
+mfield_iter_block_degree()
+  Replace internal field blocks by their average over all orders m
+for each degree n
+*/
+
+static int
+mfield_iter_block_degree(gsl_vector *d, const mfield_workspace *w)
+{
+  size_t n;
+
+  for (n = 1; n <= w->nmax_mf; ++n)
+    {
+      int ni = (int) n;
+      int m;
+      double sum[9] = { 0.0 };
+      size_t k;
+
+      for (m = -ni; m <= ni; ++m)
+        {
+          const double *B = gsl_vector_const_ptr(d, 9 * mfield_coeff_nmidx(n, m));
+
+          for (k = 0; k < 9; ++k)
+            sum[k] += B[k];
+        }
+
+      for (m = -ni; m <= ni; ++m)
+        {
+          double *B = gsl_vector_ptr(d, 9 * mfield_coeff_nmidx(n, m));
+
+          for (k = 0; k < 9; ++k)
+            B[k] = sum[k] / (2.0 * n + 1.0);
+        }
+    }
+
+  return GSL_SUCCESS;
+}
+
+/*
+mfield_iter_block_chol()
+  Cholesky factor a symmetric nb-by-nb block (nb <= 3) in place
+
+Inputs: B  - row-major block with row stride 3; on output the lower
+             triangle contains the factor L
+        nb - block size
+
+Return: 0 on success, -1 if the block is not positive definite
+*/
+
+static int
+mfield_iter_block_chol(double *B, const size_t nb)
+{
+  size_t i, j, k;
+
+  for (j = 0; j < nb; ++j)
+    {
+      double djj = B[4 * j];
+
+      for (k = 0; k < j; ++k)
+        djj -= B[3 * j + k] * B[3 * j + k];
+
+      if (djj <= 0.0)
+        return -1;
+
+      B[4 * j] = sqrt(djj);
+
+      for (i = j + 1; i < nb; ++i)
+        {
+          double sum = B[3 * i + j];
+
+          for (k = 0; k < j; ++k)
+            sum -= B[3 * i + k] * B[3 * j + k];
+
+          B[3 * i + j] = sum / B[4 * j];
+        }
+    }
+
+  return 0;
+}
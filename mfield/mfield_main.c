@@ -12,6 +12,12 @@
  *   -r residual_file
  *   -l Lcurve_data_file
  *
+ * When built with MFIELD_MPI = 1 (see mfield_mpi.h), run with
+ * mpirun; each process fits a partition of the data and only
+ * rank 0 writes output files, except for the residual files
+ * (-r), which each process writes for its own partition with a
+ * _rank# suffix.
+ *
  * After each iteration, the file 'res.#.dat' is written
  * where # is the iteration number. This file contains the
  * residuals of a sample of the DMSP dataset.
@@ -240,34 +246,67 @@ print_spectrum(const char *filename, mfield_workspace *w)
   return 0;
 } /* print_spectrum() */
 
+/*
+mfield_print_residual_stat()
+  Print residual statistics for one component
+
+Inputs: component_str - component name, or NULL to print header
+        rstat_p       - running statistics of local residuals
+
+Notes:
+1) With MPI, the statistics are combined over all processes and
+printed by rank 0; every process must call this function
+*/
+
 int
 mfield_print_residual_stat(const char *component_str, const gsl_rstat_workspace *rstat_p)
 {
+  const int myid = mfield_mpi_rank();
+
   if (component_str == NULL)
     {
       /* print header */
-      fprintf(stderr, "%12s %10s %12s %12s %12s\n",
-              "", "N", "mean (nT)", "sigma (nT)", "rms (nT)");
-
+      if (myid == 0)
+        {
+          fprintf(stderr, "%12s %10s %12s %12s %12s\n",
+                  "", "N", "mean (nT)", "sigma (nT)", "rms (nT)");
+        }
     }
   else
     {
-      const size_t n = gsl_rstat_n(rstat_p);
+      size_t n;
+      double mean, sd;
+
+      mfield_mpi_rstat(rstat_p, &n, &mean, &sd);
 
-      if (n > 0)
+      if (n > 0 && myid == 0)
         {
+          /* rms^2 = mean^2 + (n-1)/n sd^2 */
+          double rms = sqrt(mean * mean + (n - 1.0) / n * sd * sd);
+
           fprintf(stderr, "%12s %10zu %12.2f %12.2f %12.2f\n",
-                  component_str,
-                  n,
-                  gsl_rstat_mean(rstat_p),
-                  gsl_rstat_sd(rstat_p),
-                  gsl_rstat_rms(rstat_p));
+                  component_str, n, mean, sd, rms);
         }
     }
 
   return GSL_SUCCESS;
 }
 
+/*
+mfield_print_residual()
+  Print residual files and fit statistics for each satellite
+
+Inputs: prefix - output directory
+        iter   - robust iteration number
+        w      - workspace
+
+Notes:
+1) With more than one MPI process, each process writes the residuals
+of its own data partition to files with a "_rank#" suffix, and the
+fit statistics are reduced to rank 0; every process must call this
+function
+*/
+
 int
 mfield_print_residual(const char *prefix, const size_t iter, mfield_workspace *w)
 {
@@ -282,6 +321,8 @@ mfield_print_residual(const char *prefix, const size_t iter, mfield_workspace *w
   size_t i;
   mfield_data_workspace *data_p = w->data_workspace_p;
   size_t idx = 0;
+  const int myid = mfield_mpi_rank();
+  char suffix[32] = "";
   gsl_rstat_workspace *rstat_x = gsl_rstat_alloc();
   gsl_rstat_workspace *rstat_y = gsl_rstat_alloc();
   gsl_rstat_workspace *rstat_z = gsl_rstat_alloc();
@@ -301,7 +342,11 @@ mfield_print_residual(const char *prefix, const size_t iter, mfield_workspace *w
   gsl_rstat_workspace *rstat_high_dz_ew = gsl_rstat_alloc();
   gsl_rstat_workspace *rstat_df_ew = gsl_rstat_alloc();
 
-  fprintf(stderr, "\n");
+  if (mfield_mpi_size() > 1)
+    sprintf(suffix, "_rank%d", myid);
+
+  if (myid == 0)
+    fprintf(stderr, "\n");
 
   for (i = 0; i < data_p->nsources; ++i)
     {
@@ -327,40 +372,40 @@ mfield_print_residual(const char *prefix, const size_t iter, mfield_workspace *w
       gsl_rstat_reset(rstat_high_dz_ew);
       gsl_rstat_reset(rstat_df_ew);
 
-      sprintf(buf, "%s/res%zu_X_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_X_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[0] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_Y_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_Y_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[1] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_Z_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_Z_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[2] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_F_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_F_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[3] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_DX_NS_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_DX_NS_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[4] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_DY_NS_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_DY_NS_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[5] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_DZ_NS_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_DZ_NS_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[6] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_DF_NS_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_DF_NS_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[7] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_DX_EW_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_DX_EW_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[8] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_DY_EW_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_DY_EW_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[9] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_DZ_EW_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_DZ_EW_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[10] = fopen(buf, "w");
 
-      sprintf(buf, "%s/res%zu_DF_EW_iter%zu.dat", prefix, i, iter);
+      sprintf(buf, "%s/res%zu_DF_EW_iter%zu%s.dat", prefix, i, iter, suffix);
       fp[11] = fopen(buf, "w");
 
       /* header line */
@@ -740,7 +785,8 @@ mfield_print_residual(const char *prefix, const size_t iter, mfield_workspace *w
             }
         }
 
-      fprintf(stderr, "=== FIT STATISTICS SATELLITE %zu ===\n", i);
+      if (myid == 0)
+        fprintf(stderr, "=== FIT STATISTICS SATELLITE %zu ===\n", i);
 
       /* print header */
       mfield_print_residual_stat(NULL, NULL);
@@ -1154,6 +1200,36 @@ check_parameters(const mfield_parameters * mfield_params,
         }
     }
 
+  /*
+   * with several MPI processes only the linear (vector data, no Euler
+   * angles) problem can be solved, since the normal equations are
+   * reduced onto rank 0; reject other setups before reading any data
+   */
+  if (mfield_mpi_size() > 1)
+    {
+      if (mfield_params->iter_solver)
+        {
+          fprintf(stderr, "check_parameters: iter_solver is not supported with %d MPI processes\n",
+                  mfield_mpi_size());
+          ++s;
+        }
+
+      if (mfield_params->fit_euler)
+        {
+          fprintf(stderr, "check_parameters: fitting Euler angles is not supported with %d MPI processes\n",
+                  mfield_mpi_size());
+          ++s;
+        }
+
+      if (data_params->fit_F || data_params->fit_DF_NS || data_params->fit_DF_EW ||
+          data_params->fit_F_highlat || data_params->fit_DF_NS_highlat || data_params->fit_DF_EW_highlat)
+        {
+          fprintf(stderr, "check_parameters: fitting scalar data is not supported with %d MPI processes\n",
+                  mfield_mpi_size());
+          ++s;
+        }
+    }
+
   return s;
 }
 
@@ -1213,6 +1289,8 @@ parse_config_file(const char *filename, mfield_parameters *mfield_params,
     mfield_params->scale_time = ival;
   if (config_lookup_int(&cfg, "use_weights", &ival))
     mfield_params->use_weights = ival;
+  if (config_lookup_int(&cfg, "iter_solver", &ival))
+    mfield_params->iter_solver = ival;
   if (config_lookup_int(&cfg, "regularize", &ival))
     mfield_params->regularize = ival;
 
@@ -1337,6 +1415,10 @@ main(int argc, char *argv[])
   double bias = 0.0;          /* bias for artificial noise */
   struct timeval tv0, tv1;
   char buf[MAX_BUFFER];
+  int myid;                   /* MPI id */
+
+  mfield_mpi_init(&argc, &argv);
+  myid = mfield_mpi_rank();
 
   data_params.qdlat_fit_cutoff = -1.0;
 
@@ -1465,7 +1547,7 @@ main(int argc, char *argv[])
 
   status = check_parameters(&mfield_params, &data_params);
   if (status)
-    exit(1);
+    mfield_mpi_abort(1);
 
   fprintf(stderr, "main: epoch = %.2f\n", mfield_params.epoch);
   fprintf(stderr, "main: radius = %g [km]\n", mfield_params.R);
@@ -1489,6 +1571,7 @@ main(int argc, char *argv[])
   fprintf(stderr, "main: number of robust iterations = %zu\n", mfield_params.max_iter);
   fprintf(stderr, "main: number of satellites = %d\n", nsat);
   fprintf(stderr, "main: number of threads = %d\n", omp_get_max_threads());
+  fprintf(stderr, "main: number of MPI processes = %d\n", mfield_mpi_size());
   fprintf(stderr, "main: print_residuals = %d\n", print_residuals);
   if (outfile)
     fprintf(stderr, "main: output coefficient file = %s\n", outfile);
@@ -1544,6 +1627,13 @@ main(int argc, char *argv[])
     fprintf(stderr, "main: flagging non-fitted components...");
     nflag = mfield_data_filter_comp(mfield_data_p);
     fprintf(stderr, "done (%zu data flagged)\n", nflag);
+
+    if (mfield_mpi_size() > 1)
+      {
+        fprintf(stderr, "main: partitioning data for MPI process %d/%d...", myid, mfield_mpi_size());
+        nflag = mfield_mpi_partition(mfield_data_p);
+        fprintf(stderr, "done (%zu data flagged)\n", nflag);
+      }
   }
 
   if (bias > 0.0 || sigma > 0.0)
@@ -1557,7 +1647,7 @@ main(int argc, char *argv[])
   fprintf(stderr, "main: data tmin  = %.2f\n", satdata_epoch2year(mfield_data_p->t0_data));
   fprintf(stderr, "main: data tmax  = %.2f\n", satdata_epoch2year(mfield_data_p->t1_data));
 
-  if (print_map)
+  if (print_map && myid == 0)
     {
       /* print spatial coverage maps for each satellite */
       mfield_data_map(datamap_prefix, mfield_data_p);
@@ -1583,7 +1673,7 @@ main(int argc, char *argv[])
 
   /* print out dataset if requested - do this after mfield_init() so
    * spatial weights are computed */
-  if (print_data)
+  if (print_data && myid == 0)
     {
       /* print data used for MF modeling for each satellite */
       fprintf(stderr, "main: printing data for MF modeling to %s...", data_prefix);
@@ -1603,7 +1693,27 @@ main(int argc, char *argv[])
     {
       fprintf(stderr, "main: ROBUST ITERATION %zu/%zu\n", iter, mfield_params.max_iter);
 
-      mfield_calc_nonlinear(coeffs, mfield_workspace_p);
+      status = mfield_calc_nonlinear(coeffs, mfield_workspace_p);
+      if (status == GSL_EINVAL)
+        {
+          /* no fit was computed; stop all processes before any output is written */
+          fprintf(stderr, "main: error: mfield_calc_nonlinear failed: %s\n", gsl_strerror(status));
+          mfield_mpi_abort(1);
+        }
+
+      /* all processes take part, since the fit statistics are reduced */
+      if (print_residuals)
+        {
+          fprintf(stderr, "main: printing residuals to %s...", residual_prefix);
+          mfield_print_residual(residual_prefix, iter, mfield_workspace_p);
+          fprintf(stderr, "done\n");
+        }
+
+      if (myid != 0)
+        {
+          mfield_reset(mfield_workspace_p);
+          continue;
+        }
 
       /* output coefficients for this iteration */
       sprintf(buf, "coef.txt.iter%zu", iter);
@@ -1615,13 +1725,6 @@ main(int argc, char *argv[])
       sprintf(buf, "mfield.s.iter%zu", iter);
       print_spectrum(buf, mfield_workspace_p);
 
-      if (print_residuals)
-        {
-          fprintf(stderr, "main: printing residuals to %s...", residual_prefix);
-          mfield_print_residual(residual_prefix, iter, mfield_workspace_p);
-          fprintf(stderr, "done\n");
-        }
-
       /* reset workspace for a new iteration */
       mfield_reset(mfield_workspace_p);
     }
@@ -1630,6 +1733,15 @@ main(int argc, char *argv[])
 
   fprintf(stderr, "main: total time for inversion: %.2f seconds\n", time_diff(tv0, tv1));
 
+  if (myid != 0)
+    {
+      mfield_free(mfield_workspace_p);
+      mfield_data_free(mfield_data_p);
+      gsl_vector_free(coeffs);
+      mfield_mpi_finalize();
+      return 0;
+    }
+
   /* calculate errors in coefficients */
   fprintf(stderr, "main: calculating coefficient uncertainties...");
   gettimeofday(&tv0, NULL);
@@ -1794,5 +1906,7 @@ main(int argc, char *argv[])
   mfield_data_free(mfield_data_p);
   gsl_vector_free(coeffs);
 
+  mfield_mpi_finalize();
+
   return 0;
 } /* main() */
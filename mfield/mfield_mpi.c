@@ -0,0 +1,361 @@
+/*
+ * mfield_mpi.c
+ *
+ * Distributed-memory support for the main field inversion. When
+ * compiled with MFIELD_MPI = 1, each MPI process reads the full data
+ * set but retains only a contiguous block of each satellite's
+ * (non-discarded) data points; the remaining points are flagged
+ * with MAGDATA_FLG_DISCARD. Each rank then assembles its own partial
+ * normal equations J^T W J and J^T W f, which are summed onto rank 0
+ * for the solve, and the solution is broadcast back to all ranks.
+ *
+ * Global quantities which depend on the full data set (time scaling
+ * statistics, spatial weighting histogram, robust sigmas) are combined
+ * across ranks with the routines below so that every rank builds the
+ * same weights as a serial run.
+ *
+ * When MFIELD_MPI = 0, all routines reduce to their single process
+ * equivalents.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_rstat.h>
+#include <gsl/gsl_histogram2d.h>
+
+#include "mfield_mpi.h"
+
+#if MFIELD_MPI
+#include <mpi.h>
+#endif
+
+int
+mfield_mpi_init(int *argc, char ***argv)
+{
+#if MFIELD_MPI
+  MPI_Init(argc, argv);
+#else
+  (void) argc;
+  (void) argv;
+#endif
+
+  return 0;
+}
+
+int
+mfield_mpi_finalize(void)
+{
+#if MFIELD_MPI
+  MPI_Finalize();
+#endif
+
+  return 0;
+}
+
+/*
+mfield_mpi_abort()
+  Terminate all processes with a given exit status; used when
+one rank detects an error which leaves the others unable to
+continue (for example blocked in a collective operation)
+*/
+
+void
+mfield_mpi_abort(const int status)
+{
+#if MFIELD_MPI
+  MPI_Abort(MPI_COMM_WORLD, status);
+#endif
+
+  exit(status);
+}
+
+int
+mfield_mpi_rank(void)
+{
+  int myid = 0;
+
+#if MFIELD_MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+#endif
+
+  return myid;
+}
+
+int
+mfield_mpi_size(void)
+{
+  int nprocs = 1;
+
+#if MFIELD_MPI
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+#endif
+
+  return nprocs;
+}
+
+/*
+mfield_mpi_partition()
+  Partition data among MPI processes, by flagging all data points
+not owned by this process with MAGDATA_FLG_DISCARD
+
+Inputs: w - data workspace
+
+Return: number of data flagged
+
+Notes:
+1) This should be called after all other filtering routines, so that
+each process receives an equal share of the data which will actually
+be fitted
+
+2) The non-discarded points of each satellite are split into nprocs
+contiguous blocks, so each process sees complete time segments
+(needed for Euler angle bins and along-track differences)
+*/
+
+size_t
+mfield_mpi_partition(mfield_data_workspace *w)
+{
+  const size_t myid = (size_t) mfield_mpi_rank();
+  const size_t nprocs = (size_t) mfield_mpi_size();
+  size_t cnt = 0;
+  size_t i, j;
+
+  if (nprocs == 1)
+    return 0;
+
+  for (i = 0; i < w->nsources; ++i)
+    {
+      magdata *mptr = mfield_data_ptr(i, w);
+      size_t ndata = 0, k = 0;
+      size_t start, end;
+
+      for (j = 0; j < mptr->n; ++j)
+        {
+          if (!(mptr->flags[j] & MAGDATA_FLG_DISCARD))
+            ++ndata;
+        }
+
+      /* this process owns points [start,end) of the kept data */
+      start = (myid * ndata) / nprocs;
+      end = ((myid + 1) * ndata) / nprocs;
+
+      for (j = 0; j < mptr->n; ++j)
+        {
+          if (mptr->flags[j] & MAGDATA_FLG_DISCARD)
+            continue;
+
+          if (k < start || k >= end)
+            {
+              mptr->flags[j] |= MAGDATA_FLG_DISCARD;
+              ++cnt;
+            }
+
+          ++k;
+        }
+    }
+
+  return cnt;
+} /* mfield_mpi_partition() */
+
+/*
+mfield_mpi_rstat()
+  Combine running statistics from all processes
+
+Inputs: rstat_p - local running statistics
+        n       - (output) global number of samples
+        mean    - (output) global mean
+        sd      - (output) global standard deviation
+
+Return: success/error
+
+Notes:
+1) Each process contributes (n, n*mean, (n-1)*sd^2 + n*mean^2), from
+which the global mean and sample standard deviation are recovered
+*/
+
+int
+mfield_mpi_rstat(const gsl_rstat_workspace *rstat_p, size_t *n, double *mean, double *sd)
+{
+  const size_t nloc = gsl_rstat_n(rstat_p);
+  double buf[3];
+
+  buf[0] = (double) nloc;
+  buf[1] = 0.0;
+  buf[2] = 0.0;
+
+  if (nloc > 0)
+    {
+      const double mu = gsl_rstat_mean(rstat_p);
+      const double sig = gsl_rstat_sd(rstat_p);
+
+      buf[1] = nloc * mu;
+      buf[2] = (nloc - 1.0) * sig * sig + nloc * mu * mu;
+    }
+
+#if MFIELD_MPI
+  MPI_Allreduce(MPI_IN_PLACE, buf, 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#endif
+
+  *n = (size_t) buf[0];
+
+  if (*n == 0)
+    {
+      *mean = 0.0;
+      *sd = 0.0;
+    }
+  else
+    {
+      *mean = buf[1] / buf[0];
+
+      if (*n > 1)
+        *sd = sqrt(GSL_MAX(buf[2] - buf[0] * (*mean) * (*mean), 0.0) / (buf[0] - 1.0));
+      else
+        *sd = 0.0;
+    }
+
+  return 0;
+} /* mfield_mpi_rstat() */
+
+/*
+mfield_mpi_sum()
+  Sum a count over all processes
+*/
+
+size_t
+mfield_mpi_sum(const size_t n)
+{
+#if MFIELD_MPI
+  unsigned long sum = (unsigned long) n;
+  MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+  return (size_t) sum;
+#else
+  return n;
+#endif
+} /* mfield_mpi_sum() */
+
+/*
+mfield_mpi_trange()
+  Compute global first/last timestamps of each data source
+
+Inputs: n  - number of data sources
+        t0 - (input/output) first timestamp of each source, length n;
+             -1 if no data
+        t1 - (input/output) last timestamp of each source, length n;
+             -1 if no data
+
+Return: success/error
+*/
+
+int
+mfield_mpi_trange(const size_t n, double *t0, double *t1)
+{
+#if MFIELD_MPI
+  size_t i;
+
+  /* map missing values so they do not win the reduction */
+  for (i = 0; i < n; ++i)
+    {
+      if (t0[i] < 0.0)
+        t0[i] = GSL_POSINF;
+    }
+
+  MPI_Allreduce(MPI_IN_PLACE, t0, (int) n, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, t1, (int) n, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+  for (i = 0; i < n; ++i)
+    {
+      if (gsl_isinf(t0[i]))
+        t0[i] = -1.0;
+    }
+#else
+  (void) n;
+  (void) t0;
+  (void) t1;
+#endif
+
+  return 0;
+} /* mfield_mpi_trange() */
+
+/*
+mfield_mpi_histogram()
+  Sum spatial weighting histogram over all processes, so that data
+weights are computed from the global data distribution
+*/
+
+int
+mfield_mpi_histogram(track_weight_workspace *w)
+{
+#if MFIELD_MPI
+  gsl_histogram2d *h = w->hist_p;
+  MPI_Allreduce(MPI_IN_PLACE, h->bin, (int) (h->nx * h->ny), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#else
+  (void) w;
+#endif
+
+  return 0;
+} /* mfield_mpi_histogram() */
+
+/*
+mfield_mpi_reduce()
+  Sum partial normal equations onto rank 0
+
+Inputs: JTJ - (input/output) local J^T W J; on output, rank 0 contains
+              the global sum. Only the lower triangle is used
+        JTf - (input/output) local J^T W f; on output, rank 0 contains
+              the global sum
+
+Return: success/error
+*/
+
+int
+mfield_mpi_reduce(gsl_matrix *JTJ, gsl_vector *JTf)
+{
+#if MFIELD_MPI
+  const int myid = mfield_mpi_rank();
+  const size_t N = JTJ->size1;
+  size_t i;
+
+  /* reduce lower triangle row by row to support non-contiguous views */
+  for (i = 0; i < N; ++i)
+    {
+      double *row = gsl_matrix_ptr(JTJ, i, 0);
+
+      if (myid == 0)
+        MPI_Reduce(MPI_IN_PLACE, row, (int) (i + 1), MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+      else
+        MPI_Reduce(row, NULL, (int) (i + 1), MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+
+  if (myid == 0)
+    MPI_Reduce(MPI_IN_PLACE, JTf->data, (int) JTf->size, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  else
+    MPI_Reduce(JTf->data, NULL, (int) JTf->size, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+#else
+  (void) JTJ;
+  (void) JTf;
+#endif
+
+  return 0;
+} /* mfield_mpi_reduce() */
+
+/*
+mfield_mpi_bcast()
+  Broadcast vector from rank 0 to all processes
+*/
+
+int
+mfield_mpi_bcast(gsl_vector *v)
+{
+#if MFIELD_MPI
+  MPI_Bcast(v->data, (int) v->size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#else
+  (void) v;
+#endif
+
+  return 0;
+} /* mfield_mpi_bcast() */
@@ -0,0 +1,41 @@
+/*
+ * mfield_mpi.h
+ */
+
+#ifndef INCLUDED_mfield_mpi_h
+#define INCLUDED_mfield_mpi_h
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_rstat.h>
+
+#include "mfield_data.h"
+#include "track_weight.h"
+
+/*
+ * define to 1 to build with MPI support; each rank then owns a
+ * disjoint time partition of the data for each satellite, and the
+ * normal equations are summed onto rank 0 before the solve
+ */
+#ifndef MFIELD_MPI
+#define MFIELD_MPI                 0
+#endif
+
+/*
+ * Prototypes
+ */
+
+int mfield_mpi_init(int *argc, char ***argv);
+int mfield_mpi_finalize(void);
+void mfield_mpi_abort(const int status);
+int mfield_mpi_rank(void);
+int mfield_mpi_size(void);
+size_t mfield_mpi_partition(mfield_data_workspace *w);
+int mfield_mpi_rstat(const gsl_rstat_workspace *rstat_p, size_t *n, double *mean, double *sd);
+size_t mfield_mpi_sum(const size_t n);
+int mfield_mpi_trange(const size_t n, double *t0, double *t1);
+int mfield_mpi_histogram(track_weight_workspace *w);
+int mfield_mpi_reduce(gsl_matrix *JTJ, gsl_vector *JTf);
+int mfield_mpi_bcast(gsl_vector *v);
+
+#endif /* INCLUDED_mfield_mpi_h */
@@ -19,6 +19,9 @@ static inline int mfield_jacobian_JTu(const double t, const size_t flags, const
 static inline int mfield_jacobian_grad_JTu(const double t, const double t_grad, const size_t flags, const double weight,
                                            const gsl_vector * u, const size_t ridx, gsl_vector * dB_int, gsl_vector * dB_int_grad,
                                            gsl_vector *JTu, const mfield_workspace *w);
+static inline int mfield_jacobian_grad_Ju(const double t, const double t_grad, const size_t flags, const double weight,
+                                          const gsl_vector * u, const size_t ridx, gsl_vector * dB_int, gsl_vector * dB_int_grad,
+                                          gsl_vector *Ju, const mfield_workspace *w);
 static inline int mfield_jacobian_Ju(const double t, const size_t flags, const double weight,
                                      const gsl_vector * u, const size_t ridx, gsl_vector * dB_int, const size_t extidx,
                                      const double dB_ext, const size_t euler_idx, const double B_nec_alpha,
@@ -52,11 +55,13 @@ static void mfield_nonlinear_callback(const size_t iter, void *params,
 static void mfield_nonlinear_callback2(const size_t iter, void *params,
                                        const gsl_multilarge_nlinear_workspace *multifit_p);
 static int mfield_robust_weights(const gsl_vector * f, gsl_vector * wts, mfield_workspace * w);
+static double mfield_robust_sd(const gsl_rstat_workspace * rstat_p);
 static double huber(const double x);
 static double bisquare(const double x);
 static int mfield_nonlinear_alloc_multilarge(const gsl_multilarge_nlinear_trs * trs, mfield_workspace * w);
 
 #include "mfield_multifit.c"
+#include "mfield_iter.c"
 
 
 /*
@@ -145,7 +150,10 @@ mfield_calc_nonlinear(gsl_vector *c, mfield_workspace *w)
 
 #if !OLD_FDF
 
-  s = mfield_calc_nonlinear_multilarge(c, w);
+  if (params->iter_solver)
+    s = mfield_calc_nonlinear_iter(c, w);
+  else
+    s = mfield_calc_nonlinear_multilarge(c, w);
 
 #else
 
@@ -273,69 +281,93 @@ mfield_calc_nonlinear_multilarge(const gsl_vector *c, mfield_workspace *w)
       mfield_calc_df2(CblasTrans, w->c, w->wfvec, w, JTf, NULL);
       fprintf(stderr, "done\n");
 
-      /* regularize JTJ matrix */
-      gsl_vector_add(&diag.vector, w->LTL);
+      if (w->nprocs > 1)
+        {
+          /* sum partial normal equations from each process onto rank 0 */
+          fprintf(stderr, "mfield_calc_nonlinear: reducing normal equations over %d processes...", w->nprocs);
+          gettimeofday(&tv0, NULL);
+          mfield_mpi_reduce(JTJ, JTf);
+          gettimeofday(&tv1, NULL);
+          fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+        }
 
-      fprintf(stderr, "mfield_calc_nonlinear: solving linear normal equations system...");
-      gettimeofday(&tv0, NULL);
+      if (w->myid == 0)
+        {
+          /* regularize JTJ matrix */
+          gsl_vector_add(&diag.vector, w->LTL);
 
-      lapack_cholesky_solve(JTJ, JTf, w->c, &rcond, L);
+          fprintf(stderr, "mfield_calc_nonlinear: solving linear normal equations system...");
+          gettimeofday(&tv0, NULL);
 
-      gsl_vector_scale(w->c, -1.0);
+          lapack_cholesky_solve(JTJ, JTf, w->c, &rcond, L);
 
-      gettimeofday(&tv1, NULL);
-      fprintf(stderr, "done (%g seconds, cond(A) = %g)\n", time_diff(tv0, tv1), 1.0 / rcond);
+          gsl_vector_scale(w->c, -1.0);
 
-      {
-        const char *error_file = "error.txt";
-        gsl_vector_const_view d = gsl_matrix_const_diagonal(L);
-        FILE *fp;
-        size_t n;
+          gettimeofday(&tv1, NULL);
+          fprintf(stderr, "done (%g seconds, cond(A) = %g)\n", time_diff(tv0, tv1), 1.0 / rcond);
+        }
 
-        /* compute (J^T J)^{-1} from Cholesky factor */
-        fprintf(stderr, "mfield_calc_nonlinear: computing (J^T J)^{-1}...");
-        gettimeofday(&tv0, NULL);
+      if (w->nprocs > 1)
+        mfield_mpi_bcast(w->c);
 
-        lapack_cholesky_invert(L);
+      if (w->myid == 0)
+        {
+          const char *error_file = "error.txt";
+          gsl_vector_const_view d = gsl_matrix_const_diagonal(L);
+          FILE *fp;
+          size_t n;
 
-        gettimeofday(&tv1, NULL);
-        fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+          /* compute (J^T J)^{-1} from Cholesky factor */
+          fprintf(stderr, "mfield_calc_nonlinear: computing (J^T J)^{-1}...");
+          gettimeofday(&tv0, NULL);
 
-        fprintf(stderr, "mfield_calc_nonlinear: printing parameter uncertainties to %s...", error_file);
+          lapack_cholesky_invert(L);
 
-        fp = fopen(error_file, "w");
+          gettimeofday(&tv1, NULL);
+          fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
 
-        n = 1;
-        fprintf(fp, "# Field %zu: spherical harmonic degree n\n", n++);
-        fprintf(fp, "# Field %zu: spherical harmonic order m\n", n++);
-        fprintf(fp, "# Field %zu: uncertainty in g(n,m) (dimensionless)\n", n++);
-        fprintf(fp, "# Field %zu: g(n,m) (nT)\n", n++);
+          fprintf(stderr, "mfield_calc_nonlinear: printing parameter uncertainties to %s...", error_file);
 
-        for (n = 1; n <= w->nmax_mf; ++n)
-          {
-            int m, ni = (int) n;
+          fp = fopen(error_file, "w");
 
-            for (m = -ni; m <= ni; ++m)
-              {
-                size_t cidx = mfield_coeff_nmidx(n, m);
-                double gnm = gsl_vector_get(w->c, cidx);
-                double err_gnm = gsl_vector_get(&d.vector, cidx);
+          n = 1;
+          fprintf(fp, "# Field %zu: spherical harmonic degree n\n", n++);
+          fprintf(fp, "# Field %zu: spherical harmonic order m\n", n++);
+          fprintf(fp, "# Field %zu: uncertainty in g(n,m) (dimensionless)\n", n++);
+          fprintf(fp, "# Field %zu: g(n,m) (nT)\n", n++);
 
-                fprintf(fp, "%5d %5zu %20.4e %20.4e\n", m, n, err_gnm, gnm);
-              }
+          for (n = 1; n <= w->nmax_mf; ++n)
+            {
+              int m, ni = (int) n;
 
-            fprintf(fp, "\n");
-          }
+              for (m = -ni; m <= ni; ++m)
+                {
+                  size_t cidx = mfield_coeff_nmidx(n, m);
+                  double gnm = gsl_vector_get(w->c, cidx);
+                  double err_gnm = gsl_vector_get(&d.vector, cidx);
 
-        fclose(fp);
+                  fprintf(fp, "%5d %5zu %20.4e %20.4e\n", m, n, err_gnm, gnm);
+                }
 
-        fprintf(stderr, "done\n");
-      }
+              fprintf(fp, "\n");
+            }
+
+          fclose(fp);
+
+          fprintf(stderr, "done\n");
+        }
 
       gsl_permutation_free(perm);
       gsl_vector_free(work);
       gsl_matrix_free(L);
     }
+  else if (w->nprocs > 1)
+    {
+      /* the multilarge driver requires the full residual vector on each process */
+      fprintf(stderr, "mfield_calc_nonlinear: error: nonlinear problem not supported with %d MPI processes\n",
+              w->nprocs);
+      s = GSL_EINVAL;
+    }
   else
     {
       fprintf(stderr, "mfield_calc_nonlinear: initializing multilarge...");
@@ -394,7 +426,7 @@ mfield_residual(const gsl_vector *c, mfield_workspace *w)
 #if OLD_FDF
   gsl_vector *f = gsl_multifit_nlinear_residual(w->multifit_nlinear_p);
 #else
-  gsl_vector *f = gsl_multilarge_nlinear_residual(w->nlinear_workspace_p);
+  gsl_vector *f = w->params.iter_solver ? w->fvec : gsl_multilarge_nlinear_residual(w->nlinear_workspace_p);
 #endif
 
   mfield_calc_f(c, w, f);
@@ -497,8 +529,8 @@ mfield_init_nonlinear(mfield_workspace *w)
   w->nres = nres;
   w->ndata = ndata;
 
-  /* check if we can use a linear least squares approach */
-  if ((nres_B[3] + nres_dB_ns[3] + nres_dB_ew[3]) == 0 &&
+  /* check if we can use a linear least squares approach (scalar data may reside on other MPI processes) */
+  if (mfield_mpi_sum(nres_B[3] + nres_dB_ns[3] + nres_dB_ew[3]) == 0 &&
       params->fit_euler == 0)
     {
       w->lls_solution = 1;
@@ -547,8 +579,10 @@ mfield_init_nonlinear(mfield_workspace *w)
 
 #else
 
-  /* allocate fit workspace - start with Levenberg-Marquardt solver */
-  mfield_nonlinear_alloc_multilarge(gsl_multilarge_nlinear_trs_lm, w);
+  /* allocate fit workspace - start with Levenberg-Marquardt solver; the
+   * iterative solver does not need the dense p-by-p multilarge workspace */
+  if (!params->iter_solver)
+    mfield_nonlinear_alloc_multilarge(gsl_multilarge_nlinear_trs_lm, w);
 
 #endif
 
@@ -935,6 +969,14 @@ mfield_calc_df2(CBLAS_TRANSPOSE_t TransJ, const gsl_vector *x, const gsl_vector
                                              &vx_grad.vector, v, w);
                   }
                 }
+              else
+                {
+#pragma omp critical
+                  {
+                    mfield_jacobian_grad_Ju(t, mptr->ts_ns[j], mptr->flags[j], wj, u, ridx, &vx.vector,
+                                            &vx_grad.vector, v, w);
+                  }
+                }
 
               ++ridx;
             }
@@ -951,6 +993,14 @@ mfield_calc_df2(CBLAS_TRANSPOSE_t TransJ, const gsl_vector *x, const gsl_vector
                                              &vy_grad.vector, v, w);
                   }
                 }
+              else
+                {
+#pragma omp critical
+                  {
+                    mfield_jacobian_grad_Ju(t, mptr->ts_ns[j], mptr->flags[j], wj, u, ridx, &vy.vector,
+                                            &vy_grad.vector, v, w);
+                  }
+                }
 
               ++ridx;
             }
@@ -967,6 +1017,14 @@ mfield_calc_df2(CBLAS_TRANSPOSE_t TransJ, const gsl_vector *x, const gsl_vector
                                              &vz_grad.vector, v, w);
                   }
                 }
+              else
+                {
+#pragma omp critical
+                  {
+                    mfield_jacobian_grad_Ju(t, mptr->ts_ns[j], mptr->flags[j], wj, u, ridx, &vz.vector,
+                                            &vz_grad.vector, v, w);
+                  }
+                }
 
               ++ridx;
             }
@@ -1179,6 +1237,73 @@ mfield_jacobian_grad_JTu(const double t, const double t_grad, const size_t flags
 
   return GSL_SUCCESS;
 }
+
+/*
+mfield_jacobian_grad_Ju()
+  Update the J u vector with a new row of the Jacobian matrix,
+corresponding to a vector gradient residual.
+
+Inputs: t           - scaled timestamp
+        t_grad      - scaled timestamp of gradient point (N/S or E/W)
+        flags       - MAGDATA_FLG_xxx flags for this data point
+        weight      - weight for this data point
+        u           - input vector u, size p
+        ridx        - residual index of this row in [0,nres-1]
+        dB_int      - Green's functions for desired vector component of
+                      internal SH expansion, nnm_mf-by-1
+        dB_int_grad - Green's functions for desired vector gradient component of
+                      internal SH expansion, nnm_mf-by-1
+        Ju          - (output) J u vector
+        w           - workspace
+*/
+
+static inline int
+mfield_jacobian_grad_Ju(const double t, const double t_grad, const size_t flags, const double weight,
+                        const gsl_vector * u, const size_t ridx, gsl_vector * dB_int, gsl_vector * dB_int_grad,
+                        gsl_vector *Ju, const mfield_workspace *w)
+{
+  double *Ju_ptr = gsl_vector_ptr(Ju, ridx);
+
+  /* check if fitting MF to this data point */
+  if (MAGDATA_FitMF(flags))
+    {
+      gsl_vector_view g_mf = gsl_vector_subvector(dB_int, 0, w->nnm_mf);
+      gsl_vector_view dg_mf = gsl_vector_subvector(dB_int_grad, 0, w->nnm_mf);
+      gsl_vector_const_view u_mf = gsl_vector_const_subvector(u, 0, w->nnm_mf);
+      double tmp, tmp_grad;
+
+      /* update J u */
+      gsl_blas_ddot(&dg_mf.vector, &u_mf.vector, &tmp_grad);
+      gsl_blas_ddot(&g_mf.vector, &u_mf.vector, &tmp);
+      *Ju_ptr = tmp_grad - tmp;
+
+      if (w->nnm_sv > 0)
+        {
+          gsl_vector_view g_sv = gsl_vector_subvector(dB_int, 0, w->nnm_sv);
+          gsl_vector_view dg_sv = gsl_vector_subvector(dB_int_grad, 0, w->nnm_sv);
+          gsl_vector_const_view u_sv = gsl_vector_const_subvector(u, w->sv_offset, w->nnm_sv);
+
+          gsl_blas_ddot(&dg_sv.vector, &u_sv.vector, &tmp_grad);
+          gsl_blas_ddot(&g_sv.vector, &u_sv.vector, &tmp);
+          *Ju_ptr += t_grad * tmp_grad - t * tmp;
+        }
+
+      if (w->nnm_sa > 0)
+        {
+          gsl_vector_view g_sa = gsl_vector_subvector(dB_int, 0, w->nnm_sa);
+          gsl_vector_view dg_sa = gsl_vector_subvector(dB_int_grad, 0, w->nnm_sa);
+          gsl_vector_const_view u_sa = gsl_vector_const_subvector(u, w->sa_offset, w->nnm_sa);
+
+          gsl_blas_ddot(&dg_sa.vector, &u_sa.vector, &tmp_grad);
+          gsl_blas_ddot(&g_sa.vector, &u_sa.vector, &tmp);
+          *Ju_ptr += 0.5 * (t_grad * t_grad * tmp_grad - t * t * tmp);
+        }
+
+      *Ju_ptr *= sqrt(weight);
+    }
+
+  return GSL_SUCCESS;
+}
 /*
 mfield_jacobian_Ju()
   Update the J u vector with a new row of the Jacobian matrix,
@@ -2146,18 +2271,18 @@ mfield_robust_weights(const gsl_vector * f, gsl_vector * wts, mfield_workspace *
     {
       magdata *mptr = mfield_data_ptr(i, w->data_workspace_p);
       const double alpha = 1.0; /* constant to multiply sigma so that mean(weights) = 0.95 */
-      double sigma_X = alpha * gsl_rstat_sd(rstat_x[i]);
-      double sigma_Y = alpha * gsl_rstat_sd(rstat_y[i]);
-      double sigma_Z = alpha * gsl_rstat_sd(rstat_z[i]);
-      double sigma_F = alpha * gsl_rstat_sd(rstat_f[i]);
-      double sigma_DX_NS = alpha * gsl_rstat_sd(rstat_dx_ns[i]);
-      double sigma_DY_NS = alpha * gsl_rstat_sd(rstat_dy_ns[i]);
-      double sigma_low_DZ_NS = alpha * gsl_rstat_sd(rstat_low_dz_ns[i]);
-      double sigma_high_DZ_NS = alpha * gsl_rstat_sd(rstat_high_dz_ns[i]);
-      double sigma_DX_EW = alpha * gsl_rstat_sd(rstat_dx_ew[i]);
-      double sigma_DY_EW = alpha * gsl_rstat_sd(rstat_dy_ew[i]);
-      double sigma_low_DZ_EW = alpha * gsl_rstat_sd(rstat_low_dz_ew[i]);
-      double sigma_high_DZ_EW = alpha * gsl_rstat_sd(rstat_high_dz_ew[i]);
+      double sigma_X = alpha * mfield_robust_sd(rstat_x[i]);
+      double sigma_Y = alpha * mfield_robust_sd(rstat_y[i]);
+      double sigma_Z = alpha * mfield_robust_sd(rstat_z[i]);
+      double sigma_F = alpha * mfield_robust_sd(rstat_f[i]);
+      double sigma_DX_NS = alpha * mfield_robust_sd(rstat_dx_ns[i]);
+      double sigma_DY_NS = alpha * mfield_robust_sd(rstat_dy_ns[i]);
+      double sigma_low_DZ_NS = alpha * mfield_robust_sd(rstat_low_dz_ns[i]);
+      double sigma_high_DZ_NS = alpha * mfield_robust_sd(rstat_high_dz_ns[i]);
+      double sigma_DX_EW = alpha * mfield_robust_sd(rstat_dx_ew[i]);
+      double sigma_DY_EW = alpha * mfield_robust_sd(rstat_dy_ew[i]);
+      double sigma_low_DZ_EW = alpha * mfield_robust_sd(rstat_low_dz_ew[i]);
+      double sigma_high_DZ_EW = alpha * mfield_robust_sd(rstat_high_dz_ew[i]);
 
       gsl_rstat_reset(rstat_x[i]);
       gsl_rstat_reset(rstat_y[i]);
@@ -2333,6 +2458,23 @@ mfield_robust_weights(const gsl_vector * f, gsl_vector * wts, mfield_workspace *
   return s;
 }
 
+/*
+mfield_robust_sd()
+  Return standard deviation of residuals accumulated in rstat_p,
+combined over all MPI processes
+*/
+
+static double
+mfield_robust_sd(const gsl_rstat_workspace * rstat_p)
+{
+  size_t n;
+  double mean, sd;
+
+  mfield_mpi_rstat(rstat_p, &n, &mean, &sd);
+
+  return sd;
+}
+
 static double
 huber(const double x)
 {
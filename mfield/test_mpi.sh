@@ -0,0 +1,81 @@
+#!/bin/sh
+#
+# Check that mfield_mpi running on several MPI processes produces
+# the same coefficients as the serial mfield program on the same
+# input data.
+#
+# Usage: test_mpi.sh [nprocs] config_file sat1.dat sat2.dat ...
+
+nprocs="4"
+case "$1" in
+  [0-9]*)
+    nprocs="$1"
+    shift
+    ;;
+esac
+
+if test $# -lt 2; then
+  echo "Usage: $0 [nprocs] config_file sat1.dat sat2.dat ..."
+  exit 1
+fi
+
+# programs are run in temporary directories, so use absolute paths
+bindir=$(pwd)
+abspath() {
+  case "$1" in
+    /*) echo "$1" ;;
+    *) echo "${bindir}/$1" ;;
+  esac
+}
+
+config_file=$(abspath "$1")
+shift
+
+files=""
+for f in "$@"; do
+  files="${files} $(abspath "$f")"
+done
+
+MPIRUN=${MPIRUN:-mpirun}
+
+# relative tolerance for comparing coefficients
+tol="1.0e-8"
+
+outdir=$(mktemp -d)
+trap 'rm -rf ${outdir}' EXIT
+
+echo "Running serial mfield..."
+mkdir ${outdir}/serial
+(cd ${outdir}/serial && \
+ ${bindir}/mfield -C ${config_file} -o coef.txt ${files} > log.txt 2>&1) || {
+  echo "FAILURE: mfield"
+  exit 1
+}
+
+echo "Running mfield_mpi on ${nprocs} processes..."
+mkdir ${outdir}/mpi
+(cd ${outdir}/mpi && \
+ ${MPIRUN} -np ${nprocs} ${bindir}/mfield_mpi -C ${config_file} -o coef.txt ${files} > log.txt 2>&1) || {
+  echo "FAILURE: mfield_mpi"
+  exit 1
+}
+
+paste -d '\n' ${outdir}/serial/coef.txt ${outdir}/mpi/coef.txt | \
+awk -v tol=${tol} '
+  NR % 2 == 1 { split($0, a); na = NF; next }
+  {
+    if ($1 ~ /^%/ || $1 ~ /^#/)
+      next;
+    if (NF != na) { bad = 1; next }
+    for (i = 1; i <= NF; ++i) {
+      d = a[i] - $i; if (d < 0) d = -d;
+      s = a[i]; if (s < 0) s = -s;
+      if (d > tol * (s + 1.0)) { bad = 1; print "mismatch: " $0 }
+    }
+  }
+  END { exit bad }' || {
+  echo "FAILURE: coefficients differ"
+  exit 1
+}
+
+echo "SUCCESS"
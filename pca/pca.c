@@ -23,6 +23,9 @@
 #include "pca.h"
 
 static int pca_calc_G(const double b, pca_workspace *w);
+static int pca_combine(const gsl_vector *alpha, pca_workspace *w);
+static int pca_B_point(const double r, const double theta, const double phi,
+                       double B[3], pca_workspace *w);
 static double pca_pc_chi(const size_t pcidx, const double theta, const double phi,
                          pca_workspace *w);
 static double pca_pc_calc_chi(const double b, const double theta, const double phi,
@@ -79,6 +82,10 @@ pca_alloc(const pca_source_t source_type)
   w->Y = malloc(w->nnm * sizeof(double));
   w->Z = malloc(w->nnm * sizeof(double));
   w->work = gsl_vector_alloc(w->nnm);
+  w->alpha = gsl_vector_alloc(w->nnm);
+  w->c_knm = gsl_vector_alloc(w->nnm);
+  w->c_gnm = gsl_vector_alloc(w->nnm);
+  w->alpha_p = 0;
 
   /* read SVD components for each UT hour */
   fprintf(stderr, "pca_alloc: reading singular values and left singular vectors...");
@@ -167,6 +174,15 @@ pca_free(pca_workspace *w)
   if (w->work)
     gsl_vector_free(w->work);
 
+  if (w->alpha)
+    gsl_vector_free(w->alpha);
+
+  if (w->c_knm)
+    gsl_vector_free(w->c_knm);
+
+  if (w->c_gnm)
+    gsl_vector_free(w->c_gnm);
+
   free(w);
 }
 
@@ -562,6 +578,55 @@ pca_pc_B(const size_t pcidx, const double r, const double theta, const double ph
   return s;
 }
 
+/*
+pca_set_alpha()
+  Combine principal components into single coefficient vectors
+for the current UT hour:
+
+c_knm = sum_i alpha_i U_i
+c_gnm = sum_i alpha_i G_i (external source only)
+
+Inputs: alpha - coefficients of sum, length p <= nnm
+        w     - workspace
+
+Return: success/error
+
+Notes:
+1) The combination is cached in the workspace and reused by pca_B(),
+pca_B_n(), pca_K() and pca_chi() for as long as alpha and the UT hour
+are unchanged, so it is computed once per track instead of once per point
+*/
+
+int
+pca_set_alpha(const gsl_vector *alpha, pca_workspace *w)
+{
+  const size_t p = alpha->size;
+  const size_t nnm = w->nnm;
+  gsl_matrix_view Up;
+  gsl_vector_view v;
+
+  if (p > nnm)
+    {
+      GSL_ERROR("alpha has more than nnm components", GSL_EBADLEN);
+    }
+
+  Up = gsl_matrix_submatrix(w->U[w->ut], 0, 0, nnm, p);
+  gsl_blas_dgemv(CblasNoTrans, 1.0, &Up.matrix, alpha, 0.0, w->c_knm);
+
+  if (w->source_type == PCA_SRC_EXTERNAL)
+    {
+      gsl_matrix_view Gp = gsl_matrix_submatrix(w->G[w->ut], 0, 0, nnm, p);
+      gsl_blas_dgemv(CblasNoTrans, 1.0, &Gp.matrix, alpha, 0.0, w->c_gnm);
+    }
+
+  v = gsl_vector_subvector(w->alpha, 0, p);
+  gsl_vector_memcpy(&v.vector, alpha);
+  w->alpha_p = p;
+  w->alpha_ut = w->ut;
+
+  return GSL_SUCCESS;
+}
+
 /*
 pca_B()
   Compute total magnetic field vector at a given point, using
@@ -579,64 +644,61 @@ Inputs: alpha - coefficients of sum
         phi   - longitude (radians)
         B     - (output) magnetic field vector
         w     - workspace
+
+Notes:
+1) sum_i alpha_i U_i is cached, see pca_set_alpha()
 */
 
 int
 pca_B(const gsl_vector *alpha, const double r, const double theta, const double phi,
       double B[3], pca_workspace *w)
 {
-  const size_t p = alpha->size; /* number of principal components to use to compute B */
-  const size_t nnm = w->nnm;
-  gsl_vector_view Xv = gsl_vector_view_array(w->X, nnm);
-  gsl_vector_view Yv = gsl_vector_view_array(w->Y, nnm);
-  gsl_vector_view Zv = gsl_vector_view_array(w->Z, nnm);
-  gsl_matrix *U;
-  size_t i;
+  int s;
 
-  gsl_vector_set_zero(w->work);
+  s = pca_combine(alpha, w);
+  if (s)
+    return s;
 
-  if (w->source_type == PCA_SRC_EXTERNAL)
-    {
-      if (r <= w->b)
-        {
-          /* external current source, use U matrix and external Green's functions */
-          U = w->U[w->ut];
-          green_calc_ext(r, theta, phi, w->X, w->Y, w->Z, w->green_workspace_p);
-        }
-      else
-        {
-          /* internal current source, use G matrix and internal Green's functions */
-          U = w->G[w->ut];
-          green_calc_int(r, theta, phi, w->X, w->Y, w->Z, w->green_workspace_p);
-        }
-    }
-  else if (w->source_type == PCA_SRC_INDUCED)
-    {
-      /* induced source, use U matrix and internal Green's functions */
-      U = w->U[w->ut];
-      green_calc_int(r, theta, phi, w->X, w->Y, w->Z, w->green_workspace_p);
+  return pca_B_point(r, theta, phi, B, w);
+}
 
-      /* sanity check */
-      if (r < w->b)
-        {
-          fprintf(stderr, "pca_B: error: r < b for induced source\n");
-          return -1;
-        }
-    }
+/*
+pca_B_n()
+  Compute total magnetic field vectors at a set of points, using
+a linear combination of principal components (see pca_B())
 
-  /* compute: work = sum_i alpha_i U_i over largest p principal components */
-  for (i = 0; i < p; ++i)
-    {
-      double ai = gsl_vector_get(alpha, i);
-      gsl_vector_view Ui = gsl_matrix_column(U, i);
+Inputs: alpha - coefficients of sum
+        n     - number of points
+        r     - radius of each point (km), length n
+        theta - colatitude of each point (radians), length n
+        phi   - longitude of each point (radians), length n
+        B     - (output) magnetic field vectors, length 3*n;
+                B[3*i + j] is component j of point i
+        w     - workspace
 
-      gsl_blas_daxpy(ai, &Ui.vector, w->work);
-    }
+Return: success/error
 
-  /* compute B = [ dX^T ; dY^T ; dZ^T ] * sum_i alpha_i U_i */
-  gsl_blas_ddot(w->work, &Xv.vector, &B[0]);
-  gsl_blas_ddot(w->work, &Yv.vector, &B[1]);
-  gsl_blas_ddot(w->work, &Zv.vector, &B[2]);
+Notes:
+1) The PCs are combined once for all points
+*/
+
+int
+pca_B_n(const gsl_vector *alpha, const size_t n, const double *r, const double *theta,
+        const double *phi, double *B, pca_workspace *w)
+{
+  int s;
+  size_t i;
+
+  s = pca_combine(alpha, w);
+  if (s)
+    return s;
+
+  for (i = 0; i < n; ++i)
+    {
+      s = pca_B_point(r[i], theta[i], phi[i], &B[3 * i], w);
+      if (s)
+        return s;
+    }
 
   return 0;
 }
@@ -724,31 +786,19 @@ int
 pca_K(const gsl_vector *alpha, const double theta, const double phi, double K[3], pca_workspace *w)
 {
   int status;
-  const size_t p = alpha->size; /* number of principal components to use to compute K */
-  size_t i;
-  gsl_matrix *U;
+  gsl_vector *c;
 
-  gsl_vector_set_zero(w->work);
+  status = pca_combine(alpha, w);
+  if (status)
+    return status;
 
+  /* sum_i alpha_i G_i over largest p principal components in gnm basis */
   if (w->source_type == PCA_SRC_EXTERNAL)
-    {
-      U = w->G[w->ut];
-    }
+    c = w->c_gnm;
   else
-    {
-      U = w->U[w->ut];
-    }
-
-  /* compute: work = sum_i alpha_i G_i over largest p principal components in gnm basis */
-  for (i = 0; i < p; ++i)
-    {
-      double ai = gsl_vector_get(alpha, i);
-      gsl_vector_view Gi = gsl_matrix_column(U, i);
-
-      gsl_blas_daxpy(ai, &Gi.vector, w->work);
-    }
+    c = w->c_knm;
 
-  status = green_eval_sheet_int(w->b, theta, phi, w->work, K, w->green_workspace_p);
+  status = green_eval_sheet_int(w->b, theta, phi, c, K, w->green_workspace_p);
 
   return status;
 }
@@ -805,22 +855,13 @@ Return: current stream function
 double
 pca_chi(const gsl_vector *alpha, const double theta, const double phi, pca_workspace *w)
 {
-  const size_t p = alpha->size; /* number of principal components to use to compute B */
-  size_t i;
   double chi;
 
-  gsl_vector_set_zero(w->work);
+  /* sum_i alpha_i U_i over largest p principal components */
+  if (pca_combine(alpha, w))
+    return 0.0;
 
-  /* compute: work = sum_i alpha_i U_i over largest p principal components */
-  for (i = 0; i < p; ++i)
-    {
-      double ai = gsl_vector_get(alpha, i);
-      gsl_vector_view Ui = gsl_matrix_column(w->U[w->ut], i);
-
-      gsl_blas_daxpy(ai, &Ui.vector, w->work);
-    }
-
-  chi = pca_pc_calc_chi(w->b, theta, phi, w->work, w);
+  chi = pca_pc_calc_chi(w->b, theta, phi, w->c_knm, w);
 
   return chi;
 }
@@ -1011,3 +1052,90 @@ pca_pc_calc_chi(const double b, const double theta, const double phi,
 
   return chi;
 }
+
+/*
+pca_combine()
+  Make sure the cached PC combination in w->c_knm and w->c_gnm
+corresponds to alpha and the current UT hour, recomputing it if not
+*/
+
+static int
+pca_combine(const gsl_vector *alpha, pca_workspace *w)
+{
+  const size_t p = alpha->size;
+
+  if (w->alpha_p == p && w->alpha_ut == w->ut)
+    {
+      size_t i;
+
+      for (i = 0; i < p; ++i)
+        {
+          if (gsl_vector_get(alpha, i) != gsl_vector_get(w->alpha, i))
+            break;
+        }
+
+      if (i == p)
+        return 0; /* cache is valid */
+    }
+
+  return pca_set_alpha(alpha, w);
+}
+
+/*
+pca_B_point()
+  Compute magnetic field vector at a given point from the cached
+PC combination
+
+Inputs: r     - radius (km)
+        theta - colatitude (radians)
+        phi   - longitude (radians)
+        B     - (output) magnetic field vector
+        w     - workspace
+*/
+
+static int
+pca_B_point(const double r, const double theta, const double phi,
+            double B[3], pca_workspace *w)
+{
+  const size_t nnm = w->nnm;
+  gsl_vector_view Xv = gsl_vector_view_array(w->X, nnm);
+  gsl_vector_view Yv = gsl_vector_view_array(w->Y, nnm);
+  gsl_vector_view Zv = gsl_vector_view_array(w->Z, nnm);
+  gsl_vector *c;
+
+  if (w->source_type == PCA_SRC_EXTERNAL)
+    {
+      if (r <= w->b)
+        {
+          /* external current source, use U matrix and external Green's functions */
+          c = w->c_knm;
+          green_calc_ext(r, theta, phi, w->X, w->Y, w->Z, w->green_workspace_p);
+        }
+      else
+        {
+          /* internal current source, use G matrix and internal Green's functions */
+          c = w->c_gnm;
+          green_calc_int(r, theta, phi, w->X, w->Y, w->Z, w->green_workspace_p);
+        }
+    }
+  else
+    {
+      /* sanity check */
+      if (r < w->b)
+        {
+          fprintf(stderr, "pca_B: error: r < b for induced source\n");
+          return -1;
+        }
+
+      /* induced source, use U matrix and internal Green's functions */
+      c = w->c_knm;
+      green_calc_int(r, theta, phi, w->X, w->Y, w->Z, w->green_workspace_p);
+    }
+
+  /* compute B = [ dX^T ; dY^T ; dZ^T ] * sum_i alpha_i U_i */
+  gsl_blas_ddot(c, &Xv.vector, &B[0]);
+  gsl_blas_ddot(c, &Yv.vector, &B[1]);
+  gsl_blas_ddot(c, &Zv.vector, &B[2]);
+
+  return 0;
+}
@@ -8,7 +8,11 @@
  *      X_{ij} = k_i(t_j) where i = shidx(n,m)
  * 5. X matrix is output to a binary file
  *
- * ./stage1 [-o binary_output_matrix_file] tiegcm1.nc tiegcm2.nc ...
+ * The grid locations are the same for all time steps, so the least
+ * squares matrix is built and factored once, and all time steps are
+ * solved together as a single multiple right hand side problem
+ *
+ * ./stage1 [-o binary_output_matrix_file] [-t knm_text_file] tiegcm1.nc tiegcm2.nc ...
  */
 
 #include <stdio.h>
@@ -451,6 +455,9 @@ main_build_matrix(const magdata *mdata, green_workspace *green_ext,
 /*
 main_build_rhs()
   Construct RHS vector for a given time index
+
+Notes:
+1) Safe to call in parallel for different time indices
 */
 
 size_t
@@ -459,7 +466,6 @@ main_build_rhs(const size_t tidx, const tiegcm_data *data, gsl_vector *b)
   const double eps = 1.0e-4;
   size_t ilon, ilat;
   size_t rowidx = 0;
-  green_workspace *green_p = green_alloc(1, 1, R_EARTH_KM);
 
   for (ilon = 0; ilon < data->nlon; ++ilon)
     {
@@ -488,8 +494,6 @@ main_build_rhs(const size_t tidx, const tiegcm_data *data, gsl_vector *b)
         }
     }
 
-  green_free(green_p);
-
   return rowidx;
 }
 
@@ -554,13 +558,13 @@ main_proc(const char *filename, const char *outfile_mat, const char *outdir_mat,
   const size_t p = p_ext + p_int;               /* number of total coefficients */
   const size_t nrhs = data->nt;                 /* number of right hand sides */
   gsl_matrix *A = gsl_matrix_alloc(n, p);       /* least squares matrix */
-  gsl_matrix *B = gsl_matrix_alloc(n, nrhs);    /* right hand sides */
+  gsl_matrix *Bt = gsl_matrix_alloc(nrhs, GSL_MAX(n, p)); /* right hand sides B^T, overwritten by X^T */
   gsl_matrix *X = gsl_matrix_alloc(p, nrhs);    /* solution vectors */
   gsl_matrix *X_taper = gsl_matrix_alloc(p, nrhs);  /* tapered solution vectors to reduce ringing */
   gsl_vector *r = gsl_vector_alloc(n);          /* residual vector */
   magdata *mdata;
   size_t ndata;                                 /* number of residuals after excluding poles */
-  gsl_matrix_view AA, BB;
+  gsl_matrix_view AA, XXt;
   size_t k;
   FILE *fp;
   struct timeval tv0, tv1;
@@ -590,15 +594,17 @@ main_proc(const char *filename, const char *outfile_mat, const char *outdir_mat,
   gettimeofday(&tv1, NULL);
   fprintf(stderr, "done (%g seconds, %zu total data)\n", time_diff(tv0, tv1), ndata);
 
-  fp = fopen(filename, "w");
-
   fprintf(stderr, "main_proc: building rhs vectors...");
   gettimeofday(&tv0, NULL);
 
-  /* construct right hand side vectors */
-  for (k = 0; k < data->nt; ++k)
+  /*
+   * construct right hand side vectors; each time step is a row of B^T,
+   * which is B in the column-major layout used by LAPACK
+   */
+#pragma omp parallel for private(k)
+  for (k = 0; k < nrhs; ++k)
     {
-      gsl_vector_view b = gsl_matrix_column(B, k);
+      gsl_vector_view b = gsl_matrix_row(Bt, k);
       size_t nrows;
 
       /* construct rhs vector for time t_k */
@@ -610,41 +616,48 @@ main_proc(const char *filename, const char *outfile_mat, const char *outdir_mat,
   gettimeofday(&tv1, NULL);
   fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
 
-  /* solve least squares system for all rhs vectors */
+  /* solve least squares system for all rhs vectors with a single factorization of A */
   AA = gsl_matrix_submatrix(A, 0, 0, ndata, p);
-  BB = gsl_matrix_submatrix(B, 0, 0, ndata, nrhs);
 
-  fprintf(stderr, "main_proc: solving LS systems with QR decomposition of A (%zu-by-%zu)...", ndata, p);
+  fprintf(stderr, "main_proc: solving LS systems with QR decomposition of A (%zu-by-%zu, %zu rhs)...",
+          ndata, p, nrhs);
   gettimeofday(&tv0, NULL);
-  status = lapack_lls(&AA.matrix, &BB.matrix, X, &rank);
+  status = lapack_lls_t(&AA.matrix, Bt, &rank);
   gettimeofday(&tv1, NULL);
   fprintf(stderr, "done (%g seconds, s = %d, rank = %d)\n",
           time_diff(tv0, tv1), status, rank);
 
-  /* form residual matrix R = B - A*X */
+  /* X = (X^T)^T */
+  XXt = gsl_matrix_submatrix(Bt, 0, 0, nrhs, p);
+  gsl_matrix_transpose_memcpy(X, &XXt.matrix);
+
+  /* form residual matrix R^T = B^T - X^T A^T, rebuilding B^T in place */
   {
-    gsl_matrix *R = gsl_matrix_alloc(ndata, nrhs);
+    gsl_matrix_view Rt = gsl_matrix_submatrix(Bt, 0, 0, nrhs, ndata);
     double rnorm_max = 0.0;
 
-    gsl_matrix_memcpy(R, &BB.matrix);
+#pragma omp parallel for private(k)
+    for (k = 0; k < nrhs; ++k)
+      {
+        gsl_vector_view b = gsl_matrix_row(Bt, k);
+        main_build_rhs(k, data, &b.vector);
+      }
 
     fprintf(stderr, "main_proc: computing residual matrix R = B - AX...");
     gettimeofday(&tv0, NULL);
-    gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1.0, &AA.matrix, X, -1.0, R);
+    gsl_blas_dgemm(CblasTrans, CblasTrans, -1.0, X, &AA.matrix, 1.0, &Rt.matrix);
     gettimeofday(&tv1, NULL);
     fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
 
     for (k = 0; k < nrhs; ++k)
       {
-        gsl_vector_view v = gsl_matrix_column(R, k);
+        gsl_vector_view v = gsl_matrix_row(&Rt.matrix, k);
         double norm = gsl_blas_dnrm2(&v.vector);
         if (norm > rnorm_max)
           rnorm_max = norm;
       }
 
     fprintf(stderr, "main_proc: maximum residual norm = %.12e\n", rnorm_max);
-
-    gsl_matrix_free(R);
   }
 
   /* taper high degree coefficients to correct TIEGCM ringing */
@@ -714,47 +727,45 @@ main_proc(const char *filename, const char *outfile_mat, const char *outdir_mat,
   fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
 #endif
 
-  k = 1;
-  fprintf(fp, "# Field %zu: timestamp (UT seconds since 1970-01-01 00:00:00 UTC)\n", k++);
-  fprintf(fp, "# Field %zu: k(1,0) (nT)\n", k++);
-  fprintf(fp, "# Field %zu: k(1,1) (nT)\n", k++);
-  fprintf(fp, "# Field %zu: k(2,0) (nT)\n", k++);
-  fprintf(fp, "# Field %zu: k(2,1) (nT)\n", k++);
-  fprintf(fp, "# Field %zu: k(2,2) (nT)\n", k++);
-
-  for (k = 0; k < data->nt; ++k)
+  /* optional text output of low degree coefficients */
+  if (filename)
     {
-      size_t N;
-#if 0
-      gsl_vector_view b = gsl_matrix_column(B, k);
-      gsl_vector_view x = gsl_matrix_column(X, k);
-
-      /* compute r = b - A x */
-      gsl_vector_memcpy(r, &b.vector);
-      gsl_blas_dgemv(CblasNoTrans, -1.0, A, &x.vector, 1.0, r);
+      fp = fopen(filename, "w");
 
-      fprintf(stderr, "main_proc: residual for timestamp (%zu/%zu): %.12e [nT]\n",
-              k + 1, data->nt, gsl_blas_dnrm2(r));
-#endif
-
-      fprintf(fp, "%ld ", data->t[k]);
+      k = 1;
+      fprintf(fp, "# Field %zu: timestamp (UT seconds since 1970-01-01 00:00:00 UTC)\n", k++);
+      fprintf(fp, "# Field %zu: k(1,0) (nT)\n", k++);
+      fprintf(fp, "# Field %zu: k(1,1) (nT)\n", k++);
+      fprintf(fp, "# Field %zu: k(2,0) (nT)\n", k++);
+      fprintf(fp, "# Field %zu: k(2,1) (nT)\n", k++);
+      fprintf(fp, "# Field %zu: k(2,2) (nT)\n", k++);
 
-      for (N = 1; N <= 2; ++N)
+      for (k = 0; k < data->nt; ++k)
         {
-          int M = (int) N;
-          int m;
+          size_t N;
+
+          fprintf(fp, "%ld ", data->t[k]);
 
-          for (m = 0; m <= M; ++m)
+          for (N = 1; N <= 2; ++N)
             {
-              size_t cidx = green_nmidx(N, m, green_ext);
-              double knm = gsl_matrix_get(X, cidx, k);
+              int M = (int) N;
+              int m;
 
-              fprintf(fp, "%f ", knm);
+              for (m = 0; m <= M; ++m)
+                {
+                  size_t cidx = green_nmidx(N, m, green_ext);
+                  double knm = gsl_matrix_get(X, cidx, k);
+
+                  fprintf(fp, "%f ", knm);
+                }
             }
+
+          putc('\n', fp);
         }
 
-      putc('\n', fp);
-      fflush(fp);
+      fclose(fp);
+
+      fprintf(stderr, "main_proc: wrote knm coefficients to %s\n", filename);
     }
 
   /* write matrix of solution vectors to output file */
@@ -790,14 +801,10 @@ main_proc(const char *filename, const char *outfile_mat, const char *outdir_mat,
 
   green_free(green_ext);
   gsl_matrix_free(A);
-  gsl_matrix_free(B);
+  gsl_matrix_free(Bt);
   gsl_matrix_free(X);
   gsl_matrix_free(X_taper);
 
-  fclose(fp);
-
-  fprintf(stderr, "main_proc: wrote knm coefficients to %s\n", filename);
-
   return 0;
 }
 
@@ -806,7 +813,7 @@ main(int argc, char *argv[])
 {
   tiegcm_data *data = NULL;
   struct timeval tv0, tv1;
-  char *outfile = "knm.txt";
+  char *outfile = NULL;
   char *outdir_mat = NULL;
   char *outfile_mat = PCA_STAGE1_KNM;
 
@@ -819,7 +826,7 @@ main(int argc, char *argv[])
           { 0, 0, 0, 0 }
         };
 
-      c = getopt_long(argc, argv, "o:m:", long_options, &option_index);
+      c = getopt_long(argc, argv, "o:m:t:", long_options, &option_index);
       if (c == -1)
         break;
 
@@ -833,6 +840,10 @@ main(int argc, char *argv[])
             outdir_mat = optarg;
             break;
 
+          case 't':
+            outfile = optarg;
+            break;
+
           default:
             break;
         }
@@ -840,7 +851,7 @@ main(int argc, char *argv[])
 
   if (optind >= argc)
     {
-      fprintf(stderr, "Usage: %s [-o binary_matrix_output_file] file1.nc file2.nc ...\n",
+      fprintf(stderr, "Usage: %s [-o binary_matrix_output_file] [-t knm_text_file] [-m matlab_output_dir] file1.nc file2.nc ...\n",
               argv[0]);
       exit(1);
     }
@@ -0,0 +1,171 @@
+/*
+ * test.c
+ *
+ * Test the cached PC combination used by pca_B() and pca_B_n();
+ * requires the stage1 and stage2b data files
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_test.h>
+
+#include <common/common.h>
+
+#include "pca.h"
+
+#define TEST_NPTS   8
+#define TEST_NPC    4
+
+/* points below and above the current shell b, to exercise both knm and gnm */
+static void
+test_points(double r[], double theta[], double phi[])
+{
+  size_t i;
+
+  for (i = 0; i < TEST_NPTS; ++i)
+    {
+      double lat = -60.0 + 15.0 * i;
+      double lon = -150.0 + 40.0 * i;
+
+      r[i] = (i % 2) ? R_EARTH_KM + 450.0 : R_EARTH_KM + 0.0;
+      theta[i] = M_PI / 2.0 - lat * M_PI / 180.0;
+      phi[i] = lon * M_PI / 180.0;
+    }
+}
+
+static void
+test_alpha(const double a, gsl_vector *alpha)
+{
+  size_t i;
+
+  for (i = 0; i < alpha->size; ++i)
+    gsl_vector_set(alpha, i, a * (i + 1.0) * pow(-1.0, (double) i));
+}
+
+/* compare B1 against B2 for all points, to relative tolerance tol */
+static void
+test_compare(const double tol, const double *B1, const double *B2, const char *desc)
+{
+  size_t i;
+
+  for (i = 0; i < 3 * TEST_NPTS; ++i)
+    gsl_test_rel(B1[i], B2[i], tol, "%s point %zu component %zu", desc, i / 3, i % 3);
+}
+
+/* compute B at all points with a fresh combination of alpha */
+static int
+test_reference(const gsl_vector *alpha, const double r[], const double theta[],
+               const double phi[], double B[], pca_workspace *w)
+{
+  int s = 0;
+  size_t i;
+
+  s += pca_set_alpha(alpha, w);
+
+  for (i = 0; i < TEST_NPTS; ++i)
+    s += pca_B(alpha, r[i], theta[i], phi[i], &B[3 * i], w);
+
+  return s;
+}
+
+/* pca_B_n() must agree with a loop of per-point pca_B() calls */
+static int
+test_B_n(pca_workspace *w)
+{
+  int s = 0;
+  const double tol = 1.0e-12;
+  gsl_vector *alpha = gsl_vector_alloc(TEST_NPC);
+  double r[TEST_NPTS], theta[TEST_NPTS], phi[TEST_NPTS];
+  double B_n[3 * TEST_NPTS], B[3 * TEST_NPTS];
+  size_t i;
+
+  test_points(r, theta, phi);
+  test_alpha(1.0, alpha);
+
+  pca_set_UT(12, w);
+
+  s += pca_B_n(alpha, TEST_NPTS, r, theta, phi, B_n, w);
+
+  for (i = 0; i < TEST_NPTS; ++i)
+    s += pca_B(alpha, r[i], theta[i], phi[i], &B[3 * i], w);
+
+  test_compare(tol, B_n, B, "pca_B_n");
+
+  gsl_vector_free(alpha);
+
+  return s;
+}
+
+/* the cached combination must be recomputed when alpha or the UT hour changes */
+static int
+test_cache(pca_workspace *w)
+{
+  int s = 0;
+  const double tol = 1.0e-12;
+  const size_t ut1 = 6;
+  const size_t ut2 = 18;
+  gsl_vector *alpha1 = gsl_vector_alloc(TEST_NPC);
+  gsl_vector *alpha2 = gsl_vector_alloc(TEST_NPC);
+  gsl_vector *alpha = gsl_vector_alloc(TEST_NPC);
+  double r[TEST_NPTS], theta[TEST_NPTS], phi[TEST_NPTS];
+  double B1_ut1[3 * TEST_NPTS], B2_ut1[3 * TEST_NPTS], B2_ut2[3 * TEST_NPTS];
+  double B[3 * TEST_NPTS];
+
+  test_points(r, theta, phi);
+  test_alpha(1.0, alpha1);
+  test_alpha(-2.5, alpha2);
+
+  /* reference fields, each from an explicitly recomputed combination */
+  pca_set_UT(ut1, w);
+  s += test_reference(alpha1, r, theta, phi, B1_ut1, w);
+  s += test_reference(alpha2, r, theta, phi, B2_ut1, w);
+
+  pca_set_UT(ut2, w);
+  s += test_reference(alpha2, r, theta, phi, B2_ut2, w);
+
+  /* change of alpha with the UT hour fixed */
+  pca_set_UT(ut1, w);
+  s += pca_B_n(alpha1, TEST_NPTS, r, theta, phi, B, w);
+  test_compare(tol, B, B1_ut1, "cache alpha1");
+
+  s += pca_B_n(alpha2, TEST_NPTS, r, theta, phi, B, w);
+  test_compare(tol, B, B2_ut1, "cache alpha changed");
+
+  /* change of the UT hour with alpha fixed */
+  pca_set_UT(ut2, w);
+  s += pca_B_n(alpha2, TEST_NPTS, r, theta, phi, B, w);
+  test_compare(tol, B, B2_ut2, "cache UT changed");
+
+  /* alpha modified in place, as done between tracks */
+  pca_set_UT(ut1, w);
+  gsl_vector_memcpy(alpha, alpha1);
+  s += pca_B_n(alpha, TEST_NPTS, r, theta, phi, B, w);
+  test_compare(tol, B, B1_ut1, "cache alpha in place");
+
+  gsl_vector_memcpy(alpha, alpha2);
+  s += pca_B_n(alpha, TEST_NPTS, r, theta, phi, B, w);
+  test_compare(tol, B, B2_ut1, "cache alpha changed in place");
+
+  gsl_vector_free(alpha1);
+  gsl_vector_free(alpha2);
+  gsl_vector_free(alpha);
+
+  return s;
+}
+
+int
+main(void)
+{
+  pca_workspace *w = pca_alloc(PCA_SRC_EXTERNAL);
+
+  gsl_test(test_B_n(w), "pca_B_n");
+  gsl_test(test_cache(w), "pca combination cache");
+
+  pca_free(w);
+
+  exit (gsl_test_summary());
+}
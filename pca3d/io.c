@@ -9,7 +9,11 @@
 #include <math.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_matrix.h>
@@ -27,7 +31,11 @@ pca3d_write_fft_data()
 Inputs: filename - output file
         data     - data to write
         light    - if 1, only metadata (grid positions, sizes etc) are written,
-                   not the current or FFT grids themselves; if 0, everything is written
+                   not the current grids themselves; if 0, everything is written
+
+Notes:
+1) The FFT grids Qr/Qt/Qp are not written here; they are stored in
+a separate file with pca3d_map_fft_grids()
 */
 
 int
@@ -65,9 +73,6 @@ pca3d_write_fft_data(const char *filename, const tiegcm3d_fft_data *data, const
       fwrite(data->Jr, sizeof(double), data->nt * data->nr * data->nlat * data->nlon, fp);
       fwrite(data->Jt, sizeof(double), data->nt * data->nr * data->nlat * data->nlon, fp);
       fwrite(data->Jp, sizeof(double), data->nt * data->nr * data->nlat * data->nlon, fp);
-      fwrite(data->Qr, sizeof(gsl_complex), data->T * data->nfreq * data->nr * data->nlat * data->nlon, fp);
-      fwrite(data->Qt, sizeof(gsl_complex), data->T * data->nfreq * data->nr * data->nlat * data->nlon, fp);
-      fwrite(data->Qp, sizeof(gsl_complex), data->T * data->nfreq * data->nr * data->nlat * data->nlon, fp);
     }
 
   fclose(fp);
@@ -113,11 +118,21 @@ pca3d_read_fft_data(const char *filename)
       data.Jr = malloc(data.nt * data.nr * data.nlat * data.nlon * sizeof(double));
       data.Jt = malloc(data.nt * data.nr * data.nlat * data.nlon * sizeof(double));
       data.Jp = malloc(data.nt * data.nr * data.nlat * data.nlon * sizeof(double));
-      data.Qr = malloc(data.T * data.nfreq * data.nr * data.nlat * data.nlon * sizeof(gsl_complex));
-      data.Qt = malloc(data.T * data.nfreq * data.nr * data.nlat * data.nlon * sizeof(gsl_complex));
-      data.Qp = malloc(data.T * data.nfreq * data.nr * data.nlat * data.nlon * sizeof(gsl_complex));
+    }
+  else
+    {
+      data.Jr = NULL;
+      data.Jt = NULL;
+      data.Jp = NULL;
     }
 
+  /* FFT grids are mapped separately with pca3d_map_fft_grids() */
+  data.Qr = NULL;
+  data.Qt = NULL;
+  data.Qp = NULL;
+  data.Q_map = NULL;
+  data.Q_len = 0;
+
   fread(data.t, sizeof(time_t), data.nt, fp);
   fread(data.r, sizeof(double), data.nr, fp);
   fread(data.glat, sizeof(double), data.nlat, fp);
@@ -129,9 +144,6 @@ pca3d_read_fft_data(const char *filename)
       fread(data.Jr, sizeof(double), data.nt * data.nr * data.nlat * data.nlon, fp);
       fread(data.Jt, sizeof(double), data.nt * data.nr * data.nlat * data.nlon, fp);
       fread(data.Jp, sizeof(double), data.nt * data.nr * data.nlat * data.nlon, fp);
-      fread(data.Qr, sizeof(gsl_complex), data.T * data.nfreq * data.nr * data.nlat * data.nlon, fp);
-      fread(data.Qt, sizeof(gsl_complex), data.T * data.nfreq * data.nr * data.nlat * data.nlon, fp);
-      fread(data.Qp, sizeof(gsl_complex), data.T * data.nfreq * data.nr * data.nlat * data.nlon, fp);
     }
 
   fclose(fp);
@@ -139,6 +151,164 @@ pca3d_read_fft_data(const char *filename)
   return data;
 }
 
+/*
+pca3d_map_fft_grids()
+  Memory map the file containing the FFT grids Qr/Qt/Qp
+
+Inputs: filename - FFT grid file
+        create   - if 1, create (or truncate) the file with the size
+                   required by data and map it for writing; if 0, map
+                   an existing file read-only
+        data     - (input/output) fft data; T, nfreq, nr, nlat, nlon
+                   must be initialized. On output, data->Qr, data->Qt,
+                   data->Qp point into the mapping
+
+Return: success/error
+
+Notes:
+1) The file contains the Qr grid, followed by Qt, followed by Qp.
+Each grid is stored frequency-major (see TIEGCM3D_FREQIDX), so the
+data for one frequency is three contiguous blocks of T*nr*nlat*nlon
+elements, and only the pages of the frequencies actually accessed
+are loaded into memory
+
+2) When created, pages are written back to the file by the kernel,
+so the grids do not need to fit in memory
+*/
+
+int
+pca3d_map_fft_grids(const char *filename, const int create, tiegcm3d_fft_data *data)
+{
+  const size_t ngrid = data->T * data->nfreq * data->nr * data->nlat * data->nlon;
+  const size_t len = 3 * ngrid * sizeof(gsl_complex);
+  gsl_complex *Q;
+  void *ptr;
+  int fd;
+
+  if (create)
+    fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  else
+    fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+    {
+      fprintf(stderr, "pca3d_map_fft_grids: unable to open %s: %s\n",
+              filename, strerror(errno));
+      return -1;
+    }
+
+  if (create)
+    {
+      if (ftruncate(fd, (off_t) len) != 0)
+        {
+          fprintf(stderr, "pca3d_map_fft_grids: unable to resize %s: %s\n",
+                  filename, strerror(errno));
+          close(fd);
+          return -1;
+        }
+    }
+  else
+    {
+      struct stat sb;
+
+      if (fstat(fd, &sb) != 0 || (size_t) sb.st_size != len)
+        {
+          fprintf(stderr, "pca3d_map_fft_grids: %s does not match FFT grid sizes\n",
+                  filename);
+          close(fd);
+          return -1;
+        }
+    }
+
+  ptr = mmap(NULL, len, create ? (PROT_READ | PROT_WRITE) : PROT_READ,
+             MAP_SHARED, fd, 0);
+
+  /* mapping remains valid after the descriptor is closed */
+  close(fd);
+
+  if (ptr == MAP_FAILED)
+    {
+      fprintf(stderr, "pca3d_map_fft_grids: mmap failed for %s: %s\n",
+              filename, strerror(errno));
+      return -1;
+    }
+
+  Q = (gsl_complex *) ptr;
+
+  data->Q_map = ptr;
+  data->Q_len = len;
+  data->Qr = Q;
+  data->Qt = Q + ngrid;
+  data->Qp = Q + 2 * ngrid;
+
+  return 0;
+}
+
+/*
+pca3d_unmap_fft_grids()
+  Unmap FFT grids previously mapped with pca3d_map_fft_grids(),
+flushing any modified pages to disk
+*/
+
+int
+pca3d_unmap_fft_grids(tiegcm3d_fft_data *data)
+{
+  int s = 0;
+
+  if (data->Q_map == NULL)
+    return 0;
+
+  s += msync(data->Q_map, data->Q_len, MS_SYNC);
+  s += munmap(data->Q_map, data->Q_len);
+
+  data->Q_map = NULL;
+  data->Q_len = 0;
+  data->Qr = NULL;
+  data->Qt = NULL;
+  data->Qp = NULL;
+
+  return s;
+}
+
+/*
+pca3d_advise_fft_grids()
+  Give the kernel paging advice for the Qr/Qt/Qp blocks of
+a single frequency
+
+Inputs: ifreq  - frequency index
+        advice - MADV_WILLNEED to prefetch the frequency slice,
+                 MADV_DONTNEED to release it once processed
+        data   - fft data mapped with pca3d_map_fft_grids()
+
+Return: success/error
+*/
+
+int
+pca3d_advise_fft_grids(const size_t ifreq, const int advice, const tiegcm3d_fft_data *data)
+{
+  const size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+  const size_t nslice = data->T * data->nr * data->nlat * data->nlon;
+  const gsl_complex *Q[3];
+  int s = 0;
+  size_t c;
+
+  Q[0] = data->Qr;
+  Q[1] = data->Qt;
+  Q[2] = data->Qp;
+
+  for (c = 0; c < 3; ++c)
+    {
+      /* madvise requires a page aligned address */
+      size_t start = (size_t) (Q[c] + ifreq * nslice);
+      size_t end = (size_t) (Q[c] + (ifreq + 1) * nslice);
+      size_t base = start - (start % pagesize);
+
+      s += madvise((void *) base, end - base, advice);
+    }
+
+  return s;
+}
+
 int
 pca_write_data(const char *filename, const size_t nmax, const size_t mmax, const tiegcm3d_data *data)
 {
@@ -17,6 +17,9 @@
 
 int pca3d_write_fft_data(const char *filename, const tiegcm3d_fft_data *data, const int light);
 tiegcm3d_fft_data pca3d_read_fft_data(const char *filename);
+int pca3d_map_fft_grids(const char *filename, const int create, tiegcm3d_fft_data *data);
+int pca3d_unmap_fft_grids(tiegcm3d_fft_data *data);
+int pca3d_advise_fft_grids(const size_t ifreq, const int advice, const tiegcm3d_fft_data *data);
 
 int pca_write_data(const char *filename, const size_t nmax, const size_t mmax, const tiegcm3d_data *data);
 int pca_read_data(const char *filename, size_t *nmax, size_t *mmax, size_t *nt, double *ut);
@@ -3,7 +3,7 @@
  *
  * Print results of FFT analysis (stage2a) on J grids
  *
- * ./print_fft [-i fft_data_file]
+ * ./print_fft [-i fft_data_file] [-g fft_grid_file]
  */
 
 #include <stdio.h>
@@ -143,6 +143,7 @@ main(int argc, char *argv[])
   tiegcm3d_fft_data data;
   struct timeval tv0, tv1;
   char *infile = PCA3D_STAGE2A_FFT_DATA;
+  char *gridfile = PCA3D_STAGE2A_FFT_GRIDS;
   double lon = 150.0; /* desired longitude */
   double lat = 8.0;   /* desired latitude */
   double alt = 110.0; /* desired altitude */
@@ -157,7 +158,7 @@ main(int argc, char *argv[])
           { 0, 0, 0, 0 }
         };
 
-      c = getopt_long(argc, argv, "a:b:c:i:r:", long_options, &option_index);
+      c = getopt_long(argc, argv, "a:b:c:g:i:r:", long_options, &option_index);
       if (c == -1)
         break;
 
@@ -167,6 +168,10 @@ main(int argc, char *argv[])
             infile = optarg;
             break;
 
+          case 'g':
+            gridfile = optarg;
+            break;
+
           case 'a':
             alt = atof(optarg);
             break;
@@ -180,7 +185,7 @@ main(int argc, char *argv[])
             break;
 
           default:
-            fprintf(stderr, "Usage: %s [-i fft_data_file] [-a altitude (km)] [-b latitude (deg)] [-c longitude (deg)] [-o output_file]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-i fft_data_file] [-g fft_grid_file] [-a altitude (km)] [-b latitude (deg)] [-c longitude (deg)] [-o output_file]\n", argv[0]);
             exit(1);
             break;
         }
@@ -192,6 +197,11 @@ main(int argc, char *argv[])
   gettimeofday(&tv1, NULL);
   fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
 
+  fprintf(stderr, "main: mapping FFT grids from %s...", gridfile);
+  if (pca3d_map_fft_grids(gridfile, 0, &data))
+    exit(1);
+  fprintf(stderr, "done\n");
+
   /* locate index of desired alt/lat/lon */
   r_idx = bsearch_double(data.r, alt + R_EARTH_KM, 0, data.nr - 1);
   lat_idx = bsearch_double(data.glat, lat, 0, data.nlat - 1);
@@ -210,7 +220,7 @@ main(int argc, char *argv[])
   free(data.Jr);
   free(data.Jt);
   free(data.Jp);
-  free(data.Qp);
+  pca3d_unmap_fft_grids(&data);
   gsl_vector_free(data.window);
 
   return 0;
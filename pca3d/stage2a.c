@@ -6,10 +6,14 @@
  * 1. Read 3D current grids for some time interval
  * 2. Divide total time interval into T smaller segments; perform windowed FFT
  *    of each time series segment for all grid points
+ *
+ * FFTW wisdom is kept in a file (-w) so the FFT plan is measured only once
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <math.h>
 #include <getopt.h>
 #include <sys/time.h>
@@ -65,6 +69,117 @@ count_windows(const size_t nsamples, const double fs,
   return T;
 }
 
+/*
+do_windows()
+  Compute the windowed FFTs of all radial shells and store them in
+the mapped Q grids
+
+Inputs: nforward - number of samples to slide window forward
+        plan     - FFTW plan for the time series of one radial shell
+        work     - per-thread input buffers, nshell-by-nwindow
+        fft_out  - per-thread output buffers, nfreq-by-nshell
+        fft_data - FFT data, with Qr/Qt/Qp grids mapped
+        data     - TIEGCM data
+*/
+
+static void
+do_windows(const size_t nforward, const fftw_plan plan, double **work,
+           fftw_complex **fft_out, const tiegcm3d_fft_data *fft_data,
+           tiegcm3d_data *data)
+{
+  const size_t nt = data->nt;
+  const size_t nwindow = fft_data->nwindow;
+  const size_t nfreq = fft_data->nfreq;
+  const size_t T = fft_data->T;
+  const size_t nshell = data->nlat * data->nlon;
+  const gsl_vector *window = fft_data->window;
+  struct timeval tv0, tv1;
+  const double *J[3];
+  gsl_complex *Q[3];
+  size_t ir;
+
+  fprintf(stderr, "do_windows: transposing grids to time-innermost layout...");
+  gettimeofday(&tv0, NULL);
+  tiegcm3d_set_layout(TIEGCM3D_LAYOUT_TIME_INNER, data);
+  gettimeofday(&tv1, NULL);
+  fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+
+  J[0] = data->Jr;
+  J[1] = data->Jt;
+  J[2] = data->Jp;
+  Q[0] = fft_data->Qr;
+  Q[1] = fft_data->Qt;
+  Q[2] = fft_data->Qp;
+
+  fprintf(stderr, "do_windows: computing FFTs of windowed data...");
+  gettimeofday(&tv0, NULL);
+
+#pragma omp parallel for private(ir)
+  for (ir = 0; ir < data->nr; ++ir)
+    {
+      int thread_id = omp_get_thread_num();
+      double *in = work[thread_id];
+      fftw_complex *out = fft_out[thread_id];
+      size_t start_idx = 0; /* starting time index */
+      size_t t;
+
+      /* loop over window segments for this radial shell */
+      for (t = 0; t < T; ++t)
+        {
+          size_t end_idx = GSL_MIN(start_idx + nwindow - 1, nt - 1);
+          size_t n = end_idx - start_idx + 1; /* size of actual window */
+          double sqrtn = sqrt((double) n);
+          size_t c;
+
+          assert(start_idx < end_idx);
+
+          for (c = 0; c < 3; ++c)
+            {
+              size_t ilat, ilon, ifreq, k;
+
+              /* copy windowed time series of all shell points into work array */
+              for (ilon = 0; ilon < data->nlon; ++ilon)
+                {
+                  for (ilat = 0; ilat < data->nlat; ++ilat)
+                    {
+                      const double *src = &J[c][TIEGCM3D_TIDX(start_idx, ir, ilat, ilon, data)];
+                      double *dest = &in[(ilon * data->nlat + ilat) * nwindow];
+                      size_t j;
+
+                      for (j = 0; j < n; ++j)
+                        dest[j] = gsl_vector_get(window, j) * src[j] / sqrtn;
+
+                      /* could happen at the end of the time series; zero pad input buffer */
+                      for (j = n; j < nwindow; ++j)
+                        dest[j] = 0.0;
+                    }
+                }
+
+              /* compute FFT of this windowed data */
+              fftw_execute_dft_r2c(plan, in, out);
+
+              /* store FFT result in Q grids */
+              for (ifreq = 0; ifreq < nfreq; ++ifreq)
+                {
+                  size_t idx = TIEGCM3D_FREQIDX(t, ifreq, ir, 0, 0, data, T, nfreq);
+                  const fftw_complex *src = &out[ifreq * nshell];
+
+                  for (k = 0; k < nshell; ++k)
+                    Q[c][idx + k] = gsl_complex_rect(src[k][0], src[k][1]);
+                }
+            }
+
+          start_idx += nforward;
+        }
+    }
+
+  gettimeofday(&tv1, NULL);
+  fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+
+  /* restore original layout for output file */
+  tiegcm3d_set_layout(TIEGCM3D_LAYOUT_TIME_OUTER, data);
+}
+
 /*
 do_transforms()
   Perform FFTs on each time window segment for all grid points in TIEGCM grid
@@ -72,12 +187,28 @@ do_transforms()
 Inputs: fs           - sampling frequency (samples/day)
         window_size  - number of days in each time window
         window_shift - how many days to advance window
+        wisdom_file  - FFTW wisdom file (can be NULL)
         data         - TIEGCM data
+
+Notes:
+1) The J grids are transposed to time-innermost layout during the
+transforms, so each windowed time series is read contiguously; they
+are restored to the original layout before being written to disk
+
+2) A single FFTW plan transforms the time series of all grid points
+in one radial shell (nlat*nlon points). It is reused by all threads
+for every shell, window and current component via fftw_execute_dft_r2c()
+
+3) The plan is computed with FFTW_MEASURE; wisdom is read from and
+saved to wisdom_file so the planning cost is paid only once
+
+4) The Qr/Qt/Qp grids are stored frequency-major in the memory mapped
+file PCA3D_STAGE2A_FFT_GRIDS rather than in RAM
 */
 
 static int
 do_transforms(const double fs, const double window_size, const double window_shift,
-              const tiegcm3d_data * data)
+              const char *wisdom_file, tiegcm3d_data * data)
 {
   int s = 0;
   const size_t nt = data->nt;
@@ -85,47 +216,48 @@ do_transforms(const double fs, const double window_size, const double window_shi
   const size_t nforward = (size_t) (window_shift * fs);              /* number of samples to slide forward */
   const size_t nfreq = nwindow / 2 + 1;                              /* number of frequencies computed by FFT */
   const size_t T = count_windows(nt, fs, window_size, window_shift); /* number of time windows */
+  const size_t nshell = data->nlat * data->nlon;                     /* grid points in one radial shell */
   const int max_threads = omp_get_max_threads();
+  const int fft_n = (int) nwindow;
   gsl_vector *window = gsl_vector_alloc(nwindow);                    /* window function */
 
   /* thread specific variables */
-  gsl_vector **workr = malloc(max_threads * sizeof(gsl_vector *));
-  gsl_vector **workt = malloc(max_threads * sizeof(gsl_vector *));
-  gsl_vector **workp = malloc(max_threads * sizeof(gsl_vector *));
-  fftw_complex **fft_r = malloc(max_threads * sizeof(fftw_complex *));
-  fftw_complex **fft_t = malloc(max_threads * sizeof(fftw_complex *));
-  fftw_complex **fft_p = malloc(max_threads * sizeof(fftw_complex *));
-  fftw_plan *plan_r = malloc(max_threads * sizeof(fftw_plan));
-  fftw_plan *plan_t = malloc(max_threads * sizeof(fftw_plan));
-  fftw_plan *plan_p = malloc(max_threads * sizeof(fftw_plan));
+  double **work = malloc(max_threads * sizeof(double *));             /* windowed time series, nshell-by-nwindow */
+  fftw_complex **fft_out = malloc(max_threads * sizeof(fftw_complex *)); /* FFT output, nfreq-by-nshell */
+  fftw_plan plan;
 
   struct timeval tv0, tv1;
-  gsl_complex *Qr; /* FT'd Jr grid, nfreq-by-nr-by-nlat-by-nlon */
-  gsl_complex *Qt; /* FT'd Jt grid, nfreq-by-nr-by-nlat-by-nlon */
-  gsl_complex *Qp; /* FT'd Jp grid, nfreq-by-nr-by-nlat-by-nlon */
   tiegcm3d_fft_data fft_data;
-  size_t ir;
   int i;
 
   /* allocate thread variables */
   for (i = 0; i < max_threads; ++i)
     {
-      workr[i] = gsl_vector_alloc(nwindow);
-      workt[i] = gsl_vector_alloc(nwindow);
-      workp[i] = gsl_vector_alloc(nwindow);
+      work[i] = fftw_malloc(sizeof(double) * nshell * nwindow);
+      fft_out[i] = fftw_malloc(sizeof(fftw_complex) * nshell * nfreq);
+    }
 
-      fft_r[i] = fftw_malloc(sizeof(fftw_complex) * nfreq);
-      fft_t[i] = fftw_malloc(sizeof(fftw_complex) * nfreq);
-      fft_p[i] = fftw_malloc(sizeof(fftw_complex) * nfreq);
+  if (wisdom_file && fftw_import_wisdom_from_filename(wisdom_file))
+    fprintf(stderr, "do_transforms: read FFTW wisdom from %s\n", wisdom_file);
 
-      plan_r[i] = fftw_plan_dft_r2c_1d(nwindow, workr[i]->data, fft_r[i], FFTW_ESTIMATE);
-      plan_t[i] = fftw_plan_dft_r2c_1d(nwindow, workt[i]->data, fft_t[i], FFTW_ESTIMATE);
-      plan_p[i] = fftw_plan_dft_r2c_1d(nwindow, workp[i]->data, fft_p[i], FFTW_ESTIMATE);
-    }
+  fprintf(stderr, "do_transforms: planning FFTs...");
+  gettimeofday(&tv0, NULL);
 
-  Qr = malloc(T * nfreq * data->nr * data->nlat * data->nlon * sizeof(gsl_complex));
-  Qt = malloc(T * nfreq * data->nr * data->nlat * data->nlon * sizeof(gsl_complex));
-  Qp = malloc(T * nfreq * data->nr * data->nlat * data->nlon * sizeof(gsl_complex));
+  /*
+   * input time series k is work[k*nwindow + j]; frequency f of series
+   * k is stored in fft_out[f*nshell + k], so each frequency of a shell
+   * is contiguous as in the Q grids
+   */
+  plan = fftw_plan_many_dft_r2c(1, &fft_n, (int) nshell,
+                                work[0], NULL, 1, fft_n,
+                                fft_out[0], NULL, (int) nshell, 1,
+                                FFTW_MEASURE);
+
+  gettimeofday(&tv1, NULL);
+  fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+
+  if (wisdom_file && !fftw_export_wisdom_to_filename(wisdom_file))
+    fprintf(stderr, "do_transforms: unable to write FFTW wisdom to %s\n", wisdom_file);
 
   fprintf(stderr, "do_transforms: samples per window   = %zu\n", nwindow);
   fprintf(stderr, "do_transforms: sample slide forward = %zu\n", nforward);
@@ -155,119 +287,46 @@ do_transforms(const double fs, const double window_size, const double window_shi
   fft_data.Jr = data->Jr;
   fft_data.Jt = data->Jt;
   fft_data.Jp = data->Jp;
-  fft_data.Qr = Qr;
-  fft_data.Qt = Qt;
-  fft_data.Qp = Qp;
 
-  fprintf(stderr, "do_transforms: computing FFTs of windowed data...");
-  gettimeofday(&tv0, NULL);
-
-#pragma omp parallel for private(ir)
-  for (ir = 0; ir < data->nr; ++ir)
+  /* FFT grids are written directly into a memory mapped file */
+  s = pca3d_map_fft_grids(PCA3D_STAGE2A_FFT_GRIDS, 1, &fft_data);
+  if (s == 0)
     {
-      int thread_id = omp_get_thread_num();
-      size_t ilat, ilon;
-
-      for (ilat = 0; ilat < data->nlat; ++ilat)
-        {
-          for (ilon = 0; ilon < data->nlon; ++ilon)
-            {
-              size_t start_idx = 0; /* starting time index */
-              size_t t;
-
-              /* loop over window segments for this (r,theta,phi) point */
-              for (t = 0; t < T; ++t)
-                {
-                  size_t end_idx = GSL_MIN(start_idx + nwindow - 1, nt - 1);
-                  size_t n = end_idx - start_idx + 1; /* size of actual window */
-                  double sqrtn = sqrt((double) n);
-                  size_t it, ifreq;
-
-                  assert(start_idx < end_idx);
-
-                  if (n < nwindow)
-                    {
-                      /* could happen at the end of the time series; zero pad input buffer */
-                      gsl_vector_set_zero(workr[thread_id]);
-                      gsl_vector_set_zero(workt[thread_id]);
-                      gsl_vector_set_zero(workp[thread_id]);
-                    }
+      do_windows(nforward, plan, work, fft_out, &fft_data, data);
 
-                  /* copy current time window into work arrays */
-                  for (it = start_idx; it <= end_idx; ++it)
-                    {
-                      size_t idx = TIEGCM3D_IDX(it, ir, ilat, ilon, data);
-
-                      gsl_vector_set(workr[thread_id], it - start_idx, data->Jr[idx]);
-                      gsl_vector_set(workt[thread_id], it - start_idx, data->Jt[idx]);
-                      gsl_vector_set(workp[thread_id], it - start_idx, data->Jp[idx]);
-                    }
-
-                  /* apply window function */
-                  gsl_vector_mul(workr[thread_id], window);
-                  gsl_vector_mul(workt[thread_id], window);
-                  gsl_vector_mul(workp[thread_id], window);
-
-                  /* compute FFT of this windowed data */
-                  fftw_execute(plan_r[thread_id]);
-                  fftw_execute(plan_t[thread_id]);
-                  fftw_execute(plan_p[thread_id]);
-
-                  /* store FFT result in Q grids */
-                  for (ifreq = 0; ifreq < nfreq; ++ifreq)
-                    {
-                      size_t idx = TIEGCM3D_FREQIDX(t, ifreq, ir, ilat, ilon, data, T, nfreq);
+      fprintf(stderr, "do_transforms: flushing FFT grids to %s...", PCA3D_STAGE2A_FFT_GRIDS);
+      gettimeofday(&tv0, NULL);
+      s = pca3d_unmap_fft_grids(&fft_data);
+      gettimeofday(&tv1, NULL);
 
-                      Qr[idx] = gsl_complex_rect(fft_r[thread_id][ifreq][0] / sqrtn, fft_r[thread_id][ifreq][1] / sqrtn);
-                      Qt[idx] = gsl_complex_rect(fft_t[thread_id][ifreq][0] / sqrtn, fft_t[thread_id][ifreq][1] / sqrtn);
-                      Qp[idx] = gsl_complex_rect(fft_p[thread_id][ifreq][0] / sqrtn, fft_p[thread_id][ifreq][1] / sqrtn);
-                    }
-
-                  start_idx += nforward;
-                }
-            }
-        }
+      if (s)
+        fprintf(stderr, "failed: %s\n", strerror(errno));
+      else
+        fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
     }
 
-  gettimeofday(&tv1, NULL);
-  fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
-
-  fprintf(stderr, "do_transforms: writing FFT grids to %s...", PCA3D_STAGE2A_FFT_DATA);
-  pca3d_write_fft_data(PCA3D_STAGE2A_FFT_DATA, &fft_data, 0);
-  fprintf(stderr, "done\n");
+  if (s == 0)
+    {
+      fprintf(stderr, "do_transforms: writing FFT grids to %s...", PCA3D_STAGE2A_FFT_DATA);
+      pca3d_write_fft_data(PCA3D_STAGE2A_FFT_DATA, &fft_data, 0);
+      fprintf(stderr, "done\n");
 
-  fprintf(stderr, "do_transforms: writing FFT metadata to %s...", PCA3D_STAGE2A_FFT_DATA_LIGHT);
-  pca3d_write_fft_data(PCA3D_STAGE2A_FFT_DATA_LIGHT, &fft_data, 1);
-  fprintf(stderr, "done\n");
+      fprintf(stderr, "do_transforms: writing FFT metadata to %s...", PCA3D_STAGE2A_FFT_DATA_LIGHT);
+      pca3d_write_fft_data(PCA3D_STAGE2A_FFT_DATA_LIGHT, &fft_data, 1);
+      fprintf(stderr, "done\n");
+    }
 
   for (i = 0; i < max_threads; ++i)
     {
-      gsl_vector_free(workr[i]);
-      gsl_vector_free(workt[i]);
-      gsl_vector_free(workp[i]);
-
-      fftw_free(fft_r[i]);
-      fftw_free(fft_t[i]);
-      fftw_free(fft_p[i]);
-
-      fftw_destroy_plan(plan_r[i]);
-      fftw_destroy_plan(plan_t[i]);
-      fftw_destroy_plan(plan_p[i]);
+      fftw_free(work[i]);
+      fftw_free(fft_out[i]);
     }
 
+  fftw_destroy_plan(plan);
+
   gsl_vector_free(window);
-  free(Qr);
-  free(Qt);
-  free(Qp);
-  free(workr);
-  free(workt);
-  free(workp);
-  free(fft_r);
-  free(fft_t);
-  free(fft_p);
-  free(plan_r);
-  free(plan_t);
-  free(plan_p);
+  free(work);
+  free(fft_out);
 
   fftw_cleanup();
 
@@ -279,6 +338,7 @@ main(int argc, char *argv[])
 {
   const double fs = 24.0;    /* sample frequency (samples/day) */
   char *infile = NULL;
+  char *wisdom_file = PCA3D_STAGE2A_FFTW_WISDOM;
   double window_size = 2.0;  /* number of days in each time segment */
   double window_shift = 1.0; /* number of days to shift forward in time */
   struct timeval tv0, tv1;
@@ -293,7 +353,7 @@ main(int argc, char *argv[])
           { 0, 0, 0, 0 }
         };
 
-      c = getopt_long(argc, argv, "i:t:s:", long_options, &option_index);
+      c = getopt_long(argc, argv, "i:t:s:w:", long_options, &option_index);
       if (c == -1)
         break;
 
@@ -311,15 +371,19 @@ main(int argc, char *argv[])
             window_shift = atof(optarg);
             break;
 
+          case 'w':
+            wisdom_file = optarg;
+            break;
+
           default:
-            fprintf(stderr, "Usage: %s <-i tiegcm3d_nc_file> [-t window_size (days)] [-s window_shift (days)]\n", argv[0]);
+            fprintf(stderr, "Usage: %s <-i tiegcm3d_nc_file> [-t window_size (days)] [-s window_shift (days)] [-w fftw_wisdom_file]\n", argv[0]);
             break;
         }
     }
 
   if (!infile)
     {
-      fprintf(stderr, "Usage: %s <-i tiegcm3d_nc_file> [-t window_size (days)] [-s window_shift (days)]\n", argv[0]);
+      fprintf(stderr, "Usage: %s <-i tiegcm3d_nc_file> [-t window_size (days)] [-s window_shift (days)] [-w fftw_wisdom_file]\n", argv[0]);
       exit(1);
     }
 
@@ -327,6 +391,7 @@ main(int argc, char *argv[])
   fprintf(stderr, "main: sample frequency    = %g [samples/day]\n", fs);
   fprintf(stderr, "main: window size         = %g [days]\n", window_size);
   fprintf(stderr, "main: window shift        = %g [days]\n", window_shift);
+  fprintf(stderr, "main: FFTW wisdom file    = %s\n", wisdom_file);
 
   fprintf(stderr, "main: reading %s...", infile);
   gettimeofday(&tv0, NULL);
@@ -342,7 +407,11 @@ main(int argc, char *argv[])
   fprintf(stderr, "done (%zu records read, %g seconds)\n", data->nt,
           time_diff(tv0, tv1));
 
-  do_transforms(fs, window_size, window_shift, data);
+  if (do_transforms(fs, window_size, window_shift, wisdom_file, data) != 0)
+    {
+      fprintf(stderr, "main: error computing FFT grids\n");
+      exit(1);
+    }
 
   return 0;
 }
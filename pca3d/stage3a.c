@@ -4,7 +4,13 @@
  * Use results of FFT analysis (stage2a) on J grids to build
  * spectral density matrix and compute SVD
  *
- * ./stage3a [-i fft_data_file]
+ * ./stage3a [-i fft_metadata_file] [-g fft_grid_file] [-k nmodes]
+ *
+ * If a mode count is given with -k, only the leading singular triplets
+ * are computed with a randomized SVD (oversampling -p, power iterations -q)
+ *
+ * The FFT grids are memory mapped, and only the slice for the
+ * frequency being analyzed is loaded into memory
  */
 
 #include <stdio.h>
@@ -15,6 +21,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <getopt.h>
 #include <assert.h>
 #include <errno.h>
@@ -53,6 +60,10 @@ Inputs: ifreq - index of desired frequency
         X     - (output) matrix, 3N-by-T
 
 Return: success/error
+
+Notes:
+1) Only the frequency slice ifreq of the memory mapped Qr/Qt/Qp grids
+is accessed, in storage order
 */
 
 int
@@ -76,9 +87,9 @@ build_X(const size_t ifreq, const tiegcm3d_fft_data * data, gsl_matrix_complex *
 
       for (ir = 0; ir < data->nr; ++ir)
         {
-          for (ilat = 0; ilat < data->nlat; ++ilat)
+          for (ilon = 0; ilon < data->nlon; ++ilon)
             {
-              for (ilon = 0; ilon < data->nlon; ++ilon)
+              for (ilat = 0; ilat < data->nlat; ++ilat)
                 {
                   size_t row_idx = CIDX3(ir, data->nr, ilat, data->nlat, ilon, data->nlon);
                   size_t fft_idx = TIEGCM3D_FREQIDX(t, ifreq, ir, ilat, ilon, data, T, nfreq);
@@ -102,7 +113,11 @@ main(int argc, char *argv[])
 {
   tiegcm3d_fft_data data;
   struct timeval tv0, tv1;
-  char *infile = PCA3D_STAGE2A_FFT_DATA;
+  char *infile = PCA3D_STAGE2A_FFT_DATA_LIGHT;
+  char *gridfile = PCA3D_STAGE2A_FFT_GRIDS;
+  size_t nmodes = 0;      /* number of modes to compute, 0 for full thin SVD */
+  size_t oversample = 10; /* randomized SVD oversampling */
+  size_t npower = 2;      /* randomized SVD power iterations */
 
   while (1)
     {
@@ -113,7 +128,7 @@ main(int argc, char *argv[])
           { 0, 0, 0, 0 }
         };
 
-      c = getopt_long(argc, argv, "i:", long_options, &option_index);
+      c = getopt_long(argc, argv, "g:i:k:p:q:", long_options, &option_index);
       if (c == -1)
         break;
 
@@ -123,8 +138,24 @@ main(int argc, char *argv[])
             infile = optarg;
             break;
 
+          case 'g':
+            gridfile = optarg;
+            break;
+
+          case 'k':
+            nmodes = (size_t) atoi(optarg);
+            break;
+
+          case 'p':
+            oversample = (size_t) atoi(optarg);
+            break;
+
+          case 'q':
+            npower = (size_t) atoi(optarg);
+            break;
+
           default:
-            fprintf(stderr, "Usage: %s [-i fft_data_file]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-i fft_metadata_file] [-g fft_grid_file] [-k nmodes] [-p oversample] [-q power_iterations]\n", argv[0]);
             exit(1);
             break;
         }
@@ -136,6 +167,11 @@ main(int argc, char *argv[])
   gettimeofday(&tv1, NULL);
   fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
 
+  fprintf(stderr, "main: mapping FFT grids from %s...", gridfile);
+  if (pca3d_map_fft_grids(gridfile, 0, &data))
+    exit(1);
+  fprintf(stderr, "done\n");
+
   {
     int status;
     const double window_size = data.window_size;
@@ -144,22 +180,36 @@ main(int argc, char *argv[])
     const size_t ifreq = (size_t) (freq * data.window_size);  /* index of desired frequency */
     const size_t N = data.nr * data.nlat * data.nlon;         /* spatial grid size */
     const size_t T = data.T;                                  /* number of time window segments */
+    const size_t minMN = GSL_MIN(3 * N, T);
+    const size_t k = (nmodes > 0) ? GSL_MIN(nmodes, minMN) : minMN; /* number of singular triplets */
     gsl_matrix_complex *X = gsl_matrix_complex_alloc(3 * N, T);
-    gsl_vector *S = gsl_vector_alloc(T);
-    gsl_matrix_complex *U = gsl_matrix_complex_alloc(3 * N, T);
-    gsl_matrix_complex *V = gsl_matrix_complex_alloc(T, T);
+    gsl_vector *S = gsl_vector_alloc(k);
+    gsl_matrix_complex *U = gsl_matrix_complex_alloc(3 * N, k);
+    gsl_matrix_complex *V = (nmodes > 0) ? gsl_matrix_complex_alloc(T, k) : gsl_matrix_complex_alloc(k, T);
     char buf[2048];
 
     fprintf(stderr, "main: building matrix X (%zu-by-%zu) for frequency %.2f [cpd]...",
             X->size1, X->size2, freq);
     gettimeofday(&tv0, NULL);
+    pca3d_advise_fft_grids(ifreq, MADV_WILLNEED, &data);
     build_X(ifreq, &data, X);
+    pca3d_advise_fft_grids(ifreq, MADV_DONTNEED, &data);
     gettimeofday(&tv1, NULL);
     fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
 
-    fprintf(stderr, "main: performing SVD of Q for frequency %g [cpd]...", freq);
     gettimeofday(&tv0, NULL);
-    status = lapack_complex_svd_thin(X, S, U, V);
+
+    if (nmodes > 0)
+      {
+        fprintf(stderr, "main: performing randomized SVD of Q for frequency %g [cpd] (%zu modes)...", freq, k);
+        status = lapack_complex_svd_rand(X, oversample, npower, S, U, V);
+      }
+    else
+      {
+        fprintf(stderr, "main: performing SVD of Q for frequency %g [cpd]...", freq);
+        status = lapack_complex_svd_thin(X, S, U, V);
+      }
+
     gettimeofday(&tv1, NULL);
     fprintf(stderr, "done (%g seconds, status = %d)\n", time_diff(tv0, tv1), status);
 
@@ -186,7 +236,7 @@ main(int argc, char *argv[])
   free(data.Jr);
   free(data.Jt);
   free(data.Jp);
-  free(data.Qp);
+  pca3d_unmap_fft_grids(&data);
   gsl_vector_free(data.window);
 
   return 0;
@@ -12,11 +12,23 @@
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_complex.h>
 
-/* time domain grid index function */
+/* storage layouts of the Jr/Jt/Jp grids */
+#define TIEGCM3D_LAYOUT_TIME_OUTER    0 /* nt-by-nr-by-nlon-by-nlat, as read from file */
+#define TIEGCM3D_LAYOUT_TIME_INNER    1 /* nr-by-nlon-by-nlat-by-nt, each time series contiguous */
+
+/* time domain grid index function (TIEGCM3D_LAYOUT_TIME_OUTER) */
 #define TIEGCM3D_IDX(it,ir,ilat,ilon,data)                    (CIDX4((it),(data->nt),(ir),(data->nr),(ilon),(data->nlon),(ilat),(data->nlat)))
 
-/* frequency domain grid index function */
-#define TIEGCM3D_FREQIDX(it,ifreq,ir,ilat,ilon,data,T,nfreq)  (CIDX5((it),(T),(ifreq),(nfreq),(ir),(data->nr),(ilon),(data->nlon),(ilat),(data->nlat)))
+/* time domain grid index function (TIEGCM3D_LAYOUT_TIME_INNER) */
+#define TIEGCM3D_TIDX(it,ir,ilat,ilon,data)                   (CIDX4((ir),(data->nr),(ilon),(data->nlon),(ilat),(data->nlat),(it),(data->nt)))
+
+/* grid index function for current layout of data */
+#define TIEGCM3D_GRIDIDX(it,ir,ilat,ilon,data)                ((data->layout == TIEGCM3D_LAYOUT_TIME_INNER) ? \
+                                                               TIEGCM3D_TIDX(it,ir,ilat,ilon,data) : \
+                                                               TIEGCM3D_IDX(it,ir,ilat,ilon,data))
+
+/* frequency domain grid index function; frequency-major so each frequency is a contiguous T-by-nr-by-nlon-by-nlat block */
+#define TIEGCM3D_FREQIDX(it,ifreq,ir,ilat,ilon,data,T,nfreq)  (CIDX5((ifreq),(nfreq),(it),(T),(ir),(data->nr),(ilon),(data->nlon),(ilat),(data->nlat)))
 
 typedef struct
 {
@@ -31,6 +43,7 @@ typedef struct
   double *Jr;   /* J_r grid, nt-by-nr-by-nlon-by-nlat (uA/m^2) */
   double *Jt;   /* J_t grid, nt-by-nr-by-nlon-by-nlat (uA/m^2) */
   double *Jp;   /* J_p grid, nt-by-nr-by-nlon-by-nlat (uA/m^2) */
+  int layout;   /* storage layout of J grids, TIEGCM3D_LAYOUT_xxx */
 
   double *work; /* temporary grid, nt-by-nr-nlon-by-nlat */
 
@@ -63,9 +76,11 @@ typedef struct
   double *Jr;      /* J_r grid, nt-by-nr-by-nlon-by-nlat */
   double *Jt;      /* J_t grid, nt-by-nr-by-nlon-by-nlat */
   double *Jp;      /* J_p grid, nt-by-nr-by-nlon-by-nlat */
-  gsl_complex *Qr; /* J_r transform grid, nfreq-by-nr-by-nlat-by-nlon */
-  gsl_complex *Qt; /* J_theta transform grid, nfreq-by-nr-by-nlat-by-nlon */
-  gsl_complex *Qp; /* J_phi transform grid, nfreq-by-nr-by-nlat-by-nlon */
+  gsl_complex *Qr; /* J_r transform grid, nfreq-by-T-by-nr-by-nlon-by-nlat */
+  gsl_complex *Qt; /* J_theta transform grid, nfreq-by-T-by-nr-by-nlon-by-nlat */
+  gsl_complex *Qp; /* J_phi transform grid, nfreq-by-T-by-nr-by-nlon-by-nlat */
+  void *Q_map;     /* memory mapping of Qr/Qt/Qp grid file, see pca3d_map_fft_grids() */
+  size_t Q_len;    /* length of mapping in bytes */
 } tiegcm3d_fft_data;
 
 /* tiegcm3d_alloc.c */
@@ -73,6 +88,7 @@ tiegcm3d_data *tiegcm3d_alloc(const size_t nt, const size_t nr, const size_t nlo
 tiegcm3d_data *tiegcm3d_realloc(const size_t nt, const size_t nr, const size_t nlon, const size_t nlat,
                                 tiegcm3d_data *data);
 void tiegcm3d_free(tiegcm3d_data *data);
+int tiegcm3d_set_layout(const int layout, tiegcm3d_data *data);
 
 /* tiegcm3d_print.c */
 int tiegcm3d_print_time(const char *filename, const tiegcm3d_data *data, const int ir, const int ilat, const int ilon);
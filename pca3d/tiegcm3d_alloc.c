@@ -13,6 +13,8 @@
 #include <errno.h>
 #include <sys/time.h>
 
+#include <common/common.h>
+
 #include "tiegcm3d.h"
 
 tiegcm3d_data *
@@ -31,6 +33,7 @@ tiegcm3d_alloc(const size_t nt, const size_t nr, const size_t nlon, const size_t
   tiegcm3d_realloc(nt, nr, nlon, nlat, data);
 
   data->nt_max = 9000;
+  data->layout = TIEGCM3D_LAYOUT_TIME_OUTER;
 
   return data;
 }
@@ -119,3 +122,74 @@ tiegcm3d_free(tiegcm3d_data *data)
 
   free(data);
 }
+
+/*
+tiegcm3d_set_layout()
+  Change storage layout of the Jr/Jt/Jp grids
+
+Inputs: layout - new layout, TIEGCM3D_LAYOUT_xxx
+        data   - tiegcm data
+
+Notes:
+1) With TIEGCM3D_LAYOUT_TIME_INNER, the time series at each grid
+point is contiguous in memory, and grid elements are accessed with
+TIEGCM3D_TIDX instead of TIEGCM3D_IDX
+
+2) data->work is used as temporary storage for the transpose
+
+3) More data can only be appended with tiegcm3d_read() in the
+TIEGCM3D_LAYOUT_TIME_OUTER layout
+*/
+
+int
+tiegcm3d_set_layout(const int layout, tiegcm3d_data *data)
+{
+  const size_t n = data->nt * data->nr * data->nlon * data->nlat;
+  double *J[3];
+  size_t c;
+
+  if (layout == data->layout)
+    return 0; /* nothing to do */
+
+  if (layout != TIEGCM3D_LAYOUT_TIME_OUTER && layout != TIEGCM3D_LAYOUT_TIME_INNER)
+    {
+      fprintf(stderr, "tiegcm3d_set_layout: unknown layout %d\n", layout);
+      return -1;
+    }
+
+  J[0] = data->Jr;
+  J[1] = data->Jt;
+  J[2] = data->Jp;
+
+  for (c = 0; c < 3; ++c)
+    {
+      size_t it, ir, ilat, ilon;
+
+      /* read the source grid sequentially */
+      for (it = 0; it < data->nt; ++it)
+        {
+          for (ir = 0; ir < data->nr; ++ir)
+            {
+              for (ilon = 0; ilon < data->nlon; ++ilon)
+                {
+                  for (ilat = 0; ilat < data->nlat; ++ilat)
+                    {
+                      size_t idx = TIEGCM3D_IDX(it, ir, ilat, ilon, data);
+                      size_t tidx = TIEGCM3D_TIDX(it, ir, ilat, ilon, data);
+
+                      if (layout == TIEGCM3D_LAYOUT_TIME_INNER)
+                        data->work[tidx] = J[c][idx];
+                      else
+                        data->work[idx] = J[c][tidx];
+                    }
+                }
+            }
+        }
+
+      memcpy(J[c], data->work, n * sizeof(double));
+    }
+
+  data->layout = layout;
+
+  return 0;
+}
@@ -60,7 +60,7 @@ tiegcm3d_print_time(const char *filename, const tiegcm3d_data *data, const int i
 
   for (it = 0; it < data->nt; ++it)
     {
-      size_t idx = TIEGCM3D_IDX(it, ir, ilat, ilon, data);
+      size_t idx = TIEGCM3D_GRIDIDX(it, ir, ilat, ilon, data);
 
       fprintf(fp, "%ld %16.4e %16.4e %16.4e\n",
               data->t[it],
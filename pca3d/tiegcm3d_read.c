@@ -53,6 +53,8 @@ Return: pointer to data structure containing data
 
 Notes:
 1) Currents are converted to units of uA/m^2
+
+2) If data is not NULL, it must be in the TIEGCM3D_LAYOUT_TIME_OUTER layout
 */
 
 tiegcm3d_data *
@@ -69,6 +71,12 @@ tiegcm3d_read(const char *filename, tiegcm3d_data *data)
   double *workr; /* hgtTop heights */
   double delta;
 
+  if (data && data->layout != TIEGCM3D_LAYOUT_TIME_OUTER)
+    {
+      fprintf(stderr, "tiegcm3d_read: error: data must be in time-outermost layout\n");
+      return data;
+    }
+
   status = nc_open(filename, NC_NOWRITE, &ncid);
   if (status)
     {
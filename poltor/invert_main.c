@@ -93,6 +93,8 @@ parse_config_file(const char *filename, poltor_parameters *poltor_params)
 
   if (config_lookup_int(&cfg, "use_weights", &ival))
     poltor_params->use_weights = ival;
+  if (config_lookup_int(&cfg, "cache_rows", &ival))
+    poltor_params->cache_rows = ival;
   if (config_lookup_int(&cfg, "regularize", &ival))
     poltor_params->regularize = ival;
   if (config_lookup_int(&cfg, "solar_flux_factor", &ival))
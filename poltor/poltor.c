@@ -261,6 +261,7 @@ poltor_alloc(const poltor_parameters *params)
     w->green_grad_p = malloc(w->max_threads * sizeof(green_complex_workspace *));
     w->omp_J = malloc(w->max_threads * sizeof(gsl_matrix_complex *));
     w->omp_f = malloc(w->max_threads * sizeof(gsl_vector_complex *));
+    w->omp_ridx = malloc(w->max_threads * w->nblock * sizeof(size_t));
     w->lls_workspace_p = lls_complex_alloc(w->nblock, w->p);
 
     for (i = 0; i < w->max_threads; ++i)
@@ -286,6 +287,20 @@ poltor_alloc(const poltor_parameters *params)
       w->lls_solution = 0;
     }
 
+  if (w->lls_solution && params->use_weights && params->cache_rows && params->max_iter > 1)
+    {
+      w->row_fp = tmpfile();
+      if (!w->row_fp)
+        {
+          fprintf(stderr, "poltor_alloc: cannot open row cache file: %s\n",
+                  strerror(errno));
+          poltor_free(w);
+          return 0;
+        }
+    }
+
+  w->row_cache_built = 0;
+
   if (w->data)
     {
       /* compute spatial weights and solar flux array */
@@ -367,6 +382,12 @@ poltor_free(poltor_workspace *w)
   if (w->omp_nrows)
     free(w->omp_nrows);
 
+  if (w->omp_ridx)
+    free(w->omp_ridx);
+
+  if (w->row_fp)
+    fclose(w->row_fp);
+
   if (w->JHJ)
     gsl_matrix_complex_free(w->JHJ);
 
@@ -417,6 +438,7 @@ poltor_init_params(poltor_parameters * params)
   params->max_iter = 0;
   params->regularize = 0;
   params->use_weights = 0;
+  params->cache_rows = 0;
   params->solar_flux_factor = 0;
   params->alpha_int = 0.0;
   params->alpha_sh = 0.0;
@@ -5,6 +5,7 @@
 #ifndef INCLUDED_poltor_h
 #define INCLUDED_poltor_h
 
+#include <stdio.h>
 #include <complex.h>
 
 #include <gsl/gsl_matrix.h>
@@ -64,6 +65,7 @@ typedef struct
 
   size_t max_iter;   /* number of robust iterations */
   int use_weights;   /* use weights in fitting */
+  int cache_rows;    /* store unweighted rows of J on disk for robust iterations of linear problems */
 
   size_t shell_J;    /* order of Taylor series expansion of q_{nm}(r) for shell B_pol */
 
@@ -192,11 +194,21 @@ typedef struct
   gsl_matrix_complex **omp_J;      /* max_threads matrices, each nblock-by-p */
   gsl_vector_complex **omp_f;      /* max_threads vectors, each size nblock */
   size_t *omp_rowidx;              /* row indices for omp_J */
+  size_t *omp_ridx;                /* residual indices of rows in omp_J, max_threads*nblock */
   size_t *omp_nrows;               /* total rows of J filled so far by each thread */
   size_t nblock;                   /* maximum rows to fold into normal matrix at a time */
   green_complex_workspace **green_p; /* array of green workspaces, size max_threads */
   green_complex_workspace **green_grad_p; /* array of green workspaces for gradient point, size max_threads */
 
+  /*
+   * row cache for linear problems: unweighted rows of J and f are written
+   * in blocks to row_fp on the first robust iteration; subsequent iterations
+   * only rescale the stored rows with the new weights, avoiding Green's
+   * function evaluations
+   */
+  FILE *row_fp;                    /* temporary file of unweighted (J,f) blocks */
+  int row_cache_built;             /* set to 1 once row_fp contains all rows */
+
   /* L-curve parameters */
   gsl_vector *reg_param;  /* regularization parameters */
   gsl_vector *rho;        /* residual norms */
@@ -4,6 +4,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <math.h>
 #include <sys/time.h>
 #include <omp.h>
@@ -25,7 +27,11 @@
 
 static int poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, poltor_workspace *w);
 static int poltor_nonlinear_regularize(poltor_workspace *w);
+static int poltor_nonlinear_jac_cache(const gsl_vector *weights, poltor_workspace *w);
 static int poltor_calc_f(gsl_vector_complex * x, void * params, gsl_vector * f);
+static int poltor_calc_f_cache(const gsl_vector_complex *x, const gsl_vector *weights, gsl_vector *f, poltor_workspace *w);
+static int poltor_rowcache_write(const gsl_matrix_complex *m, const gsl_vector_complex *v, const size_t *ridx, poltor_workspace *w);
+static int poltor_rowcache_read(gsl_matrix_complex_view *m, gsl_vector_complex_view *v, poltor_workspace *w);
 static int poltor_robust_print_stat(const char *str, const double sigma, const gsl_rstat_workspace *rstat_p);
 static int poltor_robust_weights(const gsl_vector * f, gsl_vector * weights, poltor_workspace * w);
 static double huber(const double x);
@@ -59,7 +65,10 @@ poltor_calc_nonlinear(const size_t iter, gsl_vector_complex *c, poltor_workspace
           /* calculate residuals with coefficients from previous iteration */
           fprintf(stderr, "poltor_calc_nonlinear: computing residuals with previous coefficients...");
           gettimeofday(&tv0, NULL);
-          poltor_calc_f(c, w, w->f);
+          if (w->row_cache_built)
+            poltor_calc_f_cache(c, w->wts_final, w->f, w);
+          else
+            poltor_calc_f(c, w, w->f);
           gettimeofday(&tv1, NULL);
           fprintf(stderr, "done (%g seconds, ||f|| = %.12e)\n", time_diff(tv0, tv1), gsl_blas_dnrm2(w->f));
 
@@ -78,12 +87,55 @@ poltor_calc_nonlinear(const size_t iter, gsl_vector_complex *c, poltor_workspace
     {
       /* no scalar residuals so it is a linear problem */
 
-      /* compute J^H W J and J^H W b (set x = 0) */
-      fprintf(stderr, "poltor_calc_nonlinear: computing J^H W J and J^H W f [LINEAR CASE]...");
-      gettimeofday(&tv0, NULL);
-      poltor_nonlinear_jac(NULL, w->wts_final, w);
-      gettimeofday(&tv1, NULL);
-      fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+      if (w->row_fp != NULL && !w->row_cache_built)
+        {
+          /*
+           * evaluate the Green's functions once and store the rows of J with
+           * unit weights, so later robust iterations only need to rescale them
+           */
+          gsl_vector *ones = gsl_vector_alloc(w->n);
+
+          gsl_vector_set_all(ones, 1.0);
+
+          fprintf(stderr, "poltor_calc_nonlinear: building row cache [LINEAR CASE]...");
+          gettimeofday(&tv0, NULL);
+          s = poltor_nonlinear_jac(NULL, ones, w);
+          gettimeofday(&tv1, NULL);
+          fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+
+          gsl_vector_free(ones);
+
+          if (s == GSL_SUCCESS)
+            {
+              w->row_cache_built = 1;
+            }
+          else
+            {
+              /* an incomplete cache cannot be used; fall back to recomputing rows */
+              fprintf(stderr, "poltor_calc_nonlinear: row cache disabled\n");
+              fclose(w->row_fp);
+              w->row_fp = NULL;
+            }
+        }
+
+      if (w->row_fp != NULL)
+        {
+          /* compute J^H W J and J^H W b from cached rows */
+          fprintf(stderr, "poltor_calc_nonlinear: computing J^H W J and J^H W f from row cache [LINEAR CASE]...");
+          gettimeofday(&tv0, NULL);
+          poltor_nonlinear_jac_cache(w->wts_final, w);
+          gettimeofday(&tv1, NULL);
+          fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+        }
+      else
+        {
+          /* compute J^H W J and J^H W b (set x = 0) */
+          fprintf(stderr, "poltor_calc_nonlinear: computing J^H W J and J^H W f [LINEAR CASE]...");
+          gettimeofday(&tv0, NULL);
+          poltor_nonlinear_jac(NULL, w->wts_final, w);
+          gettimeofday(&tv1, NULL);
+          fprintf(stderr, "done (%g seconds)\n", time_diff(tv0, tv1));
+        }
 
       if (params->regularize)
         {
@@ -463,6 +515,7 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
                   gsl_blas_zdscal(alpha * sqrt(wj), &v.vector);
 
                   GSL_SET_REAL(&fval, sqrt(wj) * (GSL_REAL(B_model[0]) - mptr->Bx_nec[j]));
+                  w->omp_ridx[thread_id * w->nblock + w->omp_rowidx[thread_id]] = ridx - 1;
                   gsl_vector_complex_set(w->omp_f[thread_id], w->omp_rowidx[thread_id]++, fval);
                 }
             }
@@ -501,6 +554,7 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
                   gsl_blas_zdscal(alpha * sqrt(wj), &v.vector);
 
                   GSL_SET_REAL(&fval, sqrt(wj) * (GSL_REAL(B_model[1]) - mptr->By_nec[j]));
+                  w->omp_ridx[thread_id * w->nblock + w->omp_rowidx[thread_id]] = ridx - 1;
                   gsl_vector_complex_set(w->omp_f[thread_id], w->omp_rowidx[thread_id]++, fval);
                 }
             }
@@ -539,6 +593,7 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
                   gsl_blas_zdscal(alpha * sqrt(wj), &v.vector);
 
                   GSL_SET_REAL(&fval, sqrt(wj) * (GSL_REAL(B_model[2]) - mptr->Bz_nec[j]));
+                  w->omp_ridx[thread_id * w->nblock + w->omp_rowidx[thread_id]] = ridx - 1;
                   gsl_vector_complex_set(w->omp_f[thread_id], w->omp_rowidx[thread_id]++, fval);
                 }
             }
@@ -602,6 +657,7 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
                   assert(alpha == sfac);
 
                   GSL_SET_REAL(&fval, sqrt(wj) * (F_model - mptr->F[j]));
+                  w->omp_ridx[thread_id * w->nblock + w->omp_rowidx[thread_id]] = ridx - 1;
                   gsl_vector_complex_set(w->omp_f[thread_id], w->omp_rowidx[thread_id]++, fval);
                 }
             }
@@ -646,6 +702,7 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
                     }
 
                   GSL_SET_REAL(&fval, sqrt_wj * (GSL_REAL(B_model_grad[0]) - GSL_REAL(B_model[0]) - (mptr->Bx_nec_ns[j] - mptr->Bx_nec[j])));
+                  w->omp_ridx[thread_id * w->nblock + w->omp_rowidx[thread_id]] = ridx - 1;
                   gsl_vector_complex_set(w->omp_f[thread_id], w->omp_rowidx[thread_id]++, fval);
                 }
             }
@@ -690,6 +747,7 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
                     }
 
                   GSL_SET_REAL(&fval, sqrt_wj * (GSL_REAL(B_model_grad[1]) - GSL_REAL(B_model[1]) - (mptr->By_nec_ns[j] - mptr->By_nec[j])));
+                  w->omp_ridx[thread_id * w->nblock + w->omp_rowidx[thread_id]] = ridx - 1;
                   gsl_vector_complex_set(w->omp_f[thread_id], w->omp_rowidx[thread_id]++, fval);
                 }
             }
@@ -734,6 +792,7 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
                     }
 
                   GSL_SET_REAL(&fval, sqrt_wj * (GSL_REAL(B_model_grad[2]) - GSL_REAL(B_model[2]) - (mptr->Bz_nec_ns[j] - mptr->Bz_nec[j])));
+                  w->omp_ridx[thread_id * w->nblock + w->omp_rowidx[thread_id]] = ridx - 1;
                   gsl_vector_complex_set(w->omp_f[thread_id], w->omp_rowidx[thread_id]++, fval);
                 }
             }
@@ -829,6 +888,7 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
                     }
 
                   GSL_SET_REAL(&fval, sqrt_wj * (F_model_grad - mptr->F_ns[j] - (F_model - mptr->F[j])));
+                  w->omp_ridx[thread_id * w->nblock + w->omp_rowidx[thread_id]] = ridx - 1;
                   gsl_vector_complex_set(w->omp_f[thread_id], w->omp_rowidx[thread_id]++, fval);
                 }
             }
@@ -850,11 +910,20 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
 
 #pragma omp critical
               {
-                /* JHJ += m^H m */
-                gsl_blas_zherk(CblasUpper, CblasConjTrans, 1.0, &m.matrix, 1.0, w->JHJ);
-
-                /* JHf += m^H v */
-                gsl_blas_zgemv(CblasConjTrans, GSL_COMPLEX_ONE, &m.matrix, &v.vector, GSL_COMPLEX_ONE, w->JHf);
+                if (w->row_fp != NULL && !w->row_cache_built)
+                  {
+                    /* store unweighted block in row cache; it is folded into JHJ later */
+                    if (s == GSL_SUCCESS)
+                      s = poltor_rowcache_write(&m.matrix, &v.vector, w->omp_ridx + thread_id * w->nblock, w);
+                  }
+                else
+                  {
+                    /* JHJ += m^H m */
+                    gsl_blas_zherk(CblasUpper, CblasConjTrans, 1.0, &m.matrix, 1.0, w->JHJ);
+
+                    /* JHf += m^H v */
+                    gsl_blas_zgemv(CblasConjTrans, GSL_COMPLEX_ONE, &m.matrix, &v.vector, GSL_COMPLEX_ONE, w->JHf);
+                  }
               }
 
               if (thread_id == 0)
@@ -883,11 +952,25 @@ poltor_nonlinear_jac(const gsl_vector_complex *x, const gsl_vector *weights, pol
           gsl_matrix_complex_view m = gsl_matrix_complex_submatrix(w->omp_J[i], 0, 0, w->omp_rowidx[i], w->p);
           gsl_vector_complex_view v = gsl_vector_complex_subvector(w->omp_f[i], 0, w->omp_rowidx[i]);
 
-          gsl_blas_zherk(CblasUpper, CblasConjTrans, 1.0, &m.matrix, 1.0, w->JHJ);
-          gsl_blas_zgemv(CblasConjTrans, GSL_COMPLEX_ONE, &m.matrix, &v.vector, GSL_COMPLEX_ONE, w->JHf);
+          if (w->row_fp != NULL && !w->row_cache_built)
+            {
+              if (s == GSL_SUCCESS)
+                s = poltor_rowcache_write(&m.matrix, &v.vector, w->omp_ridx + i * w->nblock, w);
+            }
+          else
+            {
+              gsl_blas_zherk(CblasUpper, CblasConjTrans, 1.0, &m.matrix, 1.0, w->JHJ);
+              gsl_blas_zgemv(CblasConjTrans, GSL_COMPLEX_ONE, &m.matrix, &v.vector, GSL_COMPLEX_ONE, w->JHf);
+            }
         }
     }
 
+  if (s == GSL_SUCCESS && w->row_fp != NULL && !w->row_cache_built && fflush(w->row_fp) != 0)
+    {
+      fprintf(stderr, "poltor_nonlinear_jac: error flushing row cache: %s\n", strerror(errno));
+      s = GSL_EFAILED;
+    }
+
   fprintf(stderr, "\t");
   progress_bar(stderr, 1.0, 70);
 
@@ -1192,6 +1275,181 @@ poltor_calc_f(gsl_vector_complex * x, void * params, gsl_vector * f)
   return GSL_SUCCESS;
 }
 
+/*
+poltor_nonlinear_jac_cache()
+  Compute J^H W J and J^H W f for a linear problem from the
+unweighted rows stored in the row cache by poltor_nonlinear_jac().
+Only the row scaling by sqrt(w_i) is repeated, so the Green's
+functions do not need to be recomputed when the robust weights change
+
+Inputs: weights - weight vector, size n
+        w       - workspace
+
+Notes:
+1) w->JHJ and w->JHf are updated on output
+2) omp_J[0], omp_f[0] and omp_ridx are used as buffers
+*/
+
+static int
+poltor_nonlinear_jac_cache(const gsl_vector *weights, poltor_workspace *w)
+{
+  int s = GSL_SUCCESS;
+  gsl_matrix_complex_view m;
+  gsl_vector_complex_view v;
+  size_t nrows = 0;
+
+  gsl_matrix_complex_set_zero(w->JHJ);
+  gsl_vector_complex_set_zero(w->JHf);
+
+  rewind(w->row_fp);
+
+  fprintf(stderr, "\n");
+
+  while (poltor_rowcache_read(&m, &v, w) == GSL_SUCCESS)
+    {
+      const size_t nblock = m.matrix.size1;
+      size_t i;
+
+#pragma omp parallel for private(i)
+      for (i = 0; i < nblock; ++i)
+        {
+          double sqrt_wi = sqrt(gsl_vector_get(weights, w->omp_ridx[i]));
+          gsl_vector_complex_view row = gsl_matrix_complex_row(&m.matrix, i);
+          gsl_complex *fi = gsl_vector_complex_ptr(&v.vector, i);
+
+          gsl_blas_zdscal(sqrt_wi, &row.vector);
+          GSL_REAL(*fi) *= sqrt_wi;
+          GSL_IMAG(*fi) *= sqrt_wi;
+        }
+
+      /* JHJ += m^H m */
+      gsl_blas_zherk(CblasUpper, CblasConjTrans, 1.0, &m.matrix, 1.0, w->JHJ);
+
+      /* JHf += m^H v */
+      gsl_blas_zgemv(CblasConjTrans, GSL_COMPLEX_ONE, &m.matrix, &v.vector, GSL_COMPLEX_ONE, w->JHf);
+
+      nrows += nblock;
+
+      fprintf(stderr, "\t");
+      progress_bar(stderr, (double) nrows / (double) w->n, 70);
+    }
+
+  fprintf(stderr, "\t");
+  progress_bar(stderr, 1.0, 70);
+
+  return s;
+}
+
+/*
+poltor_calc_f_cache()
+  Calculate residual vector for a given set of coefficients using
+the row cache (linear problems only)
+
+Inputs: x       - model coefficients
+        weights - weight vector, size n
+        f       - (output) residual vector, size n
+        w       - workspace
+
+Notes:
+1) Only residuals which are fitted (and so stored in the cache) are
+computed; the remaining elements of f are set to 0
+*/
+
+static int
+poltor_calc_f_cache(const gsl_vector_complex *x, const gsl_vector *weights, gsl_vector *f, poltor_workspace *w)
+{
+  gsl_matrix_complex_view m;
+  gsl_vector_complex_view v;
+
+  gsl_vector_set_zero(f);
+
+  rewind(w->row_fp);
+
+  while (poltor_rowcache_read(&m, &v, w) == GSL_SUCCESS)
+    {
+      const size_t nblock = m.matrix.size1;
+      size_t i;
+
+      /* v := J x + f_0 = model - data */
+      gsl_blas_zgemv(CblasNoTrans, GSL_COMPLEX_ONE, &m.matrix, x, GSL_COMPLEX_ONE, &v.vector);
+
+      for (i = 0; i < nblock; ++i)
+        {
+          size_t ridx = w->omp_ridx[i];
+          double wi = gsl_vector_get(weights, ridx);
+          gsl_complex fi = gsl_vector_complex_get(&v.vector, i);
+
+          gsl_vector_set(f, ridx, sqrt(wi) * GSL_REAL(fi));
+        }
+    }
+
+  return GSL_SUCCESS;
+}
+
+/*
+poltor_rowcache_write()
+  Append a block of unweighted rows to the row cache. Each block
+is stored as: nrows, residual indices (nrows), J block (nrows-by-p),
+f block (nrows)
+
+Inputs: m    - block of J, nrows-by-p
+        v    - block of f, size nrows
+        ridx - residual indices of each row, size nrows
+        w    - workspace
+
+Return: success/error
+*/
+
+static int
+poltor_rowcache_write(const gsl_matrix_complex *m, const gsl_vector_complex *v, const size_t *ridx, poltor_workspace *w)
+{
+  const size_t nrows = m->size1;
+
+  if (fwrite(&nrows, sizeof(size_t), 1, w->row_fp) != 1 ||
+      fwrite(ridx, sizeof(size_t), nrows, w->row_fp) != nrows ||
+      fwrite(m->data, 2 * sizeof(double), nrows * w->p, w->row_fp) != nrows * w->p ||
+      fwrite(v->data, 2 * sizeof(double), nrows, w->row_fp) != nrows)
+    {
+      fprintf(stderr, "poltor_rowcache_write: error writing row cache: %s\n", strerror(errno));
+      return GSL_EFAILED;
+    }
+
+  return GSL_SUCCESS;
+}
+
+/*
+poltor_rowcache_read()
+  Read the next block of rows from the row cache into omp_J[0],
+omp_f[0] and omp_ridx
+
+Inputs: m - (output) view of J block, nrows-by-p
+        v - (output) view of f block, size nrows
+        w - workspace
+
+Return: GSL_SUCCESS if a block was read, GSL_EOF at end of cache
+*/
+
+static int
+poltor_rowcache_read(gsl_matrix_complex_view *m, gsl_vector_complex_view *v, poltor_workspace *w)
+{
+  size_t nrows;
+
+  if (fread(&nrows, sizeof(size_t), 1, w->row_fp) != 1)
+    return GSL_EOF;
+
+  if (fread(w->omp_ridx, sizeof(size_t), nrows, w->row_fp) != nrows ||
+      fread(w->omp_J[0]->data, 2 * sizeof(double), nrows * w->p, w->row_fp) != nrows * w->p ||
+      fread(w->omp_f[0]->data, 2 * sizeof(double), nrows, w->row_fp) != nrows)
+    {
+      GSL_ERROR("truncated row cache file", GSL_EFAILED);
+    }
+
+  *m = gsl_matrix_complex_submatrix(w->omp_J[0], 0, 0, nrows, w->p);
+  *v = gsl_vector_complex_subvector(w->omp_f[0], 0, nrows);
+
+  return GSL_SUCCESS;
+}
+
 static int
 poltor_nonlinear_regularize(poltor_workspace *w)
 {
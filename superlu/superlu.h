@@ -43,5 +43,7 @@ slu_workspace *slu_alloc(int size1, int size2, int nprocs);
 void slu_free(slu_workspace *w);
 double slu_residual(slu_workspace *w);
 int slu_proc(const gsl_spmatrix *A, const double *rhs, double *sol, slu_workspace *w);
+int slu_proc_multi(const gsl_spmatrix *A, const size_t nrhs, const double *rhs,
+                   double *sol, double *rnorm, slu_workspace *w);
 
 #endif /* INCLUDED_superlu_h */
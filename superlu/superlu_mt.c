@@ -12,6 +12,7 @@
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_spmatrix.h>
 #include <gsl/gsl_spblas.h>
+#include <gsl/gsl_blas.h>
 
 #include "superlu.h"
 
@@ -234,23 +235,53 @@ Return: 0 on success, non-zero on error
 
 int
 slu_proc(const gsl_spmatrix *A, const double *rhs, double *sol, slu_workspace *w)
+{
+  return slu_proc_multi(A, 1, rhs, sol, &(w->rnorm), w);
+} /* slu_proc() */
+
+/*
+slu_proc_multi()
+  Solve a sparse linear system A X = B with multiple right
+hand sides, using a single LU factorization of A
+
+Inputs: A      - sparse matrix in CCS format
+        nrhs   - number of right hand sides
+        rhs    - rhs matrix B, stored in column-major order
+                 (size w->size1-by-nrhs, leading dimension w->size1)
+        sol    - (output) solution matrix X, stored in column-major order
+                 (size w->size2-by-nrhs, leading dimension w->size2)
+        rnorm  - (output) residual norms ||A x_k - b_k||, length nrhs
+        w      - workspace
+
+Return: 0 on success, non-zero on error
+
+Notes:
+1) w->rnorm is set to the largest residual norm
+*/
+
+int
+slu_proc_multi(const gsl_spmatrix *A, const size_t nrhs, const double *rhs,
+               double *sol, double *rnorm, slu_workspace *w)
 {
   const size_t nnz = gsl_spmatrix_nnz(A);
   int info = 0;
-  gsl_vector_const_view vrhs = gsl_vector_const_view_array(rhs, w->size1);
-  gsl_vector_view vsol = gsl_vector_view_array(sol, w->size2);
-  int *rind = malloc(nnz * sizeof(int));
-  double *data = malloc(nnz * sizeof(double));
-  size_t i;
+  int *rind;
+  double *data, *B;
+  size_t i, k;
 
   if (!GSL_SPMATRIX_ISCCS(A))
     {
-      fprintf(stderr, "slu_proc: error: matrix must be in CCS format\n");
+      fprintf(stderr, "slu_proc_multi: error: matrix must be in CCS format\n");
       return -1;
     }
 
-  /* make copy of rhs vector */
-  gsl_vector_memcpy(w->rhs_copy, &vrhs.vector);
+  rind = malloc(nnz * sizeof(int));
+  data = malloc(nnz * sizeof(double));
+  B = malloc(w->size1 * nrhs * sizeof(double));
+
+  /* make copy of rhs matrix, since it is overwritten by equilibration */
+  for (i = 0; i < w->size1 * nrhs; ++i)
+    B[i] = rhs[i];
 
   /* have to copy arrays since sizeof(int) != sizeof(size_t) */
   for (i = 0; i < nnz; ++i)
@@ -262,6 +293,8 @@ slu_proc(const gsl_spmatrix *A, const double *rhs, double *sol, slu_workspace *w
   for (i = 0; i < w->size2 + 1; ++i)
     w->cptr[i] = (int) A->p[i];
 
+  w->nrhs = (int) nrhs;
+
   dCreate_CompCol_Matrix(&(w->A),
                          (int) A->size1,
                          (int) A->size2,
@@ -277,7 +310,7 @@ slu_proc(const gsl_spmatrix *A, const double *rhs, double *sol, slu_workspace *w
   dCreate_Dense_Matrix(&(w->B),
                        w->size1,
                        w->nrhs,
-                       w->rhs_copy->data,
+                       B,
                        w->size1,
                        SLU_DN,
                        SLU_D,
@@ -285,10 +318,10 @@ slu_proc(const gsl_spmatrix *A, const double *rhs, double *sol, slu_workspace *w
 
   /* solution matrix */
   dCreate_Dense_Matrix(&(w->X),
-                       w->size1,
+                       w->size2,
                        w->nrhs,
                        sol,
-                       w->size1,
+                       w->size2,
                        SLU_DN,
                        SLU_D,
                        SLU_GE);
@@ -297,33 +330,49 @@ slu_proc(const gsl_spmatrix *A, const double *rhs, double *sol, slu_workspace *w
 
   {
     equed_t equed = NOEQUIL;
-    double ferr, berr, rpg;
+    double *ferr = malloc(nrhs * sizeof(double));
+    double *berr = malloc(nrhs * sizeof(double));
+    double rpg;
     superlu_memusage_t memusage;
 
     pdgssvx(w->nprocs, &(w->options), &(w->A), w->perm_c, w->perm_r,
             &equed, w->R, w->C, &(w->L), &(w->U), &(w->B), &(w->X), &rpg, &(w->rcond),
-	          &ferr, &berr, &memusage, &info);
+            ferr, berr, &memusage, &info);
+
+    free(ferr);
+    free(berr);
   }
 
-  if (info != 0)
+  if (info == 0)
     {
-      fprintf(stderr, "slu_proc: error in pdgssv: info = %d\n", info);
-      return info; /* error */
+      /* compute residuals */
+      w->rnorm = 0.0;
+      for (k = 0; k < nrhs; ++k)
+        {
+          gsl_vector_const_view vrhs = gsl_vector_const_view_array(rhs + k * w->size1, w->size1);
+          gsl_vector_view vsol = gsl_vector_view_array(sol + k * w->size2, w->size2);
+
+          gsl_vector_memcpy(w->rhs_copy, &vrhs.vector);
+          gsl_spblas_dgemv(CblasNoTrans, 1.0, A, &vsol.vector, -1.0, w->rhs_copy);
+          rnorm[k] = gsl_blas_dnrm2(w->rhs_copy);
+          w->rnorm = GSL_MAX(w->rnorm, rnorm[k]);
+        }
+
+      Destroy_SuperNode_SCP(&(w->L));
+      Destroy_CompCol_NCP(&(w->U));
+    }
+  else
+    {
+      fprintf(stderr, "slu_proc_multi: error in pdgssvx: info = %d\n", info);
     }
-
-  /* compute residual */
-  gsl_vector_memcpy(w->rhs_copy, &vrhs.vector);
-  gsl_spblas_dgemv(CblasNoTrans, 1.0, A, &vsol.vector, -1.0, w->rhs_copy);
-  w->rnorm = gsl_blas_dnrm2(w->rhs_copy);
 
   Destroy_SuperMatrix_Store(&(w->A));
   Destroy_SuperMatrix_Store(&(w->B));
   Destroy_SuperMatrix_Store(&(w->X));
-  Destroy_SuperNode_SCP(&(w->L));
-  Destroy_CompCol_NCP(&(w->U));
 
   free(rind);
   free(data);
+  free(B);
 
-  return GSL_SUCCESS;
-} /* slu_proc() */
+  return info;
+} /* slu_proc_multi() */
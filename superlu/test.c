@@ -142,6 +142,62 @@ test_superlu()
   gsl_rng_free(r);
 } /* test_superlu() */
 
+/* compare slu_proc_multi() against individual slu_proc() calls */
+void
+test_superlu_multi()
+{
+  const int N_max = 50;
+  const size_t nrhs = 3;
+  int n;
+  size_t k;
+  gsl_rng *r = gsl_rng_alloc(gsl_rng_default);
+
+  for (n = 1; n <= N_max; ++n)
+    {
+      gsl_spmatrix *S = gsl_spmatrix_alloc(n, n);
+      gsl_spmatrix *C;
+      gsl_matrix *A = gsl_matrix_alloc(n, n);
+      gsl_matrix *B = gsl_matrix_alloc(nrhs, n);   /* column-major n-by-nrhs */
+      gsl_matrix *X = gsl_matrix_alloc(nrhs, n);
+      gsl_vector *x_slu = gsl_vector_alloc(n);
+      double rnorm[3];
+      slu_workspace *w = slu_alloc(n, n, 1);
+
+      create_random_sparse_matrix(A, r, -10.0, 10.0);
+      gsl_spmatrix_d2sp(S, A);
+      C = gsl_spmatrix_compcol(S);
+
+      for (k = 0; k < nrhs; ++k)
+        {
+          gsl_vector_view bk = gsl_matrix_row(B, k);
+          create_random_vector(&bk.vector, r, -10.0, 10.0);
+        }
+
+      slu_proc_multi(C, nrhs, B->data, X->data, rnorm, w);
+
+      for (k = 0; k < nrhs; ++k)
+        {
+          gsl_vector_view bk = gsl_matrix_row(B, k);
+          gsl_vector_view xk = gsl_matrix_row(X, k);
+
+          gsl_test_abs(rnorm[k], 0.0, 1.0e-8, "multi residual n = %d, k = %zu", n, k);
+
+          slu_proc(C, bk.vector.data, x_slu->data, w);
+          test_vectors(xk.vector.data, x_slu->data, n);
+        }
+
+      gsl_spmatrix_free(S);
+      gsl_spmatrix_free(C);
+      gsl_matrix_free(A);
+      gsl_matrix_free(B);
+      gsl_matrix_free(X);
+      gsl_vector_free(x_slu);
+      slu_free(w);
+    }
+
+  gsl_rng_free(r);
+} /* test_superlu_multi() */
+
 int
 main()
 {
@@ -203,6 +259,7 @@ main()
   printf("cond(A)  = %.12e\n", 1.0 / sw->rcond);
 
   test_superlu();
+  test_superlu_multi();
 
   slu_free(sw);
   gsl_spmatrix_free(A);